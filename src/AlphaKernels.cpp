@@ -0,0 +1,273 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "AlphaKernels.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define ALPHA_KERNELS_SIMD 1
+#endif
+
+// MSVC compiles any intrinsic anywhere; GCC and Clang only inside functions that are
+// built for the instruction set, which these mark
+#if defined(ALPHA_KERNELS_SIMD) && !defined(_MSC_VER)
+#define ALPHA_KERNELS_SSE2 __attribute__((target("sse2")))
+#define ALPHA_KERNELS_AVX2 __attribute__((target("avx2")))
+#else
+#define ALPHA_KERNELS_SSE2
+#define ALPHA_KERNELS_AVX2
+#endif
+
+namespace
+{
+    // c * a / 255 rounded to the nearest integer, which is (c * a + 127) / 255: with
+    // t = c * a + 128, (t + (t >> 8)) >> 8 divides by 255 exactly for every c and a in
+    // 0..255. The SIMD versions do the same in 16-bit lanes, where t cannot overflow.
+    inline uint8_t MultiplyByAlpha(uint32_t c, uint32_t a)
+    {
+        const uint32_t t = c * a + 128;
+        return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+    }
+
+    void BroadcastAlphaScalar(const uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+    {
+        for (uint32_t x = 0; x < pixels; x++)
+        {
+            const uint8_t a = bgra[x*4+3];
+            alpha[x*4+0] = a;
+            alpha[x*4+1] = a;
+            alpha[x*4+2] = a;
+            alpha[x*4+3] = a;
+        }
+    }
+
+    void PremultiplyAlphaScalar(uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+    {
+        for (uint32_t x = 0; x < pixels; x++)
+        {
+            const uint8_t a = bgra[x*4+3];
+            bgra[x*4+0] = MultiplyByAlpha(bgra[x*4+0], a);
+            bgra[x*4+1] = MultiplyByAlpha(bgra[x*4+1], a);
+            bgra[x*4+2] = MultiplyByAlpha(bgra[x*4+2], a);
+
+            if (nullptr != alpha)
+            {
+                alpha[x*4+0] = a;
+                alpha[x*4+1] = a;
+                alpha[x*4+2] = a;
+                alpha[x*4+3] = a;
+            }
+        }
+    }
+
+#ifdef ALPHA_KERNELS_SIMD
+    // Copies the top byte of each 32-bit lane to the other three
+    ALPHA_KERNELS_SSE2 inline __m128i Broadcast(__m128i px)
+    {
+        __m128i a = _mm_srli_epi32(px, 24);
+        a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+        return _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    }
+
+    // Multiplies four 16-bit channels of two pixels by the alpha of each pixel
+    ALPHA_KERNELS_SSE2 inline __m128i Multiply(__m128i channels)
+    {
+        const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(channels, a), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+    }
+
+    ALPHA_KERNELS_SSE2 inline __m128i Premultiply(__m128i px)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+
+        const __m128i lo = Multiply(_mm_unpacklo_epi8(px, zero));
+        const __m128i hi = Multiply(_mm_unpackhi_epi8(px, zero));
+
+        // The alpha itself is kept as it was
+        return _mm_or_si128(_mm_andnot_si128(alphaMask, _mm_packus_epi16(lo, hi)), _mm_and_si128(alphaMask, px));
+    }
+
+    ALPHA_KERNELS_SSE2 void BroadcastAlphaSse2(const uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+    {
+        uint32_t x = 0;
+        for (; x + 4 <= pixels; x += 4)
+        {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bgra + x*4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(alpha + x*4), Broadcast(px));
+        }
+
+        BroadcastAlphaScalar(bgra + x*4, alpha + x*4, pixels - x);
+    }
+
+    ALPHA_KERNELS_SSE2 void PremultiplyAlphaSse2(uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+    {
+        uint32_t x = 0;
+        for (; x + 4 <= pixels; x += 4)
+        {
+            const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bgra + x*4));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(bgra + x*4), Premultiply(px));
+
+            if (nullptr != alpha)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(alpha + x*4), Broadcast(px));
+            }
+        }
+
+        PremultiplyAlphaScalar(bgra + x*4, (nullptr != alpha) ? alpha + x*4 : nullptr, pixels - x);
+    }
+
+    ALPHA_KERNELS_AVX2 inline __m256i Broadcast(__m256i px)
+    {
+        __m256i a = _mm256_srli_epi32(px, 24);
+        a = _mm256_or_si256(a, _mm256_slli_epi32(a, 8));
+        return _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+    }
+
+    ALPHA_KERNELS_AVX2 inline __m256i Multiply(__m256i channels)
+    {
+        const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(channels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(channels, a), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+    }
+
+    ALPHA_KERNELS_AVX2 inline __m256i Premultiply(__m256i px)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+
+        // The unpacks and the pack work within each 128-bit half, so the pixels stay in order
+        const __m256i lo = Multiply(_mm256_unpacklo_epi8(px, zero));
+        const __m256i hi = Multiply(_mm256_unpackhi_epi8(px, zero));
+
+        return _mm256_or_si256(_mm256_andnot_si256(alphaMask, _mm256_packus_epi16(lo, hi)), _mm256_and_si256(alphaMask, px));
+    }
+
+    ALPHA_KERNELS_AVX2 void BroadcastAlphaAvx2(const uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= pixels; x += 8)
+        {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bgra + x*4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(alpha + x*4), Broadcast(px));
+        }
+
+        BroadcastAlphaSse2(bgra + x*4, alpha + x*4, pixels - x);
+    }
+
+    ALPHA_KERNELS_AVX2 void PremultiplyAlphaAvx2(uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+    {
+        uint32_t x = 0;
+        for (; x + 8 <= pixels; x += 8)
+        {
+            const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bgra + x*4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(bgra + x*4), Premultiply(px));
+
+            if (nullptr != alpha)
+            {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(alpha + x*4), Broadcast(px));
+            }
+        }
+
+        PremultiplyAlphaSse2(bgra + x*4, (nullptr != alpha) ? alpha + x*4 : nullptr, pixels - x);
+    }
+
+#ifdef _MSC_VER
+    bool IsSse2Supported()
+    {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[3] & (1 << 26)) != 0;
+    }
+
+    bool IsAvx2Supported()
+    {
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+
+        // The processor has AVX and the OS saves the YMM registers
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || ((_xgetbv(0) & 0x6) != 0x6))
+        {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+#else
+    bool IsSse2Supported()
+    {
+        return __builtin_cpu_supports("sse2");
+    }
+
+    // This also checks that the OS saves the YMM registers
+    bool IsAvx2Supported()
+    {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+#endif
+
+    std::vector<AlphaKernelSet> FindKernels()
+    {
+        std::vector<AlphaKernelSet> kernels;
+
+#ifdef ALPHA_KERNELS_SIMD
+        if (IsAvx2Supported())
+        {
+            kernels.push_back({ L"AVX2", BroadcastAlphaAvx2, PremultiplyAlphaAvx2 });
+        }
+        if (IsSse2Supported())
+        {
+            kernels.push_back({ L"SSE2", BroadcastAlphaSse2, PremultiplyAlphaSse2 });
+        }
+#endif
+        kernels.push_back({ L"scalar", BroadcastAlphaScalar, PremultiplyAlphaScalar });
+
+        return kernels;
+    }
+
+    const AlphaKernelSet &GetKernels()
+    {
+        // Picked once, on first use, from any thread
+        static const AlphaKernelSet kernels = FindKernels().front();
+
+        return kernels;
+    }
+}
+
+void BroadcastAlpha(const uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+{
+    GetKernels().broadcast(bgra, alpha, pixels);
+}
+
+void PremultiplyAlpha(uint8_t *bgra, uint8_t *alpha, uint32_t pixels)
+{
+    GetKernels().premultiply(bgra, alpha, pixels);
+}
+
+const wchar_t *GetAlphaKernelName()
+{
+    return GetKernels().name;
+}
+
+std::vector<AlphaKernelSet> GetSupportedAlphaKernels()
+{
+    return FindKernels();
+}
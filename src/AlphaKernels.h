@@ -0,0 +1,37 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Per-row pixel kernels for the alpha view. Each one has SSE2 and AVX2 versions and a
+// scalar fallback; the fastest one the processor supports is picked on first use. Like
+// the native parsers, they use nothing but the standard library and the intrinsics.
+
+// Writes (a, a, a, a) for each BGRA pixel, which shows the alpha channel as gray
+void BroadcastAlpha(const uint8_t *bgra, uint8_t *alpha, uint32_t pixels);
+
+// Multiplies the colors of each BGRA pixel by its alpha in place, which shows the
+// pixels over black. When alpha is not null, it also does what BroadcastAlpha does.
+void PremultiplyAlpha(uint8_t *bgra, uint8_t *alpha, uint32_t pixels);
+
+// The instruction set of the kernels in use: "AVX2", "SSE2" or "scalar"
+const wchar_t *GetAlphaKernelName();
+
+struct AlphaKernelSet
+{
+    const wchar_t *name;
+    void (*broadcast)(const uint8_t *bgra, uint8_t *alpha, uint32_t pixels);
+    void (*premultiply)(uint8_t *bgra, uint8_t *alpha, uint32_t pixels);
+};
+
+// Every version the processor supports, fastest first and ending with the scalar one,
+// so that they can be checked against each other
+std::vector<AlphaKernelSet> GetSupportedAlphaKernels();
@@ -0,0 +1,204 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "BenchSuite.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cwchar>
+#include <cwctype>
+
+namespace
+{
+    class CTimer final
+    {
+    public:
+        void Start()
+        {
+            m_start = std::chrono::steady_clock::now();
+        }
+
+        [[nodiscard]] double GetElapsedMS() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    int32_t RunFile(IBenchCodec &codec, const std::wstring &filename, bool record, BenchFormatResults &results)
+    {
+        CTimer timer;
+        double bytes = 0;
+
+        timer.Start();
+        int32_t result = codec.Open(filename, bytes);
+        const double openTime = timer.GetElapsedMS();
+
+        if ((result >= 0) && record)
+        {
+            AddBenchSample(results.open, openTime, bytes, codec.GetWorkingSet());
+        }
+
+        if (result >= 0)
+        {
+            result = codec.PrepareRender();
+        }
+
+        if (result >= 0)
+        {
+            uint64_t peakWorkingSet = 0;
+
+            timer.Start();
+            result = codec.Render(bytes, peakWorkingSet);
+            const double renderTime = timer.GetElapsedMS();
+
+            if ((result >= 0) && record)
+            {
+                AddBenchSample(results.render, renderTime, bytes, std::max(peakWorkingSet, codec.GetWorkingSet()));
+            }
+        }
+
+        if (result >= 0)
+        {
+            timer.Start();
+            result = codec.Save(bytes);
+            const double saveTime = timer.GetElapsedMS();
+
+            if ((result >= 0) && record)
+            {
+                AddBenchSample(results.save, saveTime, bytes, codec.GetWorkingSet());
+            }
+        }
+
+        codec.Close();
+
+        return result;
+    }
+}
+
+std::vector<BenchFailure> RunBench(IBenchCodec &codec, const std::vector<std::wstring> &files, uint32_t warmup,
+    uint32_t iterations, std::map<std::wstring, BenchFormatResults> &results)
+{
+    std::vector<BenchFailure> failures;
+
+    for (const std::wstring &filename : files)
+    {
+        BenchFormatResults &formatResults = results[GetBenchFormatName(filename)];
+        formatResults.files++;
+
+        for (uint32_t iteration = 0; iteration < warmup + iterations; iteration++)
+        {
+            const bool record = (iteration >= warmup);
+
+            uint64_t operationsBefore = 0, bytesBefore = 0;
+            codec.GetReadCounters(operationsBefore, bytesBefore);
+
+            const int32_t result = RunFile(codec, filename, record, formatResults);
+
+            if (record)
+            {
+                uint64_t operationsAfter = 0, bytesAfter = 0;
+                codec.GetReadCounters(operationsAfter, bytesAfter);
+                formatResults.readOperations += operationsAfter - operationsBefore;
+                formatResults.readBytes += bytesAfter - bytesBefore;
+            }
+
+            if (result < 0)
+            {
+                failures.push_back({ filename, result });
+                formatResults.failures++;
+                break;
+            }
+        }
+    }
+
+    return failures;
+}
+
+void AddBenchSample(BenchStage &stage, double ms, double bytes, uint64_t workingSet)
+{
+    stage.times.push_back(ms);
+    stage.bytes += bytes;
+    stage.peakWorkingSet = std::max(stage.peakWorkingSet, workingSet);
+}
+
+std::wstring GetBenchFormatName(const std::wstring &filename)
+{
+    const size_t dot = filename.rfind(L'.');
+    const size_t slash = filename.find_last_of(L"\\/");
+    std::wstring extension;
+    if ((dot != std::wstring::npos) && ((slash == std::wstring::npos) || (dot > slash)))
+    {
+        extension = filename.substr(dot + 1);
+    }
+
+    for (wchar_t &c : extension)
+    {
+        c = static_cast<wchar_t>(std::towlower(c));
+    }
+
+    if ((extension == L"jpeg") || (extension == L"jpe"))
+    {
+        extension = L"jpg";
+    }
+    else if (extension == L"tiff")
+    {
+        extension = L"tif";
+    }
+
+    return extension;
+}
+
+double GetPercentile(const std::vector<double> &sorted, double percent)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+
+    const size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+std::wstring FormatBenchHeader()
+{
+    wchar_t line[128];
+    swprintf(line, sizeof(line) / sizeof(line[0]), L"%-8ls %-8ls %8ls %10ls %10ls %10ls %10ls %10ls",
+        L"Format", L"Stage", L"Samples", L"p50 ms", L"p95 ms", L"p99 ms", L"MB/s", L"Peak MB");
+
+    return line;
+}
+
+std::wstring FormatBenchStage(const std::wstring &format, const std::wstring &stage, BenchStage &samples)
+{
+    if (samples.times.empty())
+    {
+        return std::wstring();
+    }
+
+    std::sort(samples.times.begin(), samples.times.end());
+
+    double total = 0;
+    for (const double time : samples.times)
+    {
+        total += time;
+    }
+
+    wchar_t line[256];
+    swprintf(line, sizeof(line) / sizeof(line[0]), L"%-8ls %-8ls %8u %10.2f %10.2f %10.2f %10.1f %10.1f",
+        format.c_str(), stage.c_str(), static_cast<unsigned>(samples.times.size()),
+        GetPercentile(samples.times, 50), GetPercentile(samples.times, 95), GetPercentile(samples.times, 99),
+        (total > 0) ? (samples.bytes / (1024.0 * 1024.0)) / (total / 1000.0) : 0.0,
+        samples.peakWorkingSet / (1024.0 * 1024.0));
+
+    return line;
+}
@@ -0,0 +1,89 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// The timing and reporting of WICBench. Like the native parsers, it uses nothing but
+// the standard library: the codec it measures is behind IBenchCodec, which WICBench
+// implements with the element tree and the tests with a synthetic codec.
+
+// The measurements of one stage over every iteration of every file of a format
+struct BenchStage
+{
+    std::vector<double> times;
+    double bytes{};
+    uint64_t peakWorkingSet{};
+};
+
+struct BenchFormatResults
+{
+    uint32_t files{};
+    uint32_t failures{};
+    BenchStage open;
+    BenchStage render;
+    BenchStage save;
+    // The read operations of the recorded runs, and the bytes they read
+    uint64_t readOperations{};
+    uint64_t readBytes{};
+};
+
+// One run of a file goes Open, PrepareRender, Render, Save and Close; the stages
+// return an HRESULT, and the run stops at the first that fails. Only Open, Render
+// and Save are timed.
+class IBenchCodec
+{
+public:
+    virtual ~IBenchCodec() = default;
+
+    // Sets bytes to the size of the file
+    virtual int32_t Open(const std::wstring &filename, double &bytes) = 0;
+    // Does what the render needs that is not part of it, such as building metadata
+    virtual int32_t PrepareRender() = 0;
+    // Renders the first frame at full size, and sets bytes to the size of the bitmap
+    // and peakWorkingSet to the largest working set seen during the render
+    virtual int32_t Render(double &bytes, uint64_t &peakWorkingSet) = 0;
+    // Sets bytes to the size of the saved file
+    virtual int32_t Save(double &bytes) = 0;
+    // Called after every run, including one that failed
+    virtual void Close() = 0;
+
+    // What the process has used so far; zero where the platform does not say
+    virtual uint64_t GetWorkingSet() = 0;
+    virtual void GetReadCounters(uint64_t &operations, uint64_t &bytes) = 0;
+};
+
+struct BenchFailure
+{
+    std::wstring filename;
+    int32_t result{};
+};
+
+// Runs each file warmup + iterations times, and adds the runs after the warmup to the
+// results of its format. A file that fails is not run again.
+std::vector<BenchFailure> RunBench(IBenchCodec &codec, const std::vector<std::wstring> &files, uint32_t warmup,
+    uint32_t iterations, std::map<std::wstring, BenchFormatResults> &results);
+
+void AddBenchSample(BenchStage &stage, double ms, double bytes, uint64_t workingSet);
+
+// The format a file is reported under: its extension in lower case, with jpeg, jpe
+// and tiff shortened to jpg and tif
+std::wstring GetBenchFormatName(const std::wstring &filename);
+
+// The nearest rank percentile of sorted times
+double GetPercentile(const std::vector<double> &sorted, double percent);
+
+// The columns of the report, and the row of a stage: its sample count, p50, p95 and
+// p99 in milliseconds, throughput and peak working set. The row sorts the times, and
+// is empty for a stage with no samples.
+std::wstring FormatBenchHeader();
+std::wstring FormatBenchStage(const std::wstring &format, const std::wstring &stage, BenchStage &samples);
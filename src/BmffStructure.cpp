@@ -0,0 +1,794 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace FileStructure;
+
+namespace
+{
+    // Boxes nest a few levels deep in real files; this stops a crafted one
+    const int MAX_BOX_DEPTH = 16;
+    // Lists longer than this are cut short in node values
+    const size_t MAX_LISTED_IDS = 32;
+
+    bool IsType(const uint8_t *type, const char *name)
+    {
+        return memcmp(type, name, 4) == 0;
+    }
+
+    // Reads fields of a box one after the other, and remembers when one did not fit
+    class CBoxReader
+    {
+    public:
+        CBoxReader(const uint8_t *data, uint64_t offset, uint64_t end)
+            : m_data(data)
+            , m_offset(offset)
+            , m_end(end)
+        {
+        }
+
+        [[nodiscard]] bool Ok() const
+        {
+            return m_ok;
+        }
+
+        [[nodiscard]] uint64_t Offset() const
+        {
+            return m_offset;
+        }
+
+        [[nodiscard]] uint64_t Remaining() const
+        {
+            return m_ok ? m_end - m_offset : 0;
+        }
+
+        // Reads an unsigned big endian integer of 0, 1, 2, 4 or 8 bytes
+        uint64_t Read(uint32_t bytes)
+        {
+            if (!m_ok || (bytes > m_end - m_offset))
+            {
+                m_ok = false;
+                return 0;
+            }
+
+            uint64_t value = 0;
+            for (uint32_t i = 0; i < bytes; i++)
+            {
+                value = (value << 8) | m_data[m_offset + i];
+            }
+            m_offset += bytes;
+
+            return value;
+        }
+
+        uint8_t Read8()
+        {
+            return static_cast<uint8_t>(Read(1));
+        }
+
+        uint16_t Read16()
+        {
+            return static_cast<uint16_t>(Read(2));
+        }
+
+        uint32_t Read32()
+        {
+            return static_cast<uint32_t>(Read(4));
+        }
+
+        std::wstring ReadFourCC()
+        {
+            if (!m_ok || (4 > m_end - m_offset))
+            {
+                m_ok = false;
+                return std::wstring();
+            }
+
+            std::wstring code = FourCCToWide(m_data + m_offset);
+            m_offset += 4;
+
+            return code;
+        }
+
+        // Reads a null terminated UTF-8 string
+        std::wstring ReadString()
+        {
+            uint64_t start = m_offset;
+            while ((m_offset < m_end) && (m_data[m_offset] != 0))
+            {
+                m_offset++;
+            }
+
+            std::wstring text = Utf8ToWide(m_data + start, static_cast<size_t>(std::min<uint64_t>(m_offset - start, MAX_TEXT_VALUE)));
+            if (m_offset < m_end)
+            {
+                m_offset++;
+            }
+
+            return text;
+        }
+
+    private:
+        const uint8_t *m_data;
+        uint64_t m_offset;
+        uint64_t m_end;
+        bool m_ok{true};
+    };
+
+    std::wstring FormatIdList(const std::vector<uint32_t> &ids)
+    {
+        std::wstring text;
+        for (size_t i = 0; (i < ids.size()) && (i < MAX_LISTED_IDS); i++)
+        {
+            text += (i ? L", " : L"") + std::to_wstring(ids[i]);
+        }
+        if (ids.size() > MAX_LISTED_IDS)
+        {
+            text += L", ...";
+        }
+
+        return text;
+    }
+
+    class CBmffWalker
+    {
+    public:
+        CBmffWalker(const uint8_t *data, size_t size)
+            : m_data(data)
+            , m_size(size)
+        {
+        }
+
+        void WalkBoxes(uint64_t offset, uint64_t end, int depth, StructureNode &parent);
+        // Adds a node per item, with the properties, references and byte ranges of each
+        void AddItems(StructureNode &root);
+
+    private:
+        struct Extent
+        {
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        struct Item
+        {
+            std::wstring type;
+            std::wstring name;
+            std::wstring contentType;
+            uint32_t constructionMethod{};
+            bool located{};
+            std::vector<Extent> extents;
+            std::vector<uint32_t> properties;
+            std::vector<std::pair<std::wstring, std::vector<uint32_t>>> references;
+        };
+
+        struct Property
+        {
+            std::wstring type;
+            std::wstring summary;
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        void DescribeBox(const std::wstring &type, uint64_t payload, uint64_t end, int depth, StructureNode &node);
+        void ReadItemInfo(CBoxReader &reader, uint8_t version, StructureNode &node);
+        void ReadItemLocations(CBoxReader &reader, uint8_t version, StructureNode &node);
+        void ReadItemReferences(CBoxReader &reader, uint8_t version, uint64_t end, StructureNode &node);
+        void ReadPropertyAssociations(CBoxReader &reader, uint8_t version, uint32_t flags, StructureNode &node);
+        void ReadProperties(uint64_t offset, uint64_t end, StructureNode &node);
+        // Returns the item's data if it is one range inside the file, and null otherwise
+        const uint8_t *GetItemData(const Item &item, uint64_t &offset, uint64_t &length) const;
+
+        const uint8_t *m_data;
+        size_t m_size;
+
+        std::map<uint32_t, Item> m_items;
+        std::vector<Property> m_properties;
+        uint32_t m_primaryItem{};
+        bool m_hasPrimaryItem{};
+        // Where the data of the idat box starts, for items stored in it
+        uint64_t m_idatOffset{};
+        uint64_t m_idatLength{};
+    };
+
+    void CBmffWalker::WalkBoxes(uint64_t offset, uint64_t end, int depth, StructureNode &parent)
+    {
+        while (offset < end)
+        {
+            if (end - offset < 8)
+            {
+                parent.AddChild(L"Truncated box", offset, end - offset).AddError(L"There is no room for a box header");
+                return;
+            }
+
+            uint64_t boxSize = ReadBE32(m_data + offset);
+            std::wstring type = FourCCToWide(m_data + offset + 4);
+            uint64_t header = 8;
+
+            if (boxSize == 1)
+            {
+                if (end - offset < 16)
+                {
+                    parent.AddChild(type, offset, end - offset).AddError(L"There is no room for the 64-bit size");
+                    return;
+                }
+                boxSize = ReadBE64(m_data + offset + 8);
+                header = 16;
+            }
+            else if (boxSize == 0)
+            {
+                // The box runs to the end of the file
+                boxSize = end - offset;
+            }
+
+            if (IsType(m_data + offset + 4, "uuid"))
+            {
+                header += 16;
+            }
+
+            StructureNode &node = parent.AddChild(type, offset, std::min(boxSize, end - offset));
+            if ((boxSize < header) || (boxSize > end - offset))
+            {
+                node.AddValue(L"BoxSize", boxSize);
+                node.AddError((boxSize < header) ? L"The box is smaller than its header" : L"The box runs past its parent");
+                return;
+            }
+
+            if (header >= 24)
+            {
+                std::wstring extended;
+                for (uint64_t i = 0; i < 16; i++)
+                {
+                    extended += FormatHex(m_data[offset + header - 16 + i], 2).substr(2);
+                }
+                node.AddValue(L"ExtendedType", extended);
+            }
+
+            DescribeBox(type, offset + header, offset + boxSize, depth, node);
+
+            offset += boxSize;
+        }
+    }
+
+    void CBmffWalker::DescribeBox(const std::wstring &type, uint64_t payload, uint64_t end, int depth, StructureNode &node)
+    {
+        // Boxes that only hold other boxes
+        static const wchar_t *containers[] =
+        {
+            L"moov", L"trak", L"mdia", L"minf", L"stbl", L"dinf", L"edts", L"iprp", L"grpl", L"moof", L"traf", L"mvex",
+        };
+        for (const wchar_t *container : containers)
+        {
+            if (type == container)
+            {
+                if (depth < MAX_BOX_DEPTH)
+                {
+                    WalkBoxes(payload, end, depth + 1, node);
+                }
+                return;
+            }
+        }
+
+        CBoxReader reader(m_data, payload, end);
+
+        if (type == L"ftyp")
+        {
+            std::wstring major = reader.ReadFourCC();
+            uint32_t minor = reader.Read32();
+            std::wstring compatible;
+            while (reader.Remaining() >= 4)
+            {
+                compatible += (compatible.empty() ? L"" : L", ") + reader.ReadFourCC();
+            }
+            node.AddValue(L"MajorBrand", major);
+            node.AddValue(L"MinorVersion", minor);
+            node.AddValue(L"CompatibleBrands", compatible);
+            return;
+        }
+
+        if ((type == L"mdat") || (type == L"free") || (type == L"skip"))
+        {
+            node.AddValue(L"DataLength", end - payload);
+            return;
+        }
+
+        if (type == L"idat")
+        {
+            m_idatOffset = payload;
+            m_idatLength = end - payload;
+            node.AddValue(L"DataLength", end - payload);
+            return;
+        }
+
+        if (type == L"ipco")
+        {
+            ReadProperties(payload, end, node);
+            return;
+        }
+
+        // The remaining boxes the walker knows are full boxes, with a version and flags
+        static const wchar_t *fullBoxes[] = { L"meta", L"hdlr", L"pitm", L"iinf", L"iloc", L"iref", L"ipma" };
+        bool isFullBox = false;
+        for (const wchar_t *fullBox : fullBoxes)
+        {
+            isFullBox = isFullBox || (type == fullBox);
+        }
+        if (!isFullBox)
+        {
+            return;
+        }
+
+        uint8_t version = reader.Read8();
+        uint32_t flags = static_cast<uint32_t>(reader.Read(3));
+        node.AddValue(L"Version", version);
+
+        if (type == L"meta")
+        {
+            if (depth < MAX_BOX_DEPTH)
+            {
+                WalkBoxes(reader.Offset(), end, depth + 1, node);
+            }
+        }
+        else if (type == L"hdlr")
+        {
+            reader.Read32();
+            node.AddValue(L"HandlerType", reader.ReadFourCC());
+        }
+        else if (type == L"pitm")
+        {
+            m_primaryItem = (version == 0) ? reader.Read16() : reader.Read32();
+            m_hasPrimaryItem = reader.Ok();
+            node.AddValue(L"PrimaryItem", m_primaryItem);
+        }
+        else if (type == L"iinf")
+        {
+            ReadItemInfo(reader, version, node);
+        }
+        else if (type == L"iloc")
+        {
+            ReadItemLocations(reader, version, node);
+        }
+        else if (type == L"iref")
+        {
+            ReadItemReferences(reader, version, end, node);
+        }
+        else if (type == L"ipma")
+        {
+            ReadPropertyAssociations(reader, version, flags, node);
+        }
+
+        if (!reader.Ok())
+        {
+            node.AddError(L"The box is cut short");
+        }
+    }
+
+    void CBmffWalker::ReadItemInfo(CBoxReader &reader, uint8_t version, StructureNode &node)
+    {
+        uint32_t count = (version == 0) ? reader.Read16() : reader.Read32();
+        node.AddValue(L"Entries", count);
+
+        // Each entry is an infe box
+        uint64_t offset = reader.Offset();
+        uint64_t end = offset + reader.Remaining();
+        for (uint32_t i = 0; (i < count) && (end - offset >= 12); i++)
+        {
+            uint64_t boxSize = ReadBE32(m_data + offset);
+            if ((boxSize < 12) || (boxSize > end - offset) || !IsType(m_data + offset + 4, "infe"))
+            {
+                node.AddError(L"An entry is not a valid infe box");
+                return;
+            }
+
+            StructureNode &entry = node.AddChild(L"infe", offset, boxSize);
+            CBoxReader infe(m_data, offset + 8, offset + boxSize);
+            uint8_t infeVersion = infe.Read8();
+            infe.Read(3);
+            entry.AddValue(L"Version", infeVersion);
+
+            if (infeVersion >= 2)
+            {
+                uint32_t id = (infeVersion == 2) ? infe.Read16() : infe.Read32();
+                infe.Read16();
+                Item &item = m_items[id];
+                item.type = infe.ReadFourCC();
+                item.name = infe.ReadString();
+                if (item.type == L"mime")
+                {
+                    item.contentType = infe.ReadString();
+                }
+
+                entry.name = L"infe (item " + std::to_wstring(id) + L")";
+                entry.AddValue(L"ItemID", id);
+                entry.AddValue(L"ItemType", item.type);
+                entry.AddValue(L"ItemName", item.name);
+                if (!item.contentType.empty())
+                {
+                    entry.AddValue(L"ContentType", item.contentType);
+                }
+            }
+            if (!infe.Ok())
+            {
+                entry.AddError(L"The box is cut short");
+            }
+
+            offset += boxSize;
+        }
+    }
+
+    void CBmffWalker::ReadItemLocations(CBoxReader &reader, uint8_t version, StructureNode &node)
+    {
+        uint8_t sizes = reader.Read8();
+        uint32_t offsetSize = sizes >> 4;
+        uint32_t lengthSize = sizes & 0x0Fu;
+        sizes = reader.Read8();
+        uint32_t baseOffsetSize = sizes >> 4;
+        uint32_t indexSize = (version >= 1) ? (sizes & 0x0Fu) : 0;
+
+        uint32_t count = (version < 2) ? reader.Read16() : reader.Read32();
+        node.AddValue(L"Items", count);
+
+        for (uint32_t i = 0; (i < count) && reader.Ok(); i++)
+        {
+            uint32_t id = (version < 2) ? reader.Read16() : reader.Read32();
+            uint32_t method = (version >= 1) ? (reader.Read16() & 0x0Fu) : 0;
+            reader.Read16();
+            uint64_t baseOffset = reader.Read(baseOffsetSize);
+            uint16_t extentCount = reader.Read16();
+
+            Item &item = m_items[id];
+            item.located = true;
+            item.constructionMethod = method;
+            for (uint16_t e = 0; (e < extentCount) && reader.Ok(); e++)
+            {
+                reader.Read(indexSize);
+                uint64_t extentOffset = reader.Read(offsetSize);
+                uint64_t extentLength = reader.Read(lengthSize);
+                item.extents.push_back(Extent{ baseOffset + extentOffset, extentLength });
+            }
+        }
+    }
+
+    void CBmffWalker::ReadItemReferences(CBoxReader &reader, uint8_t version, uint64_t end, StructureNode &node)
+    {
+        // The references are boxes named after their type, such as dimg or thmb
+        uint64_t offset = reader.Offset();
+        while (end - offset >= 8)
+        {
+            uint64_t boxSize = ReadBE32(m_data + offset);
+            if ((boxSize < 8) || (boxSize > end - offset))
+            {
+                node.AddError(L"A reference box is not valid");
+                return;
+            }
+
+            std::wstring type = FourCCToWide(m_data + offset + 4);
+            CBoxReader box(m_data, offset + 8, offset + boxSize);
+            uint32_t from = (version == 0) ? box.Read16() : box.Read32();
+            uint16_t count = box.Read16();
+
+            std::vector<uint32_t> to;
+            for (uint16_t i = 0; (i < count) && box.Ok(); i++)
+            {
+                uint32_t id = (version == 0) ? box.Read16() : box.Read32();
+                if (box.Ok())
+                {
+                    to.push_back(id);
+                }
+            }
+
+            StructureNode &reference = node.AddChild(type, offset, boxSize);
+            reference.AddValue(L"FromItem", from);
+            reference.AddValue(L"ToItems", FormatIdList(to));
+            if (!box.Ok())
+            {
+                reference.AddError(L"The box is cut short");
+            }
+
+            m_items[from].references.emplace_back(type, std::move(to));
+
+            offset += boxSize;
+        }
+    }
+
+    void CBmffWalker::ReadPropertyAssociations(CBoxReader &reader, uint8_t version, uint32_t flags, StructureNode &node)
+    {
+        uint32_t count = reader.Read32();
+        node.AddValue(L"Entries", count);
+
+        for (uint32_t i = 0; (i < count) && reader.Ok(); i++)
+        {
+            uint32_t id = (version < 1) ? reader.Read16() : reader.Read32();
+            uint8_t associations = reader.Read8();
+
+            Item &item = m_items[id];
+            for (uint8_t a = 0; (a < associations) && reader.Ok(); a++)
+            {
+                // The top bit marks essential properties
+                uint32_t index = (flags & 1) ? (reader.Read16() & 0x7FFFu) : (reader.Read8() & 0x7Fu);
+                if (index > 0)
+                {
+                    item.properties.push_back(index);
+                }
+            }
+        }
+    }
+
+    void CBmffWalker::ReadProperties(uint64_t offset, uint64_t end, StructureNode &node)
+    {
+        // Properties are numbered from 1 in the order they appear
+        while (end - offset >= 8)
+        {
+            uint64_t boxSize = ReadBE32(m_data + offset);
+            if ((boxSize < 8) || (boxSize > end - offset))
+            {
+                node.AddError(L"A property box is not valid");
+                return;
+            }
+
+            std::wstring type = FourCCToWide(m_data + offset + 4);
+            CBoxReader box(m_data, offset + 8, offset + boxSize);
+            std::wstring summary;
+
+            if (type == L"ispe")
+            {
+                box.Read32();
+                uint32_t width = box.Read32();
+                uint32_t height = box.Read32();
+                summary = std::to_wstring(width) + L"x" + std::to_wstring(height);
+            }
+            else if (type == L"colr")
+            {
+                summary = box.ReadFourCC();
+                if (summary == L"nclx")
+                {
+                    uint16_t primaries = box.Read16();
+                    uint16_t transfer = box.Read16();
+                    uint16_t matrix = box.Read16();
+                    summary += L" " + std::to_wstring(primaries) + L"/" + std::to_wstring(transfer) + L"/" + std::to_wstring(matrix)
+                        + ((box.Read8() & 0x80) ? L" full range" : L" limited range");
+                }
+                else
+                {
+                    summary += L", " + std::to_wstring(box.Remaining()) + L" profile bytes";
+                }
+            }
+            else if (type == L"pixi")
+            {
+                box.Read32();
+                uint8_t channels = box.Read8();
+                for (uint8_t c = 0; (c < channels) && box.Ok(); c++)
+                {
+                    summary += (c ? L"," : L"") + std::to_wstring(box.Read8());
+                }
+                summary += L" bits";
+            }
+            else if (type == L"irot")
+            {
+                summary = std::to_wstring((box.Read8() & 0x03u) * 90) + L" degrees";
+            }
+            else if (type == L"imir")
+            {
+                summary = (box.Read8() & 0x01) ? L"Horizontal axis" : L"Vertical axis";
+            }
+            else if (type == L"auxC")
+            {
+                box.Read32();
+                summary = box.ReadString();
+            }
+            else if ((type == L"av1C") || (type == L"hvcC"))
+            {
+                summary = std::to_wstring(boxSize - 8) + L" bytes of decoder configuration";
+            }
+
+            m_properties.push_back(Property{ type, summary, offset, boxSize });
+
+            StructureNode &property = node.AddChild(type + L" (property " + std::to_wstring(m_properties.size()) + L")", offset, boxSize);
+            if (!summary.empty())
+            {
+                property.AddValue(L"Value", summary);
+            }
+            if (!box.Ok())
+            {
+                property.AddError(L"The box is cut short");
+            }
+
+            offset += boxSize;
+        }
+    }
+
+    const uint8_t *CBmffWalker::GetItemData(const Item &item, uint64_t &offset, uint64_t &length) const
+    {
+        if (item.extents.size() != 1)
+        {
+            return nullptr;
+        }
+
+        offset = item.extents[0].offset;
+        length = item.extents[0].length;
+        if (item.constructionMethod == 1)
+        {
+            if (!InRange(offset, length, m_idatLength))
+            {
+                return nullptr;
+            }
+            offset += m_idatOffset;
+        }
+        else if (item.constructionMethod != 0)
+        {
+            return nullptr;
+        }
+
+        return InRange(offset, length, m_size) ? m_data + offset : nullptr;
+    }
+
+    void CBmffWalker::AddItems(StructureNode &root)
+    {
+        if (m_items.empty())
+        {
+            return;
+        }
+
+        StructureNode &items = root.AddChild(L"Items", 0, 0);
+        items.AddValue(L"Count", m_items.size());
+        if (m_hasPrimaryItem)
+        {
+            items.AddValue(L"PrimaryItem", m_primaryItem);
+        }
+
+        uint64_t first = UINT64_MAX;
+        uint64_t last = 0;
+
+        for (const auto &entry : m_items)
+        {
+            uint32_t id = entry.first;
+            const Item &item = entry.second;
+
+            std::wstring name = L"Item " + std::to_wstring(id) + L" (" + (item.type.empty() ? L"unknown" : item.type) + L")";
+            if (m_hasPrimaryItem && (id == m_primaryItem))
+            {
+                name += L" primary";
+            }
+            StructureNode &node = items.AddChild(name, 0, 0);
+            if (!item.name.empty())
+            {
+                node.AddValue(L"Name", item.name);
+            }
+            if (!item.contentType.empty())
+            {
+                node.AddValue(L"ContentType", item.contentType);
+            }
+
+            for (uint32_t index : item.properties)
+            {
+                if (index <= m_properties.size())
+                {
+                    const Property &property = m_properties[index - 1];
+                    node.AddValue(property.type, property.summary.empty() ? L"(property " + std::to_wstring(index) + L")" : property.summary);
+                }
+                else
+                {
+                    node.AddError(L"Property " + std::to_wstring(index) + L" does not exist");
+                }
+            }
+
+            for (const auto &reference : item.references)
+            {
+                node.AddValue(reference.first == L"dimg" ? L"Tiles" : reference.first == L"thmb" ? L"ThumbnailOf" :
+                    reference.first == L"cdsc" ? L"Describes" : reference.first == L"auxl" ? L"AuxiliaryOf" : reference.first,
+                    FormatIdList(reference.second));
+            }
+
+            // The byte ranges of the item in the file
+            uint64_t itemFirst = UINT64_MAX;
+            uint64_t itemLast = 0;
+            uint64_t total = 0;
+            for (size_t e = 0; e < item.extents.size(); e++)
+            {
+                uint64_t offset = item.extents[e].offset + ((item.constructionMethod == 1) ? m_idatOffset : 0);
+                uint64_t length = item.extents[e].length;
+                StructureNode &extent = node.AddChild(L"Extent " + std::to_wstring(e), offset, length);
+                if (item.constructionMethod == 1)
+                {
+                    extent.AddValue(L"Storage", L"idat box");
+                }
+                if (item.constructionMethod > 1)
+                {
+                    extent.AddError(L"Extents built from other items are not resolved");
+                }
+                else if (!InRange(offset, length, m_size))
+                {
+                    extent.AddError(L"The extent lies outside of the file");
+                }
+                itemFirst = std::min(itemFirst, offset);
+                itemLast = std::max(itemLast, offset + length);
+                total += length;
+            }
+            if (!item.extents.empty())
+            {
+                node.offset = itemFirst;
+                node.length = itemLast - itemFirst;
+                node.AddValue(L"DataLength", total);
+                first = std::min(first, itemFirst);
+                last = std::max(last, itemLast);
+            }
+            else if (!item.located)
+            {
+                node.AddError(L"The item has no location");
+            }
+
+            uint64_t dataOffset = 0;
+            uint64_t dataLength = 0;
+            const uint8_t *data = GetItemData(item, dataOffset, dataLength);
+
+            if ((item.type == L"grid") && data && (dataLength >= 8))
+            {
+                // version, flags, rows - 1, columns - 1, and the output size in 16 or 32 bits
+                bool large = (data[1] & 1) != 0;
+                uint32_t rows = data[2] + 1u;
+                uint32_t columns = data[3] + 1u;
+                node.AddValue(L"GridLayout", std::to_wstring(columns) + L" columns x " + std::to_wstring(rows) + L" rows");
+                if (!large)
+                {
+                    node.AddValue(L"OutputSize", std::to_wstring(ReadBE16(data + 4)) + L"x" + std::to_wstring(ReadBE16(data + 6)));
+                }
+                else if (dataLength >= 12)
+                {
+                    node.AddValue(L"OutputSize", std::to_wstring(ReadBE32(data + 4)) + L"x" + std::to_wstring(ReadBE32(data + 8)));
+                }
+            }
+            else if ((item.type == L"Exif") && data && (dataLength >= 4))
+            {
+                // The Exif data starts with the offset of the TIFF header after the field
+                uint32_t headerOffset = ReadBE32(data);
+                if (InRange(uint64_t(4) + headerOffset, 8, dataLength))
+                {
+                    ParseTiffBlock(data + 4 + headerOffset, static_cast<size_t>(dataLength - 4 - headerOffset), dataOffset + 4 + headerOffset, nullptr, node);
+                }
+            }
+        }
+
+        if (last > 0)
+        {
+            items.offset = first;
+            items.length = last - first;
+        }
+    }
+}
+
+bool ParseBmffStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    // The file starts with a box of type ftyp
+    if ((size < 16) || !IsType(data + 4, "ftyp"))
+    {
+        return false;
+    }
+
+    CBmffWalker walker(data, size);
+    walker.WalkBoxes(0, size, 0, root);
+
+    root.name = L"ISO-BMFF";
+    root.offset = 0;
+    root.length = size;
+    for (const StructureNode &box : root.children)
+    {
+        if ((box.name == L"ftyp") && !box.values.empty())
+        {
+            root.name += L" (" + box.values[0].second + L")";
+        }
+    }
+
+    walker.AddItems(root);
+
+    return true;
+}
@@ -0,0 +1,81 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "ColorContextCache.h"
+
+HRESULT CColorContextCache::GetSrgbContext(IWICColorContextPtr &context, CString &filename)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    // A failure is remembered too, so that a missing profile is not looked for on every render
+    if (!m_srgbLoaded)
+    {
+        WCHAR wzFilename[_MAX_PATH+1];
+        DWORD cbFilename = sizeof(wzFilename);
+        IWICColorContextPtr newContext;
+
+        HRESULT result = g_imagingFactory->CreateColorContext(&newContext);
+
+        if (SUCCEEDED(result))
+        {
+            if (GetColorDirectoryW(nullptr, wzFilename, &cbFilename))
+            {
+                result = StringCchCatW(wzFilename,
+                                       sizeof(wzFilename)/sizeof(wzFilename[0]),
+                                       L"\\sRGB Color Space Profile.icm");
+            }
+            else
+            {
+                result = E_UNEXPECTED;
+            }
+        }
+
+        if (SUCCEEDED(result))
+        {
+            result = newContext->InitializeFromFilename(wzFilename);
+        }
+
+        if (SUCCEEDED(result))
+        {
+            m_srgbContext = newContext;
+            m_srgbFilename = wzFilename;
+        }
+
+        m_srgbResult = result;
+        m_srgbLoaded = true;
+        m_misses++;
+    }
+    else
+    {
+        m_hits++;
+    }
+
+    context = m_srgbContext;
+    filename = m_srgbFilename;
+
+    return m_srgbResult;
+}
+
+void CColorContextCache::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    m_srgbContext = nullptr;
+    m_srgbFilename.Empty();
+    m_srgbLoaded = false;
+}
+
+void CColorContextCache::GetStats(DWORD &hits, DWORD &misses)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    hits = m_hits;
+    misses = m_misses;
+}
@@ -0,0 +1,46 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <mutex>
+
+// Shares the sRGB output color context between renders, so that it is loaded from the
+// color directory once instead of once per frame. A source context is created and its
+// profile parsed when the frame hands it over, so there is nothing to gain from sharing
+// those, and the transforms are bound to their input bitmaps. WIC objects are free
+// threaded, so the context can be used from any thread; it is released by Clear, which
+// has to run before COM is uninitialized.
+class CColorContextCache final
+{
+public:
+    static CColorContextCache &Inst()
+    {
+        static CColorContextCache inst;
+
+        return inst;
+    }
+
+    // Gets the sRGB output context and the profile it was loaded from
+    HRESULT GetSrgbContext(IWICColorContextPtr &context, CString &filename);
+    void Clear();
+
+    // Hits are renders that reused the sRGB context, and misses the times it was loaded
+    void GetStats(DWORD &hits, DWORD &misses);
+
+private:
+    CColorContextCache() = default;
+
+    std::mutex m_lock;
+    bool m_srgbLoaded{};
+    HRESULT m_srgbResult{};
+    IWICColorContextPtr m_srgbContext;
+    CString m_srgbFilename;
+    DWORD m_hits{};
+    DWORD m_misses{};
+};
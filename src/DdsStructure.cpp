@@ -0,0 +1,659 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using namespace FileStructure;
+
+namespace
+{
+    const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+    const uint32_t DDPF_ALPHAPIXELS = 0x1;
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB = 0x40;
+    const uint32_t DDPF_LUMINANCE = 0x20000;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDSCAPS2_VOLUME = 0x200000;
+    const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+    const uint32_t DDS_DIMENSION_TEXTURE3D = 4;
+
+    // A mip chain cannot be longer than this for 32 bit dimensions
+    const uint32_t MAX_MIP_LEVELS = 32;
+    // Far beyond what Direct3D allows. With at most MAX_BITS_PER_PIXEL, a surface of
+    // this size is under 2^45 bytes, so the surfaces that are listed end well within 64
+    // bits; the summary of a larger layout checks its sums instead.
+    const uint32_t MAX_DIMENSION = 1u << 20;
+    // The widest DXGI format; a legacy header may claim any bit count
+    const uint32_t MAX_BITS_PER_PIXEL = 128;
+    // Past this many surfaces the layout is summarized instead of listed
+    const uint64_t MAX_LISTED_SURFACES = 16384;
+
+    const uint32_t HEADER_OFFSET = 4;
+    const uint32_t HEADER_SIZE = 124;
+    const uint32_t DX10_HEADER_SIZE = 20;
+
+    // How the bytes of a surface follow from its size
+    struct SurfaceFormat
+    {
+        // Bytes per 4x4 block of the block compressed formats
+        uint32_t blockBytes;
+        // Bytes per pair of pixels of the packed 4:2:2 formats
+        uint32_t pairBytes;
+        uint32_t bitsPerPixel;
+    };
+
+    struct DxgiFormat
+    {
+        const wchar_t *name;
+        SurfaceFormat format;
+    };
+
+    // Indexed by DXGI_FORMAT; the planar video formats have no size here
+    const DxgiFormat DxgiFormats[] =
+    {
+        { L"UNKNOWN", {} },
+        { L"R32G32B32A32_TYPELESS", { 0, 0, 128 } },
+        { L"R32G32B32A32_FLOAT", { 0, 0, 128 } },
+        { L"R32G32B32A32_UINT", { 0, 0, 128 } },
+        { L"R32G32B32A32_SINT", { 0, 0, 128 } },
+        { L"R32G32B32_TYPELESS", { 0, 0, 96 } },
+        { L"R32G32B32_FLOAT", { 0, 0, 96 } },
+        { L"R32G32B32_UINT", { 0, 0, 96 } },
+        { L"R32G32B32_SINT", { 0, 0, 96 } },
+        { L"R16G16B16A16_TYPELESS", { 0, 0, 64 } },
+        { L"R16G16B16A16_FLOAT", { 0, 0, 64 } },
+        { L"R16G16B16A16_UNORM", { 0, 0, 64 } },
+        { L"R16G16B16A16_UINT", { 0, 0, 64 } },
+        { L"R16G16B16A16_SNORM", { 0, 0, 64 } },
+        { L"R16G16B16A16_SINT", { 0, 0, 64 } },
+        { L"R32G32_TYPELESS", { 0, 0, 64 } },
+        { L"R32G32_FLOAT", { 0, 0, 64 } },
+        { L"R32G32_UINT", { 0, 0, 64 } },
+        { L"R32G32_SINT", { 0, 0, 64 } },
+        { L"R32G8X24_TYPELESS", { 0, 0, 64 } },
+        { L"D32_FLOAT_S8X24_UINT", { 0, 0, 64 } },
+        { L"R32_FLOAT_X8X24_TYPELESS", { 0, 0, 64 } },
+        { L"X32_TYPELESS_G8X24_UINT", { 0, 0, 64 } },
+        { L"R10G10B10A2_TYPELESS", { 0, 0, 32 } },
+        { L"R10G10B10A2_UNORM", { 0, 0, 32 } },
+        { L"R10G10B10A2_UINT", { 0, 0, 32 } },
+        { L"R11G11B10_FLOAT", { 0, 0, 32 } },
+        { L"R8G8B8A8_TYPELESS", { 0, 0, 32 } },
+        { L"R8G8B8A8_UNORM", { 0, 0, 32 } },
+        { L"R8G8B8A8_UNORM_SRGB", { 0, 0, 32 } },
+        { L"R8G8B8A8_UINT", { 0, 0, 32 } },
+        { L"R8G8B8A8_SNORM", { 0, 0, 32 } },
+        { L"R8G8B8A8_SINT", { 0, 0, 32 } },
+        { L"R16G16_TYPELESS", { 0, 0, 32 } },
+        { L"R16G16_FLOAT", { 0, 0, 32 } },
+        { L"R16G16_UNORM", { 0, 0, 32 } },
+        { L"R16G16_UINT", { 0, 0, 32 } },
+        { L"R16G16_SNORM", { 0, 0, 32 } },
+        { L"R16G16_SINT", { 0, 0, 32 } },
+        { L"R32_TYPELESS", { 0, 0, 32 } },
+        { L"D32_FLOAT", { 0, 0, 32 } },
+        { L"R32_FLOAT", { 0, 0, 32 } },
+        { L"R32_UINT", { 0, 0, 32 } },
+        { L"R32_SINT", { 0, 0, 32 } },
+        { L"R24G8_TYPELESS", { 0, 0, 32 } },
+        { L"D24_UNORM_S8_UINT", { 0, 0, 32 } },
+        { L"R24_UNORM_X8_TYPELESS", { 0, 0, 32 } },
+        { L"X24_TYPELESS_G8_UINT", { 0, 0, 32 } },
+        { L"R8G8_TYPELESS", { 0, 0, 16 } },
+        { L"R8G8_UNORM", { 0, 0, 16 } },
+        { L"R8G8_UINT", { 0, 0, 16 } },
+        { L"R8G8_SNORM", { 0, 0, 16 } },
+        { L"R8G8_SINT", { 0, 0, 16 } },
+        { L"R16_TYPELESS", { 0, 0, 16 } },
+        { L"R16_FLOAT", { 0, 0, 16 } },
+        { L"D16_UNORM", { 0, 0, 16 } },
+        { L"R16_UNORM", { 0, 0, 16 } },
+        { L"R16_UINT", { 0, 0, 16 } },
+        { L"R16_SNORM", { 0, 0, 16 } },
+        { L"R16_SINT", { 0, 0, 16 } },
+        { L"R8_TYPELESS", { 0, 0, 8 } },
+        { L"R8_UNORM", { 0, 0, 8 } },
+        { L"R8_UINT", { 0, 0, 8 } },
+        { L"R8_SNORM", { 0, 0, 8 } },
+        { L"R8_SINT", { 0, 0, 8 } },
+        { L"A8_UNORM", { 0, 0, 8 } },
+        { L"R1_UNORM", { 0, 0, 1 } },
+        { L"R9G9B9E5_SHAREDEXP", { 0, 0, 32 } },
+        { L"R8G8_B8G8_UNORM", { 0, 4, 0 } },
+        { L"G8R8_G8B8_UNORM", { 0, 4, 0 } },
+        { L"BC1_TYPELESS", { 8, 0, 0 } },
+        { L"BC1_UNORM", { 8, 0, 0 } },
+        { L"BC1_UNORM_SRGB", { 8, 0, 0 } },
+        { L"BC2_TYPELESS", { 16, 0, 0 } },
+        { L"BC2_UNORM", { 16, 0, 0 } },
+        { L"BC2_UNORM_SRGB", { 16, 0, 0 } },
+        { L"BC3_TYPELESS", { 16, 0, 0 } },
+        { L"BC3_UNORM", { 16, 0, 0 } },
+        { L"BC3_UNORM_SRGB", { 16, 0, 0 } },
+        { L"BC4_TYPELESS", { 8, 0, 0 } },
+        { L"BC4_UNORM", { 8, 0, 0 } },
+        { L"BC4_SNORM", { 8, 0, 0 } },
+        { L"BC5_TYPELESS", { 16, 0, 0 } },
+        { L"BC5_UNORM", { 16, 0, 0 } },
+        { L"BC5_SNORM", { 16, 0, 0 } },
+        { L"B5G6R5_UNORM", { 0, 0, 16 } },
+        { L"B5G5R5A1_UNORM", { 0, 0, 16 } },
+        { L"B8G8R8A8_UNORM", { 0, 0, 32 } },
+        { L"B8G8R8X8_UNORM", { 0, 0, 32 } },
+        { L"R10G10B10_XR_BIAS_A2_UNORM", { 0, 0, 32 } },
+        { L"B8G8R8A8_TYPELESS", { 0, 0, 32 } },
+        { L"B8G8R8A8_UNORM_SRGB", { 0, 0, 32 } },
+        { L"B8G8R8X8_TYPELESS", { 0, 0, 32 } },
+        { L"B8G8R8X8_UNORM_SRGB", { 0, 0, 32 } },
+        { L"BC6H_TYPELESS", { 16, 0, 0 } },
+        { L"BC6H_UF16", { 16, 0, 0 } },
+        { L"BC6H_SF16", { 16, 0, 0 } },
+        { L"BC7_TYPELESS", { 16, 0, 0 } },
+        { L"BC7_UNORM", { 16, 0, 0 } },
+        { L"BC7_UNORM_SRGB", { 16, 0, 0 } },
+        { L"AYUV", { 0, 0, 32 } },
+        { L"Y410", { 0, 0, 32 } },
+        { L"Y416", { 0, 0, 64 } },
+        { L"NV12", {} },
+        { L"P010", {} },
+        { L"P016", {} },
+        { L"420_OPAQUE", {} },
+        { L"YUY2", { 0, 4, 0 } },
+        { L"Y210", { 0, 8, 0 } },
+        { L"Y216", { 0, 8, 0 } },
+        { L"NV11", {} },
+        { L"AI44", { 0, 0, 8 } },
+        { L"IA44", { 0, 0, 8 } },
+        { L"P8", { 0, 0, 8 } },
+        { L"A8P8", { 0, 0, 16 } },
+        { L"B4G4R4A4_UNORM", { 0, 0, 16 } },
+    };
+
+    // The legacy header names formats with a FourCC, or with a D3DFORMAT number in its place
+    bool GetFourCCFormat(const uint8_t *fourCC, std::wstring &name, SurfaceFormat &format)
+    {
+        static const struct
+        {
+            char code[5];
+            SurfaceFormat format;
+        } codes[] =
+        {
+            { "DXT1", { 8, 0, 0 } },
+            { "DXT2", { 16, 0, 0 } },
+            { "DXT3", { 16, 0, 0 } },
+            { "DXT4", { 16, 0, 0 } },
+            { "DXT5", { 16, 0, 0 } },
+            { "ATI1", { 8, 0, 0 } },
+            { "BC4U", { 8, 0, 0 } },
+            { "BC4S", { 8, 0, 0 } },
+            { "ATI2", { 16, 0, 0 } },
+            { "BC5U", { 16, 0, 0 } },
+            { "BC5S", { 16, 0, 0 } },
+            { "RGBG", { 0, 4, 0 } },
+            { "GRGB", { 0, 4, 0 } },
+            { "YUY2", { 0, 4, 0 } },
+            { "UYVY", { 0, 4, 0 } },
+        };
+
+        static const struct
+        {
+            uint32_t number;
+            const wchar_t *name;
+            uint32_t bitsPerPixel;
+        } numbers[] =
+        {
+            { 36, L"A16B16G16R16", 64 },
+            { 110, L"Q16W16V16U16", 64 },
+            { 111, L"R16F", 16 },
+            { 112, L"G16R16F", 32 },
+            { 113, L"A16B16G16R16F", 64 },
+            { 114, L"R32F", 32 },
+            { 115, L"G32R32F", 64 },
+            { 116, L"A32B32G32R32F", 128 },
+            { 117, L"CxV8U8", 16 },
+        };
+
+        for (const auto &code : codes)
+        {
+            if (memcmp(fourCC, code.code, 4) == 0)
+            {
+                name = FourCCToWide(fourCC);
+                format = code.format;
+                return true;
+            }
+        }
+
+        const uint32_t number = ReadLE32(fourCC);
+        for (const auto &entry : numbers)
+        {
+            if (number == entry.number)
+            {
+                name = entry.name;
+                format = { 0, 0, entry.bitsPerPixel };
+                return true;
+            }
+        }
+
+        name = FourCCToWide(fourCC);
+        return false;
+    }
+
+    // The bytes of one surface, or 0 when the format does not say
+    uint64_t GetSurfaceBytes(const SurfaceFormat &format, uint32_t width, uint32_t height)
+    {
+        if (format.blockBytes > 0)
+        {
+            return uint64_t(std::max(1u, (width + 3) / 4)) * std::max(1u, (height + 3) / 4) * format.blockBytes;
+        }
+        if (format.pairBytes > 0)
+        {
+            return ((uint64_t(width) + 1) / 2) * format.pairBytes * height;
+        }
+
+        return ((uint64_t(width) * format.bitsPerPixel + 7) / 8) * height;
+    }
+
+    std::wstring FormatSize(uint32_t width, uint32_t height, uint32_t depth)
+    {
+        std::wstring text = std::to_wstring(width) + L"x" + std::to_wstring(height);
+        if (depth > 1)
+        {
+            text += L"x" + std::to_wstring(depth);
+        }
+
+        return text;
+    }
+
+    void DescribePixelFormat(StructureNode &node, const uint8_t *pf)
+    {
+        const uint32_t flags = ReadLE32(pf + 4);
+
+        node.AddValue(L"Flags", FormatHex(flags, 8));
+        if (flags & DDPF_FOURCC)
+        {
+            node.AddValue(L"FourCC", FourCCToWide(pf + 8));
+        }
+        if (flags & (DDPF_RGB | DDPF_LUMINANCE | DDPF_ALPHAPIXELS))
+        {
+            node.AddValue(L"RGBBitCount", ReadLE32(pf + 12));
+            node.AddValue(L"RBitMask", FormatHex(ReadLE32(pf + 16), 8));
+            node.AddValue(L"GBitMask", FormatHex(ReadLE32(pf + 20), 8));
+            node.AddValue(L"BBitMask", FormatHex(ReadLE32(pf + 24), 8));
+            node.AddValue(L"ABitMask", FormatHex(ReadLE32(pf + 28), 8));
+        }
+    }
+
+    // Describes the surfaces of a texture with too many to list by their number and
+    // size. Sets end to where they end and returns true, or returns false when that is
+    // beyond 64 bits.
+    bool SummarizeSurfaces(StructureNode &dataNode, const SurfaceFormat &format, uint32_t width, uint32_t height,
+        uint32_t depth, uint32_t mipLevels, uint64_t elements, uint64_t offset, uint64_t &end)
+    {
+        // An element holds at most 2^21 slices, and there are at most 6 * 2^32 elements
+        uint64_t surfaces = 0;
+        uint64_t bytes = 0;
+        bool fits = true;
+        for (uint32_t mip = 0; mip < mipLevels; mip++)
+        {
+            const uint32_t levelDepth = std::max(1u, depth >> mip);
+            const uint64_t sliceBytes = GetSurfaceBytes(format, std::max(1u, width >> mip), std::max(1u, height >> mip));
+
+            surfaces += levelDepth;
+            fits = fits && (sliceBytes <= (UINT64_MAX - bytes) / levelDepth);
+            bytes += fits ? sliceBytes * levelDepth : 0;
+        }
+        fits = fits && (bytes <= (UINT64_MAX - offset) / elements);
+
+        dataNode.AddValue(L"Surfaces", surfaces * elements);
+        dataNode.AddValue(L"Layout", L"Not listed, as there are more than " + std::to_wstring(MAX_LISTED_SURFACES) + L" surfaces");
+        if (!fits)
+        {
+            dataNode.AddError(L"The surfaces would need more than 2^64 bytes");
+            return false;
+        }
+
+        end = offset + bytes * elements;
+        dataNode.AddValue(L"SurfaceBytes", bytes * elements);
+        if (end > dataNode.offset + dataNode.length)
+        {
+            dataNode.AddError(L"The file ends inside the surfaces");
+            return false;
+        }
+
+        return true;
+    }
+
+    // Lays out the surfaces that follow the headers. Each array element (each face of
+    // each cube of a cube map) holds its whole mip chain, and each mip level of a
+    // volume texture holds all of its depth slices.
+    class CDdsLayout
+    {
+    public:
+        CDdsLayout(size_t size, const SurfaceFormat &format, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels)
+            : m_size(size)
+            , m_format(format)
+            , m_width(width)
+            , m_height(height)
+            , m_depth(depth)
+            , m_mipLevels(mipLevels)
+        {
+        }
+
+        // Adds the mip chain of one array element; returns false once the data ends
+        bool AddMipChain(StructureNode &parent, uint32_t arrayIndex, uint64_t &offset)
+        {
+            for (uint32_t mip = 0; mip < m_mipLevels; mip++)
+            {
+                const uint32_t width = std::max(1u, m_width >> mip);
+                const uint32_t height = std::max(1u, m_height >> mip);
+                const uint32_t depth = std::max(1u, m_depth >> mip);
+                const uint64_t sliceBytes = GetSurfaceBytes(m_format, width, height);
+
+                StructureNode &level = parent.AddChild(L"Mip #" + std::to_wstring(mip) + L" (" + FormatSize(width, height, depth) + L")",
+                    offset, sliceBytes * depth);
+                level.AddValue(L"Width", width);
+                level.AddValue(L"Height", height);
+                if (m_depth > 1)
+                {
+                    level.AddValue(L"Depth", depth);
+                }
+
+                if (m_depth > 1)
+                {
+                    for (uint32_t slice = 0; slice < depth; slice++)
+                    {
+                        StructureNode &node = level.AddChild(L"Slice #" + std::to_wstring(slice), offset + sliceBytes * slice, sliceBytes);
+                        MarkSurface(node, arrayIndex, mip, slice);
+                    }
+                }
+                else
+                {
+                    MarkSurface(level, arrayIndex, mip, 0);
+                }
+
+                m_surfaces += depth;
+
+                if (!InRange(offset, sliceBytes * depth, m_size))
+                {
+                    level.AddError(L"The file ends inside the mip level");
+                    return false;
+                }
+                offset += sliceBytes * depth;
+            }
+
+            return true;
+        }
+
+        [[nodiscard]] uint64_t Surfaces() const
+        {
+            return m_surfaces;
+        }
+
+    private:
+        static void MarkSurface(StructureNode &node, uint32_t arrayIndex, uint32_t mip, uint32_t slice)
+        {
+            node.ddsSurface = true;
+            node.ddsArrayIndex = arrayIndex;
+            node.ddsMipLevel = mip;
+            node.ddsSlice = slice;
+        }
+
+        size_t m_size;
+        SurfaceFormat m_format;
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_depth;
+        uint32_t m_mipLevels;
+        uint64_t m_surfaces{};
+    };
+}
+
+bool ParseDdsStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    if ((size < 8) || (memcmp(data, "DDS ", 4) != 0) || (ReadLE32(data + 4) != HEADER_SIZE))
+    {
+        return false;
+    }
+
+    root.name = L"DDS";
+    root.offset = 0;
+    root.length = size;
+    root.AddChild(L"Magic", 0, 4);
+
+    StructureNode &headerNode = root.AddChild(L"Header", HEADER_OFFSET, HEADER_SIZE);
+    if (!InRange(HEADER_OFFSET, HEADER_SIZE, size))
+    {
+        headerNode.AddError(L"The file ends inside the header");
+        return true;
+    }
+
+    const uint8_t *header = data + HEADER_OFFSET;
+    const uint32_t flags = ReadLE32(header + 4);
+    const uint32_t height = ReadLE32(header + 8);
+    const uint32_t width = ReadLE32(header + 12);
+    const uint32_t caps2 = ReadLE32(header + 108);
+    const uint8_t *pf = header + 72;
+
+    headerNode.AddValue(L"Flags", FormatHex(flags, 8));
+    headerNode.AddValue(L"Height", height);
+    headerNode.AddValue(L"Width", width);
+    headerNode.AddValue(L"PitchOrLinearSize", ReadLE32(header + 16));
+    headerNode.AddValue(L"Depth", ReadLE32(header + 20));
+    headerNode.AddValue(L"MipMapCount", ReadLE32(header + 24));
+    headerNode.AddValue(L"Caps", FormatHex(ReadLE32(header + 104), 8));
+    headerNode.AddValue(L"Caps2", FormatHex(caps2, 8));
+    DescribePixelFormat(headerNode.AddChild(L"Pixel Format", HEADER_OFFSET + 72, 32), pf);
+
+    std::wstring formatName;
+    SurfaceFormat format{};
+    bool knownFormat = false;
+    uint32_t depth = 1;
+    uint32_t arraySize = 1;
+    uint32_t faces = 1;
+    // The faces of a cube map that are stored, in the order they are stored in
+    uint32_t faceIndices[6] = { 0, 1, 2, 3, 4, 5 };
+    uint64_t offset = HEADER_OFFSET + HEADER_SIZE;
+
+    const uint32_t pfFlags = ReadLE32(pf + 4);
+    if ((pfFlags & DDPF_FOURCC) && (memcmp(pf + 8, "DX10", 4) == 0))
+    {
+        StructureNode &dx10Node = root.AddChild(L"DX10 Header", offset, DX10_HEADER_SIZE);
+        if (!InRange(offset, DX10_HEADER_SIZE, size))
+        {
+            dx10Node.AddError(L"The file ends inside the DX10 header");
+            return true;
+        }
+
+        static const wchar_t *dimensions[] = { L"Unknown", L"Buffer", L"Texture1D", L"Texture2D", L"Texture3D" };
+        static const wchar_t *alphaModes[] = { L"Unknown", L"Straight", L"Premultiplied", L"Opaque", L"Custom" };
+
+        const uint8_t *dx10 = data + offset;
+        const uint32_t dxgiFormat = ReadLE32(dx10);
+        const uint32_t dimension = ReadLE32(dx10 + 4);
+        const uint32_t miscFlag = ReadLE32(dx10 + 8);
+        const uint32_t alphaMode = ReadLE32(dx10 + 16) & 0x7;
+
+        if (dxgiFormat < std::size(DxgiFormats))
+        {
+            formatName = DxgiFormats[dxgiFormat].name;
+            format = DxgiFormats[dxgiFormat].format;
+            knownFormat = (format.blockBytes | format.pairBytes | format.bitsPerPixel) != 0;
+        }
+        else
+        {
+            formatName = std::to_wstring(dxgiFormat);
+        }
+
+        dx10Node.AddValue(L"DxgiFormat", formatName + L" (" + std::to_wstring(dxgiFormat) + L")");
+        dx10Node.AddValue(L"ResourceDimension", (dimension < std::size(dimensions)) ? dimensions[dimension] : L"Unknown");
+        dx10Node.AddValue(L"MiscFlag", FormatHex(miscFlag, 8));
+        dx10Node.AddValue(L"ArraySize", ReadLE32(dx10 + 12));
+        dx10Node.AddValue(L"AlphaMode", (alphaMode < std::size(alphaModes)) ? alphaModes[alphaMode] : L"Unknown");
+
+        arraySize = ReadLE32(dx10 + 12);
+        if (dimension == DDS_DIMENSION_TEXTURE3D)
+        {
+            depth = ReadLE32(header + 20);
+        }
+        if (miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+        {
+            faces = 6;
+        }
+        offset += DX10_HEADER_SIZE;
+    }
+    else
+    {
+        if (pfFlags & DDPF_FOURCC)
+        {
+            knownFormat = GetFourCCFormat(pf + 8, formatName, format);
+        }
+        else if (pfFlags & (DDPF_RGB | DDPF_LUMINANCE | DDPF_ALPHAPIXELS))
+        {
+            format.bitsPerPixel = ReadLE32(pf + 12);
+            formatName = std::wstring((pfFlags & DDPF_LUMINANCE) ? L"Luminance" : L"RGB") + L", " + std::to_wstring(format.bitsPerPixel) + L" bits";
+            knownFormat = (format.bitsPerPixel > 0) && (format.bitsPerPixel <= MAX_BITS_PER_PIXEL) && (format.bitsPerPixel % 8 == 0);
+        }
+
+        if (caps2 & DDSCAPS2_VOLUME)
+        {
+            depth = ReadLE32(header + 20);
+        }
+        if (caps2 & DDSCAPS2_CUBEMAP)
+        {
+            // The legacy header may leave faces out; they are stored in this order
+            faces = 0;
+            for (uint32_t face = 0; face < 6; face++)
+            {
+                if (caps2 & (0x400u << face))
+                {
+                    faceIndices[faces++] = face;
+                }
+            }
+        }
+    }
+
+    const uint32_t maxDimension = std::max({ width, height, depth, 1u });
+    uint32_t fullChain = 1;
+    while ((fullChain < MAX_MIP_LEVELS) && ((maxDimension >> fullChain) > 0))
+    {
+        fullChain++;
+    }
+
+    uint32_t mipLevels = ((flags & DDSD_MIPMAPCOUNT) && (ReadLE32(header + 24) > 0)) ? ReadLE32(header + 24) : 1;
+    const bool mipsClamped = mipLevels > fullChain;
+    mipLevels = std::min(mipLevels, fullChain);
+    depth = std::max(depth, 1u);
+
+    root.AddValue(L"Format", formatName.empty() ? L"Unknown" : formatName);
+    const bool cubeMap = (faces == 6) || (caps2 & DDSCAPS2_CUBEMAP);
+    root.AddValue(L"Dimension", (depth > 1) ? L"Texture3D" : (cubeMap ? L"Cube map" : L"Texture2D"));
+    root.AddValue(L"Size", FormatSize(width, height, depth));
+    root.AddValue(L"MipLevels", mipLevels);
+    root.AddValue(L"ArraySize", arraySize);
+    if (cubeMap)
+    {
+        root.AddValue(L"Faces", faces);
+    }
+    if (format.blockBytes > 0)
+    {
+        root.AddValue(L"BlockSize", std::to_wstring(format.blockBytes) + L" bytes per 4x4 block");
+    }
+    else if (format.pairBytes > 0)
+    {
+        root.AddValue(L"PackedSize", std::to_wstring(format.pairBytes) + L" bytes per 2 pixels");
+    }
+    else if (format.bitsPerPixel > 0)
+    {
+        root.AddValue(L"BitsPerPixel", format.bitsPerPixel);
+    }
+
+    if (mipsClamped)
+    {
+        root.AddError(L"MipMapCount is larger than the mip chain of the texture");
+    }
+    if ((width == 0) || (height == 0) || (arraySize == 0) || (faces == 0))
+    {
+        root.AddError(L"The texture has no surfaces");
+        return true;
+    }
+    if ((width > MAX_DIMENSION) || (height > MAX_DIMENSION) || (depth > MAX_DIMENSION))
+    {
+        root.AddError(L"The texture is too large to lay out");
+        return true;
+    }
+    if (!knownFormat)
+    {
+        root.AddError(L"The size of the surfaces of this format is not known");
+        return true;
+    }
+
+    StructureNode &dataNode = root.AddChild(L"Data", offset, size - std::min<uint64_t>(offset, size));
+
+    const uint64_t elements = uint64_t(arraySize) * faces;
+    const uint64_t surfacesPerElement = (depth > 1) ? (2ull * depth) : mipLevels;
+    if (elements * surfacesPerElement > MAX_LISTED_SURFACES)
+    {
+        uint64_t end = 0;
+        if (SummarizeSurfaces(dataNode, format, width, height, depth, mipLevels, elements, offset, end) && (end < size))
+        {
+            root.AddChild(L"Trailing Data", end, size - end);
+        }
+        return true;
+    }
+
+    static const wchar_t *faceNames[] = { L"+X", L"-X", L"+Y", L"-Y", L"+Z", L"-Z" };
+
+    CDdsLayout layout(size, format, width, height, depth, mipLevels);
+    bool complete = true;
+
+    for (uint32_t element = 0; complete && (element < arraySize); element++)
+    {
+        StructureNode *parent = &dataNode;
+        if (arraySize > 1)
+        {
+            parent = &dataNode.AddChild(L"Array Element #" + std::to_wstring(element), offset, 0);
+        }
+        const uint64_t elementOffset = offset;
+
+        for (uint32_t face = 0; complete && (face < faces); face++)
+        {
+            StructureNode *faceParent = parent;
+            const uint64_t faceOffset = offset;
+            if (cubeMap)
+            {
+                // WIC counts the faces of each cube as array elements
+                faceParent = &parent->AddChild(std::wstring(L"Face ") + faceNames[faceIndices[face]], offset, 0);
+            }
+
+            complete = layout.AddMipChain(*faceParent, element * faces + face, offset);
+
+            if (cubeMap)
+            {
+                faceParent->length = std::min<uint64_t>(offset, size) - faceOffset;
+            }
+        }
+
+        if (arraySize > 1)
+        {
+            parent->length = std::min<uint64_t>(offset, size) - elementOffset;
+        }
+    }
+
+    dataNode.AddValue(L"Surfaces", layout.Surfaces());
+
+    if (complete && (offset < size))
+    {
+        root.AddChild(L"Trailing Data", offset, size - offset);
+    }
+
+    return true;
+}
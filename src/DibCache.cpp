@@ -0,0 +1,198 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "DibCache.h"
+#include "Element.h"
+
+CDibCache::~CDibCache()
+{
+    while (!m_entries.empty())
+    {
+        Remove(m_entries.begin());
+    }
+}
+
+bool CDibCache::Lookup(const Key &key, BitmapRendering &rendering)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    const auto found = m_index.find(key);
+    if (found == m_index.end())
+    {
+        m_misses++;
+        return false;
+    }
+
+    const Entry &entry = *found->second;
+
+    rendering.hDib = CopyDib(entry.hDib);
+    rendering.hAlpha = CopyDib(entry.hAlpha);
+
+    if ((nullptr == rendering.hDib) || ((nullptr != entry.hAlpha) && (nullptr == rendering.hAlpha)))
+    {
+        // Out of memory; the caller renders as if nothing was cached
+        if (nullptr != rendering.hDib)
+        {
+            GlobalFree(rendering.hDib);
+            rendering.hDib = nullptr;
+        }
+        m_misses++;
+        return false;
+    }
+
+    rendering.result = S_OK;
+    rendering.colorContextCount = entry.colorContextCount;
+    rendering.outputColorContext = entry.outputColorContext;
+    rendering.scaled = entry.scaled;
+    rendering.width = entry.width;
+    rendering.height = entry.height;
+    rendering.cached = true;
+
+    // Move it to the front
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    m_hits++;
+
+    return true;
+}
+
+void CDibCache::Add(const Key &key, const BitmapRendering &rendering)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    const auto found = m_index.find(key);
+    if (found != m_index.end())
+    {
+        Remove(found->second);
+    }
+
+    Entry entry{key, CopyDib(rendering.hDib), CopyDib(rendering.hAlpha),
+        rendering.colorContextCount, rendering.outputColorContext,
+        rendering.scaled, rendering.width, rendering.height, 0};
+
+    if ((nullptr == entry.hDib) || ((nullptr != rendering.hAlpha) && (nullptr == entry.hAlpha)))
+    {
+        if (nullptr != entry.hDib)
+        {
+            GlobalFree(entry.hDib);
+        }
+        if (nullptr != entry.hAlpha)
+        {
+            GlobalFree(entry.hAlpha);
+        }
+        return;
+    }
+
+    entry.bytes = GlobalSize(entry.hDib) + ((nullptr != entry.hAlpha) ? GlobalSize(entry.hAlpha) : 0);
+
+    // A bitmap bigger than the whole budget is not worth keeping
+    if (entry.bytes > m_budget)
+    {
+        GlobalFree(entry.hDib);
+        if (nullptr != entry.hAlpha)
+        {
+            GlobalFree(entry.hAlpha);
+        }
+        return;
+    }
+
+    m_bytes += entry.bytes;
+    m_entries.push_front(entry);
+    m_index[key] = m_entries.begin();
+
+    Trim();
+}
+
+void CDibCache::Evict(ULONG id)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    // The keys are ordered by id first, so the element's entries are next to each other
+    auto found = m_index.lower_bound(Key{id, false, false, 0, 0});
+    while ((found != m_index.end()) && (found->first.id == id))
+    {
+        const auto entry = found->second;
+        ++found;
+        Remove(entry);
+    }
+}
+
+void CDibCache::SetBudget(SIZE_T bytes)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    m_budget = bytes;
+    Trim();
+}
+
+void CDibCache::GetStats(DWORD &hits, DWORD &misses, SIZE_T &bytes, SIZE_T &budget)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    hits = m_hits;
+    misses = m_misses;
+    bytes = m_bytes;
+    budget = m_budget;
+}
+
+void CDibCache::Trim()
+{
+    while ((m_bytes > m_budget) && !m_entries.empty())
+    {
+        Remove(std::prev(m_entries.end()));
+    }
+}
+
+void CDibCache::Remove(std::list<Entry>::iterator entry)
+{
+    GlobalFree(entry->hDib);
+    if (nullptr != entry->hAlpha)
+    {
+        GlobalFree(entry->hAlpha);
+    }
+
+    m_bytes -= entry->bytes;
+    m_index.erase(entry->key);
+    m_entries.erase(entry);
+}
+
+HGLOBAL CDibCache::CopyDib(HGLOBAL hGlobal)
+{
+    if (nullptr == hGlobal)
+    {
+        return nullptr;
+    }
+
+    const SIZE_T size = GlobalSize(hGlobal);
+
+    HGLOBAL hCopy = GlobalAlloc(GMEM_MOVEABLE, size);
+    if (nullptr == hCopy)
+    {
+        return nullptr;
+    }
+
+    const void *source = GlobalLock(hGlobal);
+    void *dest = GlobalLock(hCopy);
+
+    if ((nullptr != source) && (nullptr != dest))
+    {
+        memcpy(dest, source, size);
+    }
+
+    GlobalUnlock(hCopy);
+    GlobalUnlock(hGlobal);
+
+    if ((nullptr == source) || (nullptr == dest))
+    {
+        GlobalFree(hCopy);
+        return nullptr;
+    }
+
+    return hCopy;
+}
@@ -0,0 +1,102 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+
+struct BitmapRendering;
+
+// Keeps copies of rendered DIBs so that re-selecting an element does not decode it
+// again. Entries are keyed by the element's render id and the view settings, and the
+// least recently used ones are dropped once the cache holds more than its budget.
+// Elements evict their own entries when they are destroyed, which is what happens
+// to the frames of a decoder when it is unloaded.
+class CDibCache final
+{
+public:
+    enum { DEFAULT_BUDGET_MB = 256 };
+
+    static CDibCache &Inst()
+    {
+        static CDibCache inst;
+
+        return inst;
+    }
+
+    struct Key final
+    {
+        ULONG id;
+        bool alpha;
+        bool premultiply;
+        // The size the bitmap was fitted to, or 0 for full size
+        UINT fitWidth;
+        UINT fitHeight;
+
+        bool operator < (const Key &other) const
+        {
+            if (id != other.id)
+            {
+                return id < other.id;
+            }
+            if (alpha != other.alpha)
+            {
+                return alpha < other.alpha;
+            }
+            if (premultiply != other.premultiply)
+            {
+                return premultiply < other.premultiply;
+            }
+            return (fitWidth != other.fitWidth) ? (fitWidth < other.fitWidth) : (fitHeight < other.fitHeight);
+        }
+    };
+
+    // Fills the rendering with copies of the cached DIBs
+    bool Lookup(const Key &key, BitmapRendering &rendering);
+    // Stores copies of the rendering's DIBs
+    void Add(const Key &key, const BitmapRendering &rendering);
+    // Removes every entry of an element
+    void Evict(ULONG id);
+
+    void SetBudget(SIZE_T bytes);
+    void GetStats(DWORD &hits, DWORD &misses, SIZE_T &bytes, SIZE_T &budget);
+
+private:
+
+    struct Entry final
+    {
+        Key key;
+        HGLOBAL hDib;
+        HGLOBAL hAlpha;
+        int colorContextCount;
+        CString outputColorContext;
+        bool scaled;
+        UINT width;
+        UINT height;
+        SIZE_T bytes;
+    };
+
+    CDibCache() = default;
+    ~CDibCache();
+
+    void Trim();
+    void Remove(std::list<Entry>::iterator entry);
+
+    static HGLOBAL CopyDib(HGLOBAL hGlobal);
+
+    std::mutex m_lock;
+    // Most recently used first
+    std::list<Entry> m_entries;
+    std::map<Key, std::list<Entry>::iterator> m_index;
+    SIZE_T m_bytes{};
+    SIZE_T m_budget{SIZE_T(DEFAULT_BUDGET_MB) * 1024 * 1024};
+    DWORD m_hits{};
+    DWORD m_misses{};
+};
@@ -9,42 +9,144 @@
 #include "pch.h"
 
 #include "Element.h"
+#include "AlphaKernels.h"
+#include "ColorContextCache.h"
+#include "DibCache.h"
+#include "FileStructure.h"
+#include "ImageCache.h"
+#include "MappedFile.h"
+#include "MappedStream.h"
 #include "Stopwatch.h"
+#include "Trace.h"
 #include "PropVariant.h"
 #include "MetadataTranslator.h"
+#include "ProgressiveLevels.h"
 #include "resource.h"
+#include "WorkerPool.h"
 
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+// One level of a progressive frame. The pixels come from the snapshot that
+// CProgressiveLevels keeps of the level, and the rest from the frame.
 class CProgressiveBitmapSource final : public IWICBitmapSource
 {
 public:
-    CProgressiveBitmapSource(IWICBitmapSource * source, int level) :
+    CProgressiveBitmapSource(std::shared_ptr<CProgressiveLevels> levels, UINT level) :
         m_level(level),
-        m_source(source)
-    {
-        m_source->AddRef();
-        m_source->QueryInterface(IID_PPV_ARGS(&m_prog));
-        m_prog->GetLevelCount(&m_max);
-        m_max--;
-    }
-
-    ~CProgressiveBitmapSource()
+        m_levels(std::move(levels)),
+        m_source(m_levels->GetFrame())
     {
-        m_source->Release();
-        m_prog->Release();
     }
 
     HRESULT STDMETHODCALLTYPE QueryInterface(
             REFIID riid,
             void **ppvObject) override
     {
-        if (riid == IID_IUnknown)
+        if ((riid == IID_IUnknown) || (riid == IID_IWICBitmapSource))
         {
             *ppvObject = this;
             AddRef();
             return S_OK;
         }
 
-        if (riid == IID_IWICBitmapSource)
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() override
+    {
+        return ++m_ref;
+    }
+
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+        const ULONG ref = --m_ref;
+        if (!ref)
+        {
+            delete this;
+        }
+
+        return ref;
+    }
+
+    STDMETHOD(GetSize)(
+        UINT *puiWidth,
+        UINT *puiHeight
+        ) override
+    {
+        return m_source->GetSize(puiWidth, puiHeight);
+    }
+
+    STDMETHOD( GetPixelFormat)(
+        WICPixelFormatGUID *pPixelFormat
+        ) override
+    {
+        return m_source->GetPixelFormat(pPixelFormat);
+    }
+
+    STDMETHOD( GetResolution)(
+        double *pDpiX,
+        double *pDpiY
+        ) override
+    {
+        return m_source->GetResolution(pDpiX, pDpiY);
+    }
+
+    STDMETHOD( CopyPalette)(
+        IWICPalette *pIPalette
+        ) override
+    {
+        return m_source->CopyPalette(pIPalette);
+    }
+
+    STDMETHOD( CopyPixels)(
+        const WICRect *prc,
+        const UINT cbStride,
+        const UINT cbBufferSize,
+        BYTE *pbBuffer
+        ) override
+    {
+        return m_levels->CopyPixels(m_level, prc, cbStride, cbBufferSize, pbBuffer);
+    }
+
+
+private:
+    UINT m_level{};
+    std::shared_ptr<CProgressiveLevels> m_levels;
+    IWICBitmapFrameDecodePtr m_source;
+    // Render workers hold it as well as the element. Starts owned by its creator,
+    // which attaches it
+    std::atomic<ULONG> m_ref{1};
+};
+
+// Passes everything through to its source, and adds up how long the source's
+// CopyPixels takes, which includes the stages the source pulls from. Only
+// IWICBitmapSource is exposed, so a stage after it cannot bypass the source.
+class CTimedBitmapSource final : public IWICBitmapSource
+{
+public:
+    explicit CTimedBitmapSource(IWICBitmapSource * source) :
+        m_source(source)
+    {
+        m_source->AddRef();
+    }
+
+    ~CTimedBitmapSource()
+    {
+        m_source->Release();
+    }
+
+    [[nodiscard]] double GetTimeMS() const
+    {
+        return m_timeMS;
+    }
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(
+            REFIID riid,
+            void **ppvObject) override
+    {
+        if ((riid == IID_IUnknown) || (riid == IID_IWICBitmapSource))
         {
             *ppvObject = this;
             AddRef();
@@ -56,20 +158,18 @@ class CProgressiveBitmapSource final : public IWICBitmapSource
 
     ULONG STDMETHODCALLTYPE AddRef() override
     {
-        m_ref++;
-        return m_ref;
+        return ++m_ref;
     }
 
     ULONG STDMETHODCALLTYPE Release() override
     {
-        m_ref--;
-        if (!m_ref)
+        const ULONG ref = --m_ref;
+        if (!ref)
         {
             delete this;
-            return 0;
         }
 
-        return m_ref;
+        return ref;
     }
 
     STDMETHOD(GetSize)(
@@ -109,26 +209,27 @@ class CProgressiveBitmapSource final : public IWICBitmapSource
         BYTE *pbBuffer
         ) override
     {
-        HRESULT result;
+        CStopwatch timer;
+        timer.Start();
 
-        IFC(m_prog->SetCurrentLevel(static_cast<UINT>(m_level)));
-        IFC(m_source->CopyPixels(prc, cbStride, cbBufferSize, pbBuffer));
-        IFC(m_prog->SetCurrentLevel(static_cast<UINT>(m_max)));
+        const HRESULT result = m_source->CopyPixels(prc, cbStride, cbBufferSize, pbBuffer);
+
+        m_timeMS += timer.GetElapsedMS();
 
         return result;
     }
 
-
 private:
-    int m_level{};
-    UINT m_max{};
     IWICBitmapSource * m_source{};
-    IWICProgressiveLevelControl * m_prog{};
-    int m_ref{};
+    double m_timeMS{};
+    // Starts owned by its creator, which attaches it
+    std::atomic<ULONG> m_ref{1};
 };
 
 
-IWICImagingFactoryPtr g_imagingFactory;
+thread_local IWICImagingFactoryPtr g_imagingFactory;
+UINT g_bandHeight = DEFAULT_BAND_HEIGHT;
+bool g_mappedStreams = true;
 
 CInfoElement::CInfoElement(LPCWSTR name)
 {
@@ -162,28 +263,30 @@ void CInfoElement::AddSibling(CInfoElement *element)
     element->Unlink();
     element->m_prevSibling = this;
     element->m_nextSibling = m_nextSibling;
+    if(m_nextSibling)
+    {
+        m_nextSibling->m_prevSibling = element;
+    }
     m_nextSibling = element;
     element->m_parent = m_parent;
+    if(m_parent && m_parent->m_lastChild == this)
+    {
+        m_parent->m_lastChild = element;
+    }
 }
 
 void CInfoElement::AddChild(CInfoElement *element)
 {
-    CInfoElement *firstChild = FirstChild();
-    if(!firstChild)
+    if(!m_lastChild)
     {
         element->Unlink();
         m_firstChild = element;
+        m_lastChild = element;
         element->m_parent = this;
     }
     else
     {
-        CInfoElement *prev = firstChild;
-        while(firstChild)
-        {
-            prev = firstChild;
-            firstChild = firstChild->NextSibling();
-        }
-        prev->AddSibling(element);
+        m_lastChild->AddSibling(element);
     }
 }
 
@@ -202,6 +305,10 @@ void CInfoElement::Unlink()
     {
         m_parent->m_firstChild = m_nextSibling;
     }
+    if(m_parent && m_parent->m_lastChild == this)
+    {
+        m_parent->m_lastChild = m_prevSibling;
+    }
     if(m_nextSibling)
     {
         m_nextSibling->m_prevSibling = m_prevSibling;
@@ -215,6 +322,23 @@ void CInfoElement::Unlink()
     m_parent = nullptr;
 }
 
+HRESULT CInfoElement::EnsureSubtree(ICodeGenerator &codeGen)
+{
+    // Keep going after a failure so that the rest of the tree is still created
+    HRESULT result = EnsureChildren(codeGen);
+
+    for (CInfoElement *child = FirstChild(); nullptr != child; child = child->NextSibling())
+    {
+        const HRESULT childResult = child->EnsureSubtree(codeGen);
+        if (SUCCEEDED(result))
+        {
+            result = childResult;
+        }
+    }
+
+    return result;
+}
+
 void CInfoElement::RemoveChild(CInfoElement *child)
 {
     if(child->m_parent != this)
@@ -233,10 +357,34 @@ HRESULT CElementManager::OpenFile(LPCWSTR filename, ICodeGenerator &codeGen, CIn
 
     if (g_imagingFactory)
     {
-        // Refresh the list of codecs
-        IEnumUnknownPtr enumUnknown;
-        IFC(g_imagingFactory->CreateComponentEnumerator(WICDecoder, WICComponentEnumerateRefresh, &enumUnknown));
+        IFC(RefreshComponents());
+        IFC(LoadFile(filename, codeGen, decElem));
+    }
+
+    return result;
+}
+
+HRESULT CElementManager::RefreshComponents()
+{
+    HRESULT result = S_OK;
+
+    // Refresh the list of codecs
+    IEnumUnknownPtr enumUnknown;
+    IFC(g_imagingFactory->CreateComponentEnumerator(WICDecoder, WICComponentEnumerateRefresh, &enumUnknown));
+
+    return result;
+}
+
+HRESULT CElementManager::LoadFile(LPCWSTR filename, ICodeGenerator &codeGen, CInfoElement *&decElem)
+{
+    // Directories are opened on the worker pool, where this is the outermost span
+    CTraceSpan span("OpenFile", filename);
+    HRESULT result = E_UNEXPECTED;
 
+    ATLASSERT(g_imagingFactory);
+
+    if (g_imagingFactory)
+    {
         // Begin monitoring how long this takes
         CStopwatch creationTimer;
         creationTimer.Start();
@@ -264,61 +412,270 @@ HRESULT CElementManager::OpenFile(LPCWSTR filename, ICodeGenerator &codeGen, CIn
     return result;
 }
 
-void CBitmapDecoderElement::Unload()
+HRESULT CElementManager::LoadFileWithCache(LPCWSTR filename, CImageCache &cache, CInfoElement *&decElem, bool &cached)
+{
+    HRESULT result = S_OK;
+    CSimpleCodeGenerator codeGen;
+
+    decElem = nullptr;
+    cached = false;
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes{};
+    if (!GetFileAttributesExW(filename, GetFileExInfoStandard, &attributes))
+    {
+        return LoadFile(filename, codeGen, decElem);
+    }
+
+    ImageCacheKey key;
+    key.path = filename;
+    key.size = (uint64_t(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+    key.modifiedTime = static_cast<int64_t>((uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+
+    // The content is only read when the path is new or changed since it was cached
+    uint64_t contentHash = 0;
+    const CImageCache::PathState pathState = cache.FindContentHash(key, contentHash);
+    if (CImageCache::PathState::Unchanged != pathState)
+    {
+        CTraceSpan span("HashFile", filename);
+        CMappedFile file;
+        if (FAILED(file.Open(filename)))
+        {
+            return LoadFile(filename, codeGen, decElem);
+        }
+        contentHash = HashImageContent(file.Data(), file.Size());
+    }
+
+    // The sampled hash finds copies and renames of cached files, but a file that was
+    // edited in place may keep it, so a changed path is always loaded again
+    std::shared_ptr<const CachedImageSummary> summary;
+    if (CImageCache::PathState::Changed != pathState)
+    {
+        summary = cache.FindSummary(contentHash);
+    }
+    if (summary)
+    {
+        cache.Store(key, contentHash, nullptr);
+
+        auto *element = new CBitmapDecoderElement(filename);
+        element->SetCacheEntry(contentHash, std::move(summary));
+        decElem = element;
+        cached = true;
+
+        return S_OK;
+    }
+
+    IFC(LoadFile(filename, codeGen, decElem));
+
+    // A thumbnail kept under the same hash may show what the file was before
+    if (CImageCache::PathState::Changed == pathState)
+    {
+        cache.RemoveThumbnail(contentHash);
+    }
+
+    auto *element = dynamic_cast<CBitmapDecoderElement *>(decElem);
+    auto created = std::make_shared<CachedImageSummary>();
+    if ((nullptr != element) && SUCCEEDED(element->CreateSummary(*created)))
+    {
+        cache.Store(key, contentHash, created);
+        element->SetCacheEntry(contentHash, std::move(created));
+    }
+
+    return result;
+}
+
+HRESULT CElementManager::OpenFiles(const CSimpleArray<CString> &filenames, CWorkerPool &pool, CImageCache *cache, DWORD &opened, DWORD &cached)
 {
-    if(m_decoder)
+    HRESULT result = S_OK;
+
+    ATLASSERT(g_imagingFactory);
+
+    CTraceSpan span("OpenFiles");
+    IFC(RefreshComponents());
+
+    struct OpenResult
+    {
+        HRESULT result;
+        CInfoElement *decElem;
+        bool cached;
+    };
+
+    std::vector<OpenResult> results(static_cast<size_t>(filenames.GetSize()), OpenResult{E_PENDING, nullptr, false});
+
+    for (int i = 0; i < filenames.GetSize(); i++)
+    {
+        OpenResult *openResult = &results[static_cast<size_t>(i)];
+        LPCWSTR filename = filenames[i];
+
+        pool.Submit([openResult, filename, cache]
+        {
+            if (nullptr != cache)
+            {
+                openResult->result = LoadFileWithCache(filename, *cache, openResult->decElem, openResult->cached);
+            }
+            else
+            {
+                CSimpleCodeGenerator codeGen;
+                openResult->result = LoadFile(filename, codeGen, openResult->decElem);
+            }
+        });
+    }
+
+    pool.WaitIdle();
+
+    // Attach in the order of the filenames, regardless of which worker finished first
+    for (const OpenResult &openResult : results)
     {
-        m_decoder->Release();
-        m_decoder = nullptr;
+        if (nullptr != openResult.decElem)
+        {
+            root.AddChild(openResult.decElem);
+        }
+
+        if (SUCCEEDED(openResult.result))
+        {
+            opened++;
+            cached += openResult.cached ? 1 : 0;
+        }
+        else
+        {
+            result = openResult.result;
+        }
     }
 
+    return result;
+}
+
+void CBitmapDecoderElement::Unload()
+{
+    // The smart pointer releases its own reference; the thumbnail grid may still
+    // hold others
+    m_decoder = nullptr;
+
     RemoveChildren();
+    m_childrenLoaded = false;
+    m_loadChildrenTime = -1;
     m_loaded = FALSE;
+    m_frameCount = 0;
+    m_nativeFrameCount = false;
+    m_structure.reset();
+    m_file.reset();
+    m_childPages = 1;
+    m_hasHiddenChildren = false;
 }
 
 HRESULT CBitmapDecoderElement::Load(ICodeGenerator &codeGen)
 {
+    CTraceSpan span("Load", m_filename);
     HRESULT result = S_OK;
 
     Unload();
     codeGen.BeginVariableScope(L"IWICBitmapDecoder*", L"decoder", L"NULL");
-    codeGen.CallFunction(L"imagingFactory->CreateDecoderFromFilename(\"%s\", NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)", m_filename.GetString());
-    IFC(g_imagingFactory->CreateDecoderFromFilename(m_filename, NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &m_decoder));
 
-    // For each of the frames, create an element
+    CStopwatch stageTimer;
+    stageTimer.Start();
+
+    // The decoder reads from a mapping of the file, which the native parsers share.
+    // A file that cannot be mapped, such as a multi-gigabyte TIFF in a 32-bit
+    // process, is opened by name as before.
+    std::shared_ptr<CMappedFile> file;
+    if (g_mappedStreams)
+    {
+        file = std::make_shared<CMappedFile>();
+        if (FAILED(file->Open(m_filename)))
+        {
+            file.reset();
+        }
+    }
+
+    if (file)
+    {
+        // A WIC stream on the file is what the generated code can use in its place
+        codeGen.BeginVariableScope(L"IWICStream*", L"stream", L"NULL");
+        codeGen.CallFunction(L"imagingFactory->CreateStream(&stream)");
+        codeGen.CallFunction(L"stream->InitializeFromFilename(\"%s\", GENERIC_READ)", m_filename.GetString());
+        codeGen.CallFunction(L"imagingFactory->CreateDecoderFromStream(stream, NULL, WICDecodeMetadataCacheOnDemand, &decoder)");
+        codeGen.EndVariableScope();
+
+        m_file = file;
+
+        IStreamPtr stream;
+        stream.Attach(new CMappedStream(m_file, m_filename));
+        IFC(g_imagingFactory->CreateDecoderFromStream(stream, NULL, WICDecodeMetadataCacheOnDemand, &m_decoder));
+    }
+    else
+    {
+        codeGen.CallFunction(L"imagingFactory->CreateDecoderFromFilename(\"%s\", NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)", m_filename.GetString());
+        IFC(g_imagingFactory->CreateDecoderFromFilename(m_filename, NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &m_decoder));
+    }
+    m_createDecoderTime = stageTimer.GetElapsedMS();
+
     UINT frameCount = 0;
 
+    // The GIF decoder finds the frames of an animation by reading the whole file.
+    // The native walker reads only the block headers, so the count comes from it,
+    // unless the walk stopped early: a truncated frame or an unknown block may count
+    // differently in WIC, and GetFrame would then fail for the extra frames.
+    GUID containerFormat{};
+    if (SUCCEEDED(m_decoder->GetContainerFormat(&containerFormat)) && (GUID_ContainerFormatGif == containerFormat))
+    {
+        stageTimer.Start();
+        m_structure = ParseStructure();
+        if (m_structure && !m_structure->HasErrors() && (m_structure->frameCount > 0) && (m_structure->frameCount <= UINT_MAX))
+        {
+            frameCount = static_cast<UINT>(m_structure->frameCount);
+            m_nativeFrameCount = true;
+            m_frameCountTime = stageTimer.GetElapsedMS();
+        }
+    }
+
     codeGen.CallFunction(L"decoder->GetFrameCount(&frameCount)");
-    IFC(m_decoder->GetFrameCount(&frameCount));
+    if (!m_nativeFrameCount)
+    {
+        stageTimer.Start();
+        IFC(m_decoder->GetFrameCount(&frameCount));
+        m_frameCountTime = stageTimer.GetElapsedMS();
+    }
+    m_frameCount = frameCount;
 
-    // Even if one frame fails, we keep trying the others. However, we still
-    // want to remember the failure so that we can return it from this function.
-    HRESULT lastFailResult = result;
+    codeGen.EndVariableScope();
+
+    // The frames, thumbnail, preview and metadata are created by LoadChildren
+    // when the element is first expanded or queried
+    m_loaded = TRUE;
+
+    return (frameCount == 0) ? E_FAIL : result;
+}
 
-    if (frameCount == 0)
+std::shared_ptr<const StructureNode> CBitmapDecoderElement::ParseStructure()
+{
+    // The mapping the decoder reads from is reused when there is one
+    if (m_file)
     {
-        lastFailResult = E_FAIL;
+        return CFileStructureElement::Parse(*m_file, m_filename, m_structureParseTime);
     }
 
-    for (UINT i = 0; i < frameCount; i++)
-    {
-        codeGen.BeginVariableScope(L"IWICBitmapFrameDecode*", L"frameDecode", L"NULL");
-        IWICBitmapFrameDecodePtr frameDecode = NULL;
+    return CFileStructureElement::Parse(m_filename, m_structureParseTime);
+}
 
-        codeGen.CallFunction(L"decoder->GetFrame(%d, &frameDecode)", i);
-        HRESULT frameResult = m_decoder->GetFrame(i, &frameDecode);
+HRESULT CBitmapDecoderElement::LoadChildren(ICodeGenerator &codeGen)
+{
+    HRESULT result = S_OK;
 
-        if (SUCCEEDED(frameResult))
-        {
-            frameResult = CElementManager::CreateFrameAndChildElements(this, i, frameDecode, codeGen);
-        }
+    if (!m_loaded)
+    {
+        return E_FAIL;
+    }
 
-        if (FAILED(frameResult))
-        {
-            lastFailResult = frameResult;
-        }
+    CTraceSpan span("LoadChildren", m_filename);
+    CStopwatch loadTimer;
+    loadTimer.Start();
 
-        codeGen.EndVariableScope();
+    // For each of the frames, create an element. The frame itself is only
+    // decoded when its element is expanded or queried.
+    codeGen.CallFunction(L"decoder->GetFrameCount(&frameCount)");
+
+    for (UINT i = 0; i < m_frameCount; i++)
+    {
+        CElementManager::AddChildToElement(this, new CBitmapFrameDecodeElement(i, m_decoder));
     }
 
     // Add the Thumbnail if it exists
@@ -367,11 +724,19 @@ HRESULT CBitmapDecoderElement::Load(ICodeGenerator &codeGen)
         result = S_OK;
     }
 
-    codeGen.EndVariableScope();
+    // The layout of the file, read natively when one of the parsers knows the format
+    if (!m_structure)
+    {
+        m_structure = ParseStructure();
+    }
+    if (m_structure)
+    {
+        CElementManager::AddChildToElement(this, CFileStructureElement::Create(m_structure, m_structureParseTime));
+    }
 
-    m_loaded = FirstChild() != nullptr;
+    m_loadChildrenTime = loadTimer.GetElapsedMS();
 
-    return (FAILED(lastFailResult)) ? lastFailResult : result;
+    return result;
 }
 
 HRESULT CElementManager::CreateDecoderAndChildElements(LPCWSTR filename, ICodeGenerator &codeGen, CInfoElement *&decElem)
@@ -380,20 +745,33 @@ HRESULT CElementManager::CreateDecoderAndChildElements(LPCWSTR filename, ICodeGe
     const HRESULT result = (static_cast<CBitmapDecoderElement *>(decElem)->Load(codeGen));
     if(!static_cast<CBitmapDecoderElement *>(decElem)->IsLoaded())
     {
-        root.RemoveChild(decElem);
+        if(decElem->Parent() == &root)
+        {
+            root.RemoveChild(decElem);
+        }
+        else
+        {
+            // Registration was deferred, so nobody else knows about this element
+            delete decElem;
+        }
         decElem = nullptr;
+
+        // No codec could read the file, but its layout may still be shown
+        double parseTime = 0;
+        std::shared_ptr<const StructureNode> structure = CFileStructureElement::Parse(filename, parseTime);
+        if (structure)
+        {
+            CString name = filename;
+            name = name.Mid(name.ReverseFind('\\') + 1);
+            decElem = CFileStructureElement::Create(std::move(structure), parseTime, name);
+        }
     }
 
     return result;
 }
 
-HRESULT CElementManager::CreateFrameAndChildElements(CInfoElement *parent, UINT index, IWICBitmapFrameDecodePtr frameDecode, ICodeGenerator &codeGen)
+HRESULT CElementManager::CreateFrameChildElements(CInfoElement *frameElem, IWICBitmapFrameDecodePtr frameDecode, ICodeGenerator &codeGen)
 {
-    // Add the frame itself
-    CInfoElement *frameElem = new CBitmapFrameDecodeElement(index, frameDecode);
-
-    AddChildToElement(parent, frameElem);
-
     // Add the Thumbnail if it exists
     IWICBitmapSourcePtr thumb;
 
@@ -419,10 +797,11 @@ HRESULT CElementManager::CreateFrameAndChildElements(CInfoElement *parent, UINT
         result = prog->GetLevelCount(&count);
         if (count > 1)
         {
-            for (int c = 0; c < (int)count; c++)
+            // The levels share the snapshots of a single pass over the scans
+            auto levels = std::make_shared<CProgressiveLevels>(frameDecode, prog, count);
+            for (UINT c = 0; c < count; c++)
             {
-                AddChildToElement(frameElem, new CBitmapSourceElement(L"Level",
-                                              new CProgressiveBitmapSource(frameDecode, c)));
+                AddChildToElement(frameElem, new CProgressiveLevelElement(levels, c));
             }
         }
     }
@@ -450,6 +829,7 @@ HRESULT CElementManager::CreateFrameAndChildElements(CInfoElement *parent, UINT
 
 HRESULT CElementManager::CreateMetadataElementsFromBlock(CInfoElement *parent, IWICMetadataBlockReaderPtr blockReader, ICodeGenerator &codeGen)
 {
+    CTraceSpan span("CreateMetadataElements", parent->Name());
     HRESULT result;
 
     UINT blockCount = 0;
@@ -473,15 +853,21 @@ HRESULT CElementManager::CreateMetadataElementsFromBlock(CInfoElement *parent, I
     return result;
 }
 
-HRESULT CElementManager::CreateMetadataElements(CInfoElement *parent, UINT childIdx, IWICMetadataReaderPtr reader, ICodeGenerator &codeGen)
+HRESULT CElementManager::CreateMetadataElements(CInfoElement *parent, UINT childIdx, IWICMetadataReaderPtr reader, ICodeGenerator & /*codeGen*/)
 {
-    HRESULT result = S_OK;
-
-    // Add this reader
+    // Add this reader; embedded readers are found when it is first expanded
     CInfoElement *readerElem = new CMetadataReaderElement(parent, childIdx, reader);
 
     AddChildToElement(parent, readerElem);
 
+    return S_OK;
+}
+
+HRESULT CElementManager::CreateEmbeddedMetadataElements(CInfoElement *readerElem, IWICMetadataReaderPtr reader, ICodeGenerator &codeGen)
+{
+    CTraceSpan span("CreateMetadataElements", readerElem->Name());
+    HRESULT result = S_OK;
+
     // Search for any embedded readers
     UINT numValues = 0;
 
@@ -532,12 +918,18 @@ HRESULT CElementManager::CreateMetadataElements(CInfoElement *parent, UINT child
 
 void CElementManager::RegisterElement(CInfoElement *element)
 {
-    if(!element->Parent() && !root.IsChild(element) && element != &root)
+    // A new element has no parent, so it cannot already be one of the root's children
+    if(!deferRegistration && !element->Parent() && element != &root)
     {
         root.AddChild(element);
     }
 }
 
+void CElementManager::SetDeferRegistration(bool defer)
+{
+    deferRegistration = defer;
+}
+
 void CElementManager::ClearAllElements()
 {
     root.RemoveChildren();
@@ -578,6 +970,7 @@ CInfoElement *CElementManager::GetRootElement()
 
 HRESULT CElementManager::SaveElementAsImage(CInfoElement &element, REFGUID containerFormat, WICPixelFormatGUID &format, LPCWSTR filename, ICodeGenerator &codeGen)
 {
+    CTraceSpan span("Save", filename);
     HRESULT result = S_OK;
 
     CImageTransencoder te;
@@ -594,6 +987,7 @@ HRESULT CElementManager::SaveElementAsImage(CInfoElement &element, REFGUID conta
 }
 
 CInfoElement CElementManager::root(L"");
+thread_local bool CElementManager::deferRegistration = false;
 
 //----------------------------------------------------------------------------------------
 // COMPONENT INFO ELEMENT
@@ -767,6 +1161,13 @@ void CBitmapDecoderElement::FillContextMenu(HMENU context)
         itemInfo.dwTypeData = const_cast<LPWSTR>(L"Save As Image...");
         InsertMenuItem(context, GetMenuItemCount(context), TRUE, &itemInfo);
 
+        if (m_hasHiddenChildren)
+        {
+            itemInfo.wID = ID_SHOW_MORE_CHILDREN;
+            itemInfo.dwTypeData = const_cast<LPWSTR>(L"Show More Children");
+            InsertMenuItem(context, GetMenuItemCount(context), TRUE, &itemInfo);
+        }
+
         itemInfo.wID = ID_FILE_UNLOAD;
         itemInfo.dwTypeData = const_cast<LPWSTR>(L"Unload");
     }
@@ -790,6 +1191,8 @@ HRESULT CBitmapDecoderElement::SaveAsImage(CImageTransencoder &trans, ICodeGener
         return E_FAIL;
     }
 
+    IFC(EnsureChildren(codeGen));
+
     // Find the frame children and output them
     CInfoElement *child = FirstChild();
     while (nullptr != child)
@@ -847,6 +1250,11 @@ HRESULT CBitmapDecoderElement::OutputView(IOutputDevice &output, const InfoEleme
         int oldSize = output.SetFontSize(20);
         output.AddText(L"File not loaded");
         output.SetFontSize(oldSize);
+
+        if (m_cachedSummary)
+        {
+            result = OutputCachedSummary(output);
+        }
         return result;
     }
 
@@ -858,31 +1266,78 @@ HRESULT CBitmapDecoderElement::OutputView(IOutputDevice &output, const InfoEleme
 
         output.AddKeyValue(L"Filename", m_filename);
 
-        // Get the number of frames
-        UINT numFrames = 0;
-        m_decoder->GetFrameCount(&numFrames);
         CString value;
-        value.Format(L"%u", numFrames);
+        value.Format(L"%u", m_frameCount);
         output.AddKeyValue(L"FrameCount", value);
+        output.AddKeyValue(L"FrameCountSource", m_nativeFrameCount ? L"File structure" : L"WIC");
 
         // Display the decode time
         value.Format(L"%u ms", m_creationTime);
         output.AddKeyValue(L"CreationTime", value);
 
+        // The parts of it, and of the first expansion
+        value.Format(L"%.2f ms", m_createDecoderTime);
+        output.AddKeyValue(L"CreateDecoderTime", value);
+        value.Format(L"%.2f ms", m_frameCountTime);
+        output.AddKeyValue(L"GetFrameCountTime", value);
+        if (m_loadChildrenTime >= 0)
+        {
+            value.Format(L"%.2f ms", m_loadChildrenTime);
+            output.AddKeyValue(L"LoadChildrenTime", value);
+        }
+
         output.EndKeyValues();
 
         // Also show the children
-        CInfoElement *child = FirstChild();
-        while (nullptr != child)
+        if (context.bIsChildViewEnable)
+        {
+            CSimpleCodeGenerator codeGen;
+            EnsureChildren(codeGen);
+        }
+
+        // A page of children at a time, with their bitmaps as thumbnails; a child is
+        // only rendered in full when it is selected itself
+        InfoElementViewContext childContext = context;
+        UINT childLimit = UINT_MAX;
+        if (context.childPageSize > 0)
+        {
+            childLimit = context.childPageSize * m_childPages;
+        }
+        if (context.childFitSize > 0)
+        {
+            childContext.fitWidth = (context.fitWidth > 0) ? std::min(context.fitWidth, context.childFitSize) : context.childFitSize;
+            childContext.fitHeight = (context.fitHeight > 0) ? std::min(context.fitHeight, context.childFitSize) : context.childFitSize;
+        }
+
+        CInfoElement *child = context.bIsChildViewEnable ? FirstChild() : nullptr;
+        UINT shown = 0;
+        while ((nullptr != child) && (shown < childLimit))
         {
             output.BeginSection(child->Name());
 
-            child->OutputView(output, context);
+            child->OutputView(output, childContext);
             child = child->NextSibling();
+            shown++;
 
             output.EndSection();
         }
 
+        m_hasHiddenChildren = (nullptr != child);
+        if (m_hasHiddenChildren)
+        {
+            UINT hidden = 0;
+            for (; nullptr != child; child = child->NextSibling())
+            {
+                hidden++;
+            }
+
+            output.BeginKeyValues(L"");
+            value.Format(L"%u of %u", shown, shown + hidden);
+            output.AddKeyValue(L"ChildrenShown", value);
+            output.AddKeyValue(L"More", L"Choose Show More Children on the file's context menu");
+            output.EndKeyValues();
+        }
+
         // Show the code
         if (m_creationCode.GetLength() > 0)
         {
@@ -898,6 +1353,169 @@ HRESULT CBitmapDecoderElement::OutputView(IOutputDevice &output, const InfoEleme
     return result;
 }
 
+HRESULT GetPixelFormatName(WCHAR *dest, UINT chars, WICPixelFormatGUID guid);
+
+namespace
+{
+    static_assert(sizeof(GUID) == sizeof(CacheGuid), "A CacheGuid holds the bytes of a GUID");
+
+    CacheGuid ToCacheGuid(REFGUID guid)
+    {
+        CacheGuid bytes{};
+        memcpy(bytes.data(), &guid, bytes.size());
+
+        return bytes;
+    }
+
+    GUID FromCacheGuid(const CacheGuid &bytes)
+    {
+        GUID guid{};
+        memcpy(&guid, bytes.data(), bytes.size());
+
+        return guid;
+    }
+
+    // The friendly names of the readers of a decoder or frame
+    void GetMetadataReaderNames(IUnknown *object, std::vector<std::wstring> &names)
+    {
+        HRESULT result = S_OK;
+        IWICMetadataBlockReaderPtr blockReader;
+        UINT count = 0;
+
+        if (FAILED(object->QueryInterface(IID_PPV_ARGS(&blockReader))) || FAILED(blockReader->GetCount(&count)))
+        {
+            return;
+        }
+
+        for (UINT i = 0; i < count; i++)
+        {
+            IWICMetadataReaderPtr reader;
+            IWICMetadataHandlerInfoPtr info;
+            CString name;
+
+            if (SUCCEEDED(blockReader->GetReaderByIndex(i, &reader)) && SUCCEEDED(reader->GetMetadataHandlerInfo(&info)))
+            {
+                READ_WIC_STRING(info->GetFriendlyName, name);
+            }
+
+            names.emplace_back(name.IsEmpty() ? L"Unknown" : name.GetString());
+        }
+    }
+
+    CString JoinNames(const std::vector<std::wstring> &names)
+    {
+        CString joined;
+        for (const std::wstring &name : names)
+        {
+            if (!joined.IsEmpty())
+            {
+                joined += L", ";
+            }
+            joined += name.c_str();
+        }
+
+        return joined.IsEmpty() ? CString(L"None") : joined;
+    }
+}
+
+HRESULT CBitmapDecoderElement::CreateSummary(CachedImageSummary &summary)
+{
+    HRESULT result = S_OK;
+
+    if (!m_loaded)
+    {
+        return E_FAIL;
+    }
+
+    IWICBitmapDecoderInfoPtr decoderInfo;
+    CLSID clsid{};
+    IFC(m_decoder->GetDecoderInfo(&decoderInfo));
+    IFC(decoderInfo->GetCLSID(&clsid));
+    summary.decoderClsid = ToCacheGuid(clsid);
+
+    GUID containerFormat{};
+    IFC(m_decoder->GetContainerFormat(&containerFormat));
+    summary.containerFormat = ToCacheGuid(containerFormat);
+
+    summary.frameCount = m_frameCount;
+    GetMetadataReaderNames(m_decoder, summary.metadataReaders);
+
+    // The frames are created here but not decoded
+    const UINT listedFrames = std::min<UINT>(m_frameCount, CImageCache::MAX_SUMMARY_FRAMES);
+    summary.frames.resize(listedFrames);
+    for (UINT i = 0; i < listedFrames; i++)
+    {
+        CachedFrameSummary &frameSummary = summary.frames[i];
+        IWICBitmapFrameDecodePtr frame;
+        WICPixelFormatGUID pixelFormat{};
+
+        IFC(m_decoder->GetFrame(i, &frame));
+        IFC(frame->GetSize(&frameSummary.width, &frameSummary.height));
+        IFC(frame->GetPixelFormat(&pixelFormat));
+        frameSummary.pixelFormat = ToCacheGuid(pixelFormat);
+        GetMetadataReaderNames(frame, frameSummary.metadataReaders);
+    }
+
+    return result;
+}
+
+HRESULT CBitmapDecoderElement::OutputCachedSummary(IOutputDevice &output)
+{
+    HRESULT result = S_OK;
+    const CachedImageSummary &summary = *m_cachedSummary;
+
+    output.BeginKeyValues(L"Cached Summary");
+
+    output.AddKeyValue(L"Filename", m_filename);
+
+    CString value;
+    value.Format(L"%u", summary.frameCount);
+    output.AddKeyValue(L"FrameCount", value);
+
+    CString name;
+    IWICComponentInfoPtr decoderInfo;
+    if (SUCCEEDED(g_imagingFactory->CreateComponentInfo(FromCacheGuid(summary.decoderClsid), &decoderInfo)))
+    {
+        READ_WIC_STRING(decoderInfo->GetFriendlyName, name);
+    }
+    WCHAR guid[64];
+    StringFromGUID2(FromCacheGuid(summary.decoderClsid), guid, ARRAYSIZE(guid));
+    value.Format(L"%s %s", name.GetString(), guid);
+    output.AddKeyValue(L"Decoder", value);
+
+    StringFromGUID2(FromCacheGuid(summary.containerFormat), guid, ARRAYSIZE(guid));
+    output.AddKeyValue(L"ContainerFormat", guid);
+    output.AddKeyValue(L"MetadataReaders", JoinNames(summary.metadataReaders));
+
+    for (size_t i = 0; i < summary.frames.size(); i++)
+    {
+        const CachedFrameSummary &frame = summary.frames[i];
+
+        WCHAR pixelFormat[128];
+        if (FAILED(GetPixelFormatName(pixelFormat, ARRAYSIZE(pixelFormat), FromCacheGuid(frame.pixelFormat))))
+        {
+            StringFromGUID2(FromCacheGuid(frame.pixelFormat), pixelFormat, ARRAYSIZE(pixelFormat));
+        }
+
+        CString key;
+        key.Format(L"Frame #%u", static_cast<UINT>(i));
+        value.Format(L"%ux%u %s; metadata: %s", frame.width, frame.height, pixelFormat, JoinNames(frame.metadataReaders).GetString());
+        output.AddKeyValue(key, value);
+    }
+
+    if (summary.frames.size() < summary.frameCount)
+    {
+        value.Format(L"%u of %u", static_cast<UINT>(summary.frames.size()), summary.frameCount);
+        output.AddKeyValue(L"FramesListed", value);
+    }
+
+    output.AddKeyValue(L"Load", L"Choose Load on the file's context menu to see its frames");
+    output.EndKeyValues();
+
+    // A decoder that is no longer installed only leaves its name out
+    return S_OK;
+}
+
 HRESULT CBitmapDecoderElement::OutputInfo(IOutputDevice &output)
 {
     HRESULT result = S_OK;
@@ -927,6 +1545,13 @@ void CBitmapDecoderElement::SetCreationCode(LPCWSTR code)
 // BITMAP SOURCE ELEMENT
 //----------------------------------------------------------------------------------------
 
+std::atomic<ULONG> CBitmapSourceElement::s_lastRenderId{};
+
+CBitmapSourceElement::~CBitmapSourceElement()
+{
+    CDibCache::Inst().Evict(m_renderId);
+}
+
 void CBitmapSourceElement::FillContextMenu(const HMENU context)
 {
     CInfoElement::FillContextMenu(context);
@@ -941,6 +1566,11 @@ void CBitmapSourceElement::FillContextMenu(const HMENU context)
     itemInfo.dwTypeData = const_cast<LPWSTR>(L"Save As Image...");
 
     InsertMenuItem(context, GetMenuItemCount(context), TRUE, &itemInfo);
+
+    itemInfo.wID = ID_RENDER_FULL_SIZE;
+    itemInfo.dwTypeData = const_cast<LPWSTR>(L"Render at Full Resolution");
+
+    InsertMenuItem(context, GetMenuItemCount(context), TRUE, &itemInfo);
 }
 
 HRESULT CBitmapSourceElement::SaveAsImage(CImageTransencoder &trans, ICodeGenerator & /*codeGen*/)
@@ -1006,134 +1636,351 @@ HRESULT CBitmapSourceElement::OutputView(IOutputDevice &output, const InfoElemen
         StringFromGUID2(pixelFormat, v + len, int(ARRAYSIZE(v) - len));
         output.AddKeyValue(L"Format", v);
 
+        if (!context.bIsRenderEnable)
+        {
+            output.EndKeyValues();
+            return S_OK;
+        }
+
+        if (nullptr != context.pDeferredRenders)
+        {
+            // The caller renders the bitmap, and puts it in place of the placeholder when it is done
+            BitmapRenderRequest request = CreateRenderRequest(context);
+
+            request.placeholderStart = output.GetPosition();
+            output.AddKeyValue(L"Time", L"Rendering...");
+            output.EndKeyValues();
+            request.placeholderEnd = output.GetPosition();
+
+            context.pDeferredRenders->Add(request);
+            return S_OK;
+        }
+
         // Now, the bitmap itself
-        CStopwatch renderTimer;
-        renderTimer.Start();
+        BitmapRenderRequest request = CreateRenderRequest(context);
+
+        BitmapRendering rendering;
+        Render(request, nullptr, rendering);
+        OutputRendering(output, rendering);
+
+        result = rendering.result;
+    }
+    else
+    {
+    }
+
+    return result;
+}
+
+BitmapRenderRequest CBitmapSourceElement::CreateRenderRequest(const InfoElementViewContext &context) const
+{
+    BitmapRenderRequest request;
+    request.name = m_name;
+    request.source = m_source;
+    request.cacheId = m_renderId;
+    request.alpha = context.bIsAlphaEnable;
+    request.premultiply = context.bIsPremultiplyEnable;
+    request.fitWidth = context.fitWidth;
+    request.fitHeight = context.fitHeight;
+
+    return request;
+}
+
+HRESULT CBitmapSourceElement::CreateColorTransform(IWICBitmapSourcePtr source, IWICBitmapSourcePtr input,
+    IWICBitmapSourcePtr &colorTransform, BitmapRendering &rendering)
+{
+    IWICBitmapFrameDecodePtr frame;
+    IWICColorContextPtr colorContextSrc;
+    IWICColorContextPtr colorContextDst;
+    IWICColorTransformPtr newTransform;
+    CString dstFilename;
+    UINT cActual = 0;
+
+    // Only a frame has color contexts
+    HRESULT result = source->QueryInterface(IID_PPV_ARGS(&frame));
 
-        HGLOBAL hGlobal = nullptr;
-        HGLOBAL hAlpha = nullptr;
-        IWICBitmapSourcePtr source;
+    if (SUCCEEDED(result))
+    {
+        IWICColorContext **ppiContextSrc = &colorContextSrc;
+        result = g_imagingFactory->CreateColorContext(ppiContextSrc);
 
-        if (m_colorTransform == NULL)
+        if (SUCCEEDED(result))
         {
-            IWICBitmapFrameDecodePtr frame;
-            IWICColorContextPtr colorContextSrc;
-            IWICColorContextPtr colorContextDst;
-            IWICColorTransformPtr colorTransform;
-            WCHAR wzFilename[_MAX_PATH+1];
-            UINT cActual = 0;
+            result = frame->GetColorContexts(1, ppiContextSrc, &cActual);
+            if (SUCCEEDED(result))
+            {
+                rendering.colorContextCount = static_cast<int>(cActual);
+            }
+        }
 
-            result = m_source->QueryInterface(IID_PPV_ARGS(&frame));
+        if (SUCCEEDED(result) && cActual > 0)
+        {
+            // The sRGB profile is only loaded once
+            result = CColorContextCache::Inst().GetSrgbContext(colorContextDst, dstFilename);
 
             if (SUCCEEDED(result))
             {
-                IWICColorContext **ppiContextSrc = &colorContextSrc;
-                result = g_imagingFactory->CreateColorContext(ppiContextSrc);
+                result = g_imagingFactory->CreateColorTransformer(&newTransform);
+            }
 
+            if (SUCCEEDED(result))
+            {
+                result = newTransform->Initialize(input,
+                                                  colorContextSrc,
+                                                  colorContextDst,
+                                                  GUID_WICPixelFormat32bppBGRA);
                 if (SUCCEEDED(result))
                 {
-                    result = frame->GetColorContexts(1, ppiContextSrc, &cActual);
-                    CString value;
-                    value.Format(L"%u", cActual);
-                    output.AddKeyValue(L"Total ColorContexts", value);
+                    colorTransform = newTransform;
+                    rendering.outputColorContext = dstFilename;
                 }
+            }
+        }
+    }
 
-                if (SUCCEEDED(result) && cActual > 0)
-                {
-                    result = g_imagingFactory->CreateColorContext(&colorContextDst);
-
-                    if (SUCCEEDED(result))
-                    {
-                        DWORD cbFilename = sizeof(wzFilename);
-
-                        if (GetColorDirectoryW(nullptr, wzFilename, &cbFilename))
-                        {
-                            result = StringCchCatW(wzFilename,
-                                                   sizeof(wzFilename)/sizeof(wzFilename[0]),
-                                                   L"\\sRGB Color Space Profile.icm");
-                        }
-                        else
-                        {
-                            result = E_UNEXPECTED;
-                        }
-
-                        if (SUCCEEDED(result))
-                        {
-                            result = colorContextDst->InitializeFromFilename(wzFilename);
-                        }
-                    }
-
-                    if (SUCCEEDED(result))
-                    {
-                        result = g_imagingFactory->CreateColorTransformer(&colorTransform);
-                    }
-
-                    if (SUCCEEDED(result))
-                    {
-                        result = colorTransform->Initialize(m_source,
-                                                            colorContextSrc,
-                                                            colorContextDst,
-                                                            GUID_WICPixelFormat32bppBGRA);
-                        if (SUCCEEDED(result))
-                        {
-                            m_colorTransform = colorTransform;
-                            output.AddKeyValue(L"Output ColorContext", wzFilename);
-                        }
-                    }
-                }
+    return result;
+}
 
-            }
+static SIZE_T GetPeakWorkingSet()
+{
+    PROCESS_MEMORY_COUNTERS memoryCounters{};
+    memoryCounters.cb = sizeof(memoryCounters);
 
-        }
+    return GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters))
+        ? memoryCounters.PeakWorkingSetSize : 0;
+}
 
-        if (m_colorTransform)
+HRESULT CBitmapSourceElement::Render(BitmapRenderRequest &request, const RenderCancellation *cancel, BitmapRendering &rendering)
+{
+    CTraceSpan span("Render", request.name);
+    CStopwatch renderTimer;
+    renderTimer.Start();
+
+    CDibCache::Key cacheKey{request.cacheId, request.alpha, request.premultiply, request.fitWidth, request.fitHeight};
+
+    if ((0 != request.cacheId) && CDibCache::Inst().Lookup(cacheKey, rendering))
+    {
+        rendering.renderTime = renderTimer.GetTimeMS();
+        return rendering.result;
+    }
+
+    UINT width = 0, height = 0;
+    rendering.result = request.source->GetSize(&width, &height);
+    if (FAILED(rendering.result))
+    {
+        return rendering.result;
+    }
+
+    rendering.width = width;
+    rendering.height = height;
+
+    // The process's peak counter catches what is allocated inside CopyPixels too
+    const SIZE_T peakBefore = GetPeakWorkingSet();
+
+    CStopwatch setupTimer;
+    setupTimer.Start();
+
+    IWICBitmapSourcePtr input = request.source;
+
+    if ((request.fitWidth > 0) && (request.fitHeight > 0) && ((width > request.fitWidth) || (height > request.fitHeight)))
+    {
+        // Keep the aspect ratio, and never go below one pixel
+        const double scale = std::min(double(request.fitWidth) / width, double(request.fitHeight) / height);
+        rendering.width = std::max(1U, UINT(width * scale));
+        rendering.height = std::max(1U, UINT(height * scale));
+
+        // The scaler goes directly on the source, before color management and format
+        // conversion, so that only the scaled pixels go through those stages. When the
+        // source is a frame whose codec implements IWICBitmapSourceTransform, the
+        // scaler uses the codec's own downscaling and the full image is never decoded.
+        IWICBitmapScalerPtr scaler;
+        rendering.result = g_imagingFactory->CreateBitmapScaler(&scaler);
+        if (SUCCEEDED(rendering.result))
         {
-            source = m_colorTransform;
+            rendering.result = scaler->Initialize(request.source, rendering.width, rendering.height, WICBitmapInterpolationModeFant);
         }
-        else
+        if (FAILED(rendering.result))
         {
-            source = m_source;
+            return rendering.result;
         }
 
-        result = CreateDibFromBitmapSource(source, hGlobal, context.bIsAlphaEnable ? &hAlpha : nullptr);
+        input = scaler;
+        rendering.scaled = true;
+    }
 
-        const DWORD renderTime = renderTimer.GetTimeMS();
+    // Each stage is timed by what it pulls from the one after it
+    IWICBitmapSourcePtr decodeStage;
+    decodeStage.Attach(new CTimedBitmapSource(input));
 
-        // Note how long it took to render
-        StringCchPrintfW(v, 64, L"%u ms", renderTime);
-        output.AddKeyValue(L"Time", v);
+    IWICBitmapSourcePtr colorTransform;
+    IWICBitmapSourcePtr transformStage;
 
-        output.EndKeyValues();
+    CreateColorTransform(request.source, decodeStage, colorTransform, rendering);
+    if (colorTransform)
+    {
+        transformStage.Attach(new CTimedBitmapSource(colorTransform));
+    }
 
-        // Output the bitmap
-        if (SUCCEEDED(result))
+    rendering.stageTimes.setup = setupTimer.GetElapsedMS();
+
+    rendering.result = CreateDibFromBitmapSource(transformStage ? transformStage : decodeStage,
+        request, cancel, rendering);
+
+    // Take the time of the stages each one pulled from out of its own
+    RenderStageTimes &stageTimes = rendering.stageTimes;
+    stageTimes.decode = static_cast<CTimedBitmapSource *>(decodeStage.GetInterfacePtr())->GetTimeMS();
+    if (transformStage)
+    {
+        const double transformTime = static_cast<CTimedBitmapSource *>(transformStage.GetInterfacePtr())->GetTimeMS();
+        stageTimes.colorTransform = std::max(0.0, transformTime - stageTimes.decode);
+        stageTimes.conversion = std::max(0.0, stageTimes.conversion - transformTime);
+    }
+    else
+    {
+        stageTimes.conversion = std::max(0.0, stageTimes.conversion - stageTimes.decode);
+    }
+
+    rendering.renderTime = renderTimer.GetTimeMS();
+
+    if ((0 != request.cacheId) && SUCCEEDED(rendering.result))
+    {
+        CDibCache::Inst().Add(cacheKey, rendering);
+    }
+
+    rendering.peakWorkingSet = GetPeakWorkingSet();
+    rendering.peakWorkingSetGrowth = (rendering.peakWorkingSet > peakBefore) ? rendering.peakWorkingSet - peakBefore : 0;
+
+    return rendering.result;
+}
+
+void CBitmapSourceElement::OutputRendering(IOutputDevice &output, BitmapRendering &rendering)
+{
+    CString value;
+
+    if (rendering.colorContextCount >= 0)
+    {
+        value.Format(L"%d", rendering.colorContextCount);
+        output.AddKeyValue(L"Total ColorContexts", value);
+    }
+
+    if (rendering.outputColorContext.GetLength() > 0)
+    {
+        output.AddKeyValue(L"Output ColorContext", rendering.outputColorContext);
+    }
+
+    if (rendering.scaled)
+    {
+        value.Format(L"%u x %u (fit to view)", rendering.width, rendering.height);
+        output.AddKeyValue(L"Rendered Size", value);
+    }
+
+    // Note how long it took to render
+    value.Format(rendering.cached ? L"%u ms (cached)" : L"%u ms", rendering.renderTime);
+    output.AddKeyValue(L"Time", value);
+
+    if (!rendering.cached && SUCCEEDED(rendering.result))
+    {
+        const RenderStageTimes &stageTimes = rendering.stageTimes;
+
+        value.Format(L"%.2f ms", stageTimes.setup);
+        output.AddKeyValue(L"Setup Time", value);
+
+        value.Format(L"%.2f ms", stageTimes.decode);
+        output.AddKeyValue(rendering.scaled ? L"Decode and Scale Time" : L"Decode Time", value);
+
+        if (rendering.outputColorContext.GetLength() > 0)
         {
-            output.AddText(L"RGB:\n");
-            output.AddDib(hGlobal);
-            if (hAlpha != nullptr)
-            {
-                output.AddText(L"Alpha:\n");
-                output.AddDib(hAlpha);
-            }
+            value.Format(L"%.2f ms", stageTimes.colorTransform);
+            output.AddKeyValue(L"Color Transform Time", value);
         }
-        else
+
+        value.Format(L"%.2f ms", stageTimes.conversion);
+        output.AddKeyValue(L"Format Conversion Time", value);
+
+        if (stageTimes.alpha > 0)
         {
-            CString msg;
-            CString err;
+            value.Format(L"%.2f ms", stageTimes.alpha);
+            output.AddKeyValue(L"Alpha Time", value);
+        }
+    }
 
-            GetHresultString(result, err);
+    if (rendering.peakWorkingSet > 0)
+    {
+        value.Format(L"%.1f MB, %.1f MB higher after the render, in bands of %u rows",
+            rendering.peakWorkingSet / (1024.0 * 1024.0), rendering.peakWorkingSetGrowth / (1024.0 * 1024.0), g_bandHeight);
+        output.AddKeyValue(L"Peak Working Set", value);
+    }
 
-            msg.Format(L"Failed to convert IWICBitmapSource to HBITMAP: %s", (LPCWSTR)err);
-            COLORREF oldColor = output.SetTextColor(RGB(255, 0, 0));
-            output.AddText(msg);
-            output.SetTextColor(oldColor);
+    output.EndKeyValues();
+
+    // Output the bitmap
+    if (SUCCEEDED(rendering.result))
+    {
+        CStopwatch insertTimer;
+        insertTimer.Start();
+
+        output.AddText(L"RGB:\n");
+        output.AddDib(rendering.hDib);
+        rendering.hDib = nullptr;
+        if (rendering.hAlpha != nullptr)
+        {
+            output.AddText(L"Alpha:\n");
+            output.AddDib(rendering.hAlpha);
+            rendering.hAlpha = nullptr;
         }
+
+        // Only known once the bitmaps are in, so it goes after them
+        rendering.stageTimes.insert = insertTimer.GetElapsedMS();
+
+        output.BeginKeyValues(L"");
+        value.Format(L"%.2f ms", rendering.stageTimes.insert);
+        output.AddKeyValue(L"Insert Time", value);
+        output.EndKeyValues();
     }
     else
     {
+        CString msg;
+        CString err;
+
+        GetHresultString(rendering.result, err);
+
+        msg.Format(L"Failed to convert IWICBitmapSource to HBITMAP: %s", (LPCWSTR)err);
+        COLORREF oldColor = output.SetTextColor(RGB(255, 0, 0));
+        output.AddText(msg);
+        output.SetTextColor(oldColor);
     }
+}
 
-    return result;
+BitmapRendering::BitmapRendering(BitmapRendering &&other) noexcept
+    : result(other.result)
+    , hDib(other.hDib)
+    , hAlpha(other.hAlpha)
+    , renderTime(other.renderTime)
+    , colorContextCount(other.colorContextCount)
+    , outputColorContext(other.outputColorContext)
+    , cached(other.cached)
+    , scaled(other.scaled)
+    , width(other.width)
+    , height(other.height)
+    , peakWorkingSet(other.peakWorkingSet)
+    , peakWorkingSetGrowth(other.peakWorkingSetGrowth)
+    , stageTimes(other.stageTimes)
+{
+    other.hDib = nullptr;
+    other.hAlpha = nullptr;
+}
+
+BitmapRendering::~BitmapRendering()
+{
+    if (nullptr != hDib)
+    {
+        GlobalFree(hDib);
+    }
+
+    if (nullptr != hAlpha)
+    {
+        GlobalFree(hAlpha);
+    }
 }
 
 HRESULT CBitmapSourceElement::OutputInfo(IOutputDevice & /*output*/)
@@ -1153,8 +2000,8 @@ bool HasAlpha (REFWICPixelFormatGUID pGuid)
         || IsEqualGUID(pGuid, GUID_WICPixelFormat128bppRGBAFixedPoint);
 }
 
-HRESULT CBitmapSourceElement::CreateDibFromBitmapSource(IWICBitmapSourcePtr source,
-    HGLOBAL &hGlobal, HGLOBAL* phAlpha)
+HRESULT CBitmapSourceElement::CreateDibFromBitmapSource(IWICBitmapSourcePtr source, const BitmapRenderRequest &request,
+    const RenderCancellation *cancel, BitmapRendering &rendering)
 {
     HRESULT result = S_OK;
     if (NULL == source)
@@ -1162,13 +2009,19 @@ HRESULT CBitmapSourceElement::CreateDibFromBitmapSource(IWICBitmapSourcePtr sour
         return E_INVALIDARG;
     }
 
+    HGLOBAL &hGlobal = rendering.hDib;
+    HGLOBAL *phAlpha = request.alpha ? &rendering.hAlpha : nullptr;
+    RenderStageTimes &stageTimes = rendering.stageTimes;
+
     UINT width = 0, height = 0;
     UINT stride = 0;
 
     WICPixelFormatGUID pFormatGuid;
     IFC (source->GetPixelFormat(&pFormatGuid));
 
-    const bool bAlphaEnabled = (phAlpha != nullptr) && HasAlpha (pFormatGuid);
+    const bool bHasAlpha = HasAlpha (pFormatGuid);
+    const bool bAlphaEnabled = (phAlpha != nullptr) && bHasAlpha;
+    const bool bPremultiply = request.premultiply && bHasAlpha;
 
     // Create a format converter
     IWICFormatConverterPtr formatConverter;
@@ -1178,21 +2031,14 @@ HRESULT CBitmapSourceElement::CreateDibFromBitmapSource(IWICBitmapSourcePtr sour
     IFC(formatConverter->Initialize(source, GUID_WICPixelFormat32bppBGRA,
         WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom));
 
-    // Create a FlipRotator because windows requires the bitmap to be bottom-up
-    IWICBitmapFlipRotatorPtr flipper;
-    IFC(g_imagingFactory->CreateBitmapFlipRotator(&flipper));
-
-    // Init the format converter to output Bgra32
-    IFC(flipper->Initialize(formatConverter, WICBitmapTransformFlipVertical));
-
     // Get the size
-    IFC(flipper->GetSize(&width, &height));
+    IFC(formatConverter->GetSize(&width, &height));
     stride = width * 4;
 
     // Force the stride to be a multiple of sizeof(DWORD)
     stride = ((stride + sizeof(DWORD) - 1) / sizeof(DWORD)) * sizeof(DWORD);
 
-    const SIZE_T dibSize = sizeof(BITMAPINFOHEADER) + stride*height;
+    const SIZE_T dibSize = sizeof(BITMAPINFOHEADER) + SIZE_T(stride)*height;
 
     // Allocate the DIB bytes
     hGlobal = GlobalAlloc(GMEM_MOVEABLE, dibSize);
@@ -1209,82 +2055,122 @@ HRESULT CBitmapSourceElement::CreateDibFromBitmapSource(IWICBitmapSourcePtr sour
     if (nullptr == dibBytes)
     {
         GlobalFree(hGlobal);
+        hGlobal = nullptr;
         return E_OUTOFMEMORY;
     }
 
+    // Set the header. The negative height makes the DIB top-down, so its rows are
+    // in the order the converter produces them and need no flipping.
     auto* bmih = reinterpret_cast<BITMAPINFOHEADER*>(dibBytes);
     BYTE *dibPixels = dibBytes + sizeof(BITMAPINFOHEADER);
 
-    // Set the header
     ZeroMemory(bmih, sizeof(BITMAPINFOHEADER));
     bmih->biSize = sizeof(BITMAPINFOHEADER);
     bmih->biPlanes = 1;
     bmih->biBitCount = 32;
     bmih->biCompression = BI_RGB;
     bmih->biWidth = width;
-    bmih->biHeight = height;
+    bmih->biHeight = -static_cast<LONG>(height);
     bmih->biSizeImage = stride*height;
 
-    // Copy the pixels
-    WICRect rct;
-    rct.X = 0;
-    rct.Y = 0;
-    rct.Width = width;
-    rct.Height = height;
-
-    result = flipper->CopyPixels(&rct, stride, stride*height, dibPixels);
+    BYTE *dibAlphaPixels = nullptr;
 
     if (bAlphaEnabled)
     {
+        // The alpha view is handed to its own OLE object, so it cannot share the
+        // allocation of the RGB one
         *phAlpha = GlobalAlloc(GMEM_MOVEABLE, dibSize);
         ATLASSERT(NULL != *phAlpha);
-        if (nullptr == hGlobal)
+
+        BYTE *dibAlphaBytes = (nullptr != *phAlpha) ? static_cast<BYTE*>(GlobalLock(*phAlpha)) : nullptr;
+        ATLASSERT(dibAlphaBytes);
+
+        if (nullptr == dibAlphaBytes)
         {
-        return E_OUTOFMEMORY;
+            if (nullptr != *phAlpha)
+            {
+                GlobalFree(*phAlpha);
+                *phAlpha = nullptr;
+            }
+            GlobalUnlock(hGlobal);
+            GlobalFree(hGlobal);
+            hGlobal = nullptr;
+            return E_OUTOFMEMORY;
         }
 
-        BYTE *dibPixels2 = dibBytes + sizeof(BITMAPINFOHEADER);
+        // The alpha view has the same header as the RGB one
+        memcpy(dibAlphaBytes, bmih, sizeof(BITMAPINFOHEADER));
+        dibAlphaPixels = dibAlphaBytes + sizeof(BITMAPINFOHEADER);
+    }
 
-        BYTE *dibAlphaBytes = static_cast<BYTE*>(GlobalLock(*phAlpha));
+    // The pixels are pulled through the converter one band at a time, top to
+    // bottom, which is the order sequential decoders produce them in. Each band
+    // goes straight into its rows of the DIB, and the alpha view is filled from
+    // those rows while they are still in the cache.
+    const UINT bandHeight = std::max(1U, std::min(g_bandHeight, height));
 
-        ATLASSERT(dibAlphaBytes);
-        if (nullptr == dibAlphaBytes)
+    for (UINT top = 0; (top < height) && SUCCEEDED(result); top += bandHeight)
+    {
+        if ((nullptr != cancel) && cancel->IsCanceled())
         {
-            GlobalFree(phAlpha);
-            *phAlpha = nullptr;
-            return E_OUTOFMEMORY;
+            result = E_ABORT;
+            break;
         }
 
-        BYTE *dibAlphaPixels = dibAlphaBytes + sizeof(BITMAPINFOHEADER);
-        auto* bmih2 = reinterpret_cast<BITMAPINFOHEADER*>(dibAlphaBytes);
+        // Copy the pixels
+        WICRect rct;
+        rct.X = 0;
+        rct.Y = static_cast<INT>(top);
+        rct.Width = static_cast<INT>(width);
+        rct.Height = static_cast<INT>(std::min(bandHeight, height - top));
+
+        BYTE *bandPixels = dibPixels + SIZE_T(stride) * top;
+
+        CStopwatch stageTimer;
+        stageTimer.Start();
+
+        result = formatConverter->CopyPixels(&rct, stride, stride * rct.Height, bandPixels);
 
-        // Set the header
-        ZeroMemory(bmih2, sizeof(BITMAPINFOHEADER));
-        bmih2->biSize = sizeof(BITMAPINFOHEADER);
-        bmih2->biPlanes = 1;
-        bmih2->biBitCount = 32;
-        bmih2->biCompression = BI_RGB;
-        bmih2->biWidth = width;
-        bmih2->biHeight = height;
-        bmih2->biSizeImage = stride*height;
+        stageTimes.conversion += stageTimer.GetElapsedMS();
 
-        // Fill the dibpixels with alpha values:
-        for (unsigned y = 0; y < height; y++)
+        if (FAILED(result))
+        {
+            break;
+        }
+
+        if (bPremultiply || (nullptr != dibAlphaPixels))
         {
-            for (unsigned x = 0; x < width; x++)
+            stageTimer.Start();
+
+            for (INT y = 0; y < rct.Height; y++)
             {
-                dibAlphaPixels[x*4+0] = dibPixels2[x*4+3];
-                dibAlphaPixels[x*4+1] = dibPixels2[x*4+3];
-                dibAlphaPixels[x*4+2] = dibPixels2[x*4+3];
-                dibAlphaPixels[x*4+3] = dibPixels2[x*4+3];
+                const SIZE_T rowOffset = SIZE_T(stride) * (top + y);
+                BYTE *dibRow = dibPixels + rowOffset;
+                BYTE *alphaRow = (nullptr != dibAlphaPixels) ? dibAlphaPixels + rowOffset : nullptr;
+
+                // Fill the alpha pixels with the alpha values, in the same pass as the
+                // premultiply when there is one
+                if (bPremultiply)
+                {
+                    PremultiplyAlpha(dibRow, alphaRow, width);
+                }
+                else
+                {
+                    BroadcastAlpha(dibRow, alphaRow, width);
+                }
             }
-            dibAlphaPixels += stride;
-            dibPixels2 += stride;
+
+            stageTimes.alpha += stageTimer.GetElapsedMS();
         }
+    }
+
+    if (nullptr != dibAlphaPixels)
+    {
         GlobalUnlock (*phAlpha);
         if (FAILED(result))
         {
             GlobalFree(*phAlpha);
+            *phAlpha = nullptr;
         }
     }
 
@@ -1294,6 +2180,7 @@ HRESULT CBitmapSourceElement::CreateDibFromBitmapSource(IWICBitmapSourcePtr sour
     if (FAILED(result))
     {
         GlobalFree(hGlobal);
+        hGlobal = nullptr;
     }
 
     return result;
@@ -1319,10 +2206,44 @@ void CBitmapFrameDecodeElement::FillContextMenu(HMENU context)
     InsertMenuItem(context, GetMenuItemCount(context), TRUE, &itemInfo);
 }
 
+HRESULT CBitmapFrameDecodeElement::EnsureFrame()
+{
+    HRESULT result = S_OK;
+
+    if (NULL == m_frameDecode)
+    {
+        CTraceSpan span("GetFrame", m_name);
+        IFC(m_decoder->GetFrame(m_index, &m_frameDecode));
+        m_source = m_frameDecode;
+    }
+
+    return result;
+}
+
+HRESULT CBitmapFrameDecodeElement::LoadChildren(ICodeGenerator &codeGen)
+{
+    HRESULT result = S_OK;
+
+    codeGen.BeginVariableScope(L"IWICBitmapFrameDecode*", L"frameDecode", L"NULL");
+    codeGen.CallFunction(L"decoder->GetFrame(%d, &frameDecode)", m_index);
+    result = EnsureFrame();
+
+    if (SUCCEEDED(result))
+    {
+        result = CElementManager::CreateFrameChildElements(this, m_frameDecode, codeGen);
+    }
+
+    // Ended on failure too, so that the generated code stays balanced
+    codeGen.EndVariableScope();
+
+    return result;
+}
+
 HRESULT CBitmapFrameDecodeElement::SaveAsImage(CImageTransencoder &trans, ICodeGenerator & /*codeGen*/)
 {
     HRESULT result = S_OK;
 
+    IFC(EnsureFrame());
     IFC(trans.AddFrame(m_frameDecode));
 
     return result;
@@ -1332,6 +2253,8 @@ HRESULT CBitmapFrameDecodeElement::OutputView(IOutputDevice &output, const InfoE
 {
     HRESULT result = S_OK;
 
+    IFC(EnsureFrame());
+
     ATLASSERT(NULL != m_frameDecode);
 
     if (NULL != m_frameDecode)
@@ -1347,6 +2270,73 @@ HRESULT CBitmapFrameDecodeElement::OutputInfo(IOutputDevice & /*output*/)
     return S_OK;
 }
 
+CProgressiveLevelElement::CProgressiveLevelElement(std::shared_ptr<CProgressiveLevels> levels, UINT level)
+    : CBitmapSourceElement(L"", IWICBitmapSourcePtr(new CProgressiveBitmapSource(levels, level), false))
+    , m_levels(std::move(levels))
+    , m_level(level)
+{
+    m_name.Format(L"Level #%u", level);
+}
+
+HRESULT CProgressiveLevelElement::OutputView(IOutputDevice &output, const InfoElementViewContext& context)
+{
+    std::vector<CProgressiveLevels::LevelStats> levels;
+    SIZE_T bytes = 0;
+    UINT walks = 0;
+    m_levels->GetStats(levels, bytes, walks);
+
+    output.BeginKeyValues(L"Progressive Level");
+
+    CString value;
+    value.Format(L"%u of %u", m_level + 1, static_cast<UINT>(levels.size()));
+    output.AddKeyValue(L"Level", value);
+
+    // The time of each level is the time to get to it from the level before, so
+    // that encodes with different scan scripts can be compared
+    if (levels[m_level].decodeMS >= 0)
+    {
+        value.Format(L"%.2f ms", levels[m_level].decodeMS);
+    }
+    else
+    {
+        value = L"Not decoded yet";
+    }
+    output.AddKeyValue(L"DecodeTime", value);
+
+    CString times;
+    double total = 0;
+    UINT cached = 0;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        if (!times.IsEmpty())
+        {
+            times += L", ";
+        }
+        if (levels[i].decodeMS >= 0)
+        {
+            value.Format(L"%.2f", levels[i].decodeMS);
+            total += levels[i].decodeMS;
+        }
+        else
+        {
+            value = L"-";
+        }
+        times += value;
+        cached += levels[i].cached ? 1 : 0;
+    }
+    output.AddKeyValue(L"LevelTimes", times + L" ms");
+    value.Format(L"%.2f ms", total);
+    output.AddKeyValue(L"TotalDecodeTime", value);
+    value.Format(L"%u of %u levels, %.1f MB", cached, static_cast<UINT>(levels.size()), bytes / (1024.0 * 1024.0));
+    output.AddKeyValue(L"Snapshots", value);
+    value.Format(L"%u", walks);
+    output.AddKeyValue(L"DecodePasses", value);
+
+    output.EndKeyValues();
+
+    return CBitmapSourceElement::OutputView(output, context);
+}
+
 
 //----------------------------------------------------------------------------------------
 // METADATA READER ELEMENT
@@ -1356,12 +2346,26 @@ CMetadataReaderElement::CMetadataReaderElement(CInfoElement *parent, UINT idx, I
     : CComponentInfoElement(L"")
     , m_reader(reader)
 {
+    m_childrenLoaded = false;
+
     if (FAILED(SetNiceName(parent, idx)))
     {
         m_name = L"MetadataReader";
     }
 }
 
+HRESULT CMetadataReaderElement::LoadChildren(ICodeGenerator &codeGen)
+{
+    return CElementManager::CreateEmbeddedMetadataElements(this, m_reader, codeGen);
+}
+
+bool CMetadataReaderElement::MayHaveChildren()
+{
+    // Only a reader with values can hold an embedded reader
+    UINT numValues = 0;
+    return SUCCEEDED(m_reader->GetCount(&numValues)) && (numValues > 0);
+}
+
 HRESULT CMetadataReaderElement::SetNiceName(CInfoElement *parent, UINT idx)
 {
     HRESULT result = S_OK;
@@ -1516,3 +2520,250 @@ HRESULT CMetadataReaderElement::TranslateValueID(PROPVARIANT *pv, unsigned optio
     return result;
 }
 
+
+std::shared_ptr<const StructureNode> CFileStructureElement::Parse(LPCWSTR filename, double &parseTime)
+{
+    CMappedFile file;
+    if (FAILED(file.Open(filename)))
+    {
+        return nullptr;
+    }
+
+    return Parse(file, filename, parseTime);
+}
+
+std::shared_ptr<const StructureNode> CFileStructureElement::Parse(const CMappedFile &file, LPCWSTR filename, double &parseTime)
+{
+    CTraceSpan span("ParseFileStructure", filename);
+
+    if (0 == file.Size())
+    {
+        return nullptr;
+    }
+
+    CStopwatch parseTimer;
+    parseTimer.Start();
+
+    auto root = std::make_shared<StructureNode>();
+    if (!ParseFileStructure(file.Data(), file.Size(), *root))
+    {
+        return nullptr;
+    }
+
+    parseTime = parseTimer.GetElapsedMS();
+
+    return root;
+}
+
+CFileStructureElement *CFileStructureElement::Create(std::shared_ptr<const StructureNode> root, double parseTime, LPCWSTR name)
+{
+    const StructureNode &node = *root;
+    auto *element = new CFileStructureElement(name, std::move(root), node);
+    element->m_parseTime = parseTime;
+
+    return element;
+}
+
+CFileStructureElement::CFileStructureElement(LPCWSTR name, std::shared_ptr<const StructureNode> root, const StructureNode &node)
+    : CInfoElement(name)
+    , m_root(std::move(root))
+    , m_node(node)
+{
+    m_childrenLoaded = false;
+}
+
+HRESULT CFileStructureElement::OutputView(IOutputDevice &output, const InfoElementViewContext& context)
+{
+    HRESULT result = S_OK;
+
+    IFC(CInfoElement::OutputView(output, context));
+
+    output.BeginKeyValues(m_node.name.c_str());
+
+    CString value;
+    value.Format(L"%llu (0x%llX)", m_node.offset, m_node.offset);
+    output.AddKeyValue(L"Offset", value);
+    value.Format(L"%llu", m_node.length);
+    output.AddKeyValue(L"Length", value);
+
+    for (const auto &keyValue : m_node.values)
+    {
+        output.AddKeyValue(keyValue.first.c_str(), keyValue.second.c_str());
+    }
+
+    if (m_parseTime >= 0)
+    {
+        value.Format(L"%.3f ms", m_parseTime);
+        output.AddKeyValue(L"ParseTime", value);
+    }
+
+    output.EndKeyValues();
+
+    if (!m_node.metadataQuery.empty())
+    {
+        IFC(OutputMetadataCheck(output));
+    }
+
+    return result;
+}
+
+CBitmapDecoderElement *CFileStructureElement::FindDecoderElement() const
+{
+    for (CInfoElement *parent = Parent(); parent; parent = parent->Parent())
+    {
+        if (auto *decoder = dynamic_cast<CBitmapDecoderElement *>(parent))
+        {
+            return decoder;
+        }
+    }
+
+    return nullptr;
+}
+
+CInfoElement *CFileStructureElement::FindFrameElement() const
+{
+    CBitmapDecoderElement *decoder = FindDecoderElement();
+    if (!decoder)
+    {
+        return nullptr;
+    }
+
+    UINT index = 0;
+    for (CInfoElement *child = decoder->FirstChild(); child; child = child->NextSibling())
+    {
+        if (dynamic_cast<CBitmapFrameDecodeElement *>(child))
+        {
+            if (index == m_node.metadataFrame)
+            {
+                return child;
+            }
+            index++;
+        }
+    }
+
+    return nullptr;
+}
+
+HRESULT CFileStructureElement::OutputMetadataCheck(IOutputDevice &output)
+{
+    HRESULT result = S_OK;
+
+    CInfoElement *frame = FindFrameElement();
+    if (!frame)
+    {
+        return result;
+    }
+
+    output.BeginKeyValues(L"WIC Metadata");
+
+    CString value;
+    value.Format(L"%s (frame %u)", m_node.metadataQuery.c_str(), m_node.metadataFrame);
+    output.AddKeyValue(L"Query", value);
+
+    IWICMetadataQueryReaderPtr frameReader;
+    PROPVARIANT pv;
+    PropVariantInit(&pv);
+
+    result = frame->GetQueryReader(&frameReader);
+    if (SUCCEEDED(result))
+    {
+        result = frameReader->GetMetadataByName(m_node.metadataQuery.c_str(), &pv);
+    }
+
+    if (FAILED(result))
+    {
+        GetHresultString(result, value);
+        output.AddKeyValue(L"Result", L"Not found: " + value);
+        output.EndKeyValues();
+        return S_OK;
+    }
+
+    if (VT_UNKNOWN == pv.vt)
+    {
+        // A block: the reader should have a value for each of the node's entries
+        UINT wicValues = 0;
+        IWICMetadataQueryReaderPtr blockReader;
+        IEnumStringPtr names;
+        if (SUCCEEDED(pv.punkVal->QueryInterface(IID_PPV_ARGS(&blockReader))) && SUCCEEDED(blockReader->GetEnumerator(&names)))
+        {
+            LPOLESTR name = nullptr;
+            while (S_OK == names->Next(1, &name, nullptr))
+            {
+                CoTaskMemFree(name);
+                wicValues++;
+            }
+        }
+
+        UINT entries = 0;
+        CString missing;
+        for (const StructureNode &child : m_node.children)
+        {
+            if (child.metadataQuery.empty())
+            {
+                continue;
+            }
+
+            entries++;
+
+            PROPVARIANT childValue;
+            PropVariantInit(&childValue);
+            if (FAILED(frameReader->GetMetadataByName(child.metadataQuery.c_str(), &childValue)))
+            {
+                if (!missing.IsEmpty())
+                {
+                    missing += L", ";
+                }
+                missing += child.name.c_str();
+            }
+            PropVariantClear(&childValue);
+        }
+
+        value.Format(L"%u", wicValues);
+        output.AddKeyValue(L"WicValues", value);
+        value.Format(L"%u", entries);
+        output.AddKeyValue(L"ParsedEntries", value);
+        output.AddKeyValue(L"MissingFromWic", missing.IsEmpty() ? L"None" : missing.GetString());
+        output.AddKeyValue(L"Match", (missing.IsEmpty() && (wicValues == entries)) ? L"Yes" : L"No");
+    }
+    else
+    {
+        result = PropVariantToString(&pv, PVTSOPTION_IncludeType, value);
+        output.AddKeyValue(L"WicValue", SUCCEEDED(result) ? value.GetString() : L"");
+        result = S_OK;
+    }
+
+    PropVariantClear(&pv);
+    output.EndKeyValues();
+
+    return result;
+}
+
+HRESULT CFileStructureElement::LoadChildren(ICodeGenerator &codeGen)
+{
+    for (const StructureNode &child : m_node.children)
+    {
+        CElementManager::AddChildToElement(this, new CFileStructureElement(child.name.c_str(), m_root, child));
+    }
+
+    // A DDS surface is decoded on its own, and only once its element is rendered,
+    // instead of going through the decoder's flat list of frames
+    CBitmapDecoderElement *decoder = m_node.ddsSurface ? FindDecoderElement() : nullptr;
+    IWICDdsDecoderPtr ddsDecoder;
+    if (decoder && decoder->GetDecoder() && SUCCEEDED(decoder->GetDecoder()->QueryInterface(IID_PPV_ARGS(&ddsDecoder))))
+    {
+        IWICBitmapFrameDecodePtr frame;
+
+        codeGen.CallFunction(L"ddsDecoder->GetFrame(%u, %u, %u, &frame)", m_node.ddsArrayIndex, m_node.ddsMipLevel, m_node.ddsSlice);
+        if (SUCCEEDED(ddsDecoder->GetFrame(m_node.ddsArrayIndex, m_node.ddsMipLevel, m_node.ddsSlice, &frame)))
+        {
+            CElementManager::AddChildToElement(this, new CBitmapSourceElement(L"Surface", frame));
+        }
+    }
+
+    return S_OK;
+}
+
+bool CFileStructureElement::MayHaveChildren()
+{
+    return !m_node.children.empty() || m_node.ddsSurface;
+}
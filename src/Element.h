@@ -8,12 +8,119 @@
 //----------------------------------------------------------------------------------------
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
 #include "ImageTransencoder.h"
 #include "OutputDevice.h"
 
+class CWorkerPool;
+struct StructureNode;
+class CMappedFile;
+class CProgressiveLevels;
+class CImageCache;
+struct CachedImageSummary;
+
+// A bitmap that OutputView left for its caller to render
+struct BitmapRenderRequest
+{
+    CString name;
+    IWICBitmapSourcePtr source;
+    // The element's key in CDibCache
+    ULONG cacheId{};
+    bool alpha{};
+    // The colors are multiplied by alpha, which shows them as they blend over black
+    bool premultiply{};
+    // When not 0, larger bitmaps are scaled down to fit
+    UINT fitWidth{};
+    UINT fitHeight{};
+    // The output positions of the "Rendering..." placeholder that the rendering
+    // replaces, or -1 when the device cannot tell them
+    LONG placeholderStart{-1};
+    LONG placeholderEnd{-1};
+};
+
+// Milliseconds spent in each stage of one render. The WIC stages pull their pixels
+// from the stage before them, so each one is measured without the time it waited on
+// that stage.
+struct RenderStageTimes
+{
+    // Creating the scaler and the color transform
+    double setup{};
+    // The source's own CopyPixels, which includes the scaler's when there is one
+    double decode{};
+    double colorTransform{};
+    double conversion{};
+    // The alpha view and the premultiply
+    double alpha{};
+    // Handing the DIBs to the output device
+    double insert{};
+};
+
+// The DIBs and measurements of one render. The DIBs are freed with the rendering
+// unless they have been handed to an output device.
+struct BitmapRendering final
+{
+    BitmapRendering() = default;
+    BitmapRendering(BitmapRendering &&other) noexcept;
+    ~BitmapRendering();
+
+    BitmapRendering(const BitmapRendering &) = delete;
+    BitmapRendering &operator=(const BitmapRendering &) = delete;
+
+    HRESULT result{S_OK};
+    HGLOBAL hDib{};
+    HGLOBAL hAlpha{};
+    DWORD renderTime{};
+    // -1 when the source was not asked for its color contexts
+    int colorContextCount{-1};
+    CString outputColorContext;
+    // The DIBs are copies from CDibCache
+    bool cached{};
+    // The bitmap was scaled down to fit the view; this is the rendered size
+    bool scaled{};
+    UINT width{};
+    UINT height{};
+    // The peak working set of the process after the render, and how much the render
+    // and its copy in CDibCache raised it. Renders on other workers count as well, and
+    // a render that stays below an earlier peak raises it by nothing.
+    SIZE_T peakWorkingSet{};
+    SIZE_T peakWorkingSetGrowth{};
+    // Not set when the DIBs came from the cache
+    RenderStageTimes stageTimes;
+};
+
+// Lets a background render stop early once its result is no longer wanted
+struct RenderCancellation
+{
+    const std::atomic<LONG> *current;
+    LONG generation;
+
+    [[nodiscard]] bool IsCanceled() const
+    {
+        return current->load() != generation;
+    }
+};
+
 struct InfoElementViewContext
 {
     bool bIsAlphaEnable;
+    // When true, the colors of bitmaps with alpha are shown premultiplied
+    bool bIsPremultiplyEnable;
+    // When false, bitmap elements only report their properties and skip the render
+    bool bIsRenderEnable;
+    // When false, the decoder view does not include the views of its children
+    bool bIsChildViewEnable;
+    // When set, bitmap elements add a request here instead of rendering in OutputView
+    CSimpleArray<BitmapRenderRequest> *pDeferredRenders;
+    // When not 0, bitmaps larger than this are scaled down to fit before they are rendered
+    UINT fitWidth;
+    UINT fitHeight;
+    // When not 0, the decoder view shows its children this many at a time, and
+    // fits their bitmaps in a square of childFitSize
+    UINT childPageSize;
+    UINT childFitSize;
 };
 
 class CInfoElement
@@ -64,6 +171,38 @@ class CInfoElement
         return m_firstChild;
     }
 
+    [[nodiscard]] CInfoElement *LastChild() const
+    {
+        return m_lastChild;
+    }
+
+    // Creates the children of this element, the first time it is expanded or queried
+    HRESULT EnsureChildren(ICodeGenerator &codeGen)
+    {
+        if (m_childrenLoaded)
+        {
+            return S_OK;
+        }
+
+        m_childrenLoaded = true;
+        return LoadChildren(codeGen);
+    }
+
+    // Creates every element below this one
+    HRESULT EnsureSubtree(ICodeGenerator &codeGen);
+
+    [[nodiscard]] bool ChildrenLoaded() const
+    {
+        return m_childrenLoaded;
+    }
+
+    // A cheap answer for the tree view; it may be true for an element that
+    // turns out to have no children once they are created
+    [[nodiscard]] bool HasChildren()
+    {
+        return m_childrenLoaded ? (nullptr != FirstChild()) : MayHaveChildren();
+    }
+
     [[nodiscard]] BOOL IsChild(CInfoElement *element)
     {
         CInfoElement *child = FirstChild();
@@ -114,7 +253,19 @@ class CInfoElement
     CString m_queryValue;
 
 protected:
+    virtual HRESULT LoadChildren(ICodeGenerator & /*codeGen*/)
+    {
+        return S_OK;
+    }
+
+    virtual bool MayHaveChildren()
+    {
+        return false;
+    }
+
     CString   m_name;
+    // Elements with lazily created children clear this in their constructor
+    bool      m_childrenLoaded{true};
 
 private:
     void Unlink();
@@ -122,14 +273,28 @@ class CInfoElement
     CInfoElement *m_prevSibling{};
     CInfoElement *m_nextSibling{};
     CInfoElement *m_firstChild{};
+    CInfoElement *m_lastChild{};
 };
 
 class CElementManager
 {
 public:
     static HRESULT OpenFile(LPCWSTR filename, ICodeGenerator &codeGen, CInfoElement *&decElem);
+    // Opens the files on the worker pool and attaches them to the root in the given order.
+    // With a cache, files it has a summary of are added without being loaded.
+    static HRESULT OpenFiles(const CSimpleArray<CString> &filenames, CWorkerPool &pool, CImageCache *cache, DWORD &opened, DWORD &cached);
+
+    // Same as OpenFile, without refreshing the list of codecs first
+    static HRESULT LoadFile(LPCWSTR filename, ICodeGenerator &codeGen, CInfoElement *&decElem);
+    // Same as LoadFile, unless the cache has a summary of the file; then the element
+    // is created with it instead, and cached is set. Loaded files are added to the cache.
+    static HRESULT LoadFileWithCache(LPCWSTR filename, CImageCache &cache, CInfoElement *&decElem, bool &cached);
+    static HRESULT RefreshComponents();
 
     static void RegisterElement(CInfoElement *element);
+    // Elements created while registration is deferred are not added to the root.
+    // Worker threads use this, because the root can only be changed on the UI thread.
+    static void SetDeferRegistration(bool defer);
     static void ClearAllElements();
 
     static void AddSiblingToElement(CInfoElement *element, CInfoElement *sib);
@@ -139,15 +304,17 @@ class CElementManager
 
     static HRESULT SaveElementAsImage(CInfoElement &element, REFGUID containerFormat, WICPixelFormatGUID &format, LPCWSTR filename, ICodeGenerator &codeGen);
     static HRESULT CreateDecoderAndChildElements(LPCWSTR filename, ICodeGenerator &codeGen, CInfoElement *&decElem);
-    static HRESULT CreateFrameAndChildElements(CInfoElement *parent, UINT index, IWICBitmapFrameDecodePtr frameDecode, ICodeGenerator &codeGen);
+    static HRESULT CreateFrameChildElements(CInfoElement *frameElem, IWICBitmapFrameDecodePtr frameDecode, ICodeGenerator &codeGen);
     static HRESULT CreateMetadataElementsFromBlock(CInfoElement *parent, IWICMetadataBlockReaderPtr blockReader, ICodeGenerator &codeGen);
     static HRESULT CreateMetadataElements(CInfoElement *parent, UINT childIdx, IWICMetadataReaderPtr reader, ICodeGenerator &codeGen);
+    static HRESULT CreateEmbeddedMetadataElements(CInfoElement *readerElem, IWICMetadataReaderPtr reader, ICodeGenerator &codeGen);
 
     static CString queryKey;
     static CString queryValue;
 
 private:
     static CInfoElement root;
+    static thread_local bool deferRegistration;
 };
 
 class CComponentInfoElement : public CInfoElement
@@ -171,6 +338,8 @@ class CBitmapDecoderElement : public CComponentInfoElement
         : CComponentInfoElement(filename)
         , m_filename(filename)
     {
+        m_childrenLoaded = false;
+
         const int pathDelim = m_name.ReverseFind('\\');
         if (pathDelim >= 0)
         {
@@ -178,7 +347,7 @@ class CBitmapDecoderElement : public CComponentInfoElement
         }
     }
 
-    // Creates the decoder and child objects based on the filename
+    // Creates the decoder based on the filename; the child objects are created on demand
     HRESULT Load(ICodeGenerator &codeGen);
     // Releases the decoder and child objects but keeps the filename
     void Unload();
@@ -188,21 +357,83 @@ class CBitmapDecoderElement : public CComponentInfoElement
         return m_loaded;
     }
 
+    [[nodiscard]] IWICBitmapDecoderPtr GetDecoder() const
+    {
+        return m_decoder;
+    }
+
+    [[nodiscard]] const CString &GetFilename() const
+    {
+        return m_filename;
+    }
+
+    // What CImageCache knows about the file; the summary is shown while it is not loaded
+    void SetCacheEntry(uint64_t contentHash, std::shared_ptr<const CachedImageSummary> summary)
+    {
+        m_hasCacheEntry = true;
+        m_contentHash = contentHash;
+        m_cachedSummary = std::move(summary);
+    }
+
+    [[nodiscard]] bool GetContentHash(uint64_t &contentHash) const
+    {
+        contentHash = m_contentHash;
+        return m_hasCacheEntry;
+    }
+
+    // Describes the loaded file for CImageCache
+    HRESULT CreateSummary(CachedImageSummary &summary);
+
     HRESULT SaveAsImage(CImageTransencoder &trans, ICodeGenerator &codeGen);
 
     HRESULT OutputView(IOutputDevice &output, const InfoElementViewContext& context);
     HRESULT OutputInfo(IOutputDevice &output);
 
+    // Adds a page to the children that the view shows
+    void ShowMoreChildren()
+    {
+        m_childPages++;
+    }
+
     void SetCreationTime(DWORD ms);
     void SetCreationCode(LPCWSTR code);
     void FillContextMenu(HMENU context) override;
 
+protected:
+    HRESULT LoadChildren(ICodeGenerator &codeGen) override;
+    bool MayHaveChildren() override
+    {
+        return m_loaded;
+    }
+
 private:
     CString              m_filename;
     IWICBitmapDecoderPtr m_decoder;
     DWORD                m_creationTime{};
+    // The stages of the creation and of the first expansion, in milliseconds
+    double               m_createDecoderTime{};
+    double               m_frameCountTime{};
+    double               m_loadChildrenTime{-1};
     CString              m_creationCode;
     bool                 m_loaded{};
+    UINT                 m_frameCount{};
+    // True when the frame count was read from the file structure instead of from WIC
+    bool                 m_nativeFrameCount{};
+    // The layout read by the native parsers, once it is needed
+    std::shared_ptr<const StructureNode> m_structure;
+    double               m_structureParseTime{};
+    // The mapping the decoder reads through, when g_mappedStreams is set
+    std::shared_ptr<CMappedFile> m_file;
+    // The pages of children in the view, and whether the last view left some out
+    UINT                 m_childPages{1};
+    bool                 m_hasHiddenChildren{};
+    // Kept when the file is unloaded, since they describe the file
+    bool                 m_hasCacheEntry{};
+    uint64_t             m_contentHash{};
+    std::shared_ptr<const CachedImageSummary> m_cachedSummary;
+
+    std::shared_ptr<const StructureNode> ParseStructure();
+    HRESULT OutputCachedSummary(IOutputDevice &output);
 };
 
 class CBitmapSourceElement : public CInfoElement
@@ -211,24 +442,58 @@ class CBitmapSourceElement : public CInfoElement
     CBitmapSourceElement(LPCWSTR name, IWICBitmapSourcePtr source)
         : CInfoElement(name)
         , m_source(source)
+        , m_renderId(++s_lastRenderId)
     {
 
     }
 
+    ~CBitmapSourceElement() override;
+
     HRESULT SaveAsImage(CImageTransencoder &trans, ICodeGenerator &codeGen);
 
     HRESULT OutputView(IOutputDevice &output, const InfoElementViewContext& context);
     HRESULT OutputInfo(IOutputDevice &output);
     void FillContextMenu(HMENU context);
 
+    // Scales, color manages and converts a source to DIBs. This uses nothing but the
+    // request and the calling thread's imaging factory, so it can run on a worker.
+    // When the request has a cacheId, the DIBs come from and go to CDibCache.
+    static HRESULT Render(BitmapRenderRequest &request, const RenderCancellation *cancel, BitmapRendering &rendering);
+    // Adds the render keys, ends the key/value block and hands the DIBs to the output
+    static void OutputRendering(IOutputDevice &output, BitmapRendering &rendering);
+    BitmapRenderRequest CreateRenderRequest(const InfoElementViewContext &context) const;
+
 protected:
-    HRESULT CreateDibFromBitmapSource(IWICBitmapSourcePtr source,
-        HGLOBAL &hGlobal, HGLOBAL* phAlpha);
+    // Creates a transform of input from the color context of source to sRGB
+    static HRESULT CreateColorTransform(IWICBitmapSourcePtr source, IWICBitmapSourcePtr input,
+        IWICBitmapSourcePtr &colorTransform, BitmapRendering &rendering);
+    // Converts source to the rendering's DIBs. The conversion stage time it sets
+    // includes the time source took to produce its pixels.
+    static HRESULT CreateDibFromBitmapSource(IWICBitmapSourcePtr source, const BitmapRenderRequest &request,
+        const RenderCancellation *cancel, BitmapRendering &rendering);
     HRESULT CreateHbitmapFromBitmapSource(IWICBitmapSourcePtr source, HBITMAP &hGlobal);
 
-private:
     IWICBitmapSourcePtr m_source;
-    IWICBitmapSourcePtr m_colorTransform;
+
+private:
+    // Unlike the element's address, this is never reused, so a render that finishes
+    // after the element is gone cannot be mistaken for a later element's
+    const ULONG m_renderId;
+
+    static std::atomic<ULONG> s_lastRenderId;
+};
+
+// One level of a progressive frame; the levels of a frame share their decoding
+class CProgressiveLevelElement final : public CBitmapSourceElement
+{
+public:
+    CProgressiveLevelElement(std::shared_ptr<CProgressiveLevels> levels, UINT level);
+
+    HRESULT OutputView(IOutputDevice &output, const InfoElementViewContext& context) override;
+
+private:
+    std::shared_ptr<CProgressiveLevels> m_levels;
+    UINT m_level;
 };
 
 
@@ -236,12 +501,14 @@ class CBitmapSourceElement : public CInfoElement
 class CBitmapFrameDecodeElement final : public CBitmapSourceElement
 {
 public:
-    CBitmapFrameDecodeElement(UINT index, IWICBitmapFrameDecodePtr frameDecode)
-        : CBitmapSourceElement(L"", frameDecode)
+    // The frame itself is not decoded until the element is expanded or queried
+    CBitmapFrameDecodeElement(UINT index, IWICBitmapDecoderPtr decoder)
+        : CBitmapSourceElement(L"", nullptr)
         , m_index(index)
-        , m_frameDecode(frameDecode)
+        , m_decoder(decoder)
     {
         m_name.Format(L"Frame #%u", index);
+        m_childrenLoaded = false;
     }
 
     HRESULT SaveAsImage(CImageTransencoder &trans, ICodeGenerator &codeGen) override;
@@ -251,11 +518,22 @@ class CBitmapFrameDecodeElement final : public CBitmapSourceElement
     HRESULT OutputInfo(IOutputDevice &output) override;
     HRESULT GetQueryReader(IWICMetadataQueryReader **reader) override
     {
-        return m_frameDecode->GetMetadataQueryReader(reader);
+        const HRESULT result = EnsureFrame();
+        return SUCCEEDED(result) ? m_frameDecode->GetMetadataQueryReader(reader) : result;
+    }
+
+protected:
+    HRESULT LoadChildren(ICodeGenerator &codeGen) override;
+    bool MayHaveChildren() override
+    {
+        return true;
     }
 
 private:
+    HRESULT EnsureFrame();
+
     UINT                     m_index;
+    IWICBitmapDecoderPtr     m_decoder;
     IWICBitmapFrameDecodePtr m_frameDecode;
 };
 
@@ -275,6 +553,10 @@ class CMetadataReaderElement final : public CComponentInfoElement
         return CComponentInfoElement::FindElementByReader(reader);
     }
 
+protected:
+    HRESULT LoadChildren(ICodeGenerator &codeGen) override;
+    bool MayHaveChildren() override;
+
 private:
     HRESULT TranslateValueID(PROPVARIANT *pv, unsigned options, CString &out);
     static HRESULT TrimQuotesFromName(CString &out);
@@ -282,3 +564,36 @@ class CMetadataReaderElement final : public CComponentInfoElement
 
     IWICMetadataReaderPtr m_reader;
 };
+
+// A node of the layout that the native container parsers read from the file itself,
+// without WIC. The whole tree is parsed up front, because that takes microseconds;
+// the elements of the nodes are only created as the tree is expanded.
+class CFileStructureElement final : public CInfoElement
+{
+public:
+    // Maps and parses the file; returns null when no native parser recognizes it
+    static std::shared_ptr<const StructureNode> Parse(LPCWSTR filename, double &parseTime);
+    // Parses a file that is already mapped
+    static std::shared_ptr<const StructureNode> Parse(const CMappedFile &file, LPCWSTR filename, double &parseTime);
+    // Files that no codec can read get a root element of this kind, named after the file
+    static CFileStructureElement *Create(std::shared_ptr<const StructureNode> root, double parseTime, LPCWSTR name = L"File Structure");
+
+    HRESULT OutputView(IOutputDevice &output, const InfoElementViewContext& context) override;
+
+protected:
+    HRESULT LoadChildren(ICodeGenerator &codeGen) override;
+    bool MayHaveChildren() override;
+
+private:
+    CFileStructureElement(LPCWSTR name, std::shared_ptr<const StructureNode> root, const StructureNode &node);
+
+    // Reads the node's metadata query through the frame's WIC reader, to check the two agree
+    HRESULT OutputMetadataCheck(IOutputDevice &output);
+    CBitmapDecoderElement *FindDecoderElement() const;
+    CInfoElement *FindFrameElement() const;
+
+    // Keeps the tree alive for as long as any of its elements is
+    std::shared_ptr<const StructureNode> m_root;
+    const StructureNode &m_node;
+    double m_parseTime{-1};
+};
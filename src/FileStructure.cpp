@@ -0,0 +1,209 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <cwchar>
+
+StructureNode &StructureNode::AddChild(const std::wstring &childName, uint64_t childOffset, uint64_t childLength)
+{
+    children.emplace_back();
+
+    StructureNode &child = children.back();
+    child.name = childName;
+    child.offset = childOffset;
+    child.length = childLength;
+
+    return child;
+}
+
+void StructureNode::AddValue(const std::wstring &key, const std::wstring &value)
+{
+    values.emplace_back(key, value);
+}
+
+void StructureNode::AddValue(const std::wstring &key, uint64_t value)
+{
+    values.emplace_back(key, std::to_wstring(value));
+}
+
+bool StructureNode::HasErrors() const
+{
+    for (const auto &value : values)
+    {
+        if (value.first == L"Error")
+        {
+            return true;
+        }
+    }
+
+    for (const StructureNode &child : children)
+    {
+        if (child.HasErrors())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ParseFileStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    return ParsePngStructure(data, size, root)
+        || ParseJpegStructure(data, size, root)
+        || ParseGifStructure(data, size, root)
+        || ParseTiffStructure(data, size, root)
+        || ParseBmffStructure(data, size, root)
+        || ParseDdsStructure(data, size, root);
+}
+
+namespace FileStructure
+{
+    std::wstring Latin1ToWide(const uint8_t *text, size_t length)
+    {
+        std::wstring wide;
+        wide.reserve(length);
+
+        for (size_t i = 0; i < length; i++)
+        {
+            wide += static_cast<wchar_t>(text[i]);
+        }
+
+        return wide;
+    }
+
+    static void AppendCodePoint(std::wstring &wide, uint32_t c)
+    {
+        // wchar_t is UTF-16 on Windows and UTF-32 elsewhere
+        if constexpr (sizeof(wchar_t) == 2)
+        {
+            if (c >= 0x10000)
+            {
+                c -= 0x10000;
+                wide += static_cast<wchar_t>(0xD800 + (c >> 10));
+                wide += static_cast<wchar_t>(0xDC00 + (c & 0x3FF));
+                return;
+            }
+        }
+
+        wide += static_cast<wchar_t>(c);
+    }
+
+    std::wstring Utf8ToWide(const uint8_t *text, size_t length)
+    {
+        std::wstring wide;
+        wide.reserve(length);
+
+        for (size_t i = 0; i < length; )
+        {
+            uint32_t c = text[i];
+            size_t extra = 0;
+
+            if (c >= 0xF0)
+            {
+                c &= 0x07;
+                extra = 3;
+            }
+            else if (c >= 0xE0)
+            {
+                c &= 0x0F;
+                extra = 2;
+            }
+            else if (c >= 0xC0)
+            {
+                c &= 0x1F;
+                extra = 1;
+            }
+            else if (c >= 0x80)
+            {
+                // A stray continuation byte
+                c = 0xFFFD;
+            }
+
+            i++;
+            for (; (extra > 0) && (i < length) && ((text[i] & 0xC0) == 0x80); extra--, i++)
+            {
+                c = (c << 6) | (text[i] & 0x3Fu);
+            }
+            if (extra > 0)
+            {
+                c = 0xFFFD;
+            }
+
+            AppendCodePoint(wide, c);
+        }
+
+        return wide;
+    }
+
+    std::wstring FourCCToWide(const uint8_t *code)
+    {
+        std::wstring wide;
+
+        for (int i = 0; i < 4; i++)
+        {
+            wide += ((code[i] >= 0x20) && (code[i] < 0x7F)) ? static_cast<wchar_t>(code[i]) : L'?';
+        }
+
+        return wide;
+    }
+
+    std::wstring FormatHex(uint64_t value, int digits)
+    {
+        wchar_t text[24];
+        swprintf(text, sizeof(text) / sizeof(text[0]), L"0x%0*llX", digits, static_cast<unsigned long long>(value));
+
+        return text;
+    }
+
+    uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t length)
+    {
+        // Slicing by 4: four tables, so that a word is folded in per step
+        static const struct Tables
+        {
+            uint32_t t[4][256];
+
+            Tables()
+            {
+                for (uint32_t n = 0; n < 256; n++)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                    }
+                    t[0][n] = c;
+                }
+                for (uint32_t n = 0; n < 256; n++)
+                {
+                    for (int k = 1; k < 4; k++)
+                    {
+                        t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xFF];
+                    }
+                }
+            }
+        } tables;
+
+        crc = ~crc;
+
+        for (; length >= 4; data += 4, length -= 4)
+        {
+            crc ^= ReadLE32(data);
+            crc = tables.t[3][crc & 0xFF] ^ tables.t[2][(crc >> 8) & 0xFF]
+                ^ tables.t[1][(crc >> 16) & 0xFF] ^ tables.t[0][crc >> 24];
+        }
+
+        for (; length > 0; data++, length--)
+        {
+            crc = tables.t[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+        }
+
+        return ~crc;
+    }
+}
@@ -0,0 +1,116 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The native container parsers read the layout of a file straight from its bytes,
+// without a WIC decoder, and describe it as a tree of StructureNodes. They use
+// nothing but the standard library, so they build and run on any platform, and they
+// never read outside of the bytes they are given: a truncated or corrupt file gives
+// an Error value on the node where parsing stopped, not a failure.
+struct StructureNode
+{
+    std::wstring name;
+    // The byte range of the node in the file
+    uint64_t offset{};
+    uint64_t length{};
+    std::vector<std::pair<std::wstring, std::wstring>> values;
+    std::vector<StructureNode> children;
+    // The WIC metadata query that reads the same data from frame metadataFrame, if
+    // there is one, so that the two can be checked against each other
+    std::wstring metadataQuery;
+    uint32_t metadataFrame{};
+    // The number of frames in the file, on the root of the parsers that can count them
+    uint64_t frameCount{};
+    // A surface of a DDS texture, as IWICDdsDecoder::GetFrame addresses it
+    bool ddsSurface{};
+    uint32_t ddsArrayIndex{};
+    uint32_t ddsMipLevel{};
+    uint32_t ddsSlice{};
+
+    StructureNode &AddChild(const std::wstring &childName, uint64_t childOffset, uint64_t childLength);
+    void AddValue(const std::wstring &key, const std::wstring &value);
+    void AddValue(const std::wstring &key, uint64_t value);
+    void AddError(const std::wstring &message)
+    {
+        AddValue(L"Error", message);
+    }
+    // Whether parsing stopped anywhere in the tree, in which case the counts on the
+    // root may not match what a decoder finds
+    [[nodiscard]] bool HasErrors() const;
+};
+
+// Fills root with the layout of data, if one of the parsers knows its format
+bool ParseFileStructure(const uint8_t *data, size_t size, StructureNode &root);
+
+bool ParsePngStructure(const uint8_t *data, size_t size, StructureNode &root);
+bool ParseJpegStructure(const uint8_t *data, size_t size, StructureNode &root);
+bool ParseGifStructure(const uint8_t *data, size_t size, StructureNode &root);
+bool ParseBmffStructure(const uint8_t *data, size_t size, StructureNode &root);
+bool ParseTiffStructure(const uint8_t *data, size_t size, StructureNode &root);
+bool ParseDdsStructure(const uint8_t *data, size_t size, StructureNode &root);
+// Adds the header and IFDs of a TIFF structure embedded in another file, such as an
+// Exif block, to parent. base is where the block starts in the file. ifd0Query is the
+// metadata query of its first IFD in the first frame, or null if WIC has none.
+bool ParseTiffBlock(const uint8_t *data, size_t size, uint64_t base, const wchar_t *ifd0Query, StructureNode &parent);
+
+namespace FileStructure
+{
+    inline uint16_t ReadBE16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    inline uint32_t ReadBE32(const uint8_t *p)
+    {
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    inline uint64_t ReadBE64(const uint8_t *p)
+    {
+        return (uint64_t(ReadBE32(p)) << 32) | ReadBE32(p + 4);
+    }
+
+    inline uint16_t ReadLE16(const uint8_t *p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    inline uint32_t ReadLE32(const uint8_t *p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    inline uint64_t ReadLE64(const uint8_t *p)
+    {
+        return uint64_t(ReadLE32(p)) | (uint64_t(ReadLE32(p + 4)) << 32);
+    }
+
+    // True when count bytes starting at offset are inside size bytes, without overflowing
+    inline bool InRange(uint64_t offset, uint64_t count, uint64_t size)
+    {
+        return (offset <= size) && (count <= size - offset);
+    }
+
+    std::wstring Latin1ToWide(const uint8_t *text, size_t length);
+    std::wstring Utf8ToWide(const uint8_t *text, size_t length);
+    // Four characters, with the ones that are not printable as '?'
+    std::wstring FourCCToWide(const uint8_t *code);
+    std::wstring FormatHex(uint64_t value, int digits);
+    // Text longer than this is cut short in node values
+    constexpr size_t MAX_TEXT_VALUE = 512;
+
+    // CRC-32 as used by PNG, ZIP and others
+    uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t length);
+}
@@ -0,0 +1,303 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace FileStructure;
+
+namespace
+{
+    // Skips a chain of data sub-blocks, and returns the offset after its terminator,
+    // or 0 if the data ends first
+    uint64_t SkipSubBlocks(const uint8_t *data, size_t size, uint64_t offset, uint64_t &blocks, uint64_t &bytes)
+    {
+        blocks = 0;
+        bytes = 0;
+
+        while (offset < size)
+        {
+            uint8_t length = data[offset];
+            offset++;
+            if (length == 0)
+            {
+                return offset;
+            }
+            blocks++;
+            bytes += length;
+            offset += length;
+        }
+
+        return 0;
+    }
+
+    void AddColorTable(StructureNode &parent, const wchar_t *name, uint64_t offset, uint32_t entries, size_t size)
+    {
+        StructureNode &table = parent.AddChild(name, offset, uint64_t(entries) * 3);
+        table.AddValue(L"Entries", entries);
+        if (!InRange(offset, uint64_t(entries) * 3, size))
+        {
+            table.AddError(L"The file ends inside the color table");
+        }
+    }
+
+    void DescribeGraphicControl(StructureNode &node, const uint8_t *block)
+    {
+        static const wchar_t *disposals[] = { L"Unspecified", L"None", L"Background", L"Previous" };
+
+        uint8_t disposal = static_cast<uint8_t>((block[0] >> 2) & 0x07);
+        node.AddValue(L"Disposal", (disposal < 4) ? disposals[disposal] : L"Unknown");
+        node.AddValue(L"UserInput", (block[0] & 0x02) ? L"Yes" : L"No");
+        node.AddValue(L"Delay", std::to_wstring(ReadLE16(block + 1) * 10) + L" ms");
+        if (block[0] & 0x01)
+        {
+            node.AddValue(L"TransparentIndex", block[3]);
+        }
+    }
+}
+
+bool ParseGifStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    if ((size < 6) || (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0))
+    {
+        return false;
+    }
+
+    root.name = L"GIF";
+    root.offset = 0;
+    root.length = size;
+    root.AddChild(L"Header", 0, 6).AddValue(L"Version", Latin1ToWide(data + 3, 3));
+
+    if (!InRange(6, 7, size))
+    {
+        root.AddError(L"The file ends inside the logical screen descriptor");
+        return true;
+    }
+
+    const uint8_t *screen = data + 6;
+    StructureNode &screenNode = root.AddChild(L"Logical Screen Descriptor", 6, 7);
+    screenNode.AddValue(L"Width", ReadLE16(screen));
+    screenNode.AddValue(L"Height", ReadLE16(screen + 2));
+    screenNode.AddValue(L"ColorResolution", ((screen[4] >> 4) & 0x07) + 1u);
+    screenNode.AddValue(L"BackgroundIndex", screen[5]);
+    screenNode.AddValue(L"PixelAspectRatio", screen[6]);
+
+    uint64_t offset = 13;
+    if (screen[4] & 0x80)
+    {
+        uint32_t entries = 2u << (screen[4] & 0x07);
+        screenNode.AddValue(L"GlobalColorTable", std::to_wstring(entries) + L" entries" + ((screen[4] & 0x08) ? L", sorted" : L""));
+        AddColorTable(root, L"Global Color Table", offset, entries, size);
+        offset += uint64_t(entries) * 3;
+    }
+
+    uint64_t frames = 0;
+    int64_t loopCount = -1;
+    bool ended = false;
+    // A graphic control extension applies to the image that follows it
+    uint64_t pendingControl = 0;
+    size_t pendingControlIndex = 0;
+
+    while (offset < size)
+    {
+        uint64_t blockOffset = offset;
+        uint8_t introducer = data[offset];
+
+        if (introducer == 0x3B)
+        {
+            root.AddChild(L"Trailer", offset, 1);
+            offset++;
+            ended = true;
+            break;
+        }
+
+        if (introducer == 0x21)
+        {
+            if (!InRange(offset, 2, size))
+            {
+                root.AddChild(L"Extension", offset, size - offset).AddError(L"The file ends inside the extension");
+                break;
+            }
+
+            uint8_t label = data[offset + 1];
+            uint64_t blocks = 0;
+            uint64_t bytes = 0;
+            uint64_t end = SkipSubBlocks(data, size, offset + 2, blocks, bytes);
+            uint64_t length = (end ? end : size) - offset;
+
+            // The first sub-block holds the fixed fields of the known extensions
+            const uint8_t *fields = data + offset + 3;
+            uint8_t fieldsLength = (offset + 2 < size) ? data[offset + 2] : 0;
+            bool hasFields = (blocks > 0) && InRange(offset + 3, fieldsLength, size);
+
+            StructureNode *node = nullptr;
+            switch (label)
+            {
+            case 0xF9:
+                node = &root.AddChild(L"Graphic Control Extension", offset, length);
+                if (hasFields && (fieldsLength >= 4))
+                {
+                    DescribeGraphicControl(*node, fields);
+                }
+                pendingControl = offset;
+                pendingControlIndex = root.children.size() - 1;
+                break;
+
+            case 0xFF:
+                node = &root.AddChild(L"Application Extension", offset, length);
+                if (hasFields && (fieldsLength >= 11))
+                {
+                    node->AddValue(L"Application", Latin1ToWide(fields, 8) + L" " + Latin1ToWide(fields + 8, 3));
+
+                    // NETSCAPE2.0 and ANIMEXTS1.0 carry the loop count in their second sub-block
+                    uint64_t next = offset + 3 + fieldsLength;
+                    bool isLoop = (memcmp(fields, "NETSCAPE2.0", 11) == 0) || (memcmp(fields, "ANIMEXTS1.0", 11) == 0);
+                    if (isLoop && InRange(next, 4, size) && (data[next] >= 3) && (data[next + 1] == 1))
+                    {
+                        loopCount = ReadLE16(data + next + 2);
+                        node->AddValue(L"LoopCount", (loopCount == 0) ? std::wstring(L"Forever") : std::to_wstring(loopCount));
+                    }
+                }
+                node->AddValue(L"DataBytes", bytes);
+                break;
+
+            case 0xFE:
+                node = &root.AddChild(L"Comment Extension", offset, length);
+                if (hasFields)
+                {
+                    node->AddValue(L"Comment", Latin1ToWide(fields, fieldsLength) + ((blocks > 1) ? L"..." : L""));
+                }
+                break;
+
+            case 0x01:
+                node = &root.AddChild(L"Plain Text Extension", offset, length);
+                // Plain text is rendered as a frame of its own
+                pendingControl = 0;
+                break;
+
+            default:
+                node = &root.AddChild(L"Extension " + FormatHex(label, 2), offset, length);
+                break;
+            }
+
+            node->AddValue(L"SubBlocks", blocks);
+            if (!end)
+            {
+                node->AddError(L"The file ends inside the extension");
+                break;
+            }
+
+            offset = end;
+            continue;
+        }
+
+        if (introducer == 0x2C)
+        {
+            // A frame starts at its graphic control extension, when it has one, and
+            // takes the place of the extension's node, which moves below it
+            StructureNode *frame = nullptr;
+            if (pendingControl)
+            {
+                StructureNode control = std::move(root.children[pendingControlIndex]);
+                frame = &root.children[pendingControlIndex];
+                *frame = StructureNode();
+                frame->name = L"Frame " + std::to_wstring(frames);
+                frame->offset = pendingControl;
+                for (const auto &value : control.values)
+                {
+                    if (value.first != L"SubBlocks")
+                    {
+                        frame->values.push_back(value);
+                    }
+                }
+                frame->children.push_back(std::move(control));
+                pendingControl = 0;
+            }
+            else
+            {
+                frame = &root.AddChild(L"Frame " + std::to_wstring(frames), offset, 0);
+            }
+            frames++;
+
+            StructureNode &frameNode = *frame;
+            uint64_t frameStart = frameNode.offset;
+
+            if (!InRange(offset, 10, size))
+            {
+                frameNode.length = size - frameStart;
+                frameNode.AddError(L"The file ends inside the image descriptor");
+                break;
+            }
+
+            const uint8_t *descriptor = data + offset;
+            StructureNode &descriptorNode = frameNode.AddChild(L"Image Descriptor", offset, 10);
+            descriptorNode.AddValue(L"Left", ReadLE16(descriptor + 1));
+            descriptorNode.AddValue(L"Top", ReadLE16(descriptor + 3));
+            descriptorNode.AddValue(L"Width", ReadLE16(descriptor + 5));
+            descriptorNode.AddValue(L"Height", ReadLE16(descriptor + 7));
+            descriptorNode.AddValue(L"Interlaced", (descriptor[9] & 0x40) ? L"Yes" : L"No");
+            frameNode.AddValue(L"Rect", std::to_wstring(ReadLE16(descriptor + 5)) + L"x" + std::to_wstring(ReadLE16(descriptor + 7))
+                + L" at " + std::to_wstring(ReadLE16(descriptor + 1)) + L"," + std::to_wstring(ReadLE16(descriptor + 3)));
+            offset += 10;
+
+            if (descriptor[9] & 0x80)
+            {
+                uint32_t entries = 2u << (descriptor[9] & 0x07);
+                descriptorNode.AddValue(L"LocalColorTable", std::to_wstring(entries) + L" entries");
+                AddColorTable(frameNode, L"Local Color Table", offset, entries, size);
+                offset += uint64_t(entries) * 3;
+            }
+
+            // The LZW data is skipped, not decoded
+            uint64_t blocks = 0;
+            uint64_t bytes = 0;
+            uint64_t end = (offset < size) ? SkipSubBlocks(data, size, offset + 1, blocks, bytes) : 0;
+            StructureNode &imageData = frameNode.AddChild(L"Image Data", offset, (end ? end : size) - std::min<uint64_t>(offset, size));
+            if (offset < size)
+            {
+                imageData.AddValue(L"LzwMinimumCodeSize", data[offset]);
+            }
+            imageData.AddValue(L"SubBlocks", blocks);
+            imageData.AddValue(L"DataBytes", bytes);
+
+            frameNode.length = (end ? end : size) - frameStart;
+            if (!end)
+            {
+                imageData.AddError(L"The file ends inside the image data");
+                break;
+            }
+
+            offset = end;
+            continue;
+        }
+
+        StructureNode &unknown = root.AddChild(L"Unexpected data", blockOffset, size - blockOffset);
+        unknown.AddError(L"Unknown block introducer " + FormatHex(introducer, 2));
+        break;
+    }
+
+    if (ended && (offset < size))
+    {
+        root.AddChild(L"Trailing data", offset, size - offset);
+    }
+
+    root.frameCount = frames;
+    root.AddValue(L"Frames", frames);
+    if (loopCount >= 0)
+    {
+        root.AddValue(L"LoopCount", (loopCount == 0) ? std::wstring(L"Forever") : std::to_wstring(loopCount));
+    }
+    if (!ended)
+    {
+        root.AddError(L"There is no trailer");
+    }
+
+    return true;
+}
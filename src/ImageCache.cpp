@@ -0,0 +1,665 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "ImageCache.h"
+#include "FileStructure.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+using namespace FileStructure;
+
+namespace
+{
+    const char INDEX_MAGIC[8] = { 'W', 'I', 'C', 'X', 'I', 'D', 'X', '1' };
+    const char THUMBNAIL_MAGIC[8] = { 'W', 'I', 'C', 'X', 'T', 'H', 'M', '1' };
+    const wchar_t INDEX_NAME[] = L"index.bin";
+
+    const uint64_t SAMPLE_SIZE = 64 * 1024;
+    // Names and lists longer than this are not from a real file
+    const uint32_t MAX_STRING_LENGTH = 32 * 1024;
+    const uint32_t MAX_LIST_LENGTH = 4096;
+
+    uint64_t Mix(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+
+        return value;
+    }
+
+    uint64_t HashBytes(uint64_t hash, const uint8_t *data, uint64_t length)
+    {
+        uint64_t i = 0;
+        for (; i + 8 <= length; i += 8)
+        {
+            hash = (hash ^ Mix(ReadLE64(data + i))) * 0x9e3779b97f4a7c15ULL;
+            hash = (hash << 27) | (hash >> 37);
+        }
+
+        uint64_t tail = 0;
+        for (uint64_t j = 0; i + j < length; j++)
+        {
+            tail |= uint64_t(data[i + j]) << (8 * j);
+        }
+
+        return Mix(hash ^ Mix(tail ^ length));
+    }
+
+    // Appends little-endian fields
+    class CByteWriter
+    {
+    public:
+        void Write8(uint8_t value)
+        {
+            m_bytes.push_back(value);
+        }
+
+        void Write32(uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                m_bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        void Write64(uint64_t value)
+        {
+            Write32(static_cast<uint32_t>(value));
+            Write32(static_cast<uint32_t>(value >> 32));
+        }
+
+        void WriteBytes(const void *data, size_t length)
+        {
+            const auto *bytes = static_cast<const uint8_t *>(data);
+            m_bytes.insert(m_bytes.end(), bytes, bytes + length);
+        }
+
+        void WriteGuid(const CacheGuid &guid)
+        {
+            WriteBytes(guid.data(), guid.size());
+        }
+
+        // As UTF-16 code units, whatever the size of wchar_t
+        void WriteString(const std::wstring &text)
+        {
+            std::vector<uint16_t> units;
+            units.reserve(text.size());
+            for (const wchar_t c : text)
+            {
+                const auto codePoint = static_cast<uint32_t>(c);
+                if ((codePoint > 0xffff) && (codePoint <= 0x10ffff))
+                {
+                    units.push_back(static_cast<uint16_t>(0xd800 + ((codePoint - 0x10000) >> 10)));
+                    units.push_back(static_cast<uint16_t>(0xdc00 + ((codePoint - 0x10000) & 0x3ff)));
+                }
+                else
+                {
+                    units.push_back(static_cast<uint16_t>(codePoint));
+                }
+            }
+
+            Write32(static_cast<uint32_t>(units.size()));
+            for (const uint16_t unit : units)
+            {
+                Write8(static_cast<uint8_t>(unit));
+                Write8(static_cast<uint8_t>(unit >> 8));
+            }
+        }
+
+        void WriteStrings(const std::vector<std::wstring> &strings)
+        {
+            Write32(static_cast<uint32_t>(strings.size()));
+            for (const std::wstring &text : strings)
+            {
+                WriteString(text);
+            }
+        }
+
+        // Ends the data with its CRC, which the reader checks first
+        void WriteCrc()
+        {
+            Write32(Crc32(0, m_bytes.data(), m_bytes.size()));
+        }
+
+        std::vector<uint8_t> &Bytes()
+        {
+            return m_bytes;
+        }
+
+    private:
+        std::vector<uint8_t> m_bytes;
+    };
+
+    // Reads little-endian fields one after the other, and remembers when one did not fit
+    class CByteReader
+    {
+    public:
+        CByteReader(const uint8_t *data, size_t size)
+            : m_data(data)
+            , m_size(size)
+        {
+        }
+
+        [[nodiscard]] bool Ok() const
+        {
+            return m_ok;
+        }
+
+        [[nodiscard]] size_t Remaining() const
+        {
+            return m_ok ? m_size - m_offset : 0;
+        }
+
+        const uint8_t *Take(size_t length)
+        {
+            if (!m_ok || !InRange(m_offset, length, m_size))
+            {
+                m_ok = false;
+                return nullptr;
+            }
+
+            const uint8_t *p = m_data + m_offset;
+            m_offset += length;
+
+            return p;
+        }
+
+        uint8_t Read8()
+        {
+            const uint8_t *p = Take(1);
+            return p ? p[0] : 0;
+        }
+
+        uint32_t Read32()
+        {
+            const uint8_t *p = Take(4);
+            return p ? ReadLE32(p) : 0;
+        }
+
+        uint64_t Read64()
+        {
+            const uint8_t *p = Take(8);
+            return p ? ReadLE64(p) : 0;
+        }
+
+        CacheGuid ReadGuid()
+        {
+            CacheGuid guid{};
+            const uint8_t *p = Take(guid.size());
+            if (p)
+            {
+                memcpy(guid.data(), p, guid.size());
+            }
+
+            return guid;
+        }
+
+        // A count of items that are at least itemSize bytes each
+        uint32_t ReadCount(uint32_t limit, size_t itemSize)
+        {
+            const uint32_t count = Read32();
+            if ((count > limit) || (count > Remaining() / itemSize))
+            {
+                m_ok = false;
+                return 0;
+            }
+
+            return count;
+        }
+
+        std::wstring ReadString()
+        {
+            const uint32_t length = ReadCount(MAX_STRING_LENGTH, 2);
+            const uint8_t *p = Take(size_t(length) * 2);
+            std::wstring text;
+            if (!p)
+            {
+                return text;
+            }
+
+            text.reserve(length);
+            for (uint32_t i = 0; i < length; i++)
+            {
+                uint32_t unit = ReadLE16(p + 2 * i);
+
+                // wchar_t is UTF-16 on Windows and UTF-32 elsewhere, where pairs of surrogates are put together
+                if constexpr (sizeof(wchar_t) > 2)
+                {
+                    if ((unit >= 0xd800) && (unit < 0xdc00) && (i + 1 < length))
+                    {
+                        const uint32_t low = ReadLE16(p + 2 * (i + 1));
+                        if ((low >= 0xdc00) && (low < 0xe000))
+                        {
+                            unit = 0x10000 + ((unit - 0xd800) << 10) + (low - 0xdc00);
+                            i++;
+                        }
+                    }
+                }
+
+                text.push_back(static_cast<wchar_t>(unit));
+            }
+
+            return text;
+        }
+
+        std::vector<std::wstring> ReadStrings()
+        {
+            std::vector<std::wstring> strings(ReadCount(MAX_LIST_LENGTH, 4));
+            for (std::wstring &text : strings)
+            {
+                text = ReadString();
+            }
+
+            return strings;
+        }
+
+    private:
+        const uint8_t *m_data;
+        size_t m_size;
+        size_t m_offset{};
+        bool m_ok{true};
+    };
+
+    // Checks the magic at the start and the CRC at the end, and returns a reader of what is between
+    bool OpenChecked(const uint8_t *data, size_t size, const char (&magic)[8], CByteReader &reader)
+    {
+        if ((size < sizeof(magic) + 4) || (memcmp(data, magic, sizeof(magic)) != 0)
+            || (Crc32(0, data, size - 4) != ReadLE32(data + size - 4)))
+        {
+            return false;
+        }
+
+        reader = CByteReader(data + sizeof(magic), size - sizeof(magic) - 4);
+
+        return true;
+    }
+
+    bool ReadFileBytes(const std::filesystem::path &path, std::vector<uint8_t> &bytes)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+        return !file.bad();
+    }
+
+    // A name for a temporary file that no other write uses, from this process or from
+    // another one sharing the directory
+    std::filesystem::path GetTemporaryPath(const std::filesystem::path &path)
+    {
+        static const uint64_t process = (uint64_t(std::random_device()()) << 32) | std::random_device()();
+        static std::atomic<uint64_t> writes{};
+
+        static const wchar_t digits[] = L"0123456789abcdef";
+        const uint64_t unique = Mix(process + writes++);
+        std::wstring suffix = L".";
+        for (int shift = 60; shift >= 0; shift -= 4)
+        {
+            suffix += digits[(unique >> shift) & 0xF];
+        }
+        suffix += L".tmp";
+
+        std::filesystem::path temporary = path;
+        temporary += suffix;
+
+        return temporary;
+    }
+
+    // Writes next to the file and renames it over, so that a reader never sees half of one
+    bool WriteFileBytes(const std::filesystem::path &path, const std::vector<uint8_t> &bytes)
+    {
+        const std::filesystem::path temporary = GetTemporaryPath(path);
+        std::error_code error;
+
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+            {
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            if (!file)
+            {
+                file.close();
+                std::filesystem::remove(temporary, error);
+                return false;
+            }
+        }
+
+        std::filesystem::rename(temporary, path, error);
+        if (error)
+        {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+
+        return true;
+    }
+}
+
+uint64_t HashImageContent(const uint8_t *data, uint64_t size)
+{
+    uint64_t hash = Mix(size ^ 0x57494358ULL);
+
+    if (size <= 3 * SAMPLE_SIZE)
+    {
+        return HashBytes(hash, data, size);
+    }
+
+    hash = HashBytes(hash, data, SAMPLE_SIZE);
+    hash = HashBytes(hash, data + (size - SAMPLE_SIZE) / 2, SAMPLE_SIZE);
+
+    return HashBytes(hash, data + size - SAMPLE_SIZE, SAMPLE_SIZE);
+}
+
+CImageCache::CImageCache(std::filesystem::path directory)
+    : m_directory(std::move(directory))
+{
+}
+
+bool CImageCache::Open()
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes;
+    if (!ReadFileBytes(m_directory / INDEX_NAME, bytes))
+    {
+        // A new cache
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    if (!DeserializeIndex(bytes.data(), bytes.size()))
+    {
+        // What is left of an index that cannot be read is dropped with it
+        m_paths.clear();
+        m_summaries.clear();
+        m_dirty = true;
+    }
+
+    return true;
+}
+
+bool CImageCache::Save()
+{
+    std::vector<uint8_t> bytes;
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if (!m_dirty)
+        {
+            return true;
+        }
+
+        bytes = SerializeIndex();
+        m_dirty = false;
+    }
+
+    return WriteFileBytes(m_directory / INDEX_NAME, bytes);
+}
+
+CImageCache::PathState CImageCache::FindContentHash(const ImageCacheKey &key, uint64_t &contentHash)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    const auto found = m_paths.find(key.path);
+    if (found == m_paths.end())
+    {
+        return PathState::Unknown;
+    }
+    if ((found->second.size != key.size) || (found->second.modifiedTime != key.modifiedTime))
+    {
+        return PathState::Changed;
+    }
+
+    contentHash = found->second.contentHash;
+
+    return PathState::Unchanged;
+}
+
+std::shared_ptr<const CachedImageSummary> CImageCache::FindSummary(uint64_t contentHash)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    const auto found = m_summaries.find(contentHash);
+
+    return (found != m_summaries.end()) ? found->second : nullptr;
+}
+
+void CImageCache::Store(const ImageCacheKey &key, uint64_t contentHash, std::shared_ptr<const CachedImageSummary> summary)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    PathEntry &entry = m_paths[key.path];
+    if ((entry.size != key.size) || (entry.modifiedTime != key.modifiedTime) || (entry.contentHash != contentHash))
+    {
+        entry = PathEntry{ key.size, key.modifiedTime, contentHash };
+        m_dirty = true;
+    }
+
+    if (summary)
+    {
+        m_summaries[contentHash] = std::move(summary);
+        m_dirty = true;
+    }
+}
+
+std::filesystem::path CImageCache::GetThumbnailPath(uint64_t contentHash) const
+{
+    return m_directory / (FormatHex(contentHash, 16).substr(2) + L".thm");
+}
+
+bool CImageCache::LoadThumbnail(uint64_t contentHash, CachedThumbnail &thumbnail) const
+{
+    std::vector<uint8_t> bytes;
+
+    return ReadFileBytes(GetThumbnailPath(contentHash), bytes) && DeserializeThumbnail(bytes.data(), bytes.size(), thumbnail);
+}
+
+bool CImageCache::StoreThumbnail(uint64_t contentHash, const CachedThumbnail &thumbnail) const
+{
+    return WriteFileBytes(GetThumbnailPath(contentHash), SerializeThumbnail(thumbnail));
+}
+
+void CImageCache::RemoveThumbnail(uint64_t contentHash) const
+{
+    std::error_code error;
+    std::filesystem::remove(GetThumbnailPath(contentHash), error);
+}
+
+void CImageCache::GetStats(size_t &paths, size_t &summaries)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    paths = m_paths.size();
+    summaries = m_summaries.size();
+}
+
+std::vector<uint8_t> CImageCache::SerializeSummary(const CachedImageSummary &summary)
+{
+    CByteWriter writer;
+
+    writer.WriteGuid(summary.decoderClsid);
+    writer.WriteGuid(summary.containerFormat);
+    writer.Write32(summary.frameCount);
+    writer.WriteStrings(summary.metadataReaders);
+
+    writer.Write32(static_cast<uint32_t>(std::min<size_t>(summary.frames.size(), MAX_SUMMARY_FRAMES)));
+    for (size_t i = 0; (i < summary.frames.size()) && (i < MAX_SUMMARY_FRAMES); i++)
+    {
+        const CachedFrameSummary &frame = summary.frames[i];
+        writer.Write32(frame.width);
+        writer.Write32(frame.height);
+        writer.WriteGuid(frame.pixelFormat);
+        writer.WriteStrings(frame.metadataReaders);
+    }
+
+    return std::move(writer.Bytes());
+}
+
+bool CImageCache::DeserializeSummary(const uint8_t *data, size_t size, CachedImageSummary &summary)
+{
+    CByteReader reader(data, size);
+
+    summary.decoderClsid = reader.ReadGuid();
+    summary.containerFormat = reader.ReadGuid();
+    summary.frameCount = reader.Read32();
+    summary.metadataReaders = reader.ReadStrings();
+
+    // Each frame is at least its size, pixel format and reader count
+    summary.frames.resize(reader.ReadCount(MAX_SUMMARY_FRAMES, 28));
+    for (CachedFrameSummary &frame : summary.frames)
+    {
+        frame.width = reader.Read32();
+        frame.height = reader.Read32();
+        frame.pixelFormat = reader.ReadGuid();
+        frame.metadataReaders = reader.ReadStrings();
+    }
+
+    return reader.Ok() && (0 == reader.Remaining());
+}
+
+std::vector<uint8_t> CImageCache::SerializeThumbnail(const CachedThumbnail &thumbnail)
+{
+    CByteWriter writer;
+
+    writer.WriteBytes(THUMBNAIL_MAGIC, sizeof(THUMBNAIL_MAGIC));
+    writer.Write32(thumbnail.width);
+    writer.Write32(thumbnail.height);
+    writer.Write32(thumbnail.embedded ? 1 : 0);
+    writer.WriteBytes(thumbnail.pixels.data(), thumbnail.pixels.size());
+    writer.WriteCrc();
+
+    return std::move(writer.Bytes());
+}
+
+bool CImageCache::DeserializeThumbnail(const uint8_t *data, size_t size, CachedThumbnail &thumbnail)
+{
+    CByteReader reader(nullptr, 0);
+    if (!OpenChecked(data, size, THUMBNAIL_MAGIC, reader))
+    {
+        return false;
+    }
+
+    thumbnail.width = reader.Read32();
+    thumbnail.height = reader.Read32();
+    thumbnail.embedded = (reader.Read32() & 1) != 0;
+
+    if ((thumbnail.width == 0) || (thumbnail.height == 0)
+        || (thumbnail.width > MAX_THUMBNAIL_SIZE) || (thumbnail.height > MAX_THUMBNAIL_SIZE))
+    {
+        return false;
+    }
+
+    const size_t length = size_t(thumbnail.width) * thumbnail.height * 4;
+    const uint8_t *pixels = reader.Take(length);
+    if (!pixels || (0 != reader.Remaining()))
+    {
+        return false;
+    }
+
+    thumbnail.pixels.assign(pixels, pixels + length);
+
+    return true;
+}
+
+std::vector<uint8_t> CImageCache::SerializeIndex()
+{
+    CByteWriter writer;
+
+    writer.WriteBytes(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+
+    // Each summary is prefixed with its length, so that a reader can skip it whole
+    writer.Write32(static_cast<uint32_t>(m_summaries.size()));
+    for (const auto &summary : m_summaries)
+    {
+        const std::vector<uint8_t> bytes = SerializeSummary(*summary.second);
+        writer.Write64(summary.first);
+        writer.Write32(static_cast<uint32_t>(bytes.size()));
+        writer.WriteBytes(bytes.data(), bytes.size());
+    }
+
+    writer.Write32(static_cast<uint32_t>(m_paths.size()));
+    for (const auto &path : m_paths)
+    {
+        writer.WriteString(path.first);
+        writer.Write64(path.second.size);
+        writer.Write64(static_cast<uint64_t>(path.second.modifiedTime));
+        writer.Write64(path.second.contentHash);
+    }
+
+    writer.WriteCrc();
+
+    return std::move(writer.Bytes());
+}
+
+bool CImageCache::DeserializeIndex(const uint8_t *data, size_t size)
+{
+    CByteReader reader(nullptr, 0);
+    if (!OpenChecked(data, size, INDEX_MAGIC, reader))
+    {
+        return false;
+    }
+
+    // The counts are only checked against what is left to read; the CRC already
+    // tells that the file is the one that was written
+    const uint32_t summaryCount = reader.ReadCount(UINT32_MAX, 12);
+    for (uint32_t i = 0; i < summaryCount; i++)
+    {
+        const uint64_t contentHash = reader.Read64();
+        const uint32_t length = reader.Read32();
+        const uint8_t *bytes = reader.Take(length);
+
+        auto summary = std::make_shared<CachedImageSummary>();
+        if (!bytes || !DeserializeSummary(bytes, length, *summary))
+        {
+            return false;
+        }
+
+        m_summaries[contentHash] = std::move(summary);
+    }
+
+    const uint32_t pathCount = reader.ReadCount(UINT32_MAX, 28);
+    for (uint32_t i = 0; i < pathCount; i++)
+    {
+        std::wstring path = reader.ReadString();
+        PathEntry entry;
+        entry.size = reader.Read64();
+        entry.modifiedTime = static_cast<int64_t>(reader.Read64());
+        entry.contentHash = reader.Read64();
+
+        if (!reader.Ok())
+        {
+            return false;
+        }
+
+        m_paths[std::move(path)] = entry;
+    }
+
+    return reader.Ok() && (0 == reader.Remaining());
+}
@@ -0,0 +1,140 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What WIC Explorer remembers about an image file between sessions. GUIDs are kept as
+// their 16 bytes in the order a Windows GUID has them in memory.
+using CacheGuid = std::array<uint8_t, 16>;
+
+struct CachedFrameSummary
+{
+    uint32_t width{};
+    uint32_t height{};
+    CacheGuid pixelFormat{};
+    // The friendly names of the frame's metadata readers
+    std::vector<std::wstring> metadataReaders;
+};
+
+struct CachedImageSummary
+{
+    CacheGuid decoderClsid{};
+    CacheGuid containerFormat{};
+    uint32_t frameCount{};
+    // The first MAX_SUMMARY_FRAMES frames of the file
+    std::vector<CachedFrameSummary> frames;
+    // The friendly names of the container's metadata readers
+    std::vector<std::wstring> metadataReaders;
+};
+
+struct CachedThumbnail
+{
+    uint32_t width{};
+    uint32_t height{};
+    // Whether it came from a thumbnail embedded in the file
+    bool embedded{};
+    // Top-down 32bpp premultiplied BGRA
+    std::vector<uint8_t> pixels;
+};
+
+// A file as the file system describes it; the cache only trusts what it knows about a
+// path while its size and modification time stay the same
+struct ImageCacheKey
+{
+    std::wstring path;
+    uint64_t size{};
+    int64_t modifiedTime{};
+};
+
+// A hash of the file's size and of up to three 64 KB samples of its content, from its
+// start, middle and end. It tells files apart well enough to address the cache without
+// reading all of a large file.
+uint64_t HashImageContent(const uint8_t *data, uint64_t size);
+
+// A cache on disk of image summaries and thumbnails, addressed by content hash. The
+// index file holds the summaries and the content hash last seen for each path, so
+// that a file that did not change is found without reading it. A path that is new to
+// the cache is looked up by its hash, so that copies and renames are found again; a
+// known path whose size or time changed is not, since the sampled hash can miss an
+// edit. Thumbnails are kept in a file per hash next to the index. Like the native
+// parsers, it uses nothing but the standard library, and it treats files it cannot
+// read or check as missing.
+class CImageCache final
+{
+public:
+    enum : uint32_t
+    {
+        MAX_SUMMARY_FRAMES = 64,
+        MAX_THUMBNAIL_SIZE = 1024,
+    };
+
+    enum class PathState
+    {
+        Unknown,
+        Unchanged,
+        Changed,
+    };
+
+    explicit CImageCache(std::filesystem::path directory);
+
+    CImageCache(const CImageCache &) = delete;
+    CImageCache &operator=(const CImageCache &) = delete;
+
+    // Creates the directory and reads the index, if there is one
+    bool Open();
+    // Writes the index if it changed since it was read
+    bool Save();
+
+    // Finds the content hash recorded for the path; it is only set when the size and
+    // time still match
+    PathState FindContentHash(const ImageCacheKey &key, uint64_t &contentHash);
+    std::shared_ptr<const CachedImageSummary> FindSummary(uint64_t contentHash);
+    // Records the content hash of the path and, when summary is not null, its summary
+    void Store(const ImageCacheKey &key, uint64_t contentHash, std::shared_ptr<const CachedImageSummary> summary);
+
+    bool LoadThumbnail(uint64_t contentHash, CachedThumbnail &thumbnail) const;
+    bool StoreThumbnail(uint64_t contentHash, const CachedThumbnail &thumbnail) const;
+    void RemoveThumbnail(uint64_t contentHash) const;
+
+    void GetStats(size_t &paths, size_t &summaries);
+
+    // The index and thumbnail formats, which are the same on every platform
+    static std::vector<uint8_t> SerializeSummary(const CachedImageSummary &summary);
+    static bool DeserializeSummary(const uint8_t *data, size_t size, CachedImageSummary &summary);
+    static std::vector<uint8_t> SerializeThumbnail(const CachedThumbnail &thumbnail);
+    static bool DeserializeThumbnail(const uint8_t *data, size_t size, CachedThumbnail &thumbnail);
+
+private:
+    struct PathEntry
+    {
+        uint64_t size{};
+        int64_t modifiedTime{};
+        uint64_t contentHash{};
+    };
+
+    std::filesystem::path GetThumbnailPath(uint64_t contentHash) const;
+    std::vector<uint8_t> SerializeIndex();
+    bool DeserializeIndex(const uint8_t *data, size_t size);
+
+    const std::filesystem::path m_directory;
+
+    std::mutex m_lock;
+    std::map<std::wstring, PathEntry> m_paths;
+    std::map<uint64_t, std::shared_ptr<const CachedImageSummary>> m_summaries;
+    bool m_dirty{};
+};
@@ -0,0 +1,105 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "ImageFiles.h"
+
+static const LPCWSTR ImageFileExtensions[] =
+{
+    L".jpg", L".jpeg", L".png", L".gif", L".bmp",
+    L".tif", L".tiff", L".ico", L".icon", L".dds",
+};
+
+bool IsImageFile(LPCWSTR filename)
+{
+    const LPCWSTR extension = wcsrchr(filename, L'.');
+    if (nullptr == extension)
+    {
+        return false;
+    }
+
+    for (const LPCWSTR imageExtension : ImageFileExtensions)
+    {
+        if (0 == _wcsicmp(extension, imageExtension))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+HRESULT EnumerateImageFiles(LPCWSTR directory, CSimpleArray<CString> &files)
+{
+    HRESULT hr = S_OK;
+    WIN32_FIND_DATA fdata;
+    const HANDLE hf = FindFirstFile(CString(directory) + L"\\*", &fdata);
+
+    if (hf == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    do
+    {
+        const CString path = CString(directory) + L"\\" + fdata.cFileName;
+
+        if ((fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY)
+        {
+            if (wcscmp(fdata.cFileName, L".") && wcscmp(fdata.cFileName, L".."))
+            {
+                const HRESULT temp = EnumerateImageFiles(path, files);
+                if (FAILED(temp))
+                {
+                    hr = temp;
+                }
+            }
+        }
+        else if (IsImageFile(fdata.cFileName))
+        {
+            files.Add(path);
+        }
+    } while (FindNextFile(hf, &fdata));
+
+    FindClose(hf);
+
+    return hr;
+}
+
+HRESULT ExpandWildcard(LPCWSTR search, CSimpleArray<CString> &files)
+{
+    // cFileName does not include the directory, so keep the one from the search string
+    CString directory(search);
+    int lastSlash = directory.ReverseFind(L'\\');
+    if (directory.ReverseFind(L'/') > lastSlash)
+    {
+        lastSlash = directory.ReverseFind(L'/');
+    }
+    directory = directory.Left(lastSlash + 1);
+
+    WIN32_FIND_DATA fdata;
+    const HANDLE hf = FindFirstFile(search, &fdata);
+
+    if (hf == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    do
+    {
+        if ((fdata.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+        {
+            files.Add(directory + fdata.cFileName);
+        }
+    } while (FindNextFile(hf, &fdata));
+
+    FindClose(hf);
+
+    return S_OK;
+}
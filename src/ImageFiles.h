@@ -0,0 +1,18 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+// Returns true if the filename has one of the extensions that Open Directory picks up
+bool IsImageFile(LPCWSTR filename);
+
+// Appends the full path of every image file below directory (recursively) to files
+HRESULT EnumerateImageFiles(LPCWSTR directory, CSimpleArray<CString> &files);
+
+// Appends the files matching a wildcard expression (not recursive) to files
+HRESULT ExpandWildcard(LPCWSTR search, CSimpleArray<CString> &files);
@@ -302,15 +302,22 @@ HRESULT CImageTransencoder::CreateFrameEncode(IWICBitmapSourcePtr bitmapSource,
         delete[] contexts;
     }
 
-    // Finally, write the actual BitmapSource
+    // Finally, write the actual BitmapSource. It is written in bands of rows, so
+    // that the encoder never asks the source for the whole image at once.
+    const UINT bandHeight = (g_bandHeight > 0) ? g_bandHeight : height;
+
     WICRect rct;
     rct.X = 0;
-    rct.Y = 0;
     rct.Width = width;
-    rct.Height = height;
 
-    m_codeGen->CallFunction(L"frame->WriteSource(source, &rct)");
-    IFC(frameEncode->WriteSource(bitmapSource, &rct));
+    m_codeGen->CallFunction(L"frame->WriteSource(source, &rct) for each band of %u rows", bandHeight);
+    for (UINT top = 0; top < height; top += bandHeight)
+    {
+        rct.Y = top;
+        rct.Height = (height - top < bandHeight) ? (height - top) : bandHeight;
+
+        IFC(frameEncode->WriteSource(bitmapSource, &rct));
+    }
 
     return result;
 }
@@ -12,6 +12,7 @@
 
 MP(IWICBitmapScaler)
 MP(IWICBitmapSource)
+MP(IWICBitmapSourceTransform)
 MP(IWICBitmapClipper)
 MP(IWICBitmapEncoder)
 MP(IWICBitmapFrameEncode)
@@ -39,5 +40,6 @@ MP(IWICComponentFactory)
 MP(IWICMetadataQueryWriter)
 MP(IWICMetadataQueryReader)
 MP(IWICProgressiveLevelControl)
+MP(IWICDdsDecoder)
 
 #undef MP
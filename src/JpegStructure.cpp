@@ -0,0 +1,480 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace FileStructure;
+
+namespace
+{
+    // Restart markers past this many are counted but get no node of their own
+    const uint64_t MAX_LISTED_RESTARTS = 1024;
+
+    const uint8_t ZigZag[64] =
+    {
+         0,  1,  8, 16,  9,  2,  3, 10,
+        17, 24, 32, 25, 18, 11,  4,  5,
+        12, 19, 26, 33, 40, 48, 41, 34,
+        27, 20, 13,  6,  7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36,
+        29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46,
+        53, 60, 61, 54, 47, 55, 62, 63,
+    };
+
+    bool IsStartOfFrame(uint8_t marker)
+    {
+        // C4, C8 and CC are DHT, JPG and DAC
+        return (marker >= 0xC0) && (marker <= 0xCF) && (marker != 0xC4) && (marker != 0xC8) && (marker != 0xCC);
+    }
+
+    std::wstring GetMarkerName(uint8_t marker)
+    {
+        static const wchar_t *frameNames[16] =
+        {
+            L"SOF0", L"SOF1", L"SOF2", L"SOF3", L"DHT", L"SOF5", L"SOF6", L"SOF7",
+            L"JPG", L"SOF9", L"SOF10", L"SOF11", L"DAC", L"SOF13", L"SOF14", L"SOF15",
+        };
+
+        if ((marker >= 0xC0) && (marker <= 0xCF))
+        {
+            return frameNames[marker - 0xC0];
+        }
+        if ((marker >= 0xD0) && (marker <= 0xD7))
+        {
+            return L"RST" + std::to_wstring(marker - 0xD0);
+        }
+        if ((marker >= 0xE0) && (marker <= 0xEF))
+        {
+            return L"APP" + std::to_wstring(marker - 0xE0);
+        }
+
+        switch (marker)
+        {
+        case 0x01: return L"TEM";
+        case 0xD8: return L"SOI";
+        case 0xD9: return L"EOI";
+        case 0xDA: return L"SOS";
+        case 0xDB: return L"DQT";
+        case 0xDC: return L"DNL";
+        case 0xDD: return L"DRI";
+        case 0xDE: return L"DHP";
+        case 0xDF: return L"EXP";
+        case 0xFE: return L"COM";
+        default: return L"Marker " + FormatHex(marker, 2);
+        }
+    }
+
+    const wchar_t *GetFrameTypeName(uint8_t marker)
+    {
+        switch (marker)
+        {
+        case 0xC0: return L"Baseline";
+        case 0xC1: return L"Extended sequential, Huffman";
+        case 0xC2: return L"Progressive, Huffman";
+        case 0xC3: return L"Lossless, Huffman";
+        case 0xC5: return L"Differential sequential, Huffman";
+        case 0xC6: return L"Differential progressive, Huffman";
+        case 0xC7: return L"Differential lossless, Huffman";
+        case 0xC9: return L"Extended sequential, arithmetic";
+        case 0xCA: return L"Progressive, arithmetic";
+        case 0xCB: return L"Lossless, arithmetic";
+        case 0xCD: return L"Differential sequential, arithmetic";
+        case 0xCE: return L"Differential progressive, arithmetic";
+        case 0xCF: return L"Differential lossless, arithmetic";
+        default: return L"Unknown";
+        }
+    }
+
+    void DescribeApp(StructureNode &node, const uint8_t *data, size_t length)
+    {
+        // Application segments start with a null terminated identifier
+        size_t end = 0;
+        while ((end < length) && (end < 64) && (data[end] != 0))
+        {
+            end++;
+        }
+        if ((end == length) || (end == 64))
+        {
+            return;
+        }
+
+        std::string identifier(reinterpret_cast<const char *>(data), end);
+        node.AddValue(L"Identifier", Latin1ToWide(data, end));
+
+        const uint8_t *payload = data + end + 1;
+        size_t payloadLength = length - end - 1;
+
+        if ((identifier == "JFIF") && (payloadLength >= 7))
+        {
+            static const wchar_t *units[] = { L"None", L"Dots per inch", L"Dots per cm" };
+            node.AddValue(L"Version", std::to_wstring(payload[0]) + L"." + std::to_wstring(payload[1]));
+            node.AddValue(L"DensityUnits", (payload[2] < 3) ? units[payload[2]] : L"Unknown");
+            node.AddValue(L"XDensity", ReadBE16(payload + 3));
+            node.AddValue(L"YDensity", ReadBE16(payload + 5));
+        }
+        else if ((identifier == "Exif") && (payloadLength >= 1))
+        {
+            // Exif is followed by a second null before the TIFF header
+            ParseTiffBlock(payload + 1, payloadLength - 1, node.offset + 4 + end + 2, L"/app1/ifd", node);
+        }
+        else if ((identifier == "ICC_PROFILE") && (payloadLength >= 2))
+        {
+            node.AddValue(L"ChunkNumber", std::to_wstring(payload[0]) + L" of " + std::to_wstring(payload[1]));
+            node.AddValue(L"ProfileBytes", payloadLength - 2);
+        }
+        else if ((identifier == "http://ns.adobe.com/xap/1.0/"))
+        {
+            node.AddValue(L"XmpBytes", payloadLength);
+        }
+    }
+
+    void DescribeQuantizationTables(StructureNode &node, const uint8_t *data, size_t length)
+    {
+        size_t pos = 0;
+        while (pos < length)
+        {
+            uint8_t precision = static_cast<uint8_t>(data[pos] >> 4);
+            uint8_t id = static_cast<uint8_t>(data[pos] & 0x0F);
+            size_t tableLength = 1 + 64 * (precision ? 2u : 1u);
+
+            StructureNode &table = node.AddChild(L"Table " + std::to_wstring(id), node.offset + 4 + pos, std::min(tableLength, length - pos));
+            table.AddValue(L"Precision", precision ? L"16 bit" : L"8 bit");
+            if (tableLength > length - pos)
+            {
+                table.AddError(L"The table is cut short");
+                break;
+            }
+
+            // The values are stored in zigzag order; show them as the 8x8 block they scale
+            uint16_t values[64];
+            for (size_t i = 0; i < 64; i++)
+            {
+                values[ZigZag[i]] = precision ? ReadBE16(data + pos + 1 + i * 2) : uint16_t(data[pos + 1 + i]);
+            }
+            for (size_t row = 0; row < 8; row++)
+            {
+                std::wstring text;
+                for (size_t column = 0; column < 8; column++)
+                {
+                    if (column)
+                    {
+                        text += L' ';
+                    }
+                    text += std::to_wstring(values[row * 8 + column]);
+                }
+                table.AddValue(L"Row " + std::to_wstring(row), text);
+            }
+
+            pos += tableLength;
+        }
+    }
+
+    void DescribeHuffmanTables(StructureNode &node, const uint8_t *data, size_t length)
+    {
+        size_t pos = 0;
+        while (pos < length)
+        {
+            uint8_t tableClass = static_cast<uint8_t>(data[pos] >> 4);
+            uint8_t id = static_cast<uint8_t>(data[pos] & 0x0F);
+
+            uint32_t symbols = 0;
+            if (17 <= length - pos)
+            {
+                for (size_t i = 1; i <= 16; i++)
+                {
+                    symbols += data[pos + i];
+                }
+            }
+            size_t tableLength = 17 + symbols;
+
+            StructureNode &table = node.AddChild(std::wstring(tableClass ? L"AC" : L"DC") + L" table " + std::to_wstring(id),
+                node.offset + 4 + pos, std::min(tableLength, length - pos));
+            if (tableLength > length - pos)
+            {
+                table.AddError(L"The table is cut short");
+                break;
+            }
+            table.AddValue(L"Symbols", symbols);
+
+            pos += tableLength;
+        }
+    }
+
+    void DescribeFrame(StructureNode &node, uint8_t marker, const uint8_t *data, size_t length)
+    {
+        node.AddValue(L"FrameType", GetFrameTypeName(marker));
+        if (length < 6)
+        {
+            return;
+        }
+
+        node.AddValue(L"Precision", data[0]);
+        node.AddValue(L"Height", ReadBE16(data + 1));
+        node.AddValue(L"Width", ReadBE16(data + 3));
+        node.AddValue(L"Components", data[5]);
+
+        for (size_t i = 0; (i < data[5]) && (6 + i * 3 + 3 <= length); i++)
+        {
+            const uint8_t *component = data + 6 + i * 3;
+            node.AddValue(L"Component " + std::to_wstring(component[0]),
+                L"Sampling " + std::to_wstring(component[1] >> 4) + L"x" + std::to_wstring(component[1] & 0x0F)
+                + L", quantization table " + std::to_wstring(component[2]));
+        }
+    }
+
+    void DescribeScan(StructureNode &node, const uint8_t *data, size_t length)
+    {
+        if (length < 1)
+        {
+            return;
+        }
+
+        size_t count = data[0];
+        node.AddValue(L"Components", count);
+        for (size_t i = 0; (i < count) && (1 + i * 2 + 2 <= length); i++)
+        {
+            const uint8_t *component = data + 1 + i * 2;
+            node.AddValue(L"Component " + std::to_wstring(component[0]),
+                L"DC table " + std::to_wstring(component[1] >> 4) + L", AC table " + std::to_wstring(component[1] & 0x0F));
+        }
+
+        if (1 + count * 2 + 3 <= length)
+        {
+            const uint8_t *selection = data + 1 + count * 2;
+            node.AddValue(L"SpectralStart", selection[0]);
+            node.AddValue(L"SpectralEnd", selection[1]);
+            node.AddValue(L"ApproximationHigh", selection[2] >> 4);
+            node.AddValue(L"ApproximationLow", selection[2] & 0x0F);
+        }
+    }
+
+    // Skips the entropy coded data that follows a scan header, and returns the offset
+    // of the marker that ends it. Stuffed zero bytes and restart markers are part of
+    // the data.
+    uint64_t SkipEntropyCodedData(const uint8_t *data, size_t size, uint64_t offset, StructureNode &node)
+    {
+        uint64_t restarts = 0;
+        uint64_t pos = offset;
+
+        for (;;)
+        {
+            const void *found = memchr(data + pos, 0xFF, size - pos);
+            if (!found)
+            {
+                pos = size;
+                break;
+            }
+
+            pos = static_cast<uint64_t>(static_cast<const uint8_t *>(found) - data);
+            if (pos + 1 >= size)
+            {
+                pos = size;
+                break;
+            }
+
+            uint8_t marker = data[pos + 1];
+            if (marker == 0x00)
+            {
+                pos += 2;
+                continue;
+            }
+            if ((marker >= 0xD0) && (marker <= 0xD7))
+            {
+                if (restarts < MAX_LISTED_RESTARTS)
+                {
+                    StructureNode &restart = node.AddChild(GetMarkerName(marker), pos, 2);
+                    if ((marker - 0xD0) != static_cast<int>(restarts % 8))
+                    {
+                        restart.AddError(L"Restart markers are out of sequence");
+                    }
+                }
+                restarts++;
+                pos += 2;
+                continue;
+            }
+
+            // Any other marker, or fill bytes in front of one, ends the scan
+            break;
+        }
+
+        node.length = pos - offset;
+        node.AddValue(L"RestartMarkers", restarts);
+        if (restarts > MAX_LISTED_RESTARTS)
+        {
+            node.AddValue(L"ListedRestartMarkers", MAX_LISTED_RESTARTS);
+        }
+        if (pos == size)
+        {
+            node.AddError(L"The file ends inside the scan");
+        }
+
+        return pos;
+    }
+}
+
+bool ParseJpegStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    if ((size < 3) || (data[0] != 0xFF) || (data[1] != 0xD8) || (data[2] != 0xFF))
+    {
+        return false;
+    }
+
+    root.name = L"JPEG";
+    root.offset = 0;
+    root.length = size;
+    root.AddChild(L"SOI", 0, 2);
+
+    uint64_t offset = 2;
+    uint64_t segments = 0;
+    uint64_t scans = 0;
+    uint64_t quantizationTables = 0;
+    uint64_t huffmanTables = 0;
+    uint32_t restartInterval = 0;
+    bool ended = false;
+
+    while (offset < size)
+    {
+        if (data[offset] != 0xFF)
+        {
+            StructureNode &garbage = root.AddChild(L"Unexpected data", offset, size - offset);
+            garbage.AddError(L"A marker was expected at " + std::to_wstring(offset));
+            break;
+        }
+
+        // Any number of fill bytes can come before a marker
+        uint64_t markerOffset = offset;
+        while ((offset + 1 < size) && (data[offset + 1] == 0xFF))
+        {
+            offset++;
+        }
+        if (offset + 1 >= size)
+        {
+            StructureNode &partial = root.AddChild(L"Truncated marker", markerOffset, size - markerOffset);
+            partial.AddError(L"The file ends inside a marker");
+            break;
+        }
+
+        uint8_t marker = data[offset + 1];
+        offset += 2;
+
+        // Markers without a segment
+        if ((marker == 0xD8) || (marker == 0xD9) || (marker == 0x01) || ((marker >= 0xD0) && (marker <= 0xD7)))
+        {
+            StructureNode &node = root.AddChild(GetMarkerName(marker), markerOffset, offset - markerOffset);
+            if (marker == 0xD9)
+            {
+                ended = true;
+                break;
+            }
+            if (marker != 0x01)
+            {
+                node.AddError(L"The marker is not expected here");
+            }
+            continue;
+        }
+
+        segments++;
+
+        if (!InRange(offset, 2, size))
+        {
+            StructureNode &partial = root.AddChild(GetMarkerName(marker), markerOffset, size - markerOffset);
+            partial.AddError(L"The file ends inside the segment length");
+            break;
+        }
+
+        uint16_t length = ReadBE16(data + offset);
+        bool complete = (length >= 2) && InRange(offset, length, size);
+        // Nodes start at the marker itself, after any fill bytes, so that the offsets of
+        // the tables inside a segment can be worked out from the node's
+        StructureNode &node = root.AddChild(GetMarkerName(marker), offset - 2, complete ? uint64_t(length) + 2 : size - (offset - 2));
+        node.AddValue(L"SegmentLength", length);
+
+        if (length < 2)
+        {
+            node.AddError(L"The segment length is less than 2");
+            break;
+        }
+        if (!complete)
+        {
+            node.AddError(L"The file ends inside the segment");
+            break;
+        }
+
+        // The payload follows the two length bytes
+        const uint8_t *payload = data + offset + 2;
+        size_t payloadLength = length - 2u;
+
+        if ((marker >= 0xE0) && (marker <= 0xEF))
+        {
+            DescribeApp(node, payload, payloadLength);
+        }
+        else if (marker == 0xDB)
+        {
+            DescribeQuantizationTables(node, payload, payloadLength);
+            quantizationTables += node.children.size();
+        }
+        else if (marker == 0xC4)
+        {
+            DescribeHuffmanTables(node, payload, payloadLength);
+            huffmanTables += node.children.size();
+        }
+        else if (IsStartOfFrame(marker))
+        {
+            DescribeFrame(node, marker, payload, payloadLength);
+            root.AddValue(L"FrameType", GetFrameTypeName(marker));
+        }
+        else if ((marker == 0xDD) && (payloadLength >= 2))
+        {
+            restartInterval = ReadBE16(payload);
+            node.AddValue(L"RestartInterval", restartInterval);
+        }
+        else if (marker == 0xFE)
+        {
+            std::wstring text = Latin1ToWide(payload, std::min(payloadLength, MAX_TEXT_VALUE));
+            node.AddValue(L"Comment", (payloadLength > MAX_TEXT_VALUE) ? text + L"..." : text);
+        }
+
+        offset += length;
+
+        if (marker == 0xDA)
+        {
+            scans++;
+            node.name += L" (scan " + std::to_wstring(scans) + L")";
+            DescribeScan(node, payload, payloadLength);
+
+            StructureNode &entropy = root.AddChild(L"Entropy-coded data", offset, 0);
+            offset = SkipEntropyCodedData(data, size, offset, entropy);
+        }
+    }
+
+    // Data past EOI is often another image, such as the ones of an MPO file
+    if (ended && (offset < size))
+    {
+        StructureNode &trailing = root.AddChild(L"Trailing data", offset, size - offset);
+        if (InRange(offset, 2, size) && (data[offset] == 0xFF) && (data[offset + 1] == 0xD8))
+        {
+            trailing.AddValue(L"Content", L"Another JPEG image");
+        }
+    }
+
+    root.AddValue(L"Segments", segments);
+    root.AddValue(L"Scans", scans);
+    root.AddValue(L"QuantizationTables", quantizationTables);
+    root.AddValue(L"HuffmanTables", huffmanTables);
+    root.AddValue(L"RestartInterval", restartInterval);
+    if (!ended)
+    {
+        root.AddError(L"There is no EOI marker");
+    }
+
+    return true;
+}
@@ -0,0 +1,299 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "JsonRecord.h"
+
+#include <cassert>
+#include <cwchar>
+#include <cwctype>
+
+void CJsonRecordWriter::BeginRecord(const std::wstring &filename)
+{
+    m_record = L"{\"file\":";
+    AppendString(m_record, filename);
+
+    m_group.clear();
+    m_firstItem.clear();
+}
+
+void CJsonRecordWriter::AddRecordValue(const std::wstring &key, const std::wstring &value)
+{
+    assert(m_firstItem.empty());
+
+    m_record += L',';
+    AppendString(m_record, key);
+    m_record += L':';
+    AppendString(m_record, value);
+}
+
+void CJsonRecordWriter::AddRecordValue(const std::wstring &key, uint32_t value)
+{
+    assert(m_firstItem.empty());
+
+    m_record += L',';
+    AppendString(m_record, key);
+    m_record += L':';
+    m_record += std::to_wstring(value);
+}
+
+void CJsonRecordWriter::AddRecordValue(const std::wstring &key, const std::vector<InspectRender> &renders)
+{
+    assert(m_firstItem.empty());
+
+    m_record += L',';
+    AppendString(m_record, key);
+    m_record += L":[";
+
+    for (size_t i = 0; i < renders.size(); i++)
+    {
+        const InspectRender &render = renders[i];
+
+        m_record += (0 == i) ? L"{\"element\":" : L",{\"element\":";
+        AppendString(m_record, render.element);
+
+        wchar_t values[512];
+        swprintf(values, sizeof(values) / sizeof(values[0]),
+            L",\"result\":\"0x%.8X\",\"width\":%u,\"height\":%u,\"renderMs\":%.3f,\"setupMs\":%.3f,\"decodeMs\":%.3f,"
+            L"\"colorTransformMs\":%.3f,\"conversionMs\":%.3f,\"alphaMs\":%.3f}",
+            static_cast<unsigned>(render.result), render.width, render.height, render.renderMs, render.setupMs,
+            render.decodeMs, render.colorTransformMs, render.conversionMs, render.alphaMs);
+        m_record += values;
+    }
+
+    m_record += L']';
+}
+
+std::wstring CJsonRecordWriter::EndRecord()
+{
+    // Close every section that is still open, including the record's own items
+    while (m_firstItem.size() > 1)
+    {
+        EndSection();
+    }
+
+    if (!m_firstItem.empty())
+    {
+        m_record += L']';
+        m_firstItem.clear();
+    }
+
+    m_record += L'}';
+
+    std::wstring out;
+    out.swap(m_record);
+
+    return out;
+}
+
+void CJsonRecordWriter::BeginItem()
+{
+    if (m_firstItem.empty())
+    {
+        // The first item of the record opens its items array
+        m_record += L",\"items\":[";
+        m_firstItem.push_back(true);
+    }
+
+    if (!m_firstItem.back())
+    {
+        m_record += L',';
+    }
+    m_firstItem.back() = false;
+}
+
+void CJsonRecordWriter::AppendString(std::wstring &out, const std::wstring &str)
+{
+    out += L'"';
+
+    for (const wchar_t c : str)
+    {
+        switch (c)
+        {
+        case L'"':
+            out += L"\\\"";
+            break;
+        case L'\\':
+            out += L"\\\\";
+            break;
+        case L'\n':
+            out += L"\\n";
+            break;
+        case L'\r':
+            out += L"\\r";
+            break;
+        case L'\t':
+            out += L"\\t";
+            break;
+        default:
+            if (c < L' ')
+            {
+                wchar_t escape[8];
+                swprintf(escape, sizeof(escape) / sizeof(escape[0]), L"\\u%04x", static_cast<unsigned>(c));
+                out += escape;
+            }
+            else
+            {
+                out += c;
+            }
+            break;
+        }
+    }
+
+    out += L'"';
+}
+
+void CJsonRecordWriter::BeginSection(const std::wstring &name)
+{
+    BeginItem();
+
+    m_record += L"{\"section\":";
+    AppendString(m_record, name);
+    m_record += L",\"items\":[";
+
+    m_firstItem.push_back(true);
+    m_group.clear();
+}
+
+void CJsonRecordWriter::AddText(const std::wstring &text)
+{
+    // The rich edit device uses text for layout; only keep text with content
+    size_t first = 0;
+    size_t last = text.size();
+    while ((first < last) && iswspace(text[first]))
+    {
+        first++;
+    }
+    while ((last > first) && iswspace(text[last - 1]))
+    {
+        last--;
+    }
+
+    if (last > first)
+    {
+        BeginItem();
+        m_record += L"{\"text\":";
+        AppendString(m_record, text.substr(first, last - first));
+        m_record += L'}';
+    }
+}
+
+void CJsonRecordWriter::AddVerbatimText(const std::wstring &text)
+{
+    if (m_includeVerbatimText)
+    {
+        BeginItem();
+        m_record += L"{\"verbatim\":";
+        AppendString(m_record, text);
+        m_record += L'}';
+    }
+}
+
+void CJsonRecordWriter::BeginKeyValues(const std::wstring &name)
+{
+    m_group = name;
+}
+
+void CJsonRecordWriter::AddKeyValue(const std::wstring &key, const std::wstring &value)
+{
+    BeginItem();
+
+    m_record += L'{';
+    if (!m_group.empty())
+    {
+        m_record += L"\"group\":";
+        AppendString(m_record, m_group);
+        m_record += L',';
+    }
+    m_record += L"\"key\":";
+    AppendString(m_record, key);
+    m_record += L",\"value\":";
+    AppendString(m_record, value);
+    m_record += L'}';
+}
+
+void CJsonRecordWriter::EndKeyValues()
+{
+    m_group.clear();
+}
+
+void CJsonRecordWriter::EndSection()
+{
+    // The outermost entry is the record's own items array, which only EndRecord closes
+    if (m_firstItem.size() > 1)
+    {
+        m_record += L"]}";
+        m_firstItem.pop_back();
+    }
+
+    m_group.clear();
+}
+
+InspectOutcome MakeInspectOutcome(int32_t result, uint32_t openMs, bool includeCode,
+    const std::function<std::wstring(int32_t result)> &getResultText, const std::function<std::wstring()> &generateCode)
+{
+    InspectOutcome outcome;
+    outcome.result = result;
+    outcome.openMs = openMs;
+
+    // A negative result is a failed HRESULT
+    if (result < 0)
+    {
+        outcome.error = getResultText(result);
+        if (includeCode)
+        {
+            outcome.code = generateCode();
+        }
+    }
+
+    return outcome;
+}
+
+void BeginInspectRecord(CJsonRecordWriter &writer, const std::wstring &filename, const InspectOutcome &outcome,
+    InspectSummary &summary)
+{
+    writer.BeginRecord(filename);
+
+    wchar_t result[16];
+    swprintf(result, sizeof(result) / sizeof(result[0]), L"0x%.8X", static_cast<unsigned>(outcome.result));
+    writer.AddRecordValue(L"result", result);
+
+    // A negative result is a failed HRESULT
+    const bool failed = outcome.result < 0;
+    if (failed)
+    {
+        writer.AddRecordValue(L"error", outcome.error);
+
+        if (!outcome.code.empty())
+        {
+            writer.AddRecordValue(L"code", outcome.code);
+        }
+    }
+
+    writer.AddRecordValue(L"openMs", outcome.openMs);
+
+    summary.attempted++;
+    if (!failed)
+    {
+        summary.opened++;
+    }
+}
+
+std::wstring FormatInspectSummary(const InspectSummary &summary, uint32_t runMs)
+{
+    wchar_t text[160];
+    swprintf(text, sizeof(text) / sizeof(text[0]), L"Inspected %u files: %u opened, %u failed in %u ms (%.1f files/s)",
+        summary.attempted, summary.opened, summary.attempted - summary.opened, runMs,
+        (runMs > 0) ? (summary.attempted * 1000.0 / runMs) : 0.0);
+
+    return text;
+}
+
+int GetInspectExitCode(const InspectSummary &summary)
+{
+    return (summary.opened == summary.attempted) ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// How long each stage of rendering one bitmap took, in milliseconds, and the size
+// it was rendered at
+struct InspectRender
+{
+    // The names of the elements from the decoder down, separated by '/'
+    std::wstring element;
+    int32_t result{};
+    uint32_t width{};
+    uint32_t height{};
+    double renderMs{};
+    double setupMs{};
+    double decodeMs{};
+    double colorTransformMs{};
+    double conversionMs{};
+    double alphaMs{};
+};
+
+// The record format of WICInspect: everything an element writes to its view, as a
+// single-line JSON record, so that a batch run produces one line of output per
+// inspected file. Like the native parsers, it uses nothing but the standard library;
+// CJsonRecordDevice feeds it from the element tree on Windows.
+class CJsonRecordWriter final
+{
+public:
+    void BeginRecord(const std::wstring &filename);
+    // Record values must be added before any section or key/value is written
+    void AddRecordValue(const std::wstring &key, const std::wstring &value);
+    void AddRecordValue(const std::wstring &key, uint32_t value);
+    void AddRecordValue(const std::wstring &key, const std::vector<InspectRender> &renders);
+    std::wstring EndRecord();
+
+    void BeginSection(const std::wstring &name);
+    void AddText(const std::wstring &text);
+    void AddVerbatimText(const std::wstring &text);
+    void BeginKeyValues(const std::wstring &name);
+    void AddKeyValue(const std::wstring &key, const std::wstring &value);
+    void EndKeyValues();
+    void EndSection();
+
+    // Verbatim text is mostly creation code, which is large and rarely wanted in bulk
+    bool m_includeVerbatimText{};
+
+private:
+    void BeginItem();
+    static void AppendString(std::wstring &out, const std::wstring &str);
+
+    std::wstring m_record;
+    std::wstring m_group;
+    // One entry per open "items" array; true until the first item is written
+    std::vector<bool> m_firstItem;
+};
+
+// How opening one file went, which goes at the start of its record
+struct InspectOutcome
+{
+    int32_t result{};
+    // The text of a failed result, and the code that reproduces the failure
+    std::wstring error;
+    std::wstring code;
+    uint32_t openMs{};
+};
+
+// The outcome of opening a file with the given result. A failed result gets its text,
+// and with includeCode the code that reproduces it; neither is asked for otherwise.
+InspectOutcome MakeInspectOutcome(int32_t result, uint32_t openMs, bool includeCode,
+    const std::function<std::wstring(int32_t result)> &getResultText, const std::function<std::wstring()> &generateCode);
+
+struct InspectSummary
+{
+    uint32_t attempted{};
+    uint32_t opened{};
+};
+
+// Begins the record of a file with its outcome, and counts it in the summary; the
+// file's element tree follows, and EndRecord finishes it
+void BeginInspectRecord(CJsonRecordWriter &writer, const std::wstring &filename, const InspectOutcome &outcome,
+    InspectSummary &summary);
+
+// The line WICInspect ends a run with, and its exit code
+std::wstring FormatInspectSummary(const InspectSummary &summary, uint32_t runMs);
+int GetInspectExitCode(const InspectSummary &summary);
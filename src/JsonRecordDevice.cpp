@@ -0,0 +1,61 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "JsonRecordDevice.h"
+
+// Null text is written as an empty string
+static std::wstring ToString(LPCWSTR text)
+{
+    return (nullptr != text) ? std::wstring(text) : std::wstring();
+}
+
+void CJsonRecordDevice::BeginSection(LPCWSTR name)
+{
+    m_writer.BeginSection(ToString(name));
+}
+
+void CJsonRecordDevice::AddText(LPCWSTR text)
+{
+    m_writer.AddText(ToString(text));
+}
+
+void CJsonRecordDevice::AddVerbatimText(LPCWSTR text)
+{
+    m_writer.AddVerbatimText(ToString(text));
+}
+
+void CJsonRecordDevice::AddDib(HGLOBAL hGlobal)
+{
+    // Nothing is rendered into a record, but the device owns the DIB
+    if (nullptr != hGlobal)
+    {
+        GlobalFree(hGlobal);
+    }
+}
+
+void CJsonRecordDevice::BeginKeyValues(LPCWSTR name)
+{
+    m_writer.BeginKeyValues(ToString(name));
+}
+
+void CJsonRecordDevice::AddKeyValue(LPCWSTR key, LPCWSTR value)
+{
+    m_writer.AddKeyValue(ToString(key), ToString(value));
+}
+
+void CJsonRecordDevice::EndKeyValues()
+{
+    m_writer.EndKeyValues();
+}
+
+void CJsonRecordDevice::EndSection()
+{
+    m_writer.EndSection();
+}
@@ -0,0 +1,56 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include "JsonRecord.h"
+#include "OutputDevice.h"
+
+// Writes what an element writes to its view into the JSON record of its file
+class CJsonRecordDevice final : public IOutputDevice
+{
+public:
+    explicit CJsonRecordDevice(CJsonRecordWriter &writer)
+        : m_writer(writer)
+    {
+    }
+
+    void SetBackgroundColor(COLORREF /*color*/) override
+    {
+    }
+
+    COLORREF SetTextColor(COLORREF color) override
+    {
+        return color;
+    }
+
+    void SetHighlightColor(COLORREF /*color*/) override
+    {
+    }
+
+    void SetFontName(LPCWSTR /*name*/) override
+    {
+    }
+
+    int SetFontSize(int pointSize) override
+    {
+        return pointSize;
+    }
+
+    void BeginSection(LPCWSTR name) override;
+    void AddText(LPCWSTR text) override;
+    void AddVerbatimText(LPCWSTR text) override;
+    void AddDib(HGLOBAL hGlobal) override;
+    void BeginKeyValues(LPCWSTR name) override;
+    void AddKeyValue(LPCWSTR key, LPCWSTR value) override;
+    void EndKeyValues() override;
+    void EndSection() override;
+
+private:
+    CJsonRecordWriter &m_writer;
+};
@@ -12,6 +12,14 @@
 #include "EncoderSelectionDlg.h"
 #include "AboutDlg.h"
 #include "PropVariant.h"
+#include "ColorContextCache.h"
+#include "DibCache.h"
+#include "ImageFiles.h"
+#include "Stopwatch.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <vector>
 
 LRESULT CMainFrame::OnCreate(UINT, WPARAM, LPARAM, BOOL&)
 {
@@ -26,10 +34,47 @@ LRESULT CMainFrame::OnCreate(UINT, WPARAM, LPARAM, BOOL&)
 
     m_suppressMessageBox = false;
     m_viewcontext.bIsAlphaEnable = true;
+    m_viewcontext.bIsPremultiplyEnable = false;
+    m_viewcontext.bIsRenderEnable = true;
+    m_viewcontext.bIsChildViewEnable = true;
+    m_viewcontext.childPageSize = CHILD_PAGE_SIZE;
+    m_viewcontext.childFitSize = CHILD_THUMBNAIL_SIZE;
+
+    // The image cache is kept with the user's local application data unless /imagecache says otherwise
+    WCHAR localAppData[MAX_PATH];
+    const DWORD length = GetEnvironmentVariableW(L"LOCALAPPDATA", localAppData, ARRAYSIZE(localAppData));
+    if ((length > 0) && (length < ARRAYSIZE(localAppData)))
+    {
+        m_imageCacheDirectory = CString(localAppData) + L"\\WICExplorer\\Cache";
+    }
 
     return 0;
 }
 
+void CMainFrame::SaveTrace()
+{
+    if (m_traceFile.GetLength() == 0)
+    {
+        return;
+    }
+
+    FILE *out = nullptr;
+    if ((0 != _wfopen_s(&out, m_traceFile, L"wb")) || !CTrace::Inst().Write(out))
+    {
+        CString msg;
+        msg.Format(L"Could not write the trace to %s", m_traceFile.GetString());
+        if (m_suppressMessageBox == FALSE)
+        {
+            MessageBoxW(nullptr, msg, L"Trace", MB_ICONERROR);
+        }
+    }
+
+    if (nullptr != out)
+    {
+        fclose(out);
+    }
+}
+
 HWND CMainFrame::CreateClient()
 {
     CRect clientRect;
@@ -85,6 +130,12 @@ HWND CMainFrame::CreateClient()
 
     m_viewPane.SetClient(m_viewEdit.m_hWnd);
 
+    // Takes the place of m_viewEdit when shown
+    hWnd = m_thumbnailGrid.Create(m_viewPane.m_hWnd, rcDefault, nullptr, WS_CHILD | WS_CLIPSIBLINGS | WS_VSCROLL, WS_EX_CLIENTEDGE);
+    ATLASSERT(NULL != hWnd);
+
+    m_thumbnailGrid.SetNotifyWindow(m_hWnd);
+
     m_mainSplit.SetSplitterPos(clientRect.Width() / 4);    // Default size of left pane
     m_infoSplit.SetSplitterPos((2*leftRect.Height()) / 3); // Default size of bottom pane
 
@@ -140,20 +191,20 @@ HTREEITEM CMainFrame::GetTreeItemFromElement(CInfoElement *element)
 
 HTREEITEM CMainFrame::FindTreeItem(const HTREEITEM start, CInfoElement *element)
 {
-    if(!start)
+    // Recurse into the children only; the siblings are walked in a loop
+    for(HTREEITEM hItem = start; hItem; hItem = m_mainTree.GetNextSiblingItem(hItem))
     {
-        return nullptr;
-    }
-    if(GetElementFromTreeItem(start) == element)
-    {
-        return start;
-    }
-    HTREEITEM result;
-    if((result = FindTreeItem(m_mainTree.GetChildItem(start), element)) != nullptr)
-    {
-        return result;
+        if(GetElementFromTreeItem(hItem) == element)
+        {
+            return hItem;
+        }
+        const HTREEITEM result = FindTreeItem(m_mainTree.GetChildItem(hItem), element);
+        if(result)
+        {
+            return result;
+        }
     }
-    return FindTreeItem(m_mainTree.GetNextSiblingItem(start), element);
+    return nullptr;
 }
 
 int CMainFrame::GetElementTreeImage(CInfoElement *elem)
@@ -180,59 +231,147 @@ HTREEITEM CMainFrame::BuildTree(CInfoElement *elem, HTREEITEM hParent)
 {
     ATLASSERT(elem);
 
-    if (elem)
+    HTREEITEM hFirstItem = nullptr;
+    const UINT state = (nullptr == hParent) ? TVIS_BOLD : 0;
+
+    // The siblings are added in a loop rather than by recursion, since the root
+    // can have a very large number of them
+    for (; nullptr != elem; elem = elem->NextSibling())
     {
-        int image = GetElementTreeImage(elem);
-        UINT state = (nullptr == hParent) ? TVIS_BOLD : 0;
+        const int image = GetElementTreeImage(elem);
+
+        // The name and the button are supplied by OnTreeViewGetDispInfo, so the
+        // control does not hold a copy of them. Elements whose children have not
+        // been created yet get their children when the item is first expanded.
+        TVINSERTSTRUCT insert = { 0 };
+        insert.hParent = hParent;
+        insert.hInsertAfter = TVI_LAST;
+        insert.item.mask = TVIF_TEXT | TVIF_STATE | TVIF_IMAGE | TVIF_SELECTEDIMAGE | TVIF_CHILDREN | TVIF_PARAM;
+        insert.item.pszText = LPSTR_TEXTCALLBACK;
+        insert.item.iImage = image;
+        insert.item.iSelectedImage = image;
+        insert.item.state = state;
+        insert.item.stateMask = state;
+        insert.item.cChildren = I_CHILDRENCALLBACK;
+        // Set a pointer to the element in the tree
+        insert.item.lParam = reinterpret_cast<LPARAM>(elem);
 
-        HTREEITEM hItem = m_mainTree.InsertItem(TVIF_TEXT | TVIF_STATE | TVIF_IMAGE | TVIF_SELECTEDIMAGE,
-            elem->Name(), image, image, state, state, 0, hParent, nullptr);
+        const HTREEITEM hItem = m_mainTree.InsertItem(&insert);
 
-        // Set a pointer to the element in the tree
-        m_mainTree.SetItemData(hItem, reinterpret_cast<DWORD_PTR>(elem));
+        if (nullptr == hFirstItem)
+        {
+            hFirstItem = hItem;
+        }
 
-        // Add children
-        if (elem->FirstChild())
+        // Add children and expand this branch
+        if (elem->ChildrenLoaded() && elem->FirstChild())
         {
             BuildTree(elem->FirstChild(), hItem);
+            m_mainTree.Expand(hItem);
+        }
+    }
+
+    return hFirstItem;
+}
+
+LRESULT CMainFrame::OnTreeViewGetDispInfo(WPARAM /*wParam*/, LPNMHDR lpNmHdr, BOOL &bHandled)
+{
+    bHandled = true;
+
+    const auto lpDispInfo = reinterpret_cast<LPNMTVDISPINFO>(lpNmHdr);
+
+    CInfoElement *elem = reinterpret_cast<CInfoElement*>(lpDispInfo->item.lParam);
+
+    if (elem)
+    {
+        if (lpDispInfo->item.mask & TVIF_TEXT)
+        {
+            wcsncpy_s(lpDispInfo->item.pszText, lpDispInfo->item.cchTextMax, elem->Name(), _TRUNCATE);
         }
 
-        // Add the siblings
-        if (elem->NextSibling())
+        if (lpDispInfo->item.mask & TVIF_CHILDREN)
         {
-            BuildTree(elem->NextSibling(), hParent);
+            lpDispInfo->item.cChildren = elem->HasChildren() ? 1 : 0;
         }
+    }
 
-        // Expand this branch
-        m_mainTree.Expand(hItem);
+    return 0;
+}
 
-        return hItem;
+LRESULT CMainFrame::OnTreeViewItemExpanding(WPARAM /*wParam*/, LPNMHDR lpNmHdr, BOOL &bHandled)
+{
+    bHandled = true;
+
+    const auto lpNmTreeView = reinterpret_cast<LPNMTREEVIEW>(lpNmHdr);
+    const HTREEITEM hItem = lpNmTreeView->itemNew.hItem;
+
+    CInfoElement *elem = GetElementFromTreeItem(hItem);
+
+    // Only the first expansion of an item has work to do
+    if (!elem || (TVE_EXPAND != (lpNmTreeView->action & TVE_EXPAND)) || m_mainTree.GetChildItem(hItem))
+    {
+        return 0;
     }
 
-    return nullptr;
+    CWaitCursor waitCursor;
+    CSimpleCodeGenerator codeGen;
+    elem->EnsureChildren(codeGen);
+
+    // If there turned out to be no children, the button goes away on its own
+    if (elem->FirstChild())
+    {
+        BuildTree(elem->FirstChild(), hItem);
+    }
+
+    return 0;
 }
 
-void CMainFrame::UpdateTreeView(bool selectLastRoot)
+void CMainFrame::AddRootItems(CInfoElement *lastBefore, bool selectFirst)
 {
-    // This method simply destroys the entire tree, then re-creates it from scratch.
-    m_mainTree.DeleteAllItems();
+    CInfoElement *first = lastBefore ? lastBefore->NextSibling() : CElementManager::GetRootElement()->FirstChild();
 
-    CInfoElement *root = CElementManager::GetRootElement();
-    HTREEITEM rootItem = nullptr;
-    if(root->FirstChild())
+    if (nullptr == first)
     {
-        // BuildTree traverses by the first child and next sibling.
-        // Therefore, all of the elements will be added except for root.
-        rootItem = BuildTree(root->FirstChild(), nullptr);
+        return;
     }
 
-    if (selectLastRoot)
+    // Only the new files are added; the items that are already there are untouched
+    m_mainTree.SetRedraw(FALSE);
+    const HTREEITEM hFirstItem = BuildTree(first, nullptr);
+    m_mainTree.SetRedraw(TRUE);
+
+    if (selectFirst)
     {
-        m_mainTree.SelectItem(rootItem);
+        m_mainTree.SelectItem(hFirstItem);
+        m_mainTree.EnsureVisible(hFirstItem);
         m_mainTree.SetFocus();
     }
 }
 
+void CMainFrame::RefreshTreeItem(HTREEITEM hItem)
+{
+    DeleteChildItems(hItem);
+
+    CInfoElement *elem = GetElementFromTreeItem(hItem);
+
+    if (elem && elem->ChildrenLoaded() && elem->FirstChild())
+    {
+        BuildTree(elem->FirstChild(), hItem);
+        m_mainTree.Expand(hItem);
+    }
+}
+
+void CMainFrame::DeleteChildItems(HTREEITEM hItem)
+{
+    HTREEITEM hChild = m_mainTree.GetChildItem(hItem);
+    while (hChild)
+    {
+        const HTREEITEM hNext = m_mainTree.GetNextSiblingItem(hChild);
+        m_mainTree.DeleteItem(hChild);
+        hChild = hNext;
+    }
+}
+
 HRESULT CMainFrame::OpenFile(LPCWSTR filename, bool &updateElements)
 {
     updateElements = false;
@@ -359,6 +498,11 @@ HRESULT CMainFrame::Load(const LPCWSTR *filenames, int count)
     HRESULT result = S_OK;
     bool needsUpdate = false;
     const CString quiet = "/quiet";
+    const CString dibCache = "/dibcache:";
+    const CString bandHeight = "/bandheight:";
+    const CString trace = "/trace:";
+    const CString imageCache = "/imagecache:";
+    CInfoElement *lastRoot = CElementManager::GetRootElement()->LastChild();
 
     DWORD attempted = 0, opened = 0;
     for(int i = 0; i < count; i++)
@@ -367,6 +511,32 @@ HRESULT CMainFrame::Load(const LPCWSTR *filenames, int count)
         {
             m_suppressMessageBox = TRUE;
         }
+        else if(dibCache.CompareNoCase(CString(filenames[i]).Left(dibCache.GetLength())) == 0)
+        {
+            // The budget of the rendered bitmap cache, in MB
+            CDibCache::Inst().SetBudget(SIZE_T(_wtoi(filenames[i] + dibCache.GetLength())) * 1024 * 1024);
+        }
+        else if(bandHeight.CompareNoCase(CString(filenames[i]).Left(bandHeight.GetLength())) == 0)
+        {
+            // The number of rows rendered and saved at a time
+            const int rows = _wtoi(filenames[i] + bandHeight.GetLength());
+            g_bandHeight = (rows > 0) ? UINT(rows) : DEFAULT_BAND_HEIGHT;
+        }
+        else if(trace.CompareNoCase(CString(filenames[i]).Left(trace.GetLength())) == 0)
+        {
+            // Where the spans of the session go when the window closes
+            m_traceFile = filenames[i] + trace.GetLength();
+            CTrace::Inst().Enable(true);
+        }
+        else if(imageCache.CompareNoCase(CString(filenames[i]).Left(imageCache.GetLength())) == 0)
+        {
+            // Where directories are cached between sessions, or off
+            m_imageCacheDirectory = filenames[i] + imageCache.GetLength();
+            if(m_imageCacheDirectory.CompareNoCase(L"off") == 0)
+            {
+                m_imageCacheDirectory.Empty();
+            }
+        }
         else
         {
             bool thisNeedsUpdate = false;
@@ -377,7 +547,7 @@ HRESULT CMainFrame::Load(const LPCWSTR *filenames, int count)
 
     if(needsUpdate)
     {
-        UpdateTreeView(true);
+        AddRootItems(lastRoot, true);
     }
 
     if(attempted > 1)
@@ -453,6 +623,7 @@ LRESULT CMainFrame::OnFileOpen(WORD, WORD, HWND hParentWnd, BOOL&)
     if (IDOK == res)
     {
         bool updateElements = false;
+        CInfoElement *lastRoot = CElementManager::GetRootElement()->LastChild();
 
         // Get the path to the files
         const CString path = fileDlg.m_ofn.lpstrFile;
@@ -487,7 +658,7 @@ LRESULT CMainFrame::OnFileOpen(WORD, WORD, HWND hParentWnd, BOOL&)
         // Update the tree if necessary
         if (updateElements)
         {
-            UpdateTreeView(true);
+            AddRootItems(lastRoot, true);
         }
     }
 
@@ -496,13 +667,12 @@ LRESULT CMainFrame::OnFileOpen(WORD, WORD, HWND hParentWnd, BOOL&)
     return 0;
 }
 
-HRESULT CMainFrame::OpenDirectory(LPCWSTR directory, DWORD &attempted, DWORD &opened)
+HRESULT CMainFrame::OpenDirectory(LPCWSTR directory, DWORD &attempted, DWORD &opened, DWORD &cached)
 {
-    HRESULT hr = S_OK;
-    WIN32_FIND_DATA fdata;
-    const HANDLE hf = FindFirstFile(CString(directory) + "\\*", &fdata);
+    CSimpleArray<CString> files;
+    HRESULT hr = EnumerateImageFiles(directory, files);
 
-    if(hf == INVALID_HANDLE_VALUE)
+    if(FAILED(hr) && files.GetSize() == 0)
     {
         if(m_suppressMessageBox == FALSE)
         {
@@ -511,46 +681,39 @@ HRESULT CMainFrame::OpenDirectory(LPCWSTR directory, DWORD &attempted, DWORD &op
         return 0;
     }
 
-    do
+    if(!m_workerPool)
     {
-        CString path = CString(directory) + L"\\" + fdata.cFileName;
-        CString extension = CString(fdata.cFileName).Right(4);
-        HRESULT temp;
+        m_workerPool = std::make_unique<CWorkerPool>();
+    }
 
-        if((fdata.dwFileAttributes&FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY &&
-            wcscmp(fdata.cFileName, L".") &&
-            wcscmp(fdata.cFileName, L".."))
+    if(!m_imageCache && !m_imageCacheDirectory.IsEmpty())
+    {
+        auto cache = std::make_unique<CImageCache>(std::wstring(m_imageCacheDirectory.GetString()));
+        if(cache->Open())
         {
-            if(FAILED(temp = OpenDirectory(path, attempted, opened)))
-            {
-                hr = temp;
-            }
+            m_imageCache = std::move(cache);
+            m_thumbnailGrid.SetCache(m_imageCache.get());
         }
-        else if(!extension.CompareNoCase(L".jpg") ||
-            !extension.CompareNoCase(L".jpeg") ||
-            !extension.CompareNoCase(L".png") ||
-            !extension.CompareNoCase(L".gif") ||
-            !extension.CompareNoCase(L".bmp") ||
-            !extension.CompareNoCase(L".tif") ||
-            !extension.CompareNoCase(L".tiff") ||
-            !extension.CompareNoCase(L".ico") ||
-            !extension.CompareNoCase(L".icon") ||
-            !extension.CompareNoCase(L".dds"))
-        {
-            bool updateThis = 0;
-            if(SUCCEEDED(temp = OpenFile(path, updateThis)))
-            {
-                opened++;
-            }
-            else
-            {
-                hr = temp;
-            }
-            attempted++;
+        else
+        {
+            // Not tried again in this session
+            m_imageCacheDirectory.Empty();
         }
-    } while(FindNextFile(hf, &fdata));
+    }
 
-    FindClose(hf);
+    CWaitCursor waitCursor;
+
+    attempted += files.GetSize();
+    const HRESULT temp = CElementManager::OpenFiles(files, *m_workerPool, m_imageCache.get(), opened, cached);
+    if(FAILED(temp))
+    {
+        hr = temp;
+    }
+
+    if(m_imageCache)
+    {
+        m_imageCache->Save();
+    }
 
     return hr;
 }
@@ -569,24 +732,81 @@ LRESULT CMainFrame::OnFileOpenDir(WORD /*code*/, WORD /*item*/, HWND hSender, BO
         return 0;
     }
 
-    DWORD attempted = 0, opened = 0;
-    OpenDirectory(fileDlg.GetFolderPath(), attempted, opened);
+    if(m_workerPool)
+    {
+        m_workerPool->ResetStats();
+    }
+
+    CStopwatch openTimer;
+    openTimer.Start();
+
+    CInfoElement *lastRoot = CElementManager::GetRootElement()->LastChild();
+
+    DWORD attempted = 0, opened = 0, cached = 0;
+    OpenDirectory(fileDlg.GetFolderPath(), attempted, opened, cached);
 
-    UpdateTreeView(true);
+    const DWORD openTime = openTimer.GetTimeMS();
 
-    WCHAR buffer[60];
-    swprintf_s(buffer, 60, L"Successfully opened %lu out of %lu image files", opened, attempted);
+    AddRootItems(lastRoot, true);
+
+    // The grid shows every loaded image, including those opened before
+    m_thumbnailGrid.Populate(CElementManager::GetRootElement());
+    ShowThumbnailGrid(true);
+
+    CString msg;
+    msg.Format(L"Opened %lu out of %lu image files in %lu ms (%.1f files/s)\n",
+        opened, attempted, openTime, (openTime > 0) ? (attempted * 1000.0 / openTime) : 0.0);
+
+    if(m_imageCache)
+    {
+        msg.AppendFormat(L"%lu of them from the image cache, without being loaded\n", cached);
+    }
+
+    if(m_workerPool)
+    {
+        for(UINT i = 0; i < m_workerPool->GetWorkerCount(); i++)
+        {
+            DWORD tasks = 0;
+            double busyMS = 0;
+            m_workerPool->GetWorkerStats(i, tasks, busyMS);
+
+            msg.AppendFormat(L"\nWorker %u: %lu files, %.0f%% busy", i + 1, tasks,
+                (openTime > 0) ? (busyMS * 100.0 / openTime) : 0.0);
+        }
+    }
 
     if(m_suppressMessageBox == FALSE)
     {
-        MessageBox(buffer, L"Done", MB_OK);
+        MessageBox(msg, L"Done", MB_OK);
     }
 
     return 0;
 }
 
-void CMainFrame::DrawElement(CInfoElement &element)
+void CMainFrame::DrawElement(CInfoElement &element, bool fullSize)
 {
+    // Any render still running is for the previous view
+    const LONG generation = ++m_renderGeneration;
+
+    CStopwatch latencyTimer;
+    latencyTimer.Start();
+
+    // The bitmaps are rendered on a worker, so the properties show up right away
+    CSimpleArray<BitmapRenderRequest> deferredRenders;
+    InfoElementViewContext context = m_viewcontext;
+    context.pDeferredRenders = &deferredRenders;
+
+    if (m_fitToView && !fullSize)
+    {
+        // Leave room for the scroll bar and the section indent
+        const int margin = 40;
+
+        CRect viewRect;
+        m_viewEdit.GetClientRect(&viewRect);
+        context.fitWidth = UINT(std::max(int(viewRect.Width()) - margin, margin));
+        context.fitHeight = UINT(std::max(int(viewRect.Height()) - margin, margin));
+    }
+
     // Clear the RichEdits
     m_viewEdit.SetSelAll();
     m_viewEdit.ReplaceSel(L"");
@@ -605,7 +825,7 @@ void CMainFrame::DrawElement(CInfoElement &element)
 
     CRichEditDevice view(m_viewEdit);
     view.BeginSection(path);
-    element.OutputView(view,m_viewcontext);
+    element.OutputView(view, context);
     view.EndSection();
 
     m_viewEdit.SetSel(0, 0);
@@ -615,6 +835,137 @@ void CMainFrame::DrawElement(CInfoElement &element)
     element.OutputInfo(info);
 
     m_infoEdit.SetSel(0, 0);
+
+    if (deferredRenders.GetSize() > 0)
+    {
+        StartRender(generation, latencyTimer, deferredRenders);
+    }
+}
+
+void CMainFrame::StartRender(LONG generation, const CStopwatch &latencyTimer, const CSimpleArray<BitmapRenderRequest> &requests)
+{
+    // The bitmaps of a view, such as the frames of a decoder, are rendered side by
+    // side; a queued render is dropped as soon as it starts if the view has moved on
+    if (!m_renderPool)
+    {
+        m_renderPool = std::make_unique<CWorkerPool>();
+    }
+
+    auto job = std::make_shared<RenderJob>();
+    job->generation = generation;
+    job->latencyTimer = latencyTimer;
+    job->requests = requests;
+    job->renderings.resize(static_cast<size_t>(requests.GetSize()));
+    job->remaining = requests.GetSize();
+
+    const HWND hWnd = m_hWnd;
+
+    for (int i = 0; i < requests.GetSize(); i++)
+    {
+        m_renderPool->Submit([this, job, hWnd, i]
+        {
+            const RenderCancellation cancel = { &m_renderGeneration, job->generation };
+
+            if (!cancel.IsCanceled())
+            {
+                CBitmapSourceElement::Render(job->requests[i], &cancel, job->renderings[static_cast<size_t>(i)]);
+            }
+
+            if ((0 != --job->remaining) || cancel.IsCanceled())
+            {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> guard(m_renderLock);
+                m_renderedJob = job;
+            }
+
+            ::PostMessage(hWnd, WM_RENDERCOMPLETE, 0, 0);
+        });
+    }
+}
+
+LRESULT CMainFrame::OnRenderComplete(UINT, WPARAM, LPARAM, BOOL&)
+{
+    std::shared_ptr<RenderJob> job;
+    {
+        std::lock_guard<std::mutex> guard(m_renderLock);
+        job.swap(m_renderedJob);
+    }
+
+    // A stale job frees its bitmaps when it goes away
+    if (!job || (job->generation != m_renderGeneration))
+    {
+        return 0;
+    }
+
+    CRichEditDevice view(m_viewEdit);
+
+    // Each rendering replaces its placeholder, the last one first so that the
+    // positions of the ones before it stay where they were
+    std::vector<int> order;
+    for (int i = 0; i < job->requests.GetSize(); i++)
+    {
+        order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&job](int left, int right)
+    {
+        return job->requests[left].placeholderStart > job->requests[right].placeholderStart;
+    });
+
+    for (const int i : order)
+    {
+        const BitmapRenderRequest &request = job->requests[i];
+        if (request.placeholderStart < 0)
+        {
+            continue;
+        }
+
+        m_viewEdit.SetSel(request.placeholderStart, request.placeholderEnd);
+        m_viewEdit.ReplaceSel(L"");
+
+        view.SetInsertionPoint(request.placeholderStart);
+        CBitmapSourceElement::OutputRendering(view, job->renderings[static_cast<size_t>(i)]);
+        view.SetInsertionPoint(-1);
+    }
+
+    CString value;
+    value.Format(L"%u ms", job->latencyTimer.GetTimeMS());
+
+    view.BeginKeyValues(L"Background rendering");
+    view.AddKeyValue(L"Latency", value);
+
+    DWORD hits = 0, misses = 0;
+    SIZE_T bytes = 0, budget = 0;
+    CDibCache::Inst().GetStats(hits, misses, bytes, budget);
+    value.Format(L"%lu hits, %lu misses, %.1f of %.1f MB", hits, misses,
+        bytes / (1024.0 * 1024.0), budget / (1024.0 * 1024.0));
+    view.AddKeyValue(L"DIB cache", value);
+
+    CColorContextCache::Inst().GetStats(hits, misses);
+    value.Format(L"%lu sRGB reuses, %lu sRGB loads", hits, misses);
+    view.AddKeyValue(L"Color context cache", value);
+
+    view.EndKeyValues();
+
+    // Devices that could not tell where the placeholder was get the rendering at the end
+    for (int i = 0; i < job->requests.GetSize(); i++)
+    {
+        if (job->requests[i].placeholderStart >= 0)
+        {
+            continue;
+        }
+
+        view.BeginSection(job->requests[i].name);
+        view.BeginKeyValues(L"");
+        CBitmapSourceElement::OutputRendering(view, job->renderings[static_cast<size_t>(i)]);
+        view.EndSection();
+    }
+
+    m_viewEdit.SetSel(0, 0);
+
+    return 0;
 }
 
 LRESULT CMainFrame::OnTreeViewSelChanged(WPARAM /*wParam*/, LPNMHDR lpNmHdr, BOOL &bHandled)
@@ -627,6 +978,7 @@ LRESULT CMainFrame::OnTreeViewSelChanged(WPARAM /*wParam*/, LPNMHDR lpNmHdr, BOO
 
     if (elem)
     {
+        ShowThumbnailGrid(false);
         DrawElement(*elem);
     }
 
@@ -1029,6 +1381,109 @@ LRESULT CMainFrame::OnShowAlpha(WORD /*code*/, WORD item, HWND /*hSender*/, BOOL
     return 0;
 }
 
+LRESULT CMainFrame::OnFitToView(WORD /*code*/, WORD item, HWND /*hSender*/, BOOL& handled)
+{
+    handled = 1;
+
+    const HMENU menu = GetMenu();
+
+    m_fitToView = !m_fitToView;
+    CheckMenuItem(menu, item, (m_fitToView ? MF_CHECKED : MF_UNCHECKED) | MF_BYCOMMAND);
+
+    const HTREEITEM hItem = m_mainTree.GetSelectedItem();
+    CInfoElement *elem = GetElementFromTreeItem(hItem);
+    if (elem)
+    {
+        DrawElement(*elem);
+    }
+
+    return 0;
+}
+
+LRESULT CMainFrame::OnPremultiplyAlpha(WORD /*code*/, WORD item, HWND /*hSender*/, BOOL& handled)
+{
+    handled = 1;
+
+    const HMENU menu = GetMenu();
+
+    m_viewcontext.bIsPremultiplyEnable = !m_viewcontext.bIsPremultiplyEnable;
+    CheckMenuItem(menu, item, (m_viewcontext.bIsPremultiplyEnable ? MF_CHECKED : MF_UNCHECKED) | MF_BYCOMMAND);
+
+    const HTREEITEM hItem = m_mainTree.GetSelectedItem();
+    CInfoElement *elem = GetElementFromTreeItem(hItem);
+    if (elem)
+    {
+        DrawElement(*elem);
+    }
+
+    return 0;
+}
+
+LRESULT CMainFrame::OnShowThumbnailGrid(WORD /*code*/, WORD /*item*/, HWND /*hSender*/, BOOL& handled)
+{
+    handled = 1;
+
+    const bool show = !m_thumbnailGrid.IsWindowVisible();
+    if (show)
+    {
+        m_thumbnailGrid.Populate(CElementManager::GetRootElement());
+    }
+
+    ShowThumbnailGrid(show);
+
+    return 0;
+}
+
+LRESULT CMainFrame::OnThumbnailClick(UINT, WPARAM, LPARAM lParam, BOOL&)
+{
+    CInfoElement *elem = reinterpret_cast<CInfoElement *>(lParam);
+    const HTREEITEM hItem = GetTreeItemFromElement(elem);
+
+    if (nullptr == hItem)
+    {
+        return 0;
+    }
+
+    ShowThumbnailGrid(false);
+
+    // Selecting an item that already is selected does not draw it again
+    if (hItem == m_mainTree.GetSelectedItem())
+    {
+        DrawElement(*elem);
+    }
+    else
+    {
+        m_mainTree.SelectItem(hItem);
+    }
+
+    return 0;
+}
+
+void CMainFrame::ShowThumbnailGrid(bool show)
+{
+    if (show == (FALSE != m_thumbnailGrid.IsWindowVisible()))
+    {
+        return;
+    }
+
+    if (show)
+    {
+        m_viewEdit.ShowWindow(SW_HIDE);
+        m_viewPane.SetClient(m_thumbnailGrid.m_hWnd);
+        m_thumbnailGrid.ShowWindow(SW_SHOW);
+        m_viewPane.SetTitle(L"Thumbnails");
+    }
+    else
+    {
+        m_thumbnailGrid.ShowWindow(SW_HIDE);
+        m_viewPane.SetClient(m_viewEdit.m_hWnd);
+        m_viewEdit.ShowWindow(SW_SHOW);
+        m_viewPane.SetTitle(L"View");
+    }
+
+    CheckMenuItem(GetMenu(), ID_SHOW_THUMBNAIL_GRID, (show ? MF_CHECKED : MF_UNCHECKED) | MF_BYCOMMAND);
+}
+
 LRESULT CMainFrame::OnContextClick(WORD /*code*/, const WORD item, HWND /*hSender*/, BOOL& handled)
 {
     handled = 1;
@@ -1040,19 +1495,30 @@ LRESULT CMainFrame::OnContextClick(WORD /*code*/, const WORD item, HWND /*hSende
     case ID_FILE_LOAD:
         {
             CSimpleCodeGenerator temp;
+            // The items point at the elements that Load releases, so remove them first
+            DeleteChildItems(hItem);
             dynamic_cast<CBitmapDecoderElement *>(elem)->Load(temp);
-            UpdateTreeView(false);
+            RefreshTreeItem(hItem);
             DrawElement(*elem);
         }
         break;
     case ID_FILE_UNLOAD:
+        DeleteChildItems(hItem);
         static_cast<CBitmapDecoderElement *>(elem)->Unload();
-        UpdateTreeView(false);
+        RefreshTreeItem(hItem);
         DrawElement(*elem);
         break;
     case ID_FILE_CLOSE:
+        m_thumbnailGrid.RemoveElement(elem);
+        m_mainTree.DeleteItem(hItem);
         CElementManager::GetRootElement()->RemoveChild(dynamic_cast<CBitmapDecoderElement *>(elem));
-        UpdateTreeView(false);
+        break;
+    case ID_RENDER_FULL_SIZE:
+        DrawElement(*elem, true);
+        break;
+    case ID_SHOW_MORE_CHILDREN:
+        static_cast<CBitmapDecoderElement *>(elem)->ShowMoreChildren();
+        DrawElement(*elem);
         break;
     case ID_FIND_METADATA:
         {
@@ -1186,6 +1652,10 @@ HRESULT CMainFrame::QueryMetadata(CInfoElement *elem)
         parentQueryReader = rootQueryReader;
     }
 
+    // The element for the reader may not have been created yet
+    CSimpleCodeGenerator codeGen;
+    elem->EnsureSubtree(codeGen);
+
     IWICMetadataReaderPtr parentReader;
     CInfoElement *parentElem;
     if(FAILED(GetReaderFromQueryReader(parentQueryReader, &parentReader)))
@@ -1224,7 +1694,14 @@ HRESULT CMainFrame::QueryMetadata(CInfoElement *elem)
         else
         {
             // When the tree selection changes, the output view will be redrawn
-            m_mainTree.SelectItem(GetTreeItemFromElement(parentElem));
+            HTREEITEM hParentItem = GetTreeItemFromElement(parentElem);
+            if (!hParentItem)
+            {
+                // The reader was created by EnsureSubtree, so add the new items
+                RefreshTreeItem(GetTreeItemFromElement(elem));
+                hParentItem = GetTreeItemFromElement(parentElem);
+            }
+            m_mainTree.SelectItem(hParentItem);
         }
     }
     return result;
@@ -9,6 +9,10 @@
 #pragma once
 
 #include "Element.h"
+#include "ImageCache.h"
+#include "Stopwatch.h"
+#include "ThumbnailGrid.h"
+#include "WorkerPool.h"
 #include "resource.h"
 
 class CMainFrame final : public CFrameWindowImpl<CMainFrame>
@@ -16,8 +20,16 @@ class CMainFrame final : public CFrameWindowImpl<CMainFrame>
 public:
     DECLARE_FRAME_WND_CLASS(NULL, IDR_MAINFRAME)
 
+    // Posted by the render workers when the bitmaps of the view are ready
+    static const UINT WM_RENDERCOMPLETE = WM_APP + 1;
+
+    // The decoder view shows this many children at a time, as thumbnails of this size
+    enum { CHILD_PAGE_SIZE = 16, CHILD_THUMBNAIL_SIZE = 256 };
+
     BEGIN_MSG_MAP(CMainFrame)
         MESSAGE_HANDLER(WM_CREATE, OnCreate)
+        MESSAGE_HANDLER(WM_RENDERCOMPLETE, OnRenderComplete)
+        MESSAGE_HANDLER(CThumbnailGrid::WM_THUMBNAILCLICK, OnThumbnailClick)
 
         COMMAND_ID_HANDLER(ID_PANE_CLOSE, OnPaneClose)
         COMMAND_ID_HANDLER(ID_FILE_OPEN, OnFileOpen)
@@ -27,21 +39,32 @@ class CMainFrame final : public CFrameWindowImpl<CMainFrame>
         COMMAND_ID_HANDLER(ID_APP_ABOUT, OnAppAbout)
         COMMAND_ID_HANDLER(ID_SHOW_VIEWPANE, OnShowViewPane)
         COMMAND_ID_HANDLER(ID_SHOW_ALPHA, OnShowAlpha)
+        COMMAND_ID_HANDLER(ID_FIT_TO_VIEW, OnFitToView)
+        COMMAND_ID_HANDLER(ID_PREMULTIPLY_ALPHA, OnPremultiplyAlpha)
+        COMMAND_ID_HANDLER(ID_SHOW_THUMBNAIL_GRID, OnShowThumbnailGrid)
         COMMAND_ID_HANDLER(ID_FILE_LOAD, OnContextClick)
         COMMAND_ID_HANDLER(ID_FILE_UNLOAD, OnContextClick)
         COMMAND_ID_HANDLER(ID_FILE_CLOSE, OnContextClick)
         COMMAND_ID_HANDLER(ID_FIND_METADATA, OnContextClick)
+        COMMAND_ID_HANDLER(ID_RENDER_FULL_SIZE, OnContextClick)
+        COMMAND_ID_HANDLER(ID_SHOW_MORE_CHILDREN, OnContextClick)
 
         NOTIFY_CODE_HANDLER(TVN_SELCHANGED, OnTreeViewSelChanged)
+        NOTIFY_CODE_HANDLER(TVN_ITEMEXPANDING, OnTreeViewItemExpanding)
+        NOTIFY_CODE_HANDLER(TVN_GETDISPINFO, OnTreeViewGetDispInfo)
         NOTIFY_CODE_HANDLER(NM_RCLICK, OnNMRClick)
 
         CHAIN_MSG_MAP(CFrameWindowImpl<CMainFrame>)
     END_MSG_MAP()
 
     HRESULT Load(const LPCWSTR *filenames, int count);
+    // Writes the trace asked for with /trace:<file>, if any
+    void SaveTrace();
 
 private:
     InfoElementViewContext m_viewcontext{};
+    // Bitmaps are scaled down to the size of the view unless a full size render is asked for
+    bool m_fitToView{true};
 
     HWND CreateClient();
     static int GetElementTreeImage(CInfoElement *elem);
@@ -49,9 +72,14 @@ class CMainFrame final : public CFrameWindowImpl<CMainFrame>
     HRESULT OpenFile(LPCWSTR filename, bool &updateElements);
     // Opens files based on a wildcard expression (not recursive)
     HRESULT OpenWildcard(LPCWSTR search, DWORD &attempted, DWORD &opened, bool &updateElements);
-    // Opens images recursively in a directory
-    HRESULT OpenDirectory(LPCWSTR directory, DWORD &attempted, DWORD &opened);
-    void UpdateTreeView(bool selectLastRoot);
+    // Opens images recursively in a directory, on the worker pool; cached counts the
+    // ones that were found in the image cache instead of being loaded
+    HRESULT OpenDirectory(LPCWSTR directory, DWORD &attempted, DWORD &opened, DWORD &cached);
+    // Adds items for the root elements that follow lastBefore (all of them if it is null)
+    void AddRootItems(CInfoElement *lastBefore, bool selectFirst);
+    // Rebuilds the items below hItem from its element
+    void RefreshTreeItem(HTREEITEM hItem);
+    void DeleteChildItems(HTREEITEM hItem);
     HTREEITEM BuildTree(CInfoElement *elem, HTREEITEM hParent);
     BOOL DoElementContextMenu(HWND hWnd, CInfoElement &element, POINT point);
     static HMENU CreateElementContextMenu(CInfoElement &element);
@@ -60,12 +88,19 @@ class CMainFrame final : public CFrameWindowImpl<CMainFrame>
     HTREEITEM FindTreeItem(HTREEITEM start, CInfoElement *element);
     static bool ElementCanBeSavedAsImage(CInfoElement &element);
     HRESULT SaveElementAsImage(CInfoElement &element);
-    void DrawElement(CInfoElement &element);
+    void DrawElement(CInfoElement &element, bool fullSize = false);
+    void StartRender(LONG generation, const CStopwatch &latencyTimer, const CSimpleArray<BitmapRenderRequest> &requests);
     HRESULT QueryMetadata(CInfoElement* elem);
+    // Swaps the view pane between the element view and the thumbnail grid
+    void ShowThumbnailGrid(bool show);
 
     LRESULT OnCreate(UINT, WPARAM, LPARAM, BOOL&);
+    LRESULT OnRenderComplete(UINT, WPARAM, LPARAM, BOOL&);
+    LRESULT OnThumbnailClick(UINT, WPARAM, LPARAM lParam, BOOL&);
     LRESULT OnNMRClick(int , LPNMHDR pnmh, BOOL&);
     LRESULT OnTreeViewSelChanged(WPARAM wParam, LPNMHDR lpNmHdr, BOOL &bHandled);
+    LRESULT OnTreeViewItemExpanding(WPARAM wParam, LPNMHDR lpNmHdr, BOOL &bHandled);
+    LRESULT OnTreeViewGetDispInfo(WPARAM wParam, LPNMHDR lpNmHdr, BOOL &bHandled);
     LRESULT OnPaneClose(WORD, WORD, HWND hWndCtl, BOOL&);
     LRESULT OnFileOpen(WORD, WORD, HWND, BOOL&);
     LRESULT OnFileOpenDir(WORD code, WORD item, HWND hSender, BOOL& handled);
@@ -74,6 +109,9 @@ class CMainFrame final : public CFrameWindowImpl<CMainFrame>
     LRESULT OnAppAbout(WORD, WORD, HWND, BOOL&);
     LRESULT OnShowViewPane(WORD code, WORD item, HWND hSender, BOOL& handled);
     LRESULT OnShowAlpha(WORD code, WORD item, HWND hSender, BOOL& handled);
+    LRESULT OnFitToView(WORD code, WORD item, HWND hSender, BOOL& handled);
+    LRESULT OnPremultiplyAlpha(WORD code, WORD item, HWND hSender, BOOL& handled);
+    LRESULT OnShowThumbnailGrid(WORD code, WORD item, HWND hSender, BOOL& handled);
     LRESULT OnContextClick(WORD code, WORD item, HWND hSender, BOOL& handled);
 
     CSplitterWindow m_mainSplit;
@@ -85,6 +123,34 @@ class CMainFrame final : public CFrameWindowImpl<CMainFrame>
     CTreeViewCtrl m_mainTree;
     CRichEditCtrl m_infoEdit;
     CRichEditCtrl m_viewEdit;
+    CThumbnailGrid m_thumbnailGrid;
 
     bool m_suppressMessageBox{};
+    CString m_traceFile;
+
+    // Where the image cache is kept; empty when /imagecache:off turned it off
+    CString m_imageCacheDirectory;
+    // Opened the first time a directory is
+    std::unique_ptr<CImageCache> m_imageCache;
+
+    // Created the first time a directory is opened
+    std::unique_ptr<CWorkerPool> m_workerPool;
+
+    // The bitmaps of the view, rendered on m_renderPool
+    struct RenderJob
+    {
+        LONG generation{};
+        CStopwatch latencyTimer;
+        CSimpleArray<BitmapRenderRequest> requests;
+        std::vector<BitmapRendering> renderings;
+        // The renders that have not finished; the last one to finish posts the job
+        std::atomic<int> remaining{};
+    };
+
+    // Moves on every time the view is drawn, which cancels the render in flight
+    std::atomic<LONG> m_renderGeneration{};
+    std::mutex m_renderLock;
+    std::shared_ptr<RenderJob> m_renderedJob;
+    // Declared last so that its workers are joined before the members they use go away
+    std::unique_ptr<CWorkerPool> m_renderPool;
 };
@@ -0,0 +1,87 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "MappedFile.h"
+
+CMappedFile::~CMappedFile()
+{
+    Close();
+}
+
+HRESULT CMappedFile::Open(LPCWSTR filename)
+{
+    Close();
+
+    m_file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (INVALID_HANDLE_VALUE == m_file)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        const HRESULT result = HRESULT_FROM_WIN32(GetLastError());
+        Close();
+        return result;
+    }
+
+    if (ULONGLONG(size.QuadPart) > SIZE_T(-1))
+    {
+        Close();
+        return HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+    }
+
+    // An empty file cannot be mapped, and has nothing to parse anyway
+    if (0 == size.QuadPart)
+    {
+        return S_OK;
+    }
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr == m_mapping)
+    {
+        const HRESULT result = HRESULT_FROM_WIN32(GetLastError());
+        Close();
+        return result;
+    }
+
+    m_view = static_cast<const BYTE *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (nullptr == m_view)
+    {
+        const HRESULT result = HRESULT_FROM_WIN32(GetLastError());
+        Close();
+        return result;
+    }
+
+    m_size = static_cast<SIZE_T>(size.QuadPart);
+
+    return S_OK;
+}
+
+void CMappedFile::Close()
+{
+    if (m_view)
+    {
+        UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (INVALID_HANDLE_VALUE != m_file)
+    {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+}
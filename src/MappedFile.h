@@ -0,0 +1,53 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A read-only view of a whole file. The native structure parsers read the bytes in
+// place, so opening a file costs a mapping instead of a copy. MappedFile.cpp maps it
+// with the Windows API, and MappedFilePosix.cpp with mmap elsewhere.
+class CMappedFile final
+{
+public:
+    CMappedFile() = default;
+    ~CMappedFile();
+
+    CMappedFile(const CMappedFile &) = delete;
+    CMappedFile &operator=(const CMappedFile &) = delete;
+
+#ifdef _WIN32
+    HRESULT Open(LPCWSTR filename);
+#else
+    // Returns 0, or the errno of the call that failed
+    int Open(const char *filename);
+#endif
+    void Close();
+
+    [[nodiscard]] const uint8_t *Data() const
+    {
+        return m_view;
+    }
+
+    [[nodiscard]] size_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+    HANDLE m_mapping{};
+#else
+    int m_file{-1};
+#endif
+    const uint8_t *m_view{};
+    size_t m_size{};
+};
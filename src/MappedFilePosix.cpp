@@ -0,0 +1,89 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "MappedFile.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CMappedFile::~CMappedFile()
+{
+    Close();
+}
+
+int CMappedFile::Open(const char *filename)
+{
+    Close();
+
+    m_file = open(filename, O_RDONLY | O_CLOEXEC);
+    if (m_file < 0)
+    {
+        return errno;
+    }
+
+    struct stat status{};
+    if (fstat(m_file, &status) != 0)
+    {
+        const int error = errno;
+        Close();
+        return error;
+    }
+
+    if (!S_ISREG(status.st_mode))
+    {
+        Close();
+        return EINVAL;
+    }
+
+    if (uint64_t(status.st_size) > SIZE_MAX)
+    {
+        Close();
+        return EFBIG;
+    }
+
+    // An empty file cannot be mapped, and has nothing to parse anyway
+    if (0 == status.st_size)
+    {
+        return 0;
+    }
+
+    void *view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (MAP_FAILED == view)
+    {
+        const int error = errno;
+        Close();
+        return error;
+    }
+
+    // The file is read from start to end by the parsers and most decoders
+    posix_madvise(view, static_cast<size_t>(status.st_size), POSIX_MADV_SEQUENTIAL);
+
+    m_view = static_cast<const uint8_t *>(view);
+    m_size = static_cast<size_t>(status.st_size);
+
+    return 0;
+}
+
+void CMappedFile::Close()
+{
+    if (m_view)
+    {
+        munmap(const_cast<uint8_t *>(m_view), m_size);
+        m_view = nullptr;
+    }
+    if (m_file >= 0)
+    {
+        close(m_file);
+        m_file = -1;
+    }
+    m_size = 0;
+}
@@ -0,0 +1,206 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "MappedStream.h"
+
+CMappedStream::CMappedStream(std::shared_ptr<const CMappedFile> file, LPCWSTR name)
+    : m_file(std::move(file))
+    , m_name(name)
+    , m_view(m_file->Data(), m_file->Size())
+{
+}
+
+HRESULT CMappedStream::QueryInterface(REFIID riid, void **ppvObject)
+{
+    if (nullptr == ppvObject)
+    {
+        return E_POINTER;
+    }
+
+    if ((riid == IID_IUnknown) || (riid == IID_ISequentialStream) || (riid == IID_IStream))
+    {
+        *ppvObject = static_cast<IStream *>(this);
+        AddRef();
+        return S_OK;
+    }
+
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+}
+
+ULONG CMappedStream::AddRef()
+{
+    return ++m_ref;
+}
+
+ULONG CMappedStream::Release()
+{
+    // Decoders can be released on a worker thread while the UI thread holds a clone
+    const ULONG ref = --m_ref;
+    if (0 == ref)
+    {
+        delete this;
+    }
+
+    return ref;
+}
+
+HRESULT CMappedStream::Read(void *pv, ULONG cb, ULONG *pcbRead)
+{
+    if (nullptr == pv)
+    {
+        return STG_E_INVALIDPOINTER;
+    }
+
+    const auto count = static_cast<ULONG>(m_view.Read(pv, cb));
+
+    if (nullptr != pcbRead)
+    {
+        *pcbRead = count;
+    }
+
+    // A short read is how a stream reports its end
+    return (count == cb) ? S_OK : S_FALSE;
+}
+
+HRESULT CMappedStream::Write(const void *, ULONG, ULONG *)
+{
+    return STG_E_ACCESSDENIED;
+}
+
+HRESULT CMappedStream::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER *plibNewPosition)
+{
+    CMappedView::Origin origin = CMappedView::Origin::Start;
+
+    switch (dwOrigin)
+    {
+    case STREAM_SEEK_SET:
+        origin = CMappedView::Origin::Start;
+        break;
+    case STREAM_SEEK_CUR:
+        origin = CMappedView::Origin::Current;
+        break;
+    case STREAM_SEEK_END:
+        origin = CMappedView::Origin::End;
+        break;
+    default:
+        return STG_E_INVALIDFUNCTION;
+    }
+
+    uint64_t position = 0;
+    if (!m_view.Seek(dlibMove.QuadPart, origin, position))
+    {
+        return STG_E_INVALIDFUNCTION;
+    }
+
+    if (nullptr != plibNewPosition)
+    {
+        plibNewPosition->QuadPart = position;
+    }
+
+    return S_OK;
+}
+
+HRESULT CMappedStream::SetSize(ULARGE_INTEGER)
+{
+    return STG_E_ACCESSDENIED;
+}
+
+HRESULT CMappedStream::CopyTo(IStream *pstm, ULARGE_INTEGER cb, ULARGE_INTEGER *pcbRead, ULARGE_INTEGER *pcbWritten)
+{
+    HRESULT result = S_OK;
+
+    if (nullptr == pstm)
+    {
+        return STG_E_INVALIDPOINTER;
+    }
+
+    uint64_t read = 0;
+    uint64_t written = 0;
+    m_view.CopyTo(cb.QuadPart, [&](const uint8_t *data, uint32_t size, uint32_t &chunkWritten)
+    {
+        ULONG count = 0;
+        result = pstm->Write(data, size, &count);
+        chunkWritten = count;
+        return SUCCEEDED(result);
+    }, read, written);
+
+    if (nullptr != pcbRead)
+    {
+        pcbRead->QuadPart = read;
+    }
+    if (nullptr != pcbWritten)
+    {
+        pcbWritten->QuadPart = written;
+    }
+
+    return result;
+}
+
+HRESULT CMappedStream::Commit(DWORD)
+{
+    return S_OK;
+}
+
+HRESULT CMappedStream::Revert()
+{
+    return S_OK;
+}
+
+HRESULT CMappedStream::LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD)
+{
+    return STG_E_INVALIDFUNCTION;
+}
+
+HRESULT CMappedStream::UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD)
+{
+    return STG_E_INVALIDFUNCTION;
+}
+
+HRESULT CMappedStream::Stat(STATSTG *pstatstg, DWORD grfStatFlag)
+{
+    if (nullptr == pstatstg)
+    {
+        return STG_E_INVALIDPOINTER;
+    }
+
+    ZeroMemory(pstatstg, sizeof(*pstatstg));
+    pstatstg->type = STGTY_STREAM;
+    pstatstg->cbSize.QuadPart = m_view.Size();
+    pstatstg->grfMode = STGM_READ | STGM_SHARE_DENY_WRITE;
+
+    if (0 == (grfStatFlag & STATFLAG_NONAME))
+    {
+        // Some decoders use the name to find files that sit next to the image
+        const size_t bytes = (size_t(m_name.GetLength()) + 1) * sizeof(WCHAR);
+        pstatstg->pwcsName = static_cast<LPOLESTR>(CoTaskMemAlloc(bytes));
+        if (nullptr == pstatstg->pwcsName)
+        {
+            return E_OUTOFMEMORY;
+        }
+        memcpy(pstatstg->pwcsName, m_name.GetString(), bytes);
+    }
+
+    return S_OK;
+}
+
+HRESULT CMappedStream::Clone(IStream **ppstm)
+{
+    if (nullptr == ppstm)
+    {
+        return STG_E_INVALIDPOINTER;
+    }
+
+    auto *clone = new CMappedStream(m_file, m_name);
+    clone->m_view = m_view;
+    *ppstm = clone;
+
+    return S_OK;
+}
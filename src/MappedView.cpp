@@ -0,0 +1,88 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "MappedView.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+CMappedView::CMappedView(const uint8_t *data, uint64_t size)
+    : m_data(data)
+    , m_size(size)
+{
+}
+
+size_t CMappedView::Read(void *buffer, size_t size)
+{
+    const auto count = static_cast<size_t>(std::min<uint64_t>(size, Remaining()));
+
+    if (count > 0)
+    {
+        memcpy(buffer, m_data + static_cast<size_t>(m_position), count);
+        m_position += count;
+    }
+
+    return count;
+}
+
+bool CMappedView::Seek(int64_t move, Origin origin, uint64_t &position)
+{
+    uint64_t from = 0;
+
+    switch (origin)
+    {
+    case Origin::Start:
+        from = 0;
+        break;
+    case Origin::Current:
+        from = m_position;
+        break;
+    case Origin::End:
+        from = m_size;
+        break;
+    }
+
+    // Seeking past the end is allowed; reads there return nothing
+    const auto limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max());
+    const uint64_t distance = (move < 0) ? 0 - static_cast<uint64_t>(move) : static_cast<uint64_t>(move);
+    if ((from > limit) || ((move < 0) && (distance > from)) || ((move >= 0) && (distance > limit - from)))
+    {
+        return false;
+    }
+
+    m_position = (move < 0) ? from - distance : from + distance;
+    position = m_position;
+
+    return true;
+}
+
+bool CMappedView::CopyTo(uint64_t count, const CopyWriter &write, uint64_t &read, uint64_t &written)
+{
+    uint64_t remaining = std::min(count, Remaining());
+    bool ok = true;
+
+    read = 0;
+    written = 0;
+
+    // The bytes are the buffer; they are written out in pieces that fit 32 bits
+    while (ok && (remaining > 0))
+    {
+        const auto chunk = static_cast<uint32_t>(std::min<uint64_t>(remaining, MAX_COPY_CHUNK));
+        uint32_t chunkWritten = 0;
+
+        ok = write(m_data + static_cast<size_t>(m_position), chunk, chunkWritten);
+
+        m_position += chunk;
+        read += chunk;
+        written += chunkWritten;
+        remaining -= chunk;
+    }
+
+    return ok;
+}
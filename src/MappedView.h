@@ -0,0 +1,65 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// A read position over bytes that stay in place, such as a file mapping. It holds what
+// CMappedStream does apart from COM, so that it builds and is tested on any platform:
+// reads past the end come back short, seeks may go past the end but not before the
+// start, and copies hand out the bytes in place.
+class CMappedView final
+{
+public:
+    enum class Origin
+    {
+        Start,
+        Current,
+        End,
+    };
+
+    // Writes out a piece of a copy, and reports how much of it was written
+    using CopyWriter = std::function<bool(const uint8_t *data, uint32_t size, uint32_t &written)>;
+
+    // Copies are handed out in pieces of at most this many bytes
+    static const uint32_t MAX_COPY_CHUNK = 1u << 30;
+
+    CMappedView(const uint8_t *data, uint64_t size);
+
+    // Copies up to size bytes to buffer, and returns how many there were
+    size_t Read(void *buffer, size_t size);
+    // Fails, and keeps the position, when the new one would be before the start or
+    // does not fit in 63 bits
+    bool Seek(int64_t move, Origin origin, uint64_t &position);
+    // Hands the next count bytes, or what is left of them, to write until it fails.
+    // read counts every piece that was handed out, and written what write wrote of them.
+    bool CopyTo(uint64_t count, const CopyWriter &write, uint64_t &read, uint64_t &written);
+
+    [[nodiscard]] uint64_t Position() const
+    {
+        return m_position;
+    }
+
+    [[nodiscard]] uint64_t Size() const
+    {
+        return m_size;
+    }
+
+private:
+    [[nodiscard]] uint64_t Remaining() const
+    {
+        return (m_position < m_size) ? m_size - m_position : 0;
+    }
+
+    const uint8_t *m_data;
+    uint64_t m_size;
+    uint64_t m_position{};
+};
@@ -13,16 +13,9 @@ class CMetadataTranslator final
 public:
     static CMetadataTranslator &Inst()
     {
+        // The dictionary is loaded by the constructor, which runs exactly once even
+        // when elements are being created on several worker threads.
         static CMetadataTranslator inst;
-        static bool inited = false;
-
-        if (!inited)
-        {
-            // We do not fail if there was an error loading the dictionary
-            inst.LoadTranslations();
-
-            inited = true;
-        }
 
         return inst;
     }
@@ -44,7 +37,11 @@ class CMetadataTranslator final
         }
     };
 
-    CMetadataTranslator() = default;
+    CMetadataTranslator()
+    {
+        // We do not fail if there was an error loading the dictionary
+        LoadTranslations();
+    }
 
     static HRESULT ReadPropVariantInteger(PROPVARIANT *pv, int &out);
     HRESULT LoadFormat(MSXML2::IXMLDOMNodePtr formatNode);
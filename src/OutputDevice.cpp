@@ -120,13 +120,30 @@ void CRichEditDevice::BeginSection(LPCWSTR name)
 
 void CRichEditDevice::AddText(LPCWSTR name)
 {
-    m_richEditCtrl.AppendText(name);
+    if (m_insertAt < 0)
+    {
+        m_richEditCtrl.AppendText(name);
+        return;
+    }
+
+    // Moving the selection would drop the format that was set for the insertion point
+    LONG start = 0, end = 0;
+    m_richEditCtrl.GetSel(start, end);
+    if ((start != m_insertAt) || (end != m_insertAt))
+    {
+        m_richEditCtrl.SetSel(m_insertAt, m_insertAt);
+    }
+
+    m_richEditCtrl.ReplaceSel(name);
+
+    m_richEditCtrl.GetSel(start, end);
+    m_insertAt = end;
 }
 
 void CRichEditDevice::AddVerbatimText(LPCWSTR name)
 {
     SetFontName(VerbatimFontName);
-    m_richEditCtrl.AppendText(name);
+    AddText(name);
     SetFontName(NormalFontName);
 }
 
@@ -136,7 +153,18 @@ void CRichEditDevice::AddDib(HGLOBAL hBitmap)
 
     if (nullptr != oleInterface)
     {
+        // The bitmap goes in at the selection
+        if (m_insertAt >= 0)
+        {
+            m_richEditCtrl.SetSel(m_insertAt, m_insertAt);
+        }
+
         const HRESULT res = CBitmapDataObject::InsertDib(m_richEditCtrl.m_hWnd, oleInterface, hBitmap);
+        if (SUCCEEDED(res) && (m_insertAt >= 0))
+        {
+            // An embedded object is one character
+            m_insertAt++;
+        }
 
         if (FAILED(res))
         {
@@ -192,6 +220,30 @@ void CRichEditDevice::EndKeyValues()
     AddText(L"\n");
 }
 
+LONG CRichEditDevice::GetPosition()
+{
+    if (m_insertAt >= 0)
+    {
+        return m_insertAt;
+    }
+
+    m_richEditCtrl.SetSel(-1, -1);
+
+    LONG start = 0, end = 0;
+    m_richEditCtrl.GetSel(start, end);
+
+    return start;
+}
+
+void CRichEditDevice::SetInsertionPoint(LONG position)
+{
+    m_insertAt = position;
+    if (position >= 0)
+    {
+        m_richEditCtrl.SetSel(position, position);
+    }
+}
+
 void CRichEditDevice::EndSection()
 {
     if (m_sections.GetSize() > 0)
@@ -28,6 +28,13 @@ class IOutputDevice
     virtual void AddKeyValue(LPCWSTR key, LPCWSTR value) = 0;
     virtual void EndKeyValues() = 0;
     virtual void EndSection() = 0;
+
+    // Where the next output goes, for devices that can later replace what follows it;
+    // -1 for the ones that cannot
+    virtual LONG GetPosition()
+    {
+        return -1;
+    }
 };
 
 class CRichEditDevice final : public IOutputDevice
@@ -50,10 +57,15 @@ class CRichEditDevice final : public IOutputDevice
     void AddKeyValue(LPCWSTR key, LPCWSTR value) override;
     void EndKeyValues() override;
     void EndSection() override;
+    LONG GetPosition() override;
+
+    // Makes the output go to position instead of the end, until this is called with -1
+    void SetInsertionPoint(LONG position);
 
 private:
     enum { TEXT_SIZE = 10 };
 
     CSimpleArray<CString> m_sections;
     CRichEditCtrl &m_richEditCtrl;
+    LONG m_insertAt{-1};
 };
@@ -0,0 +1,359 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <cstring>
+
+using namespace FileStructure;
+
+namespace
+{
+    const uint8_t PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+    const wchar_t *GetColorTypeName(uint8_t colorType)
+    {
+        switch (colorType)
+        {
+        case 0: return L"Grayscale";
+        case 2: return L"Truecolor";
+        case 3: return L"Indexed";
+        case 4: return L"Grayscale with alpha";
+        case 6: return L"Truecolor with alpha";
+        default: return L"Unknown";
+        }
+    }
+
+    bool IsType(const uint8_t *type, const char *name)
+    {
+        return memcmp(type, name, 4) == 0;
+    }
+
+    // Finds the 0 that ends a keyword, or returns length if there is none
+    size_t FindNull(const uint8_t *data, size_t start, size_t length)
+    {
+        for (size_t i = start; i < length; i++)
+        {
+            if (data[i] == 0)
+            {
+                return i;
+            }
+        }
+
+        return length;
+    }
+
+    void AddText(StructureNode &node, const wchar_t *key, const std::wstring &text)
+    {
+        if (text.size() > MAX_TEXT_VALUE)
+        {
+            node.AddValue(key, text.substr(0, MAX_TEXT_VALUE) + L"...");
+        }
+        else
+        {
+            node.AddValue(key, text);
+        }
+    }
+
+    // Adds the values of the chunk payloads that are worth decoding. Short payloads
+    // only lose the values they do not have room for.
+    void DescribeChunk(StructureNode &node, const uint8_t *type, const uint8_t *data, uint32_t length)
+    {
+        if (IsType(type, "IHDR"))
+        {
+            if (length >= 13)
+            {
+                node.AddValue(L"Width", ReadBE32(data));
+                node.AddValue(L"Height", ReadBE32(data + 4));
+                node.AddValue(L"BitDepth", data[8]);
+                node.AddValue(L"ColorType", std::to_wstring(data[9]) + L" (" + GetColorTypeName(data[9]) + L")");
+                node.AddValue(L"Compression", data[10]);
+                node.AddValue(L"Filter", data[11]);
+                node.AddValue(L"Interlace", data[12] ? L"Adam7" : L"None");
+            }
+        }
+        else if (IsType(type, "PLTE"))
+        {
+            node.AddValue(L"Entries", length / 3);
+            if (length % 3)
+            {
+                node.AddError(L"The length is not a multiple of 3");
+            }
+        }
+        else if (IsType(type, "tRNS"))
+        {
+            node.AddValue(L"Entries", length);
+        }
+        else if (IsType(type, "gAMA"))
+        {
+            if (length >= 4)
+            {
+                node.AddValue(L"Gamma", std::to_wstring(ReadBE32(data) / 100000.0));
+            }
+        }
+        else if (IsType(type, "cHRM"))
+        {
+            static const wchar_t *names[] = { L"WhiteX", L"WhiteY", L"RedX", L"RedY", L"GreenX", L"GreenY", L"BlueX", L"BlueY" };
+            for (uint32_t i = 0; (i < 8) && (i * 4 + 4 <= length); i++)
+            {
+                node.AddValue(names[i], std::to_wstring(ReadBE32(data + i * 4) / 100000.0));
+            }
+        }
+        else if (IsType(type, "sRGB"))
+        {
+            static const wchar_t *intents[] = { L"Perceptual", L"Relative colorimetric", L"Saturation", L"Absolute colorimetric" };
+            if (length >= 1)
+            {
+                node.AddValue(L"RenderingIntent", (data[0] < 4) ? intents[data[0]] : L"Unknown");
+            }
+        }
+        else if (IsType(type, "pHYs"))
+        {
+            if (length >= 9)
+            {
+                node.AddValue(L"PixelsPerUnitX", ReadBE32(data));
+                node.AddValue(L"PixelsPerUnitY", ReadBE32(data + 4));
+                node.AddValue(L"Unit", (data[8] == 1) ? L"Meter" : L"Unknown");
+            }
+        }
+        else if (IsType(type, "tIME"))
+        {
+            if (length >= 7)
+            {
+                wchar_t text[32];
+                swprintf(text, sizeof(text) / sizeof(text[0]), L"%04u-%02u-%02u %02u:%02u:%02u",
+                    unsigned(ReadBE16(data)), unsigned(data[2]), unsigned(data[3]), unsigned(data[4]), unsigned(data[5]), unsigned(data[6]));
+                node.AddValue(L"Time", text);
+            }
+        }
+        else if (IsType(type, "iCCP"))
+        {
+            size_t end = FindNull(data, 0, length);
+            node.AddValue(L"ProfileName", Latin1ToWide(data, end));
+            if (end + 2 <= length)
+            {
+                node.AddValue(L"Compression", data[end + 1]);
+                node.AddValue(L"CompressedProfileLength", length - end - 2);
+            }
+        }
+        else if (IsType(type, "tEXt"))
+        {
+            size_t end = FindNull(data, 0, length);
+            node.AddValue(L"Keyword", Latin1ToWide(data, end));
+            if (end < length)
+            {
+                AddText(node, L"Text", Latin1ToWide(data + end + 1, length - end - 1));
+            }
+        }
+        else if (IsType(type, "zTXt"))
+        {
+            // The text is left compressed: inflating it is the job of the WIC metadata readers
+            size_t end = FindNull(data, 0, length);
+            node.AddValue(L"Keyword", Latin1ToWide(data, end));
+            if (end + 2 <= length)
+            {
+                node.AddValue(L"Compression", data[end + 1]);
+                node.AddValue(L"CompressedTextLength", length - end - 2);
+            }
+        }
+        else if (IsType(type, "iTXt"))
+        {
+            size_t keywordEnd = FindNull(data, 0, length);
+            node.AddValue(L"Keyword", Latin1ToWide(data, keywordEnd));
+            if (keywordEnd + 3 <= length)
+            {
+                bool compressed = data[keywordEnd + 1] != 0;
+                node.AddValue(L"Compressed", compressed ? L"Yes" : L"No");
+
+                size_t languageEnd = FindNull(data, keywordEnd + 3, length);
+                node.AddValue(L"Language", Latin1ToWide(data + keywordEnd + 3, languageEnd - keywordEnd - 3));
+
+                size_t translatedEnd = (languageEnd < length) ? FindNull(data, languageEnd + 1, length) : length;
+                if (languageEnd < length)
+                {
+                    node.AddValue(L"TranslatedKeyword", Utf8ToWide(data + languageEnd + 1, translatedEnd - languageEnd - 1));
+                }
+                if (translatedEnd < length)
+                {
+                    if (compressed)
+                    {
+                        node.AddValue(L"CompressedTextLength", length - translatedEnd - 1);
+                    }
+                    else
+                    {
+                        AddText(node, L"Text", Utf8ToWide(data + translatedEnd + 1, length - translatedEnd - 1));
+                    }
+                }
+            }
+        }
+        else if (IsType(type, "eXIf"))
+        {
+            // WIC has no query for this block, so it is not checked against a reader
+            if (!ParseTiffBlock(data, length, node.offset + 8, nullptr, node))
+            {
+                node.AddError(L"The chunk does not hold a TIFF header");
+            }
+        }
+        else if (IsType(type, "acTL"))
+        {
+            if (length >= 8)
+            {
+                node.AddValue(L"Frames", ReadBE32(data));
+                node.AddValue(L"Plays", ReadBE32(data + 4));
+            }
+        }
+        else if (IsType(type, "fcTL"))
+        {
+            static const wchar_t *disposeOps[] = { L"None", L"Background", L"Previous" };
+            static const wchar_t *blendOps[] = { L"Source", L"Over" };
+            if (length >= 26)
+            {
+                node.AddValue(L"SequenceNumber", ReadBE32(data));
+                node.AddValue(L"Width", ReadBE32(data + 4));
+                node.AddValue(L"Height", ReadBE32(data + 8));
+                node.AddValue(L"XOffset", ReadBE32(data + 12));
+                node.AddValue(L"YOffset", ReadBE32(data + 16));
+                node.AddValue(L"Delay", std::to_wstring(ReadBE16(data + 20)) + L"/" + std::to_wstring(ReadBE16(data + 22)) + L" s");
+                node.AddValue(L"DisposeOp", (data[24] < 3) ? disposeOps[data[24]] : L"Unknown");
+                node.AddValue(L"BlendOp", (data[25] < 2) ? blendOps[data[25]] : L"Unknown");
+            }
+        }
+        else if (IsType(type, "fdAT"))
+        {
+            if (length >= 4)
+            {
+                node.AddValue(L"SequenceNumber", ReadBE32(data));
+            }
+        }
+        else if (!IsType(type, "IDAT") && !IsType(type, "IEND"))
+        {
+            // The case of each letter of the type carries a property bit
+            node.AddValue(L"Critical", (type[0] & 0x20) ? L"No" : L"Yes");
+            node.AddValue(L"Public", (type[1] & 0x20) ? L"No" : L"Yes");
+            node.AddValue(L"SafeToCopy", (type[3] & 0x20) ? L"Yes" : L"No");
+        }
+    }
+}
+
+bool ParsePngStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    if ((size < sizeof(PngSignature)) || (memcmp(data, PngSignature, sizeof(PngSignature)) != 0))
+    {
+        return false;
+    }
+
+    root.name = L"PNG";
+    root.offset = 0;
+    root.length = size;
+    root.AddChild(L"Signature", 0, sizeof(PngSignature));
+
+    uint64_t offset = sizeof(PngSignature);
+    uint64_t chunkCount = 0;
+    uint64_t badCrcCount = 0;
+    bool ended = false;
+
+    // Consecutive image data chunks are grouped below a single node
+    StructureNode *dataRun = nullptr;
+    uint8_t dataRunType[4] = {};
+
+    while (offset < size)
+    {
+        if (ended)
+        {
+            StructureNode &trailing = root.AddChild(L"Trailing data", offset, size - offset);
+            trailing.AddError(L"There is data after IEND");
+            break;
+        }
+
+        if (!InRange(offset, 12, size))
+        {
+            StructureNode &partial = root.AddChild(L"Truncated chunk", offset, size - offset);
+            partial.AddError(L"The file ends inside a chunk header");
+            break;
+        }
+
+        const uint8_t *chunk = data + offset;
+        uint32_t length = ReadBE32(chunk);
+        const uint8_t *type = chunk + 4;
+        uint64_t chunkLength = uint64_t(length) + 12;
+
+        bool isData = IsType(type, "IDAT") || IsType(type, "fdAT");
+        StructureNode *parent = &root;
+        if (isData)
+        {
+            if (!dataRun || (memcmp(dataRunType, type, 4) != 0))
+            {
+                dataRun = &root.AddChild(FourCCToWide(type) + L" chunks", offset, 0);
+                memcpy(dataRunType, type, 4);
+            }
+            parent = dataRun;
+        }
+        else
+        {
+            dataRun = nullptr;
+        }
+
+        bool complete = InRange(offset, chunkLength, size);
+        StructureNode &node = parent->AddChild(FourCCToWide(type), offset, complete ? chunkLength : size - offset);
+        node.AddValue(L"DataOffset", offset + 8);
+        node.AddValue(L"DataLength", length);
+        chunkCount++;
+
+        if (length > 0x7FFFFFFFu)
+        {
+            node.AddError(L"The length is larger than 2^31-1");
+        }
+
+        if (!complete)
+        {
+            node.AddError(L"The file ends inside the chunk");
+            if (dataRun)
+            {
+                dataRun->length = size - dataRun->offset;
+            }
+            break;
+        }
+
+        uint32_t storedCrc = ReadBE32(chunk + 8 + length);
+        uint32_t crc = Crc32(0, type, size_t(length) + 4);
+        if (crc == storedCrc)
+        {
+            node.AddValue(L"CRC", FormatHex(storedCrc, 8) + L" (valid)");
+        }
+        else
+        {
+            node.AddValue(L"CRC", FormatHex(storedCrc, 8) + L" (invalid, computed " + FormatHex(crc, 8) + L")");
+            badCrcCount++;
+        }
+
+        DescribeChunk(node, type, chunk + 8, length);
+
+        if (dataRun)
+        {
+            dataRun->length = offset + chunkLength - dataRun->offset;
+            dataRun->values.clear();
+            dataRun->AddValue(L"Chunks", dataRun->children.size());
+        }
+
+        if (IsType(type, "IEND"))
+        {
+            ended = true;
+        }
+
+        offset += chunkLength;
+    }
+
+    root.AddValue(L"Chunks", chunkCount);
+    root.AddValue(L"InvalidCRCs", badCrcCount);
+    if (!ended)
+    {
+        root.AddError(L"There is no IEND chunk");
+    }
+
+    return true;
+}
@@ -0,0 +1,152 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "ProgressiveLevels.h"
+#include "Stopwatch.h"
+#include "Trace.h"
+
+std::atomic<SIZE_T> CProgressiveLevels::s_bytes{};
+std::atomic<SIZE_T> CProgressiveLevels::s_budget{SIZE_T(DEFAULT_BUDGET_MB) * 1024 * 1024};
+
+CProgressiveLevels::CProgressiveLevels(IWICBitmapFrameDecodePtr frame, IWICProgressiveLevelControlPtr control, UINT levelCount)
+    : m_frame(frame)
+    , m_control(control)
+    , m_levels(levelCount)
+{
+}
+
+CProgressiveLevels::~CProgressiveLevels()
+{
+    s_bytes -= m_bytes;
+}
+
+HRESULT CProgressiveLevels::CopyPixels(UINT level, const WICRect *prc, UINT stride, UINT bufferSize, BYTE *buffer)
+{
+    HRESULT result = S_OK;
+    IWICBitmapPtr snapshot;
+
+    if (level >= m_levels.size())
+    {
+        return E_INVALIDARG;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        if (!m_levels[level].snapshot)
+        {
+            IFC(Walk(level));
+        }
+        snapshot = m_levels[level].snapshot;
+    }
+
+    // Renders pull the pixels in bands; every band after the first is only a copy
+    return snapshot->CopyPixels(prc, stride, bufferSize, buffer);
+}
+
+HRESULT CProgressiveLevels::Walk(UINT wanted)
+{
+    CTraceSpan span("ProgressiveWalk");
+    HRESULT result = S_OK;
+    const UINT last = static_cast<UINT>(m_levels.size()) - 1;
+
+    // Levels after the last one without a snapshot need not be decoded again
+    UINT end = wanted;
+    for (UINT level = wanted; level <= last; level++)
+    {
+        if (!m_levels[level].snapshot)
+        {
+            end = level;
+        }
+    }
+
+    m_walks++;
+
+    // Setting a level starts the decoder over from the first scan, so the walk always
+    // starts there too; that way the time of each level is the same whichever level
+    // was asked for first
+    for (UINT level = 0; level <= end; level++)
+    {
+        Level &entry = m_levels[level];
+
+        CStopwatch timer;
+        timer.Start();
+
+        IWICBitmapPtr snapshot;
+        result = m_control->SetCurrentLevel(level);
+        if (SUCCEEDED(result))
+        {
+            result = g_imagingFactory->CreateBitmapFromSource(m_frame, WICBitmapCacheOnLoad, &snapshot);
+        }
+        if (FAILED(result))
+        {
+            break;
+        }
+
+        entry.decodeMS = timer.GetElapsedMS();
+
+        if (!entry.snapshot)
+        {
+            // The level that was asked for is kept whatever the budget says, and the
+            // walk only stops after it
+            const SIZE_T bytes = GetBitmapBytes(snapshot);
+            if ((level != wanted) && (s_bytes + bytes > s_budget))
+            {
+                if (level > wanted)
+                {
+                    break;
+                }
+                continue;
+            }
+
+            entry.snapshot = snapshot;
+            entry.bytes = bytes;
+            m_bytes += bytes;
+            s_bytes += bytes;
+        }
+    }
+
+    // The frame itself shows every scan
+    const HRESULT resetResult = m_control->SetCurrentLevel(last);
+
+    return FAILED(result) ? result : resetResult;
+}
+
+SIZE_T CProgressiveLevels::GetBitmapBytes(IWICBitmap *bitmap)
+{
+    IWICBitmapLockPtr lock;
+    UINT size = 0;
+    BYTE *data = nullptr;
+
+    if (SUCCEEDED(bitmap->Lock(nullptr, WICBitmapLockRead, &lock)))
+    {
+        lock->GetDataPointer(&size, &data);
+    }
+
+    return size;
+}
+
+void CProgressiveLevels::GetStats(std::vector<LevelStats> &levels, SIZE_T &bytes, UINT &walks)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    levels.clear();
+    for (const Level &level : m_levels)
+    {
+        levels.push_back({level.decodeMS, nullptr != level.snapshot});
+    }
+    bytes = m_bytes;
+    walks = m_walks;
+}
+
+void CProgressiveLevels::SetBudget(SIZE_T bytes)
+{
+    s_budget = bytes;
+}
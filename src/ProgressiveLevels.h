@@ -0,0 +1,79 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// The levels of one progressive frame, decoded in a single pass. Setting a lower
+// level on IWICProgressiveLevelControl makes the decoder start over from the first
+// scan, so decoding each level on its own is quadratic in the number of scans.
+// Instead, the first level that is asked for starts a walk from the first level to
+// the last one, and a copy of the pixels of each level is kept. The copies of every
+// frame share one memory budget; once it is reached, the walk stops after the level
+// that was asked for, and the levels after it are decoded by a later walk.
+class CProgressiveLevels final
+{
+public:
+    enum { DEFAULT_BUDGET_MB = 256 };
+
+    CProgressiveLevels(IWICBitmapFrameDecodePtr frame, IWICProgressiveLevelControlPtr control, UINT levelCount);
+    ~CProgressiveLevels();
+
+    CProgressiveLevels(const CProgressiveLevels &) = delete;
+    CProgressiveLevels &operator=(const CProgressiveLevels &) = delete;
+
+    [[nodiscard]] UINT GetLevelCount() const
+    {
+        return static_cast<UINT>(m_levels.size());
+    }
+
+    [[nodiscard]] IWICBitmapFrameDecodePtr GetFrame() const
+    {
+        return m_frame;
+    }
+
+    // Copies pixels out of the snapshot of a level, decoding it first if needed
+    HRESULT CopyPixels(UINT level, const WICRect *prc, UINT stride, UINT bufferSize, BYTE *buffer);
+
+    struct LevelStats
+    {
+        // The time the walk took from the previous level to this one, or -1 if it
+        // has not been decoded
+        double decodeMS;
+        bool cached;
+    };
+
+    void GetStats(std::vector<LevelStats> &levels, SIZE_T &bytes, UINT &walks);
+
+    static void SetBudget(SIZE_T bytes);
+
+private:
+    struct Level
+    {
+        IWICBitmapPtr snapshot;
+        SIZE_T bytes{};
+        double decodeMS{-1};
+    };
+
+    HRESULT Walk(UINT wanted);
+    static SIZE_T GetBitmapBytes(IWICBitmap *bitmap);
+
+    std::mutex m_lock;
+    IWICBitmapFrameDecodePtr m_frame;
+    IWICProgressiveLevelControlPtr m_control;
+    std::vector<Level> m_levels;
+    SIZE_T m_bytes{};
+    UINT m_walks{};
+
+    // The bytes of the snapshots of every frame
+    static std::atomic<SIZE_T> s_bytes;
+    static std::atomic<SIZE_T> s_budget;
+};
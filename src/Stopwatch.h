@@ -32,6 +32,15 @@ class CStopwatch final
         return DWORD(timeMS);
     }
 
+    // For stages that can take well under a millisecond
+    [[nodiscard]] double GetElapsedMS() const
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+
+        return double(now.QuadPart - m_startTime.QuadPart) * 1000.0 / double(m_frequency.QuadPart);
+    }
+
 private:
     LARGE_INTEGER m_frequency{};
     LARGE_INTEGER m_startTime{};
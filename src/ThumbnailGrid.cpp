@@ -0,0 +1,705 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "ThumbnailGrid.h"
+#include "Element.h"
+#include "ImageCache.h"
+#include "Stopwatch.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+namespace
+{
+    const int CELL_PADDING = 8;
+    const int LABEL_HEIGHT = 18;
+    const int CELL_WIDTH = CThumbnailGrid::THUMBNAIL_SIZE + 2 * CELL_PADDING;
+    const int CELL_HEIGHT = CThumbnailGrid::THUMBNAIL_SIZE + 2 * CELL_PADDING + LABEL_HEIGHT;
+
+    // The bytes per pixel of the formats a decoder's own scaling is taken in
+    UINT GetTransformBytesPerPixel(REFGUID format)
+    {
+        if ((GUID_WICPixelFormat32bppBGRA == format) || (GUID_WICPixelFormat32bppBGR == format) || (GUID_WICPixelFormat32bppPBGRA == format))
+        {
+            return 4;
+        }
+        if (GUID_WICPixelFormat24bppBGR == format)
+        {
+            return 3;
+        }
+        if (GUID_WICPixelFormat8bppGray == format)
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+}
+
+CThumbnailGrid::~CThumbnailGrid()
+{
+    // The pumps check for this between items
+    m_stopping = true;
+    m_pool.reset();
+}
+
+void CThumbnailGrid::Populate(CInfoElement *root)
+{
+    std::vector<Item> items;
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        for (CInfoElement *child = root->FirstChild(); nullptr != child; child = child->NextSibling())
+        {
+            auto *decoder = dynamic_cast<CBitmapDecoderElement *>(child);
+            if (nullptr == decoder)
+            {
+                continue;
+            }
+
+            Item item;
+            item.hasContentHash = decoder->GetContentHash(item.contentHash) && (nullptr != m_cache);
+            if (!decoder->IsLoaded() && !item.hasContentHash)
+            {
+                continue;
+            }
+
+            item.element = child;
+            item.name = child->Name();
+            item.filename = decoder->GetFilename();
+            item.decoder = decoder->GetDecoder();
+
+            // Keep what was already made for the element
+            for (Item &old : m_items)
+            {
+                if ((old.element == child) && (ItemState::Done == old.state) && (old.decoder == item.decoder))
+                {
+                    item = std::move(old);
+                    break;
+                }
+            }
+
+            items.push_back(std::move(item));
+        }
+
+        m_items.swap(items);
+        m_bytes = 0;
+        for (const Item &item : m_items)
+        {
+            m_bytes += item.pixels.size();
+        }
+        m_generation++;
+    }
+
+    m_scrollPos = 0;
+    UpdateLayout();
+    Invalidate();
+}
+
+void CThumbnailGrid::RemoveElement(CInfoElement *element)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        const auto found = std::find_if(m_items.begin(), m_items.end(), [element](const Item &item) { return item.element == element; });
+        if (found == m_items.end())
+        {
+            return;
+        }
+
+        m_bytes -= found->pixels.size();
+        m_items.erase(found);
+        m_generation++;
+
+        // What was being made for the moved items is dropped, so it is made again
+        for (Item &item : m_items)
+        {
+            if (ItemState::Working == item.state)
+            {
+                item.state = ItemState::Pending;
+            }
+        }
+    }
+
+    if (IsWindow())
+    {
+        UpdateLayout();
+        Invalidate();
+    }
+}
+
+void CThumbnailGrid::GetStats(UINT &items, UINT &ready, UINT &embedded, UINT &fromCache, double &averageMS)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    items = static_cast<UINT>(m_items.size());
+    ready = 0;
+    embedded = 0;
+    fromCache = 0;
+    double totalMS = 0;
+
+    for (const Item &item : m_items)
+    {
+        if (ItemState::Done == item.state)
+        {
+            ready++;
+            embedded += item.embedded ? 1 : 0;
+            fromCache += item.fromCache ? 1 : 0;
+            totalMS += item.timeMS;
+        }
+    }
+
+    averageMS = (ready > 0) ? totalMS / ready : 0;
+}
+
+HRESULT CThumbnailGrid::CreateThumbnail(IWICBitmapDecoder *decoder, Item &item)
+{
+    HRESULT result = S_OK;
+
+    // An embedded thumbnail of the container, or of the first frame, is the quickest
+    IWICBitmapSourcePtr source;
+    IWICBitmapFrameDecodePtr frame;
+
+    item.embedded = SUCCEEDED(decoder->GetThumbnail(&source));
+    if (!item.embedded)
+    {
+        IFC(decoder->GetFrame(0, &frame));
+        item.embedded = SUCCEEDED(frame->GetThumbnail(&source));
+        if (!item.embedded)
+        {
+            source = frame;
+        }
+    }
+
+    UINT width = 0, height = 0;
+    IFC(source->GetSize(&width, &height));
+    if ((0 == width) || (0 == height))
+    {
+        return WINCODEC_ERR_BADIMAGE;
+    }
+
+    const double scale = std::min(1.0, std::min(double(THUMBNAIL_SIZE) / width, double(THUMBNAIL_SIZE) / height));
+    item.width = std::max(1U, static_cast<UINT>(width * scale + 0.5));
+    item.height = std::max(1U, static_cast<UINT>(height * scale + 0.5));
+
+    // Decoders that can scale while they decode, such as JPEG's, skip most of the work
+    IWICBitmapSourceTransformPtr transform;
+    if (!item.embedded && (scale < 1.0) && SUCCEEDED(frame->QueryInterface(IID_PPV_ARGS(&transform))))
+    {
+        UINT closestWidth = item.width, closestHeight = item.height;
+        WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+
+        if (SUCCEEDED(transform->GetClosestSize(&closestWidth, &closestHeight))
+            && SUCCEEDED(transform->GetClosestPixelFormat(&format))
+            && (closestWidth < width) && (closestHeight < height)
+            && (GetTransformBytesPerPixel(format) > 0))
+        {
+            const UINT stride = (closestWidth * GetTransformBytesPerPixel(format) + 3) & ~3U;
+            std::vector<BYTE> buffer(SIZE_T(stride) * closestHeight);
+            IWICBitmapPtr bitmap;
+
+            if (SUCCEEDED(transform->CopyPixels(nullptr, closestWidth, closestHeight, &format, WICBitmapTransformRotate0,
+                    stride, static_cast<UINT>(buffer.size()), buffer.data()))
+                && SUCCEEDED(g_imagingFactory->CreateBitmapFromMemory(closestWidth, closestHeight, format,
+                    stride, static_cast<UINT>(buffer.size()), buffer.data(), &bitmap)))
+            {
+                source = bitmap;
+                width = closestWidth;
+                height = closestHeight;
+            }
+        }
+    }
+
+    IWICBitmapSourcePtr scaled = source;
+    if ((item.width != width) || (item.height != height))
+    {
+        IWICBitmapScalerPtr scaler;
+        IFC(g_imagingFactory->CreateBitmapScaler(&scaler));
+        IFC(scaler->Initialize(source, item.width, item.height, WICBitmapInterpolationModeFant));
+        scaled = scaler;
+    }
+
+    IWICFormatConverterPtr converter;
+    IFC(g_imagingFactory->CreateFormatConverter(&converter));
+    IFC(converter->Initialize(scaled, GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom));
+
+    const UINT stride = item.width * 4;
+    item.pixels.resize(SIZE_T(stride) * item.height);
+    IFC(converter->CopyPixels(nullptr, stride, static_cast<UINT>(item.pixels.size()), item.pixels.data()));
+
+    return result;
+}
+
+HRESULT CThumbnailGrid::MakeThumbnail(Item &item)
+{
+    HRESULT result = S_OK;
+
+    if (item.hasContentHash)
+    {
+        CachedThumbnail thumbnail;
+        if (m_cache->LoadThumbnail(item.contentHash, thumbnail) && (thumbnail.width <= THUMBNAIL_SIZE) && (thumbnail.height <= THUMBNAIL_SIZE))
+        {
+            item.width = thumbnail.width;
+            item.height = thumbnail.height;
+            item.embedded = thumbnail.embedded;
+            item.pixels.swap(thumbnail.pixels);
+            item.fromCache = true;
+            ComposeOverBackground(item.pixels);
+
+            return S_OK;
+        }
+    }
+
+    // A file opened from the cache gets a decoder of its own, which goes away with the thumbnail
+    IWICBitmapDecoderPtr decoder = item.decoder;
+    if (!decoder)
+    {
+        IFC(g_imagingFactory->CreateDecoderFromFilename(item.filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder));
+    }
+
+    IFC(CreateThumbnail(decoder, item));
+
+    if (item.hasContentHash)
+    {
+        CachedThumbnail thumbnail;
+        thumbnail.width = item.width;
+        thumbnail.height = item.height;
+        thumbnail.embedded = item.embedded;
+        thumbnail.pixels = item.pixels;
+        m_cache->StoreThumbnail(item.contentHash, thumbnail);
+    }
+
+    ComposeOverBackground(item.pixels);
+
+    return result;
+}
+
+void CThumbnailGrid::ComposeOverBackground(std::vector<BYTE> &pixels)
+{
+    // Composed over the background here, painting is a plain copy
+    const COLORREF background = GetSysColor(COLOR_WINDOW);
+    const UINT backgroundBGR[3] = { GetBValue(background), GetGValue(background), GetRValue(background) };
+    for (SIZE_T i = 0; i < pixels.size(); i += 4)
+    {
+        const UINT transparency = 255U - pixels[i + 3];
+        for (SIZE_T c = 0; c < 3; c++)
+        {
+            pixels[i + c] = static_cast<BYTE>(std::min(255U, pixels[i + c] + (transparency * backgroundBGR[c] + 127) / 255));
+        }
+    }
+}
+
+void CThumbnailGrid::Pump()
+{
+    if (!m_pool)
+    {
+        m_pool = std::make_unique<CWorkerPool>();
+    }
+
+    while (m_activePumps < static_cast<LONG>(m_pool->GetWorkerCount()))
+    {
+        m_activePumps++;
+        m_pool->Submit([this] { RunPump(); });
+    }
+}
+
+void CThumbnailGrid::RunPump()
+{
+    for (;;)
+    {
+        Item item;
+        int index = -1;
+        LONG generation = 0;
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+
+            generation = m_generation;
+            if (!m_stopping)
+            {
+                index = TakeNextItem();
+            }
+            if (index < 0)
+            {
+                // Counted down under the lock, so that Pump starts a new one for work
+                // that shows up from here on
+                m_activePumps--;
+                return;
+            }
+
+            const Item &source = m_items[size_t(index)];
+            item.filename = source.filename;
+            item.decoder = source.decoder;
+            item.hasContentHash = source.hasContentHash;
+            item.contentHash = source.contentHash;
+        }
+
+        CTraceSpan span("Thumbnail");
+        CStopwatch timer;
+        timer.Start();
+
+        const HRESULT result = MakeThumbnail(item);
+        item.timeMS = timer.GetElapsedMS();
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+
+            // The items changed while this one was made
+            if (generation != m_generation)
+            {
+                continue;
+            }
+
+            Item &target = m_items[size_t(index)];
+            target.state = SUCCEEDED(result) ? ItemState::Done : ItemState::Failed;
+            if (SUCCEEDED(result))
+            {
+                target.pixels.swap(item.pixels);
+                target.width = item.width;
+                target.height = item.height;
+                target.embedded = item.embedded;
+                target.fromCache = item.fromCache;
+                target.timeMS = item.timeMS;
+                m_bytes += target.pixels.size();
+
+                if (m_bytes > m_budget)
+                {
+                    EvictFarthest(m_firstVisible, m_lastVisible);
+                }
+            }
+
+            // One message at a time; the grid repaints everything in view for it
+            if (!m_readyPosted)
+            {
+                m_readyPosted = true;
+                PostMessage(WM_THUMBNAILREADY);
+            }
+        }
+    }
+}
+
+int CThumbnailGrid::TakeNextItem()
+{
+    const int count = static_cast<int>(m_items.size());
+    const int first = std::min(m_firstVisible, count);
+    const int last = std::min(m_lastVisible, count);
+
+    for (int i = first; i < last; i++)
+    {
+        if (ItemState::Pending == m_items[size_t(i)].state)
+        {
+            m_items[size_t(i)].state = ItemState::Working;
+            return i;
+        }
+    }
+
+    // Then the ones that scrolling reaches first, for as long as the budget has room
+    // for another one; the nearest rows below the view, then above it
+    if (m_bytes + SIZE_T(THUMBNAIL_SIZE) * THUMBNAIL_SIZE * 4 > m_budget)
+    {
+        return -1;
+    }
+
+    for (int distance = 0; (last + distance < count) || (first - 1 - distance >= 0); distance++)
+    {
+        if ((last + distance < count) && (ItemState::Pending == m_items[size_t(last + distance)].state))
+        {
+            m_items[size_t(last + distance)].state = ItemState::Working;
+            return last + distance;
+        }
+        if ((first - 1 - distance >= 0) && (ItemState::Pending == m_items[size_t(first - 1 - distance)].state))
+        {
+            m_items[size_t(first - 1 - distance)].state = ItemState::Working;
+            return first - 1 - distance;
+        }
+    }
+
+    return -1;
+}
+
+void CThumbnailGrid::EvictFarthest(int from, int to)
+{
+    int low = 0;
+    int high = static_cast<int>(m_items.size()) - 1;
+
+    while (m_bytes > m_budget)
+    {
+        while ((low < from) && (ItemState::Done != m_items[size_t(low)].state))
+        {
+            low++;
+        }
+        while ((high >= to) && (ItemState::Done != m_items[size_t(high)].state))
+        {
+            high--;
+        }
+
+        const bool hasLow = (low < from);
+        const bool hasHigh = (high >= to);
+        if (!hasLow && !hasHigh)
+        {
+            // Everything left is in view
+            return;
+        }
+
+        const int victim = (hasLow && (!hasHigh || (from - low > high - to))) ? low : high;
+        Item &item = m_items[size_t(victim)];
+        m_bytes -= item.pixels.size();
+        std::vector<BYTE>().swap(item.pixels);
+        item.state = ItemState::Evicted;
+    }
+}
+
+void CThumbnailGrid::UpdateLayout()
+{
+    RECT client{};
+    GetClientRect(&client);
+
+    int count = 0;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        count = static_cast<int>(m_items.size());
+    }
+
+    m_columns = std::max(1, int(client.right) / CELL_WIDTH);
+    m_rows = (count + m_columns - 1) / m_columns;
+
+    const int contentHeight = m_rows * CELL_HEIGHT;
+    m_scrollPos = std::max(0, std::min(m_scrollPos, contentHeight - int(client.bottom)));
+
+    SCROLLINFO info{};
+    info.cbSize = sizeof(info);
+    info.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
+    info.nMin = 0;
+    info.nMax = std::max(0, contentHeight - 1);
+    info.nPage = UINT(std::max(0, int(client.bottom)));
+    info.nPos = m_scrollPos;
+    SetScrollInfo(SB_VERT, &info, TRUE);
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        const int firstVisible = (m_scrollPos / CELL_HEIGHT) * m_columns;
+        const int lastVisible = std::min(count, ((m_scrollPos + int(client.bottom)) / CELL_HEIGHT + 1) * m_columns);
+
+        // What the budget pushed out may be nearer to the view now
+        if ((firstVisible != m_firstVisible) || (lastVisible != m_lastVisible))
+        {
+            for (Item &item : m_items)
+            {
+                if (ItemState::Evicted == item.state)
+                {
+                    item.state = ItemState::Pending;
+                }
+            }
+        }
+
+        m_firstVisible = firstVisible;
+        m_lastVisible = lastVisible;
+    }
+
+    if (count > 0)
+    {
+        Pump();
+    }
+}
+
+RECT CThumbnailGrid::GetCellRect(int index) const
+{
+    const int left = (index % m_columns) * CELL_WIDTH;
+    const int top = (index / m_columns) * CELL_HEIGHT - m_scrollPos;
+
+    return RECT{ left, top, left + CELL_WIDTH, top + CELL_HEIGHT };
+}
+
+void CThumbnailGrid::ScrollTo(int position)
+{
+    const int previous = m_scrollPos;
+    m_scrollPos = position;
+    UpdateLayout();
+
+    if (previous != m_scrollPos)
+    {
+        Invalidate();
+    }
+}
+
+LRESULT CThumbnailGrid::OnPaint(UINT, WPARAM, LPARAM, BOOL&)
+{
+    PAINTSTRUCT paint{};
+    const HDC hdc = BeginPaint(&paint);
+
+    RECT client{};
+    GetClientRect(&client);
+    FillRect(hdc, &paint.rcPaint, GetSysColorBrush(COLOR_WINDOW));
+
+    const HGDIOBJ oldFont = SelectObject(hdc, GetStockObject(DEFAULT_GUI_FONT));
+    SetBkMode(hdc, TRANSPARENT);
+    SetTextColor(hdc, GetSysColor(COLOR_WINDOWTEXT));
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        const int count = static_cast<int>(m_items.size());
+        const int first = (m_scrollPos / CELL_HEIGHT) * m_columns;
+        const int last = std::min(count, ((m_scrollPos + int(client.bottom)) / CELL_HEIGHT + 1) * m_columns);
+
+        for (int i = first; i < last; i++)
+        {
+            const Item &item = m_items[size_t(i)];
+            const RECT cell = GetCellRect(i);
+
+            RECT image = { cell.left + CELL_PADDING, cell.top + CELL_PADDING,
+                           cell.left + CELL_PADDING + THUMBNAIL_SIZE, cell.top + CELL_PADDING + THUMBNAIL_SIZE };
+
+            if (ItemState::Done == item.state)
+            {
+                BITMAPINFO info{};
+                info.bmiHeader.biSize = sizeof(info.bmiHeader);
+                info.bmiHeader.biWidth = LONG(item.width);
+                info.bmiHeader.biHeight = -LONG(item.height);
+                info.bmiHeader.biPlanes = 1;
+                info.bmiHeader.biBitCount = 32;
+                info.bmiHeader.biCompression = BI_RGB;
+
+                const int x = image.left + (THUMBNAIL_SIZE - int(item.width)) / 2;
+                const int y = image.top + (THUMBNAIL_SIZE - int(item.height)) / 2;
+                SetDIBitsToDevice(hdc, x, y, item.width, item.height, 0, 0, 0, item.height, item.pixels.data(), &info, DIB_RGB_COLORS);
+            }
+            else
+            {
+                FrameRect(hdc, &image, GetSysColorBrush(COLOR_BTNSHADOW));
+                DrawText(hdc, (ItemState::Failed == item.state) ? L"No thumbnail" : L"...", -1, &image, DT_CENTER | DT_VCENTER | DT_SINGLELINE);
+            }
+
+            RECT label = { cell.left + 2, image.bottom + 2, cell.right - 2, cell.bottom };
+            DrawText(hdc, item.name, -1, &label, DT_CENTER | DT_SINGLELINE | DT_END_ELLIPSIS | DT_NOPREFIX);
+        }
+    }
+
+    SelectObject(hdc, oldFont);
+    EndPaint(&paint);
+
+    return 0;
+}
+
+LRESULT CThumbnailGrid::OnEraseBackground(UINT, WPARAM, LPARAM, BOOL&)
+{
+    // WM_PAINT fills the background
+    return 1;
+}
+
+LRESULT CThumbnailGrid::OnSize(UINT, WPARAM, LPARAM, BOOL&)
+{
+    UpdateLayout();
+
+    return 0;
+}
+
+LRESULT CThumbnailGrid::OnVScroll(UINT, WPARAM wParam, LPARAM, BOOL&)
+{
+    SCROLLINFO info{};
+    info.cbSize = sizeof(info);
+    info.fMask = SIF_ALL;
+    GetScrollInfo(SB_VERT, &info);
+
+    int position = m_scrollPos;
+    switch (LOWORD(wParam))
+    {
+    case SB_LINEUP:
+        position -= CELL_HEIGHT / 2;
+        break;
+    case SB_LINEDOWN:
+        position += CELL_HEIGHT / 2;
+        break;
+    case SB_PAGEUP:
+        position -= int(info.nPage);
+        break;
+    case SB_PAGEDOWN:
+        position += int(info.nPage);
+        break;
+    case SB_THUMBTRACK:
+    case SB_THUMBPOSITION:
+        position = info.nTrackPos;
+        break;
+    case SB_TOP:
+        position = 0;
+        break;
+    case SB_BOTTOM:
+        position = info.nMax;
+        break;
+    default:
+        break;
+    }
+
+    ScrollTo(position);
+
+    return 0;
+}
+
+LRESULT CThumbnailGrid::OnMouseWheel(UINT, WPARAM wParam, LPARAM, BOOL&)
+{
+    const int delta = GET_WHEEL_DELTA_WPARAM(wParam);
+    ScrollTo(m_scrollPos - delta * CELL_HEIGHT / WHEEL_DELTA);
+
+    return 0;
+}
+
+LRESULT CThumbnailGrid::OnLButtonDown(UINT, WPARAM, LPARAM lParam, BOOL&)
+{
+    const int x = static_cast<short>(LOWORD(lParam));
+    const int y = static_cast<short>(HIWORD(lParam)) + m_scrollPos;
+    const int column = x / CELL_WIDTH;
+
+    if (column >= m_columns)
+    {
+        return 0;
+    }
+
+    const int index = (y / CELL_HEIGHT) * m_columns + column;
+
+    CInfoElement *element = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        if ((index >= 0) && (index < static_cast<int>(m_items.size())))
+        {
+            element = m_items[size_t(index)].element;
+        }
+    }
+
+    if ((nullptr != element) && (nullptr != m_notifyWnd))
+    {
+        ::PostMessage(m_notifyWnd, WM_THUMBNAILCLICK, 0, reinterpret_cast<LPARAM>(element));
+    }
+
+    return 0;
+}
+
+LRESULT CThumbnailGrid::OnThumbnailReady(UINT, WPARAM, LPARAM, BOOL&)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_readyPosted = false;
+    }
+
+    Invalidate(FALSE);
+
+    return 0;
+}
+
+LRESULT CThumbnailGrid::OnDestroy(UINT, WPARAM, LPARAM, BOOL& handled)
+{
+    // The workers post to the window, so they are stopped with it
+    m_stopping = true;
+    m_pool.reset();
+    m_activePumps = 0;
+    handled = FALSE;
+
+    return 0;
+}
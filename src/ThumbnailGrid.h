@@ -0,0 +1,149 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "WorkerPool.h"
+
+class CInfoElement;
+class CImageCache;
+
+// A scrolling grid of thumbnails of the loaded decoders, shown in the view pane
+// after a directory is opened. The embedded thumbnail of the container or of the
+// first frame is used when there is one; otherwise the first frame is decoded
+// scaled down. Thumbnails are made on a pool of workers, the ones in view first,
+// and kept within a memory budget by dropping those furthest from the view. With an
+// image cache, thumbnails are read from it first and the ones made are added to it;
+// files that were opened from the cache without being loaded are decoded only when
+// the cache has no thumbnail of them.
+class CThumbnailGrid final : public CWindowImpl<CThumbnailGrid>
+{
+public:
+    DECLARE_WND_CLASS_EX(L"WICExplorerThumbnailGrid", CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS, COLOR_WINDOW)
+
+    enum { THUMBNAIL_SIZE = 96, DEFAULT_BUDGET_MB = 256 };
+
+    // Posted to the notify window when a thumbnail is clicked; lParam is its element
+    static const UINT WM_THUMBNAILCLICK = WM_APP + 2;
+
+    BEGIN_MSG_MAP(CThumbnailGrid)
+        MESSAGE_HANDLER(WM_PAINT, OnPaint)
+        MESSAGE_HANDLER(WM_ERASEBKGND, OnEraseBackground)
+        MESSAGE_HANDLER(WM_SIZE, OnSize)
+        MESSAGE_HANDLER(WM_VSCROLL, OnVScroll)
+        MESSAGE_HANDLER(WM_MOUSEWHEEL, OnMouseWheel)
+        MESSAGE_HANDLER(WM_LBUTTONDOWN, OnLButtonDown)
+        MESSAGE_HANDLER(WM_THUMBNAILREADY, OnThumbnailReady)
+        MESSAGE_HANDLER(WM_DESTROY, OnDestroy)
+    END_MSG_MAP()
+
+    CThumbnailGrid() = default;
+    ~CThumbnailGrid();
+
+    CThumbnailGrid(const CThumbnailGrid &) = delete;
+    CThumbnailGrid &operator=(const CThumbnailGrid &) = delete;
+
+    void SetNotifyWindow(HWND hWnd)
+    {
+        m_notifyWnd = hWnd;
+    }
+
+    // Set before the grid is populated, and kept until it is destroyed
+    void SetCache(CImageCache *cache)
+    {
+        m_cache = cache;
+    }
+
+    // Shows the decoders among the root's children that are loaded or cached; thumbnails
+    // already made for the same elements are kept
+    void Populate(CInfoElement *root);
+    // Drops an element that is about to be deleted
+    void RemoveElement(CInfoElement *element);
+
+    void GetStats(UINT &items, UINT &ready, UINT &embedded, UINT &fromCache, double &averageMS);
+
+private:
+    // Posted by the workers when thumbnails are ready
+    static const UINT WM_THUMBNAILREADY = WM_APP + 1;
+
+    // Evicted items are made again only once the view moves, so that the workers do not
+    // keep making the ones the budget has just pushed out
+    enum class ItemState { Pending, Working, Done, Failed, Evicted };
+
+    struct Item
+    {
+        CInfoElement *element{};
+        CString name;
+        CString filename;
+        // Null for files that were opened from the cache
+        IWICBitmapDecoderPtr decoder;
+        bool hasContentHash{};
+        uint64_t contentHash{};
+        ItemState state{ItemState::Pending};
+        // Top-down BGR pixels with 4 bytes each, already composed over the background
+        std::vector<BYTE> pixels;
+        UINT width{};
+        UINT height{};
+        bool embedded{};
+        bool fromCache{};
+        double timeMS{};
+    };
+
+    // Makes the item's pixels, premultiplied; MakeThumbnail composes them over the background
+    static HRESULT CreateThumbnail(IWICBitmapDecoder *decoder, Item &item);
+    HRESULT MakeThumbnail(Item &item);
+    static void ComposeOverBackground(std::vector<BYTE> &pixels);
+
+    void Pump();
+    void RunPump();
+    // Picks the next item to make, the ones in view first; -1 when there is none
+    int TakeNextItem();
+    void EvictFarthest(int from, int to);
+
+    void UpdateLayout();
+    RECT GetCellRect(int index) const;
+    void ScrollTo(int position);
+
+    LRESULT OnPaint(UINT, WPARAM, LPARAM, BOOL&);
+    LRESULT OnEraseBackground(UINT, WPARAM, LPARAM, BOOL&);
+    LRESULT OnSize(UINT, WPARAM, LPARAM, BOOL&);
+    LRESULT OnVScroll(UINT, WPARAM wParam, LPARAM, BOOL&);
+    LRESULT OnMouseWheel(UINT, WPARAM wParam, LPARAM, BOOL&);
+    LRESULT OnLButtonDown(UINT, WPARAM, LPARAM lParam, BOOL&);
+    LRESULT OnThumbnailReady(UINT, WPARAM, LPARAM, BOOL&);
+    LRESULT OnDestroy(UINT, WPARAM, LPARAM, BOOL&);
+
+    HWND m_notifyWnd{};
+    CImageCache *m_cache{};
+
+    // Guards the items and the visible range, which the workers read
+    std::mutex m_lock;
+    std::vector<Item> m_items;
+    int m_firstVisible{};
+    int m_lastVisible{};
+    SIZE_T m_bytes{};
+    SIZE_T m_budget{SIZE_T(DEFAULT_BUDGET_MB) * 1024 * 1024};
+
+    int m_columns{1};
+    int m_rows{};
+    int m_scrollPos{};
+    bool m_readyPosted{};
+
+    // Moves on when the items change, so that thumbnails made for the previous ones are dropped
+    LONG m_generation{};
+    std::atomic<LONG> m_activePumps{};
+    std::atomic<bool> m_stopping{};
+    // Declared last so that its workers are joined before the members they use go away
+    std::unique_ptr<CWorkerPool> m_pool;
+};
@@ -0,0 +1,626 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "FileStructure.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+
+using namespace FileStructure;
+
+namespace
+{
+    // Strips and tiles past this many are counted but get no node of their own
+    const uint64_t MAX_LISTED_BLOCKS = 1024;
+    // Array values show this many items at most
+    const uint64_t MAX_LISTED_ITEMS = 16;
+    // Pointer tags can nest IFDs; this is deeper than any real file goes
+    const int MAX_IFD_DEPTH = 8;
+    const uint64_t MAX_CHAINED_IFDS = 65536;
+
+    enum class IfdKind
+    {
+        Image,
+        Exif,
+        Gps,
+        Interop,
+    };
+
+    struct TagName
+    {
+        uint16_t tag;
+        const wchar_t *name;
+    };
+
+    // Baseline and extended TIFF tags, and the Exif ones, which do not overlap them
+    const TagName ImageTagNames[] =
+    {
+        { 0x00FE, L"NewSubfileType" }, { 0x00FF, L"SubfileType" }, { 0x0100, L"ImageWidth" }, { 0x0101, L"ImageLength" },
+        { 0x0102, L"BitsPerSample" }, { 0x0103, L"Compression" }, { 0x0106, L"PhotometricInterpretation" },
+        { 0x010A, L"FillOrder" }, { 0x010D, L"DocumentName" }, { 0x010E, L"ImageDescription" }, { 0x010F, L"Make" },
+        { 0x0110, L"Model" }, { 0x0111, L"StripOffsets" }, { 0x0112, L"Orientation" }, { 0x0115, L"SamplesPerPixel" },
+        { 0x0116, L"RowsPerStrip" }, { 0x0117, L"StripByteCounts" }, { 0x011A, L"XResolution" }, { 0x011B, L"YResolution" },
+        { 0x011C, L"PlanarConfiguration" }, { 0x011D, L"PageName" }, { 0x0128, L"ResolutionUnit" }, { 0x0129, L"PageNumber" },
+        { 0x012D, L"TransferFunction" }, { 0x0131, L"Software" }, { 0x0132, L"DateTime" }, { 0x013B, L"Artist" },
+        { 0x013C, L"HostComputer" }, { 0x013D, L"Predictor" }, { 0x013E, L"WhitePoint" }, { 0x013F, L"PrimaryChromaticities" },
+        { 0x0140, L"ColorMap" }, { 0x0142, L"TileWidth" }, { 0x0143, L"TileLength" }, { 0x0144, L"TileOffsets" },
+        { 0x0145, L"TileByteCounts" }, { 0x014A, L"SubIFDs" }, { 0x0152, L"ExtraSamples" }, { 0x0153, L"SampleFormat" },
+        { 0x015B, L"JPEGTables" }, { 0x0201, L"JPEGInterchangeFormat" }, { 0x0202, L"JPEGInterchangeFormatLength" },
+        { 0x0211, L"YCbCrCoefficients" }, { 0x0212, L"YCbCrSubSampling" }, { 0x0213, L"YCbCrPositioning" },
+        { 0x0214, L"ReferenceBlackWhite" }, { 0x02BC, L"XMP" }, { 0x4746, L"Rating" }, { 0x8298, L"Copyright" },
+        { 0x829A, L"ExposureTime" }, { 0x829D, L"FNumber" }, { 0x83BB, L"IPTC" }, { 0x8649, L"Photoshop" },
+        { 0x8769, L"ExifIFD" }, { 0x8773, L"ICCProfile" }, { 0x8822, L"ExposureProgram" }, { 0x8825, L"GPSIFD" },
+        { 0x8827, L"ISOSpeedRatings" }, { 0x9000, L"ExifVersion" }, { 0x9003, L"DateTimeOriginal" },
+        { 0x9004, L"DateTimeDigitized" }, { 0x9010, L"OffsetTime" }, { 0x9101, L"ComponentsConfiguration" },
+        { 0x9201, L"ShutterSpeedValue" }, { 0x9202, L"ApertureValue" }, { 0x9204, L"ExposureBiasValue" },
+        { 0x9205, L"MaxApertureValue" }, { 0x9207, L"MeteringMode" }, { 0x9208, L"LightSource" }, { 0x9209, L"Flash" },
+        { 0x920A, L"FocalLength" }, { 0x927C, L"MakerNote" }, { 0x9286, L"UserComment" }, { 0x9290, L"SubSecTime" },
+        { 0x9291, L"SubSecTimeOriginal" }, { 0x9292, L"SubSecTimeDigitized" }, { 0xA000, L"FlashpixVersion" },
+        { 0xA001, L"ColorSpace" }, { 0xA002, L"PixelXDimension" }, { 0xA003, L"PixelYDimension" },
+        { 0xA005, L"InteroperabilityIFD" }, { 0xA20E, L"FocalPlaneXResolution" }, { 0xA20F, L"FocalPlaneYResolution" },
+        { 0xA210, L"FocalPlaneResolutionUnit" }, { 0xA217, L"SensingMethod" }, { 0xA300, L"FileSource" },
+        { 0xA301, L"SceneType" }, { 0xA401, L"CustomRendered" }, { 0xA402, L"ExposureMode" }, { 0xA403, L"WhiteBalance" },
+        { 0xA404, L"DigitalZoomRatio" }, { 0xA405, L"FocalLengthIn35mmFilm" }, { 0xA406, L"SceneCaptureType" },
+        { 0xA420, L"ImageUniqueID" }, { 0xA431, L"BodySerialNumber" }, { 0xA432, L"LensSpecification" },
+        { 0xA433, L"LensMake" }, { 0xA434, L"LensModel" }, { 0xC612, L"DNGVersion" },
+    };
+
+    const TagName GpsTagNames[] =
+    {
+        { 0x0000, L"GPSVersionID" }, { 0x0001, L"GPSLatitudeRef" }, { 0x0002, L"GPSLatitude" }, { 0x0003, L"GPSLongitudeRef" },
+        { 0x0004, L"GPSLongitude" }, { 0x0005, L"GPSAltitudeRef" }, { 0x0006, L"GPSAltitude" }, { 0x0007, L"GPSTimeStamp" },
+        { 0x0008, L"GPSSatellites" }, { 0x0009, L"GPSStatus" }, { 0x000A, L"GPSMeasureMode" }, { 0x000B, L"GPSDOP" },
+        { 0x000C, L"GPSSpeedRef" }, { 0x000D, L"GPSSpeed" }, { 0x000E, L"GPSTrackRef" }, { 0x000F, L"GPSTrack" },
+        { 0x0010, L"GPSImgDirectionRef" }, { 0x0011, L"GPSImgDirection" }, { 0x0012, L"GPSMapDatum" },
+        { 0x001D, L"GPSDateStamp" },
+    };
+
+    const TagName InteropTagNames[] =
+    {
+        { 0x0001, L"InteroperabilityIndex" }, { 0x0002, L"InteroperabilityVersion" },
+    };
+
+    template <size_t count>
+    const wchar_t *FindTagName(const TagName (&names)[count], uint16_t tag)
+    {
+        for (const TagName &name : names)
+        {
+            if (name.tag == tag)
+            {
+                return name.name;
+            }
+        }
+
+        return nullptr;
+    }
+
+    const wchar_t *GetTagName(IfdKind kind, uint16_t tag)
+    {
+        switch (kind)
+        {
+        case IfdKind::Gps: return FindTagName(GpsTagNames, tag);
+        case IfdKind::Interop: return FindTagName(InteropTagNames, tag);
+        default: return FindTagName(ImageTagNames, tag);
+        }
+    }
+
+    struct FieldType
+    {
+        const wchar_t *name;
+        uint32_t size;
+    };
+
+    FieldType GetFieldType(uint16_t type)
+    {
+        static const FieldType types[] =
+        {
+            { L"Unknown", 0 }, { L"BYTE", 1 }, { L"ASCII", 1 }, { L"SHORT", 2 }, { L"LONG", 4 }, { L"RATIONAL", 8 },
+            { L"SBYTE", 1 }, { L"UNDEFINED", 1 }, { L"SSHORT", 2 }, { L"SLONG", 4 }, { L"SRATIONAL", 8 },
+            { L"FLOAT", 4 }, { L"DOUBLE", 8 }, { L"IFD", 4 }, { L"Unknown", 0 }, { L"Unknown", 0 },
+            { L"LONG8", 8 }, { L"SLONG8", 8 }, { L"IFD8", 8 },
+        };
+
+        return (type < sizeof(types) / sizeof(types[0])) ? types[type] : types[0];
+    }
+
+    // Reads the IFDs of one TIFF structure; offsets inside it are relative to its header
+    class CTiffWalker
+    {
+    public:
+        CTiffWalker(const uint8_t *data, size_t size, uint64_t base)
+            : m_data(data)
+            , m_size(size)
+            , m_base(base)
+        {
+        }
+
+        // Reads the header and the offset of the first IFD; false if the data is not TIFF
+        bool ReadHeader(StructureNode &parent, uint64_t &firstIfd);
+        // Returns the number of IFDs read
+        uint32_t WalkChain(uint64_t offset, const wchar_t *firstQuery, bool framePerIfd, StructureNode &parent);
+
+        [[nodiscard]] bool IsBigTiff() const
+        {
+            return m_bigTiff;
+        }
+
+    private:
+        uint16_t Read16(uint64_t offset) const
+        {
+            return m_bigEndian ? ReadBE16(m_data + offset) : ReadLE16(m_data + offset);
+        }
+
+        uint32_t Read32(uint64_t offset) const
+        {
+            return m_bigEndian ? ReadBE32(m_data + offset) : ReadLE32(m_data + offset);
+        }
+
+        uint64_t Read64(uint64_t offset) const
+        {
+            return m_bigEndian ? ReadBE64(m_data + offset) : ReadLE64(m_data + offset);
+        }
+
+        // Reads an IFD offset, which takes 8 bytes in BigTIFF
+        uint64_t ReadOffset(uint64_t offset) const
+        {
+            return m_bigTiff ? Read64(offset) : Read32(offset);
+        }
+
+        // Reads item index of an integer array of the given type
+        uint64_t ReadInteger(uint16_t type, uint64_t offset, uint64_t index) const;
+
+        StructureNode *WalkIfd(uint64_t offset, const std::wstring &name, IfdKind kind, const std::wstring &query,
+            uint32_t frame, int depth, StructureNode &parent, uint64_t &next);
+        std::wstring FormatValue(uint16_t type, uint64_t offset, uint64_t count) const;
+        void AddBlocks(StructureNode &ifd, const wchar_t *name, uint16_t offsetsType, uint64_t offsetsAt,
+            uint16_t countsType, uint64_t countsAt, uint64_t count);
+
+        const uint8_t *m_data;
+        size_t m_size;
+        uint64_t m_base;
+        bool m_bigEndian{};
+        bool m_bigTiff{};
+        // Every IFD read so far, so that loops end
+        std::set<uint64_t> m_visited;
+    };
+
+    bool CTiffWalker::ReadHeader(StructureNode &parent, uint64_t &firstIfd)
+    {
+        if (m_size < 8)
+        {
+            return false;
+        }
+
+        if ((m_data[0] == 'I') && (m_data[1] == 'I'))
+        {
+            m_bigEndian = false;
+        }
+        else if ((m_data[0] == 'M') && (m_data[1] == 'M'))
+        {
+            m_bigEndian = true;
+        }
+        else
+        {
+            return false;
+        }
+
+        uint16_t version = Read16(2);
+        if (version == 43)
+        {
+            // BigTIFF: the offset size, which must be 8, and a reserved 0 come before the offset
+            if ((m_size < 16) || (Read16(4) != 8) || (Read16(6) != 0))
+            {
+                return false;
+            }
+            m_bigTiff = true;
+        }
+        else if (version != 42)
+        {
+            return false;
+        }
+
+        firstIfd = ReadOffset(m_bigTiff ? 8 : 4);
+
+        StructureNode &header = parent.AddChild(L"Header", m_base, m_bigTiff ? 16 : 8);
+        header.AddValue(L"ByteOrder", m_bigEndian ? L"Big endian (MM)" : L"Little endian (II)");
+        header.AddValue(L"Version", std::to_wstring(version) + (m_bigTiff ? L" (BigTIFF)" : L""));
+        header.AddValue(L"FirstIFD", m_base + firstIfd);
+
+        return true;
+    }
+
+    uint32_t CTiffWalker::WalkChain(uint64_t offset, const wchar_t *firstQuery, bool framePerIfd, StructureNode &parent)
+    {
+        // In a TIFF file every IFD of the chain is a frame, whose metadata starts at /ifd.
+        // Elsewhere only the first IFD has a query.
+        uint32_t index = 0;
+        for (; (offset != 0) && (index < MAX_CHAINED_IFDS); index++)
+        {
+            std::wstring query;
+            if (firstQuery && (framePerIfd || (index == 0)))
+            {
+                query = firstQuery;
+            }
+
+            uint64_t next = 0;
+            if (!WalkIfd(offset, L"IFD" + std::to_wstring(index), IfdKind::Image, query, framePerIfd ? index : 0, 0, parent, next))
+            {
+                break;
+            }
+            offset = next;
+        }
+
+        return index;
+    }
+
+    uint64_t CTiffWalker::ReadInteger(uint16_t type, uint64_t offset, uint64_t index) const
+    {
+        switch (type)
+        {
+        case 1: return m_data[offset + index];
+        case 3: return Read16(offset + index * 2);
+        case 4:
+        case 13: return Read32(offset + index * 4);
+        case 16:
+        case 18: return Read64(offset + index * 8);
+        default: return 0;
+        }
+    }
+
+    std::wstring CTiffWalker::FormatValue(uint16_t type, uint64_t offset, uint64_t count) const
+    {
+        if (type == 2)
+        {
+            uint64_t length = std::min<uint64_t>(count, MAX_TEXT_VALUE);
+            while ((length > 0) && (m_data[offset + length - 1] == 0))
+            {
+                length--;
+            }
+            std::wstring text = Latin1ToWide(m_data + offset, static_cast<size_t>(length));
+            return (count > MAX_TEXT_VALUE) ? text + L"..." : text;
+        }
+
+        std::wstring text;
+        uint64_t listed = std::min(count, MAX_LISTED_ITEMS);
+
+        for (uint64_t i = 0; i < listed; i++)
+        {
+            if (i)
+            {
+                text += L' ';
+            }
+
+            switch (type)
+            {
+            case 5:
+                text += std::to_wstring(Read32(offset + i * 8)) + L"/" + std::to_wstring(Read32(offset + i * 8 + 4));
+                break;
+            case 10:
+                text += std::to_wstring(static_cast<int32_t>(Read32(offset + i * 8))) + L"/"
+                    + std::to_wstring(static_cast<int32_t>(Read32(offset + i * 8 + 4)));
+                break;
+            case 6:
+                text += std::to_wstring(static_cast<int8_t>(m_data[offset + i]));
+                break;
+            case 8:
+                text += std::to_wstring(static_cast<int16_t>(Read16(offset + i * 2)));
+                break;
+            case 9:
+                text += std::to_wstring(static_cast<int32_t>(Read32(offset + i * 4)));
+                break;
+            case 17:
+                text += std::to_wstring(static_cast<int64_t>(Read64(offset + i * 8)));
+                break;
+            case 11:
+            {
+                uint32_t bits = Read32(offset + i * 4);
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                text += std::to_wstring(value);
+                break;
+            }
+            case 12:
+            {
+                uint64_t bits = Read64(offset + i * 8);
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                text += std::to_wstring(value);
+                break;
+            }
+            case 7:
+                text += FormatHex(m_data[offset + i], 2);
+                break;
+            default:
+                text += std::to_wstring(ReadInteger(type, offset, i));
+                break;
+            }
+        }
+
+        if (count > listed)
+        {
+            text += L" ...";
+        }
+
+        return text;
+    }
+
+    void CTiffWalker::AddBlocks(StructureNode &ifd, const wchar_t *name, uint16_t offsetsType, uint64_t offsetsAt,
+        uint16_t countsType, uint64_t countsAt, uint64_t count)
+    {
+        StructureNode &blocks = ifd.AddChild(std::wstring(name) + L"s", 0, 0);
+        blocks.AddValue(L"Count", count);
+
+        uint64_t first = UINT64_MAX;
+        uint64_t last = 0;
+        uint64_t total = 0;
+        uint64_t outside = 0;
+
+        for (uint64_t i = 0; i < count; i++)
+        {
+            uint64_t blockOffset = ReadInteger(offsetsType, offsetsAt, i);
+            uint64_t blockLength = ReadInteger(countsType, countsAt, i);
+            bool inside = InRange(blockOffset, blockLength, m_size);
+
+            first = std::min(first, blockOffset);
+            last = std::max(last, blockOffset + blockLength);
+            total += blockLength;
+            outside += inside ? 0 : 1;
+
+            if (i < MAX_LISTED_BLOCKS)
+            {
+                StructureNode &block = blocks.AddChild(std::wstring(name) + L" " + std::to_wstring(i), m_base + blockOffset, blockLength);
+                if (!inside)
+                {
+                    block.AddError(L"The data lies outside of the file");
+                }
+            }
+        }
+
+        if (count > 0)
+        {
+            blocks.offset = m_base + first;
+            blocks.length = last - first;
+        }
+        blocks.AddValue(L"TotalBytes", total);
+        if (count > MAX_LISTED_BLOCKS)
+        {
+            blocks.AddValue(L"Listed", MAX_LISTED_BLOCKS);
+        }
+        if (outside > 0)
+        {
+            blocks.AddError(std::to_wstring(outside) + L" of them lie outside of the file");
+        }
+    }
+
+    StructureNode *CTiffWalker::WalkIfd(uint64_t offset, const std::wstring &name, IfdKind kind, const std::wstring &query,
+        uint32_t frame, int depth, StructureNode &parent, uint64_t &next)
+    {
+        next = 0;
+
+        uint32_t countSize = m_bigTiff ? 8 : 2;
+        uint32_t entrySize = m_bigTiff ? 20 : 12;
+        uint32_t valueSize = m_bigTiff ? 8 : 4;
+
+        if ((offset < 8) || !InRange(offset, countSize, m_size))
+        {
+            StructureNode &missing = parent.AddChild(name, m_base + offset, 0);
+            missing.AddError(L"The IFD lies outside of the data");
+            return nullptr;
+        }
+        if (!m_visited.insert(offset).second)
+        {
+            StructureNode &loop = parent.AddChild(name, m_base + offset, 0);
+            loop.AddError(L"The IFD was already read; the file has a loop");
+            return nullptr;
+        }
+
+        uint64_t count = m_bigTiff ? Read64(offset) : Read16(offset);
+        uint64_t entriesAt = offset + countSize;
+        // The entries that fit, in case the IFD is cut short
+        uint64_t available = std::min(count, (m_size - entriesAt) / entrySize);
+        bool complete = (available == count) && InRange(entriesAt + count * entrySize, valueSize, m_size);
+
+        StructureNode &ifd = parent.AddChild(name, m_base + offset, countSize + available * entrySize + (complete ? valueSize : 0));
+        ifd.metadataQuery = query;
+        ifd.metadataFrame = frame;
+        ifd.AddValue(L"Entries", count);
+        if (complete)
+        {
+            next = ReadOffset(entriesAt + count * entrySize);
+            ifd.AddValue(L"NextIFD", (next != 0) ? m_base + next : 0);
+        }
+        else
+        {
+            ifd.AddError(L"The IFD is cut short");
+        }
+
+        // Where the strips or tiles are, which takes two tags each
+        struct ArrayField
+        {
+            uint16_t type;
+            uint64_t at;
+            uint64_t count;
+        } stripOffsets{}, stripCounts{}, tileOffsets{}, tileCounts{};
+        uint64_t thumbnailOffset = 0;
+        uint64_t thumbnailLength = 0;
+
+        uint16_t previousTag = 0;
+
+        for (uint64_t i = 0; i < available; i++)
+        {
+            uint64_t entryAt = entriesAt + i * entrySize;
+            uint16_t tag = Read16(entryAt);
+            uint16_t type = Read16(entryAt + 2);
+            uint64_t valueCount = m_bigTiff ? Read64(entryAt + 4) : Read32(entryAt + 4);
+            uint64_t valueFieldAt = entryAt + (m_bigTiff ? 12 : 8);
+
+            const wchar_t *tagName = GetTagName(kind, tag);
+            StructureNode &entry = ifd.AddChild(FormatHex(tag, 4) + L" " + (tagName ? tagName : L"Unknown"), m_base + entryAt, entrySize);
+            if (!query.empty())
+            {
+                entry.metadataQuery = query + L"/{ushort=" + std::to_wstring(tag) + L"}";
+                entry.metadataFrame = frame;
+            }
+
+            FieldType fieldType = GetFieldType(type);
+            entry.AddValue(L"Type", std::to_wstring(type) + L" (" + fieldType.name + L")");
+            entry.AddValue(L"Count", valueCount);
+
+            if ((i > 0) && (tag <= previousTag))
+            {
+                entry.AddError(L"The entries are not sorted by tag");
+            }
+            previousTag = tag;
+
+            if (fieldType.size == 0)
+            {
+                continue;
+            }
+            if (valueCount > UINT64_MAX / fieldType.size)
+            {
+                entry.AddError(L"The count is too large");
+                continue;
+            }
+
+            // Values that fit in the entry are stored in it
+            uint64_t valueLength = valueCount * fieldType.size;
+            uint64_t valueAt = valueFieldAt;
+            if (valueLength > valueSize)
+            {
+                valueAt = ReadOffset(valueFieldAt);
+                entry.AddValue(L"DataOffset", m_base + valueAt);
+                entry.AddValue(L"DataLength", valueLength);
+                if (!InRange(valueAt, valueLength, m_size))
+                {
+                    entry.AddError(L"The value lies outside of the data");
+                    continue;
+                }
+            }
+
+            entry.AddValue(L"Value", FormatValue(type, valueAt, valueCount));
+
+            bool isInteger = (type == 1) || (type == 3) || (type == 4) || (type == 13) || (type == 16) || (type == 18);
+            if (!isInteger || (kind == IfdKind::Gps) || (kind == IfdKind::Interop))
+            {
+                continue;
+            }
+
+            if (depth < MAX_IFD_DEPTH)
+            {
+                uint64_t ignored = 0;
+                std::wstring childQuery;
+                if ((tag == 0x8769) && (valueCount >= 1))
+                {
+                    childQuery = query.empty() ? query : query + L"/exif";
+                    WalkIfd(ReadInteger(type, valueAt, 0), L"Exif IFD", IfdKind::Exif, childQuery, frame, depth + 1, entry, ignored);
+                }
+                else if ((tag == 0x8825) && (valueCount >= 1))
+                {
+                    childQuery = query.empty() ? query : query + L"/gps";
+                    WalkIfd(ReadInteger(type, valueAt, 0), L"GPS IFD", IfdKind::Gps, childQuery, frame, depth + 1, entry, ignored);
+                }
+                else if ((tag == 0xA005) && (valueCount >= 1))
+                {
+                    childQuery = query.empty() ? query : query + L"/interop";
+                    WalkIfd(ReadInteger(type, valueAt, 0), L"Interop IFD", IfdKind::Interop, childQuery, frame, depth + 1, entry, ignored);
+                }
+                else if (tag == 0x014A)
+                {
+                    // Sub-IFDs are not frames, and WIC has no query for them
+                    for (uint64_t sub = 0; (sub < valueCount) && (sub < MAX_LISTED_BLOCKS); sub++)
+                    {
+                        WalkIfd(ReadInteger(type, valueAt, sub), L"SubIFD" + std::to_wstring(sub), IfdKind::Image, std::wstring(), frame, depth + 1, entry, ignored);
+                    }
+                }
+            }
+
+            ArrayField field{ type, valueAt, valueCount };
+            switch (tag)
+            {
+            case 0x0111: stripOffsets = field; break;
+            case 0x0117: stripCounts = field; break;
+            case 0x0144: tileOffsets = field; break;
+            case 0x0145: tileCounts = field; break;
+            case 0x0201: thumbnailOffset = ReadInteger(type, valueAt, 0); break;
+            case 0x0202: thumbnailLength = ReadInteger(type, valueAt, 0); break;
+            default: break;
+            }
+        }
+
+        if (stripOffsets.count > 0)
+        {
+            if (stripCounts.count == stripOffsets.count)
+            {
+                AddBlocks(ifd, L"Strip", stripOffsets.type, stripOffsets.at, stripCounts.type, stripCounts.at, stripOffsets.count);
+            }
+            else
+            {
+                ifd.AddError(L"StripOffsets and StripByteCounts have different counts");
+            }
+        }
+        if (tileOffsets.count > 0)
+        {
+            if (tileCounts.count == tileOffsets.count)
+            {
+                AddBlocks(ifd, L"Tile", tileOffsets.type, tileOffsets.at, tileCounts.type, tileCounts.at, tileOffsets.count);
+            }
+            else
+            {
+                ifd.AddError(L"TileOffsets and TileByteCounts have different counts");
+            }
+        }
+        if ((thumbnailOffset > 0) && (thumbnailLength > 0))
+        {
+            StructureNode &thumbnail = ifd.AddChild(L"JPEG thumbnail", m_base + thumbnailOffset, thumbnailLength);
+            if (!InRange(thumbnailOffset, thumbnailLength, m_size))
+            {
+                thumbnail.AddError(L"The data lies outside of the file");
+            }
+            else if ((thumbnailLength < 2) || (m_data[thumbnailOffset] != 0xFF) || (m_data[thumbnailOffset + 1] != 0xD8))
+            {
+                thumbnail.AddError(L"The data does not start with a JPEG SOI marker");
+            }
+        }
+
+        return &ifd;
+    }
+}
+
+bool ParseTiffStructure(const uint8_t *data, size_t size, StructureNode &root)
+{
+    CTiffWalker walker(data, size, 0);
+
+    uint64_t firstIfd = 0;
+    if (!walker.ReadHeader(root, firstIfd))
+    {
+        return false;
+    }
+
+    root.name = walker.IsBigTiff() ? L"BigTIFF" : L"TIFF";
+    root.offset = 0;
+    root.length = size;
+    root.AddValue(L"IFDs", walker.WalkChain(firstIfd, L"/ifd", true, root));
+
+    return true;
+}
+
+bool ParseTiffBlock(const uint8_t *data, size_t size, uint64_t base, const wchar_t *ifd0Query, StructureNode &parent)
+{
+    CTiffWalker walker(data, size, base);
+
+    uint64_t firstIfd = 0;
+    if (!walker.ReadHeader(parent, firstIfd))
+    {
+        return false;
+    }
+
+    walker.WalkChain(firstIfd, ifd0Query, false, parent);
+
+    return true;
+}
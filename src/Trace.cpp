@@ -0,0 +1,150 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "Trace.h"
+
+#include <new>
+
+void CTrace::AddSpan(const char *name, std::string &&detail, long long startNs, long long endNs)
+{
+    const unsigned thread = CurrentThread();
+
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    try
+    {
+        m_spans.push_back(Span{name, std::move(detail), thread, startNs, endNs});
+    }
+    catch (const std::bad_alloc &)
+    {
+        // The trace is missing a span, which is better than failing the work it measured
+    }
+}
+
+bool CTrace::Write(FILE *out)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    // Chrome trace timestamps are in microseconds, relative to any origin
+    long long firstNs = m_spans.empty() ? 0 : m_spans.front().startNs;
+    for (const Span &span : m_spans)
+    {
+        firstNs = (span.startNs < firstNs) ? span.startNs : firstNs;
+    }
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+
+    bool first = true;
+    for (const Span &span : m_spans)
+    {
+        fputs(first ? "\n" : ",\n", out);
+        first = false;
+
+        fputs("{\"name\":", out);
+        WriteString(out, span.name);
+        fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+            span.thread, (span.startNs - firstNs) / 1000.0, (span.endNs - span.startNs) / 1000.0);
+
+        if (!span.detail.empty())
+        {
+            fputs(",\"args\":{\"detail\":", out);
+            WriteString(out, span.detail.c_str());
+            fputc('}', out);
+        }
+
+        fputc('}', out);
+    }
+
+    fputs("\n]}\n", out);
+
+    return 0 == ferror(out);
+}
+
+void CTrace::Clear()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    m_spans.clear();
+}
+
+std::string CTrace::ToUtf8(const wchar_t *text)
+{
+    std::string utf8;
+
+    for (const wchar_t *p = text; 0 != *p; p++)
+    {
+        unsigned long c = static_cast<unsigned long>(*p);
+
+        // wchar_t is UTF-16 on Windows and UTF-32 elsewhere
+        if ((c >= 0xD800) && (c < 0xDC00) && (p[1] >= 0xDC00) && (p[1] < 0xE000))
+        {
+            c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<unsigned long>(p[1]) - 0xDC00);
+            p++;
+        }
+
+        if (c < 0x80)
+        {
+            utf8 += static_cast<char>(c);
+        }
+        else if (c < 0x800)
+        {
+            utf8 += static_cast<char>(0xC0 | (c >> 6));
+            utf8 += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            utf8 += static_cast<char>(0xE0 | (c >> 12));
+            utf8 += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            utf8 += static_cast<char>(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            utf8 += static_cast<char>(0xF0 | (c >> 18));
+            utf8 += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            utf8 += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            utf8 += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+
+    return utf8;
+}
+
+unsigned CTrace::CurrentThread()
+{
+    // Small, stable numbers read better in a trace viewer than OS thread ids
+    static std::atomic<unsigned> s_lastThread{};
+    thread_local const unsigned thread = ++s_lastThread;
+
+    return thread;
+}
+
+void CTrace::WriteString(FILE *out, const char *text)
+{
+    fputc('"', out);
+
+    for (const char *p = text; 0 != *p; p++)
+    {
+        const unsigned char c = static_cast<unsigned char>(*p);
+
+        if (('"' == c) || ('\\' == c))
+        {
+            fputc('\\', out);
+            fputc(c, out);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(out, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, out);
+        }
+    }
+
+    fputc('"', out);
+}
@@ -0,0 +1,110 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Records named spans of work, with nanosecond timestamps from std::chrono, and
+// writes them as Chrome trace events that chrome://tracing and Perfetto can load.
+// Spans on a thread nest by time, so a span opened inside another shows up under
+// it. Tracing is off until Enable is called; until then a span costs one relaxed
+// atomic load. This has no Windows dependencies, unlike the rest of the tree.
+class CTrace final
+{
+public:
+    static CTrace &Inst()
+    {
+        static CTrace inst;
+
+        return inst;
+    }
+
+    void Enable(bool enable)
+    {
+        m_enabled.store(enable, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool IsEnabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] static long long NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void AddSpan(const char *name, std::string &&detail, long long startNs, long long endNs);
+    // Writes every span recorded so far as a JSON object with a traceEvents array
+    bool Write(FILE *out);
+    void Clear();
+
+    // A UTF-8 copy of a wide string, for span details
+    static std::string ToUtf8(const wchar_t *text);
+
+private:
+    struct Span final
+    {
+        const char *name;
+        std::string detail;
+        unsigned thread;
+        long long startNs;
+        long long endNs;
+    };
+
+    CTrace() = default;
+
+    static unsigned CurrentThread();
+    static void WriteString(FILE *out, const char *text);
+
+    std::atomic<bool> m_enabled{};
+    std::mutex m_lock;
+    std::vector<Span> m_spans;
+};
+
+// Records the time from its construction to its destruction as a span. The name
+// has to outlive the trace, which a string literal does.
+class CTraceSpan final
+{
+public:
+    explicit CTraceSpan(const char *name, const wchar_t *detail = nullptr)
+    {
+        if (CTrace::Inst().IsEnabled())
+        {
+            m_name = name;
+            if (nullptr != detail)
+            {
+                m_detail = CTrace::ToUtf8(detail);
+            }
+            m_startNs = CTrace::NowNs();
+        }
+    }
+
+    ~CTraceSpan()
+    {
+        if (nullptr != m_name)
+        {
+            CTrace::Inst().AddSpan(m_name, std::move(m_detail), m_startNs, CTrace::NowNs());
+        }
+    }
+
+    CTraceSpan(const CTraceSpan &) = delete;
+    CTraceSpan &operator=(const CTraceSpan &) = delete;
+
+private:
+    const char *m_name{};
+    std::string m_detail;
+    long long m_startNs{};
+};
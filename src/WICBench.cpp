@@ -0,0 +1,507 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "AlphaKernels.h"
+#include "BenchSuite.h"
+#include "ColorContextCache.h"
+#include "Element.h"
+#include "ImageFiles.h"
+#include "ImageTransencoder.h"
+#include "Stopwatch.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+// WICBench replays what WIC Explorer does with a file: it opens it, renders its
+// first frame at full size and saves it again, each as many times as asked. It
+// reports latency percentiles, throughput and the largest working set seen for
+// each format, so that runs can be compared between commits:
+//
+//   WICBench [/iterations:<n>] [/warmup:<n>] [/save:<png|jpg|tif|bmp>] [/factory:<clsid>]
+//            [/synthetic:<width>x<height>] [/filestreams] [<file|wildcard|directory> ...]
+//
+// /synthetic generates a corpus of the same bitmap in every built-in format, so
+// the suite does not depend on which images are at hand. Renders bypass the DIB
+// cache, and the DIBs are freed instead of being shown. The alpha kernels are
+// measured on their own at the end. The timing and the report are in BenchSuite.cpp,
+// which the tests run over a synthetic codec on any platform.
+//
+// Decoders read through a mapping of the file, as they do in WIC Explorer, unless
+// /filestreams asks for the streams that WIC opens itself. The read operations that
+// each run issues are reported per format, so the two can be compared.
+
+CAppModule _Module;
+
+struct BenchOptions
+{
+    UINT iterations{10};
+    UINT warmup{1};
+    GUID saveFormat{GUID_ContainerFormatPng};
+    CString saveExtension{L"png"};
+    CLSID factoryClsid{CLSID_WICImagingFactory};
+    UINT syntheticWidth{};
+    UINT syntheticHeight{};
+    bool fileStreams{};
+};
+
+static const struct
+{
+    const GUID *containerFormat;
+    LPCWSTR extension;
+} ContainerFormats[] =
+{
+    { &GUID_ContainerFormatPng, L"png" },
+    { &GUID_ContainerFormatJpeg, L"jpg" },
+    { &GUID_ContainerFormatTiff, L"tif" },
+    { &GUID_ContainerFormatBmp, L"bmp" },
+    { &GUID_ContainerFormatGif, L"gif" },
+};
+
+static void Usage()
+{
+    fwprintf(stderr, L"Usage: WICBench [/iterations:<n>] [/warmup:<n>] [/save:<png|jpg|tif|bmp>] [/factory:<clsid>]\n"
+                     L"                [/synthetic:<width>x<height>] [/filestreams] [<file|wildcard|directory> ...]\n");
+}
+
+static ULONGLONG GetFileBytes(LPCWSTR filename)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data{};
+    if (!GetFileAttributesEx(filename, GetFileExInfoStandard, &data))
+    {
+        return 0;
+    }
+
+    return (ULONGLONG(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
+
+// Writes the same deterministic bitmap in every container format, under directory
+static HRESULT CreateSyntheticCorpus(UINT width, UINT height, const CString &directory, CSimpleArray<CString> &files)
+{
+    HRESULT result = S_OK;
+
+    IWICBitmapPtr bitmap;
+    IFC(g_imagingFactory->CreateBitmap(width, height, GUID_WICPixelFormat32bppBGRA, WICBitmapCacheOnLoad, &bitmap));
+
+    {
+        WICRect rect{0, 0, static_cast<INT>(width), static_cast<INT>(height)};
+        IWICBitmapLockPtr lock;
+        IFC(bitmap->Lock(&rect, WICBitmapLockWrite, &lock));
+
+        UINT stride = 0, size = 0;
+        BYTE *pixels = nullptr;
+        IFC(lock->GetStride(&stride));
+        IFC(lock->GetDataPointer(&size, &pixels));
+
+        // Gradients with some noise, so that the encoders have something to work
+        // with, and a varying alpha. The noise is seeded the same on every run.
+        UINT seed = 1;
+        for (UINT y = 0; y < height; y++)
+        {
+            BYTE *row = pixels + SIZE_T(stride) * y;
+            for (UINT x = 0; x < width; x++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                const UINT noise = (seed >> 24) & 0x1F;
+
+                row[x*4+0] = static_cast<BYTE>((x * 255 / std::max(1U, width - 1) + noise) & 0xFF);
+                row[x*4+1] = static_cast<BYTE>((y * 255 / std::max(1U, height - 1) + noise) & 0xFF);
+                row[x*4+2] = static_cast<BYTE>(((x + y) & 0xFF) ^ noise);
+                row[x*4+3] = static_cast<BYTE>(255 - ((x ^ y) & 0x7F));
+            }
+        }
+    }
+
+    CreateDirectory(directory, nullptr);
+
+    for (const auto &container : ContainerFormats)
+    {
+        CString filename;
+        filename.Format(L"%ssynthetic.%s", directory.GetString(), container.extension);
+
+        CSimpleCodeGenerator codeGen;
+        CImageTransencoder trans;
+
+        IFC(trans.Begin(*container.containerFormat, filename, codeGen));
+        IFC(trans.AddFrame(bitmap));
+        IFC(trans.End());
+
+        files.Add(filename);
+    }
+
+    return result;
+}
+
+// Opens, renders and saves files the way WIC Explorer does
+class CWicBenchCodec final : public IBenchCodec
+{
+public:
+    CWicBenchCodec(const BenchOptions &options, const CString &savePath)
+        : m_options(options)
+        , m_savePath(savePath)
+    {
+    }
+
+    int32_t Open(const std::wstring &filename, double &bytes) override
+    {
+        HRESULT result = CElementManager::OpenFile(filename.c_str(), m_codeGen, m_decElem);
+
+        // Files that no codec reads may still have left a structure element behind
+        if (SUCCEEDED(result) && (nullptr == m_decElem))
+        {
+            result = E_FAIL;
+        }
+
+        bytes = double(GetFileBytes(filename.c_str()));
+
+        return result;
+    }
+
+    // Building the frame's metadata elements is not part of its render
+    int32_t PrepareRender() override
+    {
+        HRESULT result = S_OK;
+
+        IFC(m_decElem->EnsureChildren(m_codeGen));
+
+        m_frameElem = dynamic_cast<CBitmapSourceElement *>(m_decElem->FirstChild());
+        if (nullptr == m_frameElem)
+        {
+            return E_FAIL;
+        }
+
+        IFC(m_frameElem->EnsureChildren(m_codeGen));
+
+        return result;
+    }
+
+    int32_t Render(double &bytes, uint64_t &peakWorkingSet) override
+    {
+        InfoElementViewContext context{};
+        BitmapRenderRequest request = m_frameElem->CreateRenderRequest(context);
+        request.cacheId = 0;
+
+        BitmapRendering rendering;
+        const HRESULT result = CBitmapSourceElement::Render(request, nullptr, rendering);
+
+        bytes = double(rendering.width) * rendering.height * 4;
+        peakWorkingSet = rendering.peakWorkingSet;
+
+        return result;
+    }
+
+    int32_t Save(double &bytes) override
+    {
+        WICPixelFormatGUID format = GUID_WICPixelFormatDontCare;
+
+        const HRESULT result = CElementManager::SaveElementAsImage(*m_decElem, m_options.saveFormat, format, m_savePath, m_codeGen);
+
+        bytes = double(GetFileBytes(m_savePath));
+
+        return result;
+    }
+
+    void Close() override
+    {
+        if (nullptr != m_decElem)
+        {
+            CElementManager::GetRootElement()->RemoveChild(m_decElem);
+        }
+
+        m_decElem = nullptr;
+        m_frameElem = nullptr;
+        m_codeGen = CSimpleCodeGenerator();
+    }
+
+    uint64_t GetWorkingSet() override
+    {
+        PROCESS_MEMORY_COUNTERS memoryCounters{};
+        memoryCounters.cb = sizeof(memoryCounters);
+
+        return GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters))
+            ? memoryCounters.WorkingSetSize : 0;
+    }
+
+    // Reads from a mapping are page faults rather than read operations, so they do not count here
+    void GetReadCounters(uint64_t &operations, uint64_t &bytes) override
+    {
+        IO_COUNTERS counters{};
+        GetProcessIoCounters(GetCurrentProcess(), &counters);
+
+        operations = counters.ReadOperationCount;
+        bytes = counters.ReadTransferCount;
+    }
+
+private:
+    const BenchOptions &m_options;
+    CString m_savePath;
+    CSimpleCodeGenerator m_codeGen;
+    CInfoElement *m_decElem{};
+    CBitmapSourceElement *m_frameElem{};
+};
+
+static void ReportStage(LPCWSTR format, LPCWSTR stage, BenchStage &samples)
+{
+    const std::wstring line = FormatBenchStage(format, stage, samples);
+    if (!line.empty())
+    {
+        wprintf(L"%s\n", line.c_str());
+    }
+}
+
+// Runs the alpha kernels over a 4 megapixel buffer that does not fit in the cache
+static void ReportAlphaKernels(UINT iterations)
+{
+    const UINT pixels = 2048 * 2048;
+    std::vector<BYTE> bgra(SIZE_T(pixels) * 4);
+    std::vector<BYTE> alpha(SIZE_T(pixels) * 4);
+
+    for (size_t i = 0; i < bgra.size(); i++)
+    {
+        bgra[i] = static_cast<BYTE>(i * 7);
+    }
+
+    BenchStage broadcast;
+    BenchStage premultiply;
+    CStopwatch timer;
+
+    for (UINT iteration = 0; iteration < iterations; iteration++)
+    {
+        timer.Start();
+        BroadcastAlpha(bgra.data(), alpha.data(), pixels);
+        AddBenchSample(broadcast, timer.GetElapsedMS(), double(bgra.size()), 0);
+
+        timer.Start();
+        PremultiplyAlpha(bgra.data(), alpha.data(), pixels);
+        AddBenchSample(premultiply, timer.GetElapsedMS(), double(bgra.size()), 0);
+    }
+
+    ReportStage(GetAlphaKernelName(), L"alpha", broadcast);
+    ReportStage(GetAlphaKernelName(), L"premult", premultiply);
+}
+
+static bool ParseArguments(int argc, wchar_t **argv, BenchOptions &options, CSimpleArray<CString> &files)
+{
+    const CString iterationsPrefix = L"/iterations:";
+    const CString warmupPrefix = L"/warmup:";
+    const CString savePrefix = L"/save:";
+    const CString factoryPrefix = L"/factory:";
+    const CString syntheticPrefix = L"/synthetic:";
+    const CString fileStreamsOption = L"/filestreams";
+
+    for (int i = 1; i < argc; i++)
+    {
+        const CString arg = argv[i];
+
+        if (0 == arg.Left(iterationsPrefix.GetLength()).CompareNoCase(iterationsPrefix))
+        {
+            const int iterations = _wtoi(arg.Mid(iterationsPrefix.GetLength()));
+            if (iterations <= 0)
+            {
+                fwprintf(stderr, L"Invalid iteration count: %s\n", arg.GetString());
+                return false;
+            }
+            options.iterations = UINT(iterations);
+        }
+        else if (0 == arg.Left(warmupPrefix.GetLength()).CompareNoCase(warmupPrefix))
+        {
+            options.warmup = UINT(std::max(0, _wtoi(arg.Mid(warmupPrefix.GetLength()))));
+        }
+        else if (0 == arg.Left(savePrefix.GetLength()).CompareNoCase(savePrefix))
+        {
+            const CString extension = arg.Mid(savePrefix.GetLength());
+            bool found = false;
+
+            // GIF is left out because it would quantize every frame
+            for (const auto &container : ContainerFormats)
+            {
+                if ((0 == extension.CompareNoCase(container.extension)) && (container.containerFormat != &GUID_ContainerFormatGif))
+                {
+                    options.saveFormat = *container.containerFormat;
+                    options.saveExtension = container.extension;
+                    found = true;
+                }
+            }
+
+            if (!found)
+            {
+                fwprintf(stderr, L"Invalid save format: %s\n", arg.GetString());
+                return false;
+            }
+        }
+        else if (0 == arg.Left(factoryPrefix.GetLength()).CompareNoCase(factoryPrefix))
+        {
+            if (FAILED(CLSIDFromString(arg.Mid(factoryPrefix.GetLength()), &options.factoryClsid)))
+            {
+                fwprintf(stderr, L"Invalid factory CLSID: %s\n", arg.GetString());
+                return false;
+            }
+        }
+        else if (0 == arg.Left(syntheticPrefix.GetLength()).CompareNoCase(syntheticPrefix))
+        {
+            if ((2 != swscanf_s(arg.Mid(syntheticPrefix.GetLength()), L"%ux%u", &options.syntheticWidth, &options.syntheticHeight))
+                || (0 == options.syntheticWidth) || (0 == options.syntheticHeight))
+            {
+                fwprintf(stderr, L"Invalid synthetic size: %s\n", arg.GetString());
+                return false;
+            }
+        }
+        else if (0 == arg.CompareNoCase(fileStreamsOption))
+        {
+            options.fileStreams = true;
+        }
+        else
+        {
+            const DWORD attributes = GetFileAttributes(arg);
+            HRESULT result;
+
+            if ((INVALID_FILE_ATTRIBUTES != attributes) && (attributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                result = EnumerateImageFiles(arg, files);
+            }
+            else
+            {
+                result = ExpandWildcard(arg, files);
+            }
+
+            if (FAILED(result))
+            {
+                CString err;
+                GetHresultString(result, err);
+                fwprintf(stderr, L"Could not open %s: %s\n", arg.GetString(), err.GetString());
+            }
+        }
+    }
+
+    return true;
+}
+
+static int Run(const BenchOptions &options, CSimpleArray<CString> &files)
+{
+    WCHAR tempPath[MAX_PATH + 1];
+    if (0 == GetTempPath(ARRAYSIZE(tempPath), tempPath))
+    {
+        fwprintf(stderr, L"Could not find the temporary directory\n");
+        return 2;
+    }
+
+    const CString workDirectory = CString(tempPath) + L"WICBench\\";
+
+    if (options.syntheticWidth > 0)
+    {
+        const HRESULT result = CreateSyntheticCorpus(options.syntheticWidth, options.syntheticHeight, workDirectory, files);
+        if (FAILED(result))
+        {
+            CString err;
+            GetHresultString(result, err);
+            fwprintf(stderr, L"Could not create the synthetic corpus: %s\n", err.GetString());
+            return 2;
+        }
+    }
+
+    if (0 == files.GetSize())
+    {
+        Usage();
+        return 2;
+    }
+
+    CreateDirectory(workDirectory, nullptr);
+    const CString savePath = workDirectory + L"saved." + options.saveExtension;
+
+    std::vector<std::wstring> filenames;
+    for (int i = 0; i < files.GetSize(); i++)
+    {
+        filenames.push_back(files[i].GetString());
+    }
+
+    CWicBenchCodec codec(options, savePath);
+    std::map<std::wstring, BenchFormatResults> results;
+    const std::vector<BenchFailure> failures = RunBench(codec, filenames, options.warmup, options.iterations, results);
+
+    for (const BenchFailure &failure : failures)
+    {
+        CString err;
+        GetHresultString(failure.result, err);
+        fwprintf(stderr, L"%s: %s\n", failure.filename.c_str(), err.GetString());
+    }
+
+    DeleteFile(savePath);
+
+    wprintf(L"%lu files, %u iterations after %u warmup\n\n", static_cast<DWORD>(files.GetSize()), options.iterations, options.warmup);
+    wprintf(L"%s\n", FormatBenchHeader().c_str());
+
+    for (auto &entry : results)
+    {
+        ReportStage(entry.first.c_str(), L"open", entry.second.open);
+        ReportStage(entry.first.c_str(), L"render", entry.second.render);
+        ReportStage(entry.first.c_str(), L"save", entry.second.save);
+    }
+
+    wprintf(L"\n%-8s %-8s %10s %10s\n", L"Format", L"Streams", L"Reads/run", L"KB/run");
+
+    for (auto &entry : results)
+    {
+        const size_t runs = entry.second.open.times.size();
+        if (runs > 0)
+        {
+            wprintf(L"%-8s %-8s %10.1f %10.1f\n", entry.first.c_str(), options.fileStreams ? L"file" : L"mapped",
+                double(entry.second.readOperations) / runs, double(entry.second.readBytes) / 1024.0 / runs);
+        }
+    }
+    wprintf(L"\n");
+
+    ReportAlphaKernels(options.iterations);
+
+    return failures.empty() ? 0 : 1;
+}
+
+int wmain(int argc, wchar_t **argv)
+{
+    PopulateWicErrorCodes();
+
+    BenchOptions options;
+    CSimpleArray<CString> files;
+
+    if (!ParseArguments(argc, argv, options, files) || ((0 == files.GetSize()) && (0 == options.syntheticWidth)))
+    {
+        Usage();
+        return 2;
+    }
+
+    g_mappedStreams = !options.fileStreams;
+
+    HRESULT hr = CoInitialize(nullptr);
+    if (FAILED(hr))
+    {
+        return 2;
+    }
+
+    int result = 2;
+
+    hr = CoCreateInstance(options.factoryClsid, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&g_imagingFactory));
+    if (SUCCEEDED(hr))
+    {
+        result = Run(options, files);
+
+        CElementManager::ClearAllElements();
+        CColorContextCache::Inst().Clear();
+        g_imagingFactory = nullptr;
+    }
+    else
+    {
+        CString err;
+        GetHresultString(hr, err);
+        fwprintf(stderr, L"Unable to create ImagingFactory. The error is: %s.\n", err.GetString());
+    }
+
+    CoUninitialize();
+
+    return result;
+}
@@ -0,0 +1,340 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "ColorContextCache.h"
+#include "Element.h"
+#include "ImageFiles.h"
+#include "JsonRecordDevice.h"
+#include "Stopwatch.h"
+#include "Trace.h"
+
+// WICInspect builds the same element tree as WIC Explorer, without any UI, and
+// writes one JSON record per file. It is meant to run as a batch job:
+//
+//   WICInspect [/out:<file>] [/factory:<clsid>] [/code] [/render] [/bandheight:<rows>] [/trace:<file>] <file|wildcard|directory> ...
+//
+// Directories are searched recursively for image files. /factory creates the
+// imaging factory from another CLSID, so that a stand-in factory can be used.
+// /render renders every bitmap at full size and records the time of each stage.
+// /bandheight sets how many rows are pulled through WIC at a time. /trace writes
+// the time spent opening, loading and walking each file as Chrome trace events.
+
+CAppModule _Module;
+
+struct InspectOptions
+{
+    CString outputFile;
+    CString traceFile;
+    CLSID factoryClsid{CLSID_WICImagingFactory};
+    bool includeCode{};
+    bool render{};
+};
+
+static void Usage()
+{
+    fwprintf(stderr, L"Usage: WICInspect [/out:<file>] [/factory:<clsid>] [/code] [/render] [/bandheight:<rows>] [/trace:<file>] <file|wildcard|directory> ...\n");
+}
+
+static void OutputElement(CInfoElement &element, CJsonRecordDevice &device, const InfoElementViewContext &context)
+{
+    device.BeginSection(element.Name());
+
+    element.OutputView(device, context);
+    element.OutputInfo(device);
+
+    for (CInfoElement *child = element.FirstChild(); nullptr != child; child = child->NextSibling())
+    {
+        OutputElement(*child, device, context);
+    }
+
+    device.EndSection();
+}
+
+// Renders the bitmaps of the tree one at a time, with their alpha view, the way WIC
+// Explorer does at full size
+static void RenderElements(CInfoElement &element, const std::wstring &path, const InfoElementViewContext &context,
+    std::vector<InspectRender> &renders)
+{
+    const std::wstring name = element.Name().GetString();
+    const std::wstring elementPath = path.empty() ? name : path + L"/" + name;
+
+    auto *bitmap = dynamic_cast<CBitmapSourceElement *>(&element);
+    BitmapRenderRequest request;
+    if (nullptr != bitmap)
+    {
+        request = bitmap->CreateRenderRequest(context);
+    }
+
+    // A frame that could not be decoded has no source
+    if (nullptr != request.source)
+    {
+        // Each bitmap is rendered once, so it is not kept in the cache
+        request.cacheId = 0;
+
+        BitmapRendering rendering;
+        CBitmapSourceElement::Render(request, nullptr, rendering);
+
+        InspectRender render;
+        render.element = elementPath;
+        render.result = rendering.result;
+        render.width = rendering.width;
+        render.height = rendering.height;
+        render.renderMs = rendering.renderTime;
+        render.setupMs = rendering.stageTimes.setup;
+        render.decodeMs = rendering.stageTimes.decode;
+        render.colorTransformMs = rendering.stageTimes.colorTransform;
+        render.conversionMs = rendering.stageTimes.conversion;
+        render.alphaMs = rendering.stageTimes.alpha;
+        renders.push_back(render);
+    }
+
+    for (CInfoElement *child = element.FirstChild(); nullptr != child; child = child->NextSibling())
+    {
+        RenderElements(*child, elementPath, context, renders);
+    }
+}
+
+static std::wstring InspectFile(LPCWSTR filename, const InspectOptions &options, CJsonRecordWriter &writer, InspectSummary &summary)
+{
+    InfoElementViewContext context{};
+    context.bIsAlphaEnable = false;
+    context.bIsPremultiplyEnable = false;
+    context.bIsRenderEnable = false;
+    context.bIsChildViewEnable = false;
+
+    CSimpleCodeGenerator codeGen;
+    CInfoElement *decElem = nullptr;
+
+    CStopwatch openTimer;
+    openTimer.Start();
+
+    HRESULT result = CElementManager::OpenFile(filename, codeGen, decElem);
+
+    // The record covers the whole tree, so create every element up front
+    if (nullptr != decElem)
+    {
+        const HRESULT subtreeResult = decElem->EnsureSubtree(codeGen);
+        if (SUCCEEDED(result))
+        {
+            result = subtreeResult;
+        }
+    }
+
+    const InspectOutcome outcome = MakeInspectOutcome(result, openTimer.GetTimeMS(), options.includeCode,
+        [](int32_t failure)
+        {
+            CString text;
+            GetHresultString(failure, text);
+            return std::wstring(text.GetString());
+        },
+        [&codeGen]()
+        {
+            CString code;
+            codeGen.GenerateCode(code);
+            return std::wstring(code.GetString());
+        });
+
+    // The renders are record values, so they are done before the elements are written
+    std::vector<InspectRender> renders;
+    if (options.render && (nullptr != decElem))
+    {
+        InfoElementViewContext renderContext = context;
+        renderContext.bIsAlphaEnable = true;
+        RenderElements(*decElem, std::wstring(), renderContext, renders);
+    }
+
+    BeginInspectRecord(writer, filename, outcome, summary);
+
+    if (options.render)
+    {
+        writer.AddRecordValue(L"renders", renders);
+    }
+
+    if (nullptr != decElem)
+    {
+        CJsonRecordDevice device(writer);
+        OutputElement(*decElem, device, context);
+
+        // Release the decoder and its elements before moving to the next file
+        CElementManager::GetRootElement()->RemoveChild(decElem);
+    }
+
+    return writer.EndRecord();
+}
+
+static bool ParseArguments(int argc, wchar_t **argv, InspectOptions &options, CSimpleArray<CString> &files)
+{
+    const CString outPrefix = L"/out:";
+    const CString factoryPrefix = L"/factory:";
+    const CString bandHeightPrefix = L"/bandheight:";
+    const CString tracePrefix = L"/trace:";
+
+    for (int i = 1; i < argc; i++)
+    {
+        const CString arg = argv[i];
+
+        if (0 == arg.Left(outPrefix.GetLength()).CompareNoCase(outPrefix))
+        {
+            options.outputFile = arg.Mid(outPrefix.GetLength());
+        }
+        else if (0 == arg.Left(factoryPrefix.GetLength()).CompareNoCase(factoryPrefix))
+        {
+            if (FAILED(CLSIDFromString(arg.Mid(factoryPrefix.GetLength()), &options.factoryClsid)))
+            {
+                fwprintf(stderr, L"Invalid factory CLSID: %s\n", arg.GetString());
+                return false;
+            }
+        }
+        else if (0 == arg.Left(bandHeightPrefix.GetLength()).CompareNoCase(bandHeightPrefix))
+        {
+            const int rows = _wtoi(arg.Mid(bandHeightPrefix.GetLength()));
+            if (rows <= 0)
+            {
+                fwprintf(stderr, L"Invalid band height: %s\n", arg.GetString());
+                return false;
+            }
+            g_bandHeight = UINT(rows);
+        }
+        else if (0 == arg.Left(tracePrefix.GetLength()).CompareNoCase(tracePrefix))
+        {
+            options.traceFile = arg.Mid(tracePrefix.GetLength());
+            CTrace::Inst().Enable(true);
+        }
+        else if (0 == arg.CompareNoCase(L"/code"))
+        {
+            options.includeCode = true;
+        }
+        else if (0 == arg.CompareNoCase(L"/render"))
+        {
+            options.render = true;
+        }
+        else
+        {
+            const DWORD attributes = GetFileAttributes(arg);
+            HRESULT result;
+
+            if ((INVALID_FILE_ATTRIBUTES != attributes) && (attributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                result = EnumerateImageFiles(arg, files);
+            }
+            else
+            {
+                result = ExpandWildcard(arg, files);
+            }
+
+            if (FAILED(result))
+            {
+                CString err;
+                GetHresultString(result, err);
+                fwprintf(stderr, L"Could not open %s: %s\n", arg.GetString(), err.GetString());
+            }
+        }
+    }
+
+    return true;
+}
+
+static int Run(const InspectOptions &options, const CSimpleArray<CString> &files)
+{
+    FILE *out = stdout;
+
+    if (options.outputFile.GetLength() > 0)
+    {
+        if (0 != _wfopen_s(&out, options.outputFile, L"wb"))
+        {
+            fwprintf(stderr, L"Could not create %s\n", options.outputFile.GetString());
+            return 2;
+        }
+    }
+
+    CJsonRecordWriter writer;
+    writer.m_includeVerbatimText = options.includeCode;
+
+    InspectSummary summary;
+
+    CStopwatch runTimer;
+    runTimer.Start();
+
+    for (int i = 0; i < files.GetSize(); i++)
+    {
+        CTraceSpan span("InspectFile", files[i]);
+        const std::wstring record = InspectFile(files[i], options, writer, summary);
+
+        const CW2A utf8(record.c_str(), CP_UTF8);
+        fputs(utf8, out);
+        fputc('\n', out);
+    }
+
+    const DWORD runTime = runTimer.GetTimeMS();
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    if (options.traceFile.GetLength() > 0)
+    {
+        FILE *trace = nullptr;
+        if ((0 != _wfopen_s(&trace, options.traceFile, L"wb")) || !CTrace::Inst().Write(trace))
+        {
+            fwprintf(stderr, L"Could not write %s\n", options.traceFile.GetString());
+        }
+        if (nullptr != trace)
+        {
+            fclose(trace);
+        }
+    }
+
+    fwprintf(stderr, L"%s\n", FormatInspectSummary(summary, runTime).c_str());
+
+    return GetInspectExitCode(summary);
+}
+
+int wmain(int argc, wchar_t **argv)
+{
+    PopulateWicErrorCodes();
+
+    InspectOptions options;
+    CSimpleArray<CString> files;
+
+    if (!ParseArguments(argc, argv, options, files) || (0 == files.GetSize()))
+    {
+        Usage();
+        return 2;
+    }
+
+    HRESULT hr = CoInitialize(nullptr);
+    if (FAILED(hr))
+    {
+        return 2;
+    }
+
+    int result = 2;
+
+    hr = CoCreateInstance(options.factoryClsid, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&g_imagingFactory));
+    if (SUCCEEDED(hr))
+    {
+        result = Run(options, files);
+
+        CElementManager::ClearAllElements();
+        CColorContextCache::Inst().Clear();
+        g_imagingFactory = nullptr;
+    }
+    else
+    {
+        CString err;
+        GetHresultString(hr, err);
+        fwprintf(stderr, L"Unable to create ImagingFactory. The error is: %s.\n", err.GetString());
+    }
+
+    CoUninitialize();
+
+    return result;
+}
@@ -0,0 +1,182 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "pch.h"
+
+#include "WorkerPool.h"
+#include "Element.h"
+
+CWorkerPool::CWorkerPool(UINT workerCount)
+{
+    QueryPerformanceFrequency(&m_frequency);
+
+    if (0 == workerCount)
+    {
+        SYSTEM_INFO systemInfo{};
+        GetSystemInfo(&systemInfo);
+        workerCount = systemInfo.dwNumberOfProcessors;
+    }
+
+    if (0 == workerCount)
+    {
+        workerCount = 1;
+    }
+
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+
+    // Only start the threads once every queue exists, since they steal from each other
+    for (UINT i = 0; i < workerCount; i++)
+    {
+        m_workers[i]->thread = std::thread(&CWorkerPool::Run, this, i);
+    }
+}
+
+CWorkerPool::~CWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto &worker : m_workers)
+    {
+        worker->thread.join();
+    }
+}
+
+void CWorkerPool::Submit(Task task)
+{
+    Worker &worker = *m_workers[m_nextWorker++ % m_workers.size()];
+
+    m_pending++;
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        worker.tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_queued++;
+    }
+    m_wake.notify_one();
+}
+
+void CWorkerPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> guard(m_lock);
+    m_idle.wait(guard, [this] { return 0 == m_pending; });
+}
+
+void CWorkerPool::ResetStats()
+{
+    for (auto &worker : m_workers)
+    {
+        worker->completed = 0;
+        worker->busyTicks = 0;
+    }
+}
+
+void CWorkerPool::GetWorkerStats(UINT worker, DWORD &tasks, double &busyMS) const
+{
+    ATLASSERT(worker < m_workers.size());
+
+    tasks = m_workers[worker]->completed;
+    busyMS = static_cast<double>(m_workers[worker]->busyTicks) * 1000.0 / static_cast<double>(m_frequency.QuadPart);
+}
+
+bool CWorkerPool::TakeTask(UINT index, Task &task)
+{
+    // Newest work from our own queue first, then the oldest work from everybody else
+    {
+        Worker &own = *m_workers[index];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < m_workers.size(); i++)
+    {
+        Worker &victim = *m_workers[(index + i) % m_workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CWorkerPool::Run(UINT index)
+{
+    Worker &worker = *m_workers[index];
+
+    const HRESULT coInit = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (SUCCEEDED(coInit))
+    {
+        CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&g_imagingFactory));
+    }
+
+    CElementManager::SetDeferRegistration(true);
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(m_lock);
+            m_wake.wait(guard, [this] { return m_stop || m_queued > 0; });
+
+            if (m_stop)
+            {
+                break;
+            }
+
+            // Claimed under the lock, so that a worker that loses the race goes back to waiting
+            m_queued--;
+        }
+
+        // A claimed task is in one of the queues, but another worker may take the one
+        // that was seen first
+        Task task;
+        while (!TakeTask(index, task))
+        {
+            std::this_thread::yield();
+        }
+
+        LARGE_INTEGER start, end;
+        QueryPerformanceCounter(&start);
+
+        task();
+
+        QueryPerformanceCounter(&end);
+        worker.busyTicks += end.QuadPart - start.QuadPart;
+        worker.completed++;
+
+        if (0 == --m_pending)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_idle.notify_all();
+        }
+    }
+
+    g_imagingFactory = nullptr;
+
+    if (SUCCEEDED(coInit))
+    {
+        CoUninitialize();
+    }
+}
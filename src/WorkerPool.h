@@ -0,0 +1,72 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads, one per processor by default. Each worker has its
+// own task queue and steals from the others when it runs dry. Every worker joins the
+// multithreaded apartment and owns its own imaging factory (g_imagingFactory is
+// thread local), so tasks can use WIC exactly as the UI thread does. Elements that
+// tasks create are not registered with CElementManager's root; the submitter
+// attaches them once the tasks are done.
+class CWorkerPool final
+{
+public:
+    typedef std::function<void()> Task;
+
+    explicit CWorkerPool(UINT workerCount = 0);
+    ~CWorkerPool();
+
+    CWorkerPool(const CWorkerPool &) = delete;
+    CWorkerPool &operator=(const CWorkerPool &) = delete;
+
+    void Submit(Task task);
+    // Blocks until every submitted task has run
+    void WaitIdle();
+
+    [[nodiscard]] UINT GetWorkerCount() const
+    {
+        return static_cast<UINT>(m_workers.size());
+    }
+
+    void ResetStats();
+    void GetWorkerStats(UINT worker, DWORD &tasks, double &busyMS) const;
+
+private:
+    struct Worker final
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+        std::thread thread;
+        std::atomic<DWORD> completed{};
+        std::atomic<LONGLONG> busyTicks{};
+    };
+
+    void Run(UINT index);
+    bool TakeTask(UINT index, Task &task);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    LARGE_INTEGER m_frequency{};
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::atomic<LONG> m_queued{};
+    std::atomic<LONG> m_pending{};
+    std::atomic<UINT> m_nextWorker{};
+    bool m_stop{};
+};
@@ -19,6 +19,7 @@
 #include <wincodec.h>
 #include <wincodecsdk.h>
 #include <Icm.h>
+#include <Psapi.h>
 
 #pragma warning(push)
 #pragma warning(disable: 4471) // enum forward without type
@@ -56,9 +57,19 @@ extern CAppModule _Module;
 
 #include "Interfaces.h"
 
-extern IWICImagingFactoryPtr g_imagingFactory;
+// Every thread that uses WIC owns its own factory; see CWorkerPool
+extern thread_local IWICImagingFactoryPtr g_imagingFactory;
 extern CSimpleMap<HRESULT, LPCWSTR> g_wicErrorCodes;
 
+// Rendering and saving pull pixels through WIC this many rows at a time, so the
+// working set does not grow with the height of the image
+enum { DEFAULT_BAND_HEIGHT = 256 };
+extern UINT g_bandHeight;
+
+// Decoders read files through a memory-mapped IStream (CMappedStream) unless this is
+// cleared, in which case WIC opens the files itself
+extern bool g_mappedStreams;
+
 #define IFC(c) do { result = (c); if (FAILED(result)) return result; } while(0);
 
 #define READ_WIC_STRING(f, out) do {                                    \
@@ -70,3 +81,4 @@ extern CSimpleMap<HRESULT, LPCWSTR> g_wicErrorCodes;
     } else { out = L""; } } while(0);
 
 void GetHresultString(HRESULT hr, CString &out);
+void PopulateWicErrorCodes();
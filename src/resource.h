@@ -20,13 +20,18 @@
 #define ID_FILE_UNLOAD                  32775
 #define ID_FIND_METADATA                32776
 #define ID_SHOW_ALPHA                   32777
+#define ID_FIT_TO_VIEW                  32778
+#define ID_RENDER_FULL_SIZE             32779
+#define ID_PREMULTIPLY_ALPHA            32780
+#define ID_SHOW_MORE_CHILDREN           32781
+#define ID_SHOW_THUMBNAIL_GRID          32782
 
 // Next default values for new objects
 // 
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        205
-#define _APS_NEXT_COMMAND_VALUE         32778
+#define _APS_NEXT_COMMAND_VALUE         32783
 #define _APS_NEXT_CONTROL_VALUE         1006
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
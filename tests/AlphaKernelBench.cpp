@@ -0,0 +1,101 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "AlphaKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Times every alpha kernel the processor supports over a 4 megapixel buffer that does
+// not fit in the cache, and prints the same columns as WICBench:
+//
+//   AlphaKernelBench [<iterations>]
+//
+// It uses nothing but the standard library, so the kernels can be compared on any
+// platform the tests build on.
+
+namespace
+{
+    const uint32_t PIXELS = 2048 * 2048;
+
+    double Percentile(const std::vector<double> &sorted, double percentile)
+    {
+        const size_t index = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    template <typename Kernel>
+    void Report(const wchar_t *name, const char *stage, uint32_t iterations, const Kernel &kernel)
+    {
+        std::vector<double> times;
+        double total = 0;
+
+        // The first run pages the buffers in
+        kernel();
+
+        for (uint32_t iteration = 0; iteration < iterations; iteration++)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            kernel();
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            times.push_back(ms);
+            total += ms;
+        }
+
+        std::sort(times.begin(), times.end());
+
+        const double megabytes = double(PIXELS) * 4 * iterations / (1024.0 * 1024.0);
+        std::printf("%-8ls %-8s %8u %10.3f %10.3f %10.3f %10.1f\n", name, stage, iterations,
+            Percentile(times, 50), Percentile(times, 95), Percentile(times, 99),
+            (total > 0) ? megabytes / (total / 1000.0) : 0.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const int iterations = (argc > 1) ? std::atoi(argv[1]) : 50;
+    if (iterations <= 0)
+    {
+        std::fprintf(stderr, "Usage: AlphaKernelBench [<iterations>]\n");
+        return 2;
+    }
+
+    std::vector<uint8_t> pixels(size_t(PIXELS) * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    std::vector<uint8_t> bgra(pixels.size());
+    std::vector<uint8_t> alpha(pixels.size());
+
+    std::printf("%-8s %-8s %8s %10s %10s %10s %10s\n", "Kernels", "Stage", "Samples", "p50 ms", "p95 ms", "p99 ms", "MB/s");
+
+    for (const AlphaKernelSet &kernels : GetSupportedAlphaKernels())
+    {
+        Report(kernels.name, "alpha", static_cast<uint32_t>(iterations), [&]
+        {
+            kernels.broadcast(pixels.data(), alpha.data(), PIXELS);
+        });
+
+        // The work does not depend on the colors, so each run premultiplies what the
+        // last one left
+        std::copy(pixels.begin(), pixels.end(), bgra.begin());
+        Report(kernels.name, "premult", static_cast<uint32_t>(iterations), [&]
+        {
+            kernels.premultiply(bgra.data(), alpha.data(), PIXELS);
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+#include "AlphaKernels.h"
+
+#include <cstdio>
+
+namespace
+{
+    // Every color with every alpha: pixel c * 256 + a has blue c, green 255 - c, red
+    // c ^ 0x5A and alpha a
+    std::vector<uint8_t> MakeAllPairs()
+    {
+        std::vector<uint8_t> bgra;
+        bgra.reserve(256 * 256 * 4);
+        for (uint32_t c = 0; c < 256; c++)
+        {
+            for (uint32_t a = 0; a < 256; a++)
+            {
+                bgra.push_back(static_cast<uint8_t>(c));
+                bgra.push_back(static_cast<uint8_t>(255 - c));
+                bgra.push_back(static_cast<uint8_t>(c ^ 0x5A));
+                bgra.push_back(static_cast<uint8_t>(a));
+            }
+        }
+
+        return bgra;
+    }
+}
+
+TEST_CASE(AlphaKernels, ScalarRounding)
+{
+    const std::vector<AlphaKernelSet> kernels = GetSupportedAlphaKernels();
+    CHECK(!kernels.empty());
+    if (kernels.empty())
+    {
+        return;
+    }
+
+    const AlphaKernelSet &scalar = kernels.back();
+    CHECK(std::wstring(L"scalar") == scalar.name);
+    CHECK(std::wstring(GetAlphaKernelName()) == kernels.front().name);
+
+    std::vector<uint8_t> bgra = MakeAllPairs();
+    std::vector<uint8_t> alpha(bgra.size());
+    scalar.premultiply(bgra.data(), alpha.data(), 256 * 256);
+
+    // Rounded to the nearest, and alpha kept
+    uint32_t mismatches = 0;
+    for (uint32_t c = 0; c < 256; c++)
+    {
+        for (uint32_t a = 0; a < 256; a++)
+        {
+            const uint8_t *px = bgra.data() + (c * 256 + a) * 4;
+            const uint8_t *gray = alpha.data() + (c * 256 + a) * 4;
+            mismatches += (px[0] != (c * a + 127) / 255) ? 1 : 0;
+            mismatches += (px[1] != ((255 - c) * a + 127) / 255) ? 1 : 0;
+            mismatches += (px[2] != ((c ^ 0x5A) * a + 127) / 255) ? 1 : 0;
+            mismatches += (px[3] != a) ? 1 : 0;
+            mismatches += ((gray[0] != a) || (gray[1] != a) || (gray[2] != a) || (gray[3] != a)) ? 1 : 0;
+        }
+    }
+    CHECK(0 == mismatches);
+}
+
+TEST_CASE(AlphaKernels, Equivalence)
+{
+    const std::vector<AlphaKernelSet> kernels = GetSupportedAlphaKernels();
+    const std::vector<uint8_t> pairs = MakeAllPairs();
+
+    std::vector<uint8_t> expected = pairs;
+    std::vector<uint8_t> expectedAlpha(pairs.size());
+    kernels.back().premultiply(expected.data(), expectedAlpha.data(), 256 * 256);
+
+    std::vector<uint8_t> expectedBroadcast(pairs.size());
+    kernels.back().broadcast(pairs.data(), expectedBroadcast.data(), 256 * 256);
+
+    for (const AlphaKernelSet &kernel : kernels)
+    {
+        printf("  %ls\n", kernel.name);
+
+        std::vector<uint8_t> bgra = pairs;
+        std::vector<uint8_t> alpha(pairs.size());
+        kernel.premultiply(bgra.data(), alpha.data(), 256 * 256);
+        CHECK(bgra == expected);
+        CHECK(alpha == expectedAlpha);
+
+        // Without an alpha row
+        bgra = pairs;
+        kernel.premultiply(bgra.data(), nullptr, 256 * 256);
+        CHECK(bgra == expected);
+
+        std::vector<uint8_t> broadcast(pairs.size());
+        kernel.broadcast(pairs.data(), broadcast.data(), 256 * 256);
+        CHECK(broadcast == expectedBroadcast);
+    }
+}
+
+TEST_CASE(AlphaKernels, Tails)
+{
+    const std::vector<AlphaKernelSet> kernels = GetSupportedAlphaKernels();
+    const std::vector<uint8_t> pairs = MakeAllPairs();
+
+    // Rows of every length up to two AVX2 steps and a few more, with a guard pixel after
+    // each to catch writes past the end; the broadcast reads from an odd address
+    const size_t start = 1 + 4 * 1000;
+    for (uint32_t pixels = 0; pixels <= 19; pixels++)
+    {
+        std::vector<uint8_t> expected(pairs.begin() + start, pairs.begin() + start + (pixels + 1) * 4);
+        kernels.back().premultiply(expected.data(), nullptr, pixels);
+
+        for (const AlphaKernelSet &kernel : kernels)
+        {
+            std::vector<uint8_t> bgra(pairs.begin() + start, pairs.begin() + start + (pixels + 1) * 4);
+            std::vector<uint8_t> alpha((pixels + 1) * 4, 0xEE);
+            kernel.premultiply(bgra.data(), alpha.data(), pixels);
+            CHECK(bgra == expected);
+            CHECK((0xEE == alpha[pixels * 4]) && (0xEE == alpha[pixels * 4 + 3]));
+
+            std::vector<uint8_t> broadcast((pixels + 1) * 4, 0xEE);
+            kernel.broadcast(pairs.data() + start, broadcast.data(), pixels);
+            CHECK((0xEE == broadcast[pixels * 4]) && (0xEE == broadcast[pixels * 4 + 3]));
+            CHECK((0 == pixels) || (broadcast[(pixels - 1) * 4] == pairs[start + (pixels - 1) * 4 + 3]));
+        }
+    }
+}
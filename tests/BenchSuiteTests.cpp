@@ -0,0 +1,135 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+#include "BenchSuite.h"
+#include "SyntheticCodec.h"
+
+#include <iterator>
+
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    const int32_t HRESULT_FILE_NOT_FOUND = static_cast<int32_t>(0x80070002);
+    const int32_t WINCODEC_ERR_BADHEADER = static_cast<int32_t>(0x88982F61);
+    const int32_t WINCODEC_ERR_BADIMAGE = static_cast<int32_t>(0x88982F60);
+}
+
+TEST_CASE(BenchSuite, FormatNames)
+{
+    CHECK(GetBenchFormatName(L"c:\\images\\a.PNG") == L"png");
+    CHECK(GetBenchFormatName(L"photo.jpeg") == L"jpg");
+    CHECK(GetBenchFormatName(L"photo.JPE") == L"jpg");
+    CHECK(GetBenchFormatName(L"scan.tiff") == L"tif");
+    CHECK(GetBenchFormatName(L"dir.d/noextension").empty());
+}
+
+TEST_CASE(BenchSuite, Percentiles)
+{
+    const std::vector<double> times = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+
+    CHECK(5 == GetPercentile(times, 50));
+    CHECK(10 == GetPercentile(times, 95));
+    CHECK(10 == GetPercentile(times, 99));
+    CHECK(1 == GetPercentile(times, 0));
+    CHECK(7 == GetPercentile({ 7 }, 99));
+    CHECK(0 == GetPercentile({}, 50));
+}
+
+TEST_CASE(BenchSuite, Report)
+{
+    BenchStage stage;
+    AddBenchSample(stage, 3, 1024 * 1024, 0);
+    AddBenchSample(stage, 1, 1024 * 1024, 2 * 1024 * 1024);
+    AddBenchSample(stage, 2, 2 * 1024 * 1024, 1024 * 1024);
+
+    CHECK(FormatBenchHeader() == L"Format   Stage     Samples     p50 ms     p95 ms     p99 ms       MB/s    Peak MB");
+    CHECK(FormatBenchStage(L"png", L"open", stage) == L"png      open            3       2.00       3.00       3.00      666.7        2.0");
+    CHECK((1 == stage.times.front()) && (3 == stage.times.back()));
+
+    BenchStage empty;
+    CHECK(FormatBenchStage(L"png", L"save", empty).empty());
+}
+
+TEST_CASE(BenchSuite, Run)
+{
+    CSyntheticCodec codec(L"saved.rle");
+    codec.AddImage(L"a.raw", 64, 32);
+    codec.AddImage(L"b.rle", 64, 32);
+    codec.AddFile(L"header.rle", { 'S', 'Y', 'N' });
+    codec.AddFile(L"truncated.raw", { 'S', 'Y', 'N', 'T', 64, 0, 0, 0, 32, 0, 0, 0, 0, 1, 2, 3 });
+
+    const std::vector<std::wstring> files = { L"a.raw", L"b.rle", L"missing.raw", L"header.rle", L"truncated.raw" };
+    std::map<std::wstring, BenchFormatResults> results;
+    const std::vector<BenchFailure> failures = RunBench(codec, files, 2, 3, results);
+
+    CHECK(3 == failures.size());
+    if (3 == failures.size())
+    {
+        CHECK((L"missing.raw" == failures[0].filename) && (HRESULT_FILE_NOT_FOUND == failures[0].result));
+        CHECK((L"header.rle" == failures[1].filename) && (WINCODEC_ERR_BADHEADER == failures[1].result));
+        CHECK((L"truncated.raw" == failures[2].filename) && (WINCODEC_ERR_BADIMAGE == failures[2].result));
+    }
+
+    // The runs after the warmup are recorded, and a failed file is not run again
+    CHECK(2 == results.size());
+    const BenchFormatResults &raw = results[L"raw"];
+    CHECK((3 == raw.files) && (2 == raw.failures));
+    CHECK((3 == raw.open.times.size()) && (3 == raw.render.times.size()) && (3 == raw.save.times.size()));
+    CHECK(3.0 * (13 + 64 * 32 * 4) == raw.open.bytes);
+    CHECK(3.0 * 64 * 32 * 4 == raw.render.bytes);
+    CHECK(raw.render.peakWorkingSet >= 2 * 64 * 32 * 4);
+
+    // A read for the header and one for the pixels of each recorded run; the truncated
+    // file failed during the warmup, which is not recorded
+    CHECK((3 * 2 == raw.readOperations) && (3 * (13 + 64 * 32 * 4) == raw.readBytes));
+
+    const BenchFormatResults &rle = results[L"rle"];
+    CHECK((2 == rle.files) && (1 == rle.failures) && (3 == rle.render.times.size()));
+
+    // Every save writes the same file
+    const std::vector<uint8_t> *saved = codec.GetFile(L"saved.rle");
+    CHECK((nullptr != saved) && (6.0 * saved->size() == raw.save.bytes + rle.save.bytes));
+}
+
+TEST_CASE(BenchSuite, RoundTrip)
+{
+    // Opaque pixels, which premultiplying leaves as they are: runs of white that grow
+    // past the longest run the encoder writes, each followed by a pixel of literals
+    const uint32_t width = 37, height = 20;
+    std::vector<uint8_t> pixels;
+    for (uint32_t run = 1; pixels.size() < size_t(width) * height * 4; run++)
+    {
+        pixels.insert(pixels.end(), size_t(run) * 4, 0xFF);
+        const uint8_t literal[] = { static_cast<uint8_t>(run), static_cast<uint8_t>(run * 7), static_cast<uint8_t>(run * 13), 0xFF };
+        pixels.insert(pixels.end(), std::begin(literal), std::end(literal));
+    }
+    pixels.resize(size_t(width) * height * 4);
+
+    CByteBuilder raw;
+    raw.AppendText("SYNT").AppendLE32(width).AppendLE32(height).AppendFill(0, 1);
+    raw.Append(pixels.data(), pixels.size());
+
+    // A saved file opens again and renders the same pixels
+    CSyntheticCodec codec(L"saved.rle");
+    codec.AddFile(L"a.raw", raw.Bytes());
+
+    double bytes = 0;
+    uint64_t peakWorkingSet = 0;
+    CHECK(0 == codec.Open(L"a.raw", bytes));
+    CHECK(0 == codec.Render(bytes, peakWorkingSet));
+    CHECK(codec.Pixels() == pixels);
+    CHECK(0 == codec.Save(bytes));
+    codec.Close();
+
+    CHECK(0 == codec.Open(L"saved.rle", bytes));
+    CHECK(0 == codec.Render(bytes, peakWorkingSet));
+    CHECK(codec.Pixels() == pixels);
+    codec.Close();
+}
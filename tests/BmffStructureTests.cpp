@@ -0,0 +1,207 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "StructureTests.h"
+
+using namespace StructureTests;
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    std::vector<uint8_t> Box(const char *type, const std::vector<uint8_t> &payload)
+    {
+        return CByteBuilder().AppendBE32(static_cast<uint32_t>(payload.size() + 8)).AppendText(type)
+            .Append(payload.data(), payload.size()).Bytes();
+    }
+
+    std::vector<uint8_t> FullBox(const char *type, uint8_t version, uint32_t flags, const std::vector<uint8_t> &payload)
+    {
+        return Box(type, CByteBuilder().AppendBE32((uint32_t(version) << 24) | flags).Append(payload.data(), payload.size()).Bytes());
+    }
+
+    std::vector<uint8_t> Join(std::initializer_list<std::vector<uint8_t>> parts)
+    {
+        CByteBuilder joined;
+        for (const std::vector<uint8_t> &part : parts)
+        {
+            joined.Append(part.data(), part.size());
+        }
+
+        return joined.Bytes();
+    }
+
+    std::vector<uint8_t> ItemInfo(uint16_t id, const char *type)
+    {
+        return FullBox("infe", 2, 0, CByteBuilder().AppendBE16(id).AppendBE16(0).AppendText(type).AppendFill(0, 1).Bytes());
+    }
+
+    // An image item in two extents of mdat, the Exif item that describes it, and a grid
+    // item stored in idat that uses it as a tile. Item 4 has no location.
+    std::vector<uint8_t> MakeHeif(uint8_t gridMethod = 1)
+    {
+        const std::vector<uint8_t> ftyp = Box("ftyp", CByteBuilder().AppendText("heic").AppendBE32(0).AppendText("mif1heic").Bytes());
+
+        // The Exif item starts with the offset of its TIFF header, which holds one empty IFD
+        const std::vector<uint8_t> exif = CByteBuilder().AppendBE32(0).AppendText("II").AppendLE16(42).AppendLE32(8)
+            .AppendLE16(0).AppendLE32(0).Bytes();
+        const std::vector<uint8_t> mdat = Box("mdat", Join({std::vector<uint8_t>(40, 0x77), exif}));
+        const auto imageAt = static_cast<uint32_t>(ftyp.size() + 8);
+        const auto exifAt = imageAt + 40;
+
+        const std::vector<uint8_t> iloc = FullBox("iloc", 1, 0, CByteBuilder()
+            .AppendFill(0x44, 1).AppendFill(0x00, 1).AppendBE16(3)
+            .AppendBE16(1).AppendBE16(0).AppendBE16(0).AppendBE16(2).AppendBE32(imageAt).AppendBE32(10).AppendBE32(imageAt + 10).AppendBE32(30)
+            .AppendBE16(2).AppendBE16(0).AppendBE16(0).AppendBE16(1).AppendBE32(exifAt).AppendBE32(static_cast<uint32_t>(exif.size()))
+            .AppendBE16(3).AppendBE16(gridMethod).AppendBE16(0).AppendBE16(1).AppendBE32(0).AppendBE32(8)
+            .Bytes());
+
+        const std::vector<uint8_t> meta = FullBox("meta", 0, 0, Join({
+            FullBox("hdlr", 0, 0, CByteBuilder().AppendBE32(0).AppendText("pict").AppendFill(0, 13).Bytes()),
+            FullBox("pitm", 0, 0, CByteBuilder().AppendBE16(3).Bytes()),
+            FullBox("iinf", 0, 0, Join({ CByteBuilder().AppendBE16(4).Bytes(),
+                ItemInfo(1, "hvc1"), ItemInfo(2, "Exif"), ItemInfo(3, "grid"), ItemInfo(4, "hvc1") })),
+            FullBox("iref", 0, 0, Join({
+                Box("cdsc", CByteBuilder().AppendBE16(2).AppendBE16(1).AppendBE16(1).Bytes()),
+                Box("dimg", CByteBuilder().AppendBE16(3).AppendBE16(2).AppendBE16(1).AppendBE16(1).Bytes()) })),
+            Box("iprp", Join({
+                Box("ipco", Join({
+                    FullBox("ispe", 0, 0, CByteBuilder().AppendBE32(64).AppendBE32(48).Bytes()),
+                    Box("irot", {1}) })),
+                FullBox("ipma", 0, 0, CByteBuilder().AppendBE32(1).AppendBE16(1).AppendFill(2, 1).AppendFill(0x81, 1).AppendFill(0x02, 1).Bytes()) })),
+            iloc,
+            // A grid of 2 columns and 1 row, 128x48
+            Box("idat", CByteBuilder().AppendFill(0, 2).AppendFill(0, 1).AppendFill(1, 1).AppendBE16(128).AppendBE16(48).Bytes()),
+        }));
+
+        return Join({ftyp, mdat, meta});
+    }
+
+    const StructureNode *FindItem(const StructureNode &root, const wchar_t *name)
+    {
+        const StructureNode *items = FindNode(root, L"Items");
+
+        return (nullptr != items) ? FindNode(*items, name) : nullptr;
+    }
+}
+
+TEST_CASE(BmffStructure, Boxes)
+{
+    const std::vector<uint8_t> heif = MakeHeif();
+    StructureNode root;
+
+    CHECK(ParseBmffStructure(heif.data(), heif.size(), root));
+    CHECK(root.name == L"ISO-BMFF (heic)");
+    CHECK(IsInside(root, heif.size()));
+
+    const StructureNode *ftyp = FindNode(root, L"ftyp");
+    CHECK((nullptr != ftyp) && (GetValue(*ftyp, L"CompatibleBrands") == L"mif1, heic"));
+
+    const StructureNode *iinf = FindNode(root, L"iinf");
+    CHECK((nullptr != iinf) && (4 == iinf->children.size()));
+
+    const StructureNode *rotation = FindNode(root, L"irot (property 2)");
+    CHECK((nullptr != rotation) && (GetValue(*rotation, L"Value") == L"90 degrees"));
+}
+
+TEST_CASE(BmffStructure, ItemLocations)
+{
+    const std::vector<uint8_t> heif = MakeHeif();
+    StructureNode root;
+
+    CHECK(ParseBmffStructure(heif.data(), heif.size(), root));
+
+    const StructureNode *items = FindNode(root, L"Items");
+    CHECK((nullptr != items) && (GetValue(*items, L"Count") == L"4") && (GetValue(*items, L"PrimaryItem") == L"3"));
+
+    // The item spans both of its extents
+    const StructureNode *image = FindItem(root, L"Item 1 (hvc1)");
+    CHECK(nullptr != image);
+    if (nullptr != image)
+    {
+        CHECK(2 == image->children.size());
+        CHECK(GetValue(*image, L"DataLength") == L"40");
+        CHECK(40 == image->length);
+        CHECK(GetValue(*image, L"ispe") == L"64x48");
+        CHECK(GetValue(*image, L"irot") == L"90 degrees");
+
+        const StructureNode *second = FindNode(*image, L"Extent 1");
+        CHECK((nullptr != second) && (second->offset == image->offset + 10) && (30 == second->length));
+    }
+
+    // Offsets of items stored in idat are taken from the start of its data
+    const StructureNode *grid = FindItem(root, L"Item 3 (grid) primary");
+    CHECK(nullptr != grid);
+    if (nullptr != grid)
+    {
+        CHECK(GetValue(*grid, L"GridLayout") == L"2 columns x 1 rows");
+        CHECK(GetValue(*grid, L"OutputSize") == L"128x48");
+        CHECK(GetValue(*grid, L"Tiles") == L"1, 1");
+        CHECK(heif.size() - 8 == grid->offset);
+
+        const StructureNode *extent = FindNode(*grid, L"Extent 0");
+        CHECK((nullptr != extent) && (GetValue(*extent, L"Storage") == L"idat box"));
+    }
+
+    const StructureNode *exif = FindItem(root, L"Item 2 (Exif)");
+    CHECK((nullptr != exif) && (GetValue(*exif, L"Describes") == L"1") && (nullptr != FindNode(*exif, L"IFD0")));
+
+    const StructureNode *unlocated = FindItem(root, L"Item 4 (hvc1)");
+    CHECK((nullptr != unlocated) && (GetValue(*unlocated, L"Error") == L"The item has no location"));
+}
+
+TEST_CASE(BmffStructure, UnresolvedExtents)
+{
+    // Construction method 2 builds an item from other items
+    const std::vector<uint8_t> heif = MakeHeif(2);
+    StructureNode root;
+
+    CHECK(ParseBmffStructure(heif.data(), heif.size(), root));
+
+    const StructureNode *grid = FindItem(root, L"Item 3 (grid) primary");
+    CHECK((nullptr != grid) && (GetValue(*grid, L"GridLayout").empty()));
+    if (nullptr != grid)
+    {
+        const StructureNode *extent = FindNode(*grid, L"Extent 0");
+        CHECK((nullptr != extent) && (GetValue(*extent, L"Error") == L"Extents built from other items are not resolved"));
+    }
+}
+
+TEST_CASE(BmffStructure, Truncated)
+{
+    const std::vector<uint8_t> heif = MakeHeif();
+
+    // The extents in mdat are past the end once the file is cut inside it
+    const size_t size = 40;
+    StructureNode root;
+    CHECK(ParseBmffStructure(heif.data(), size, root));
+    CHECK(IsInside(root, size));
+
+    const StructureNode *mdat = FindNode(root, L"mdat");
+    CHECK((nullptr != mdat) && (GetValue(*mdat, L"Error") == L"The box runs past its parent"));
+
+    CheckEveryPrefix(heif);
+}
+
+TEST_CASE(BmffStructure, LargeSize)
+{
+    // A 64-bit size, and a size of 0 that runs to the end of the file
+    CByteBuilder bmff;
+    bmff.AppendBE32(16).AppendText("ftypavif").AppendBE32(0);
+    bmff.AppendBE32(1).AppendText("free").AppendBE64(24).AppendFill(0, 8);
+    bmff.AppendBE32(0).AppendText("mdat").AppendFill(0, 12);
+
+    StructureNode root;
+    CHECK(ParseBmffStructure(bmff.Data(), bmff.Size(), root));
+    CHECK(0 == CountErrors(root));
+
+    const StructureNode *free = FindNode(root, L"free");
+    CHECK((nullptr != free) && (24 == free->length) && (GetValue(*free, L"DataLength") == L"8"));
+
+    const StructureNode *mdat = FindNode(root, L"mdat");
+    CHECK((nullptr != mdat) && (GetValue(*mdat, L"DataLength") == L"12"));
+}
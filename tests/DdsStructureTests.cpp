@@ -0,0 +1,311 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "StructureTests.h"
+
+#include <algorithm>
+
+using namespace StructureTests;
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDPF_RGB_ALPHA = 0x41;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDSCAPS2_POSITIVEX = 0x400;
+    const uint32_t DDSCAPS2_POSITIVEY = 0x1000;
+    const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+    struct DdsHeader
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t mipLevels;
+        const char *fourCC;
+        uint32_t caps2;
+    };
+
+    // A FourCC names the format, or else the pixels are 32-bit RGBA
+    CByteBuilder MakeHeader(const DdsHeader &header)
+    {
+        const uint32_t flags = 0x1007 | ((header.mipLevels > 1) ? 0x20000 : 0) | ((header.depth > 1) ? 0x800000 : 0);
+
+        CByteBuilder dds;
+        dds.AppendText("DDS ").AppendLE32(124).AppendLE32(flags).AppendLE32(header.height).AppendLE32(header.width);
+        dds.AppendLE32(0).AppendLE32(header.depth).AppendLE32(header.mipLevels).AppendFill(0, 44);
+        if (nullptr != header.fourCC)
+        {
+            dds.AppendLE32(32).AppendLE32(DDPF_FOURCC).AppendText(header.fourCC).AppendFill(0, 20);
+        }
+        else
+        {
+            dds.AppendLE32(32).AppendLE32(DDPF_RGB_ALPHA).AppendLE32(0).AppendLE32(32);
+            dds.AppendLE32(0x00FF0000).AppendLE32(0x0000FF00).AppendLE32(0x000000FF).AppendLE32(0xFF000000);
+        }
+        dds.AppendLE32(0x1000).AppendLE32(header.caps2).AppendFill(0, 12);
+
+        return dds;
+    }
+
+    size_t BlockBytes(uint32_t width, uint32_t height, uint32_t blockBytes)
+    {
+        return size_t(std::max(1u, (width + 3) / 4)) * std::max(1u, (height + 3) / 4) * blockBytes;
+    }
+
+    // Two cubes of BC7 with the full mip chain of a square texture
+    CByteBuilder MakeCubeArray(uint32_t size, uint32_t mipLevels)
+    {
+        CByteBuilder dds = MakeHeader({ size, size, 1, mipLevels, "DX10", 0 });
+        dds.AppendLE32(98).AppendLE32(3).AppendLE32(0x4).AppendLE32(2).AppendLE32(1);
+        for (uint32_t element = 0; element < 12; element++)
+        {
+            for (uint32_t mip = 0; mip < mipLevels; mip++)
+            {
+                dds.AppendFill(0x11, BlockBytes(size >> mip, size >> mip, 16));
+            }
+        }
+
+        return dds;
+    }
+
+    // 256x128 DXT1 with all 9 mip levels, and five bytes after them
+    CByteBuilder MakeMipChain()
+    {
+        CByteBuilder dds = MakeHeader({ 256, 128, 1, 9, "DXT1", 0 });
+        for (uint32_t mip = 0; mip < 9; mip++)
+        {
+            dds.AppendFill(0, BlockBytes(std::max(1u, 256u >> mip), std::max(1u, 128u >> mip), 8));
+        }
+        dds.AppendText("trail");
+
+        return dds;
+    }
+}
+
+TEST_CASE(DdsStructure, CubeArray)
+{
+    const CByteBuilder dds = MakeCubeArray(64, 7);
+    StructureNode root;
+
+    CHECK(ParseDdsStructure(dds.Data(), dds.Size(), root));
+    CHECK(root.name == L"DDS");
+    CHECK(GetValue(root, L"Format") == L"BC7_UNORM");
+    CHECK(GetValue(root, L"Dimension") == L"Cube map");
+    CHECK(GetValue(root, L"MipLevels") == L"7");
+    CHECK(GetValue(root, L"ArraySize") == L"2");
+    CHECK(GetValue(root, L"Faces") == L"6");
+    CHECK(0 == CountErrors(root));
+    CHECK(IsInside(root, dds.Size()));
+    CHECK(nullptr == FindNode(root, L"Trailing Data"));
+
+    const StructureNode *header = FindNode(root, L"DX10 Header");
+    CHECK((nullptr != header) && (GetValue(*header, L"DxgiFormat") == L"BC7_UNORM (98)"));
+    CHECK((nullptr != header) && (GetValue(*header, L"ResourceDimension") == L"Texture2D"));
+
+    const StructureNode *data = FindNode(root, L"Data");
+    CHECK((nullptr != data) && (GetValue(*data, L"Surfaces") == L"84"));
+
+    // Each face holds its whole mip chain; the faces of the second cube come after the first
+    const size_t faceBytes = (dds.Size() - 148) / 12;
+    const StructureNode *second = FindNode(root, L"Array Element #1");
+    CHECK(nullptr != second);
+    if (nullptr != second)
+    {
+        CHECK(6 == second->children.size());
+        CHECK(148 + 6 * faceBytes == second->offset);
+
+        const StructureNode *face = FindNode(*second, L"Face -Z");
+        CHECK((nullptr != face) && (faceBytes == face->length) && (7 == face->children.size()));
+        if (nullptr != face)
+        {
+            const StructureNode *last = FindNode(*face, L"Mip #6 (1x1)");
+            CHECK((nullptr != last) && last->ddsSurface && (11 == last->ddsArrayIndex) && (6 == last->ddsMipLevel));
+            CHECK((nullptr != last) && (16 == last->length) && (dds.Size() == last->offset + last->length));
+        }
+    }
+}
+
+TEST_CASE(DdsStructure, MipChain)
+{
+    const CByteBuilder dds = MakeMipChain();
+    StructureNode root;
+
+    CHECK(ParseDdsStructure(dds.Data(), dds.Size(), root));
+    CHECK(GetValue(root, L"Format") == L"DXT1");
+    CHECK(GetValue(root, L"Dimension") == L"Texture2D");
+    CHECK(GetValue(root, L"BlockSize") == L"8 bytes per 4x4 block");
+    CHECK(0 == CountErrors(root));
+
+    const StructureNode *data = FindNode(root, L"Data");
+    CHECK((nullptr != data) && (9 == data->children.size()));
+
+    // Levels smaller than a block still take a whole block
+    const StructureNode *level = FindNode(root, L"Mip #7 (2x1)");
+    CHECK((nullptr != level) && (8 == level->length));
+
+    const StructureNode *trailing = FindNode(root, L"Trailing Data");
+    CHECK((nullptr != trailing) && (5 == trailing->length));
+}
+
+TEST_CASE(DdsStructure, Volume)
+{
+    CByteBuilder dds = MakeHeader({ 16, 16, 4, 3, nullptr, DDSCAPS2_VOLUME });
+    dds.AppendFill(0, 16 * 16 * 4 * 4 + 8 * 8 * 4 * 2 + 4 * 4 * 4 * 1);
+
+    StructureNode root;
+    CHECK(ParseDdsStructure(dds.Data(), dds.Size(), root));
+    CHECK(GetValue(root, L"Format") == L"RGB, 32 bits");
+    CHECK(GetValue(root, L"Dimension") == L"Texture3D");
+    CHECK(GetValue(root, L"Size") == L"16x16x4");
+    CHECK(0 == CountErrors(root));
+
+    // Each mip level holds its own, halved, number of slices
+    const StructureNode *level = FindNode(root, L"Mip #1 (8x8x2)");
+    CHECK(nullptr != level);
+    if (nullptr != level)
+    {
+        CHECK(2 == level->children.size());
+        CHECK(128 + 16 * 16 * 4 * 4 == level->offset);
+
+        const StructureNode *slice = FindNode(*level, L"Slice #1");
+        CHECK((nullptr != slice) && slice->ddsSurface && (1 == slice->ddsSlice) && (1 == slice->ddsMipLevel));
+        CHECK((nullptr != slice) && (level->offset + 8 * 8 * 4 == slice->offset));
+    }
+
+    CHECK(nullptr != FindNode(root, L"Mip #2 (4x4)"));
+}
+
+TEST_CASE(DdsStructure, PartialCube)
+{
+    // The legacy header stores only the faces it names, in the usual order
+    CByteBuilder dds = MakeHeader({ 8, 8, 1, 1, nullptr, DDSCAPS2_CUBEMAP | DDSCAPS2_POSITIVEX | DDSCAPS2_POSITIVEY });
+    dds.AppendFill(0, 8 * 8 * 4 * 2);
+
+    StructureNode root;
+    CHECK(ParseDdsStructure(dds.Data(), dds.Size(), root));
+    CHECK(GetValue(root, L"Dimension") == L"Cube map");
+    CHECK(GetValue(root, L"Faces") == L"2");
+    CHECK(0 == CountErrors(root));
+
+    const StructureNode *data = FindNode(root, L"Data");
+    CHECK((nullptr != data) && (2 == data->children.size()));
+
+    const StructureNode *face = FindNode(root, L"Face +Y");
+    CHECK((nullptr != face) && (128 + 8 * 8 * 4 == face->offset));
+    CHECK(nullptr == FindNode(root, L"Face -X"));
+}
+
+TEST_CASE(DdsStructure, Truncated)
+{
+    const CByteBuilder dds = MakeMipChain();
+
+    // Inside the second mip level, which is where the layout stops
+    const size_t size = 128 + 64 * 32 * 8 + 100;
+    StructureNode root;
+    CHECK(ParseDdsStructure(dds.Data(), size, root));
+    CHECK(IsInside(root, size));
+
+    const StructureNode *data = FindNode(root, L"Data");
+    CHECK((nullptr != data) && (2 == data->children.size()));
+
+    const StructureNode *level = FindNode(root, L"Mip #1 (128x64)");
+    CHECK((nullptr != level) && (GetValue(*level, L"Error") == L"The file ends inside the mip level"));
+
+    StructureNode header;
+    CHECK(ParseDdsStructure(dds.Data(), 100, header));
+    const StructureNode *headerNode = FindNode(header, L"Header");
+    CHECK((nullptr != headerNode) && (GetValue(*headerNode, L"Error") == L"The file ends inside the header"));
+
+    // Small enough that every prefix can be parsed in a moment
+    const CByteBuilder cubes = MakeCubeArray(8, 4);
+    StructureNode dx10;
+    CHECK(ParseDdsStructure(cubes.Data(), 140, dx10));
+    const StructureNode *dx10Node = FindNode(dx10, L"DX10 Header");
+    CHECK((nullptr != dx10Node) && (GetValue(*dx10Node, L"Error") == L"The file ends inside the DX10 header"));
+
+    CheckEveryPrefix(dds.Bytes());
+    CheckEveryPrefix(cubes.Bytes());
+}
+
+TEST_CASE(DdsStructure, BadHeaders)
+{
+    // More mip levels than a 4x4 texture has
+    CByteBuilder dds = MakeHeader({ 4, 4, 1, 5, "DXT5", 0 });
+    dds.AppendFill(0, 16 * 3);
+
+    StructureNode root;
+    CHECK(ParseDdsStructure(dds.Data(), dds.Size(), root));
+    CHECK(GetValue(root, L"MipLevels") == L"3");
+    CHECK(GetValue(root, L"Error") == L"MipMapCount is larger than the mip chain of the texture");
+
+    const CByteBuilder empty = MakeHeader({ 0, 4, 1, 1, "DXT5", 0 });
+    StructureNode emptyRoot;
+    CHECK(ParseDdsStructure(empty.Data(), empty.Size(), emptyRoot));
+    CHECK(GetValue(emptyRoot, L"Error") == L"The texture has no surfaces");
+
+    const CByteBuilder unknown = MakeHeader({ 4, 4, 1, 1, "ABCD", 0 });
+    StructureNode unknownRoot;
+    CHECK(ParseDdsStructure(unknown.Data(), unknown.Size(), unknownRoot));
+    CHECK(GetValue(unknownRoot, L"Error") == L"The size of the surfaces of this format is not known");
+
+    const CByteBuilder huge = MakeHeader({ 1u << 21, 4, 1, 1, "DXT1", 0 });
+    StructureNode hugeRoot;
+    CHECK(ParseDdsStructure(huge.Data(), huge.Size(), hugeRoot));
+    CHECK(GetValue(hugeRoot, L"Error") == L"The texture is too large to lay out");
+
+    // A legacy header can claim any bit count
+    CByteBuilder wide = MakeHeader({ 4, 4, 1, 1, nullptr, 0 });
+    const uint8_t bitCount[] = { 0xF8, 0xFF, 0xFF, 0xFF };
+    wide.Patch(88, bitCount, sizeof(bitCount));
+    StructureNode wideRoot;
+    CHECK(ParseDdsStructure(wide.Data(), wide.Size(), wideRoot));
+    CHECK(GetValue(wideRoot, L"BitsPerPixel") == L"4294967288");
+    CHECK(GetValue(wideRoot, L"Error") == L"The size of the surfaces of this format is not known");
+
+    StructureNode notDds;
+    CHECK(!ParseDdsStructure(dds.Data(), 7, notDds));
+}
+
+TEST_CASE(DdsStructure, Summary)
+{
+    // A volume of 1x1 RGBA slices, with more slices than are listed
+    const uint32_t depth = 8193;
+    CByteBuilder dds = MakeHeader({ 1, 1, depth, 1, nullptr, DDSCAPS2_VOLUME });
+    dds.AppendFill(0x22, 4 * depth).AppendText("trail");
+
+    StructureNode root;
+    CHECK(ParseDdsStructure(dds.Data(), dds.Size(), root));
+    CHECK(0 == CountErrors(root));
+
+    const StructureNode *data = FindNode(root, L"Data");
+    CHECK((nullptr != data) && data->children.empty());
+    CHECK((nullptr != data) && (GetValue(*data, L"Surfaces") == L"8193"));
+    CHECK((nullptr != data) && (GetValue(*data, L"SurfaceBytes") == L"32772"));
+
+    const StructureNode *trailing = FindNode(root, L"Trailing Data");
+    CHECK((nullptr != trailing) && (128 + 4 * depth == trailing->offset) && (5 == trailing->length));
+
+    StructureNode shortRoot;
+    CHECK(ParseDdsStructure(dds.Data(), 1000, shortRoot));
+    const StructureNode *shortData = FindNode(shortRoot, L"Data");
+    CHECK((nullptr != shortData) && (GetValue(*shortData, L"Error") == L"The file ends inside the surfaces"));
+    CHECK(nullptr == FindNode(shortRoot, L"Trailing Data"));
+    CHECK(IsInside(shortRoot, 1000));
+
+    // Four billion elements of 2^20 x 2^20 R32G32B32A32 pixels
+    CByteBuilder huge = MakeHeader({ 1u << 20, 1u << 20, 1, 1, "DX10", 0 });
+    huge.AppendLE32(2).AppendLE32(3).AppendLE32(0).AppendLE32(0xFFFFFFFF).AppendLE32(0);
+
+    StructureNode hugeRoot;
+    CHECK(ParseDdsStructure(huge.Data(), huge.Size(), hugeRoot));
+    const StructureNode *hugeData = FindNode(hugeRoot, L"Data");
+    CHECK((nullptr != hugeData) && (GetValue(*hugeData, L"Surfaces") == L"4294967295"));
+    CHECK((nullptr != hugeData) && (GetValue(*hugeData, L"Error") == L"The surfaces would need more than 2^64 bytes"));
+}
@@ -0,0 +1,148 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "StructureTests.h"
+
+#include <algorithm>
+
+using namespace StructureTests;
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    void AppendSubBlocks(CByteBuilder &gif, const std::vector<uint8_t> &data)
+    {
+        for (size_t at = 0; at < data.size(); at += 255)
+        {
+            const size_t length = std::min<size_t>(255, data.size() - at);
+            gif.AppendFill(static_cast<uint8_t>(length), 1).Append(data.data() + at, length);
+        }
+        gif.AppendFill(0, 1);
+    }
+
+    void AppendImage(CByteBuilder &gif, uint16_t width, uint16_t height, uint8_t flags)
+    {
+        gif.AppendFill(0x2C, 1).AppendLE16(1).AppendLE16(2).AppendLE16(width).AppendLE16(height).AppendFill(flags, 1);
+        if (flags & 0x80)
+        {
+            gif.AppendFill(0x33, size_t(6) << (flags & 0x07));
+        }
+        gif.AppendFill(2, 1);
+        AppendSubBlocks(gif, std::vector<uint8_t>(300, 0x11));
+    }
+
+    // A looping animation of two frames; only the first has a graphic control extension
+    CByteBuilder MakeGif()
+    {
+        CByteBuilder gif;
+        gif.AppendText("GIF89a").AppendLE16(4).AppendLE16(2).AppendFill(0x81, 1).AppendFill(0, 2);
+        gif.AppendFill(0x22, 4 * 3);
+
+        gif.AppendFill(0x21, 1).AppendFill(0xFF, 1);
+        gif.AppendFill(11, 1).AppendText("NETSCAPE2.0").AppendFill(3, 1).AppendFill(1, 1).AppendLE16(0).AppendFill(0, 1);
+
+        gif.AppendFill(0x21, 1).AppendFill(0xFE, 1);
+        AppendSubBlocks(gif, CByteBuilder().AppendText("hello").Bytes());
+
+        gif.AppendFill(0x21, 1).AppendFill(0xF9, 1);
+        gif.AppendFill(4, 1).AppendFill(0x09, 1).AppendLE16(10).AppendFill(1, 1).AppendFill(0, 1);
+        AppendImage(gif, 4, 2, 0);
+
+        AppendImage(gif, 2, 1, 0xC0);
+
+        gif.AppendFill(0x3B, 1);
+
+        return gif;
+    }
+}
+
+TEST_CASE(GifStructure, Frames)
+{
+    const CByteBuilder gif = MakeGif();
+    StructureNode root;
+
+    CHECK(ParseGifStructure(gif.Data(), gif.Size(), root));
+    CHECK(root.name == L"GIF");
+    CHECK(2 == root.frameCount);
+    CHECK(GetValue(root, L"Frames") == L"2");
+    CHECK(GetValue(root, L"LoopCount") == L"Forever");
+    CHECK(0 == CountErrors(root));
+    CHECK(!root.HasErrors());
+    CHECK(IsInside(root, gif.Size()));
+
+    const StructureNode *table = FindNode(root, L"Global Color Table");
+    CHECK((nullptr != table) && (GetValue(*table, L"Entries") == L"4"));
+
+    const StructureNode *comment = FindNode(root, L"Comment Extension");
+    CHECK((nullptr != comment) && (GetValue(*comment, L"Comment") == L"hello"));
+
+    // The graphic control extension moves below the frame it applies to
+    const StructureNode *first = FindNode(root, L"Frame 0");
+    CHECK(nullptr != first);
+    if (nullptr != first)
+    {
+        CHECK(GetValue(*first, L"Delay") == L"100 ms");
+        CHECK(GetValue(*first, L"TransparentIndex") == L"1");
+        CHECK(nullptr != FindNode(*first, L"Graphic Control Extension"));
+
+        const StructureNode *data = FindNode(*first, L"Image Data");
+        CHECK((nullptr != data) && (GetValue(*data, L"SubBlocks") == L"2") && (GetValue(*data, L"DataBytes") == L"300"));
+    }
+
+    const StructureNode *second = FindNode(root, L"Frame 1");
+    CHECK((nullptr != second) && (GetValue(*second, L"Rect") == L"2x1 at 1,2"));
+    if (nullptr != second)
+    {
+        const StructureNode *descriptor = FindNode(*second, L"Image Descriptor");
+        CHECK((nullptr != descriptor) && (GetValue(*descriptor, L"Interlaced") == L"Yes"));
+        CHECK((nullptr != descriptor) && (GetValue(*descriptor, L"LocalColorTable") == L"2 entries"));
+    }
+}
+
+TEST_CASE(GifStructure, Truncated)
+{
+    const CByteBuilder gif = MakeGif();
+
+    // Inside the second frame's image data
+    StructureNode root;
+    CHECK(ParseGifStructure(gif.Data(), gif.Size() - 100, root));
+    CHECK(GetValue(root, L"Error") == L"There is no trailer");
+    CHECK(2 == root.frameCount);
+    CHECK(root.HasErrors());
+
+    const StructureNode *second = FindNode(root, L"Frame 1");
+    CHECK((nullptr != second) && (gif.Size() - 100 == second->offset + second->length));
+
+    CheckEveryPrefix(gif.Bytes());
+}
+
+TEST_CASE(GifStructure, UnknownBlock)
+{
+    CByteBuilder gif;
+    gif.AppendText("GIF87a").AppendLE16(1).AppendLE16(1).AppendFill(0, 3).AppendFill(0x99, 4);
+
+    StructureNode root;
+    CHECK(ParseGifStructure(gif.Data(), gif.Size(), root));
+
+    const StructureNode *unknown = FindNode(root, L"Unexpected data");
+    CHECK((nullptr != unknown) && (4 == unknown->length) && (GetValue(*unknown, L"Error") == L"Unknown block introducer 0x99"));
+    CHECK(root.HasErrors());
+}
+
+TEST_CASE(GifStructure, TrailingData)
+{
+    CByteBuilder gif = MakeGif();
+    gif.AppendText("extra");
+
+    StructureNode root;
+    CHECK(ParseGifStructure(gif.Data(), gif.Size(), root));
+
+    const StructureNode *trailing = FindNode(root, L"Trailing data");
+    CHECK((nullptr != trailing) && (5 == trailing->length));
+    CHECK(!root.HasErrors());
+}
@@ -0,0 +1,349 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+#include "ImageCache.h"
+
+#include <fstream>
+#include <iterator>
+#include <atomic>
+#include <random>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+    // A cache directory of its own, removed with everything in it
+    class CTemporaryDirectory
+    {
+    public:
+        explicit CTemporaryDirectory(const char *name)
+        {
+            std::random_device random;
+            m_path = std::filesystem::temp_directory_path() / (std::string("ImageCacheTests-") + name + "-" + std::to_string(random()));
+        }
+
+        ~CTemporaryDirectory()
+        {
+            std::error_code error;
+            std::filesystem::remove_all(m_path, error);
+        }
+
+        CTemporaryDirectory(const CTemporaryDirectory &) = delete;
+        CTemporaryDirectory &operator=(const CTemporaryDirectory &) = delete;
+
+        [[nodiscard]] const std::filesystem::path &Path() const
+        {
+            return m_path;
+        }
+
+    private:
+        std::filesystem::path m_path;
+    };
+
+    std::shared_ptr<CachedImageSummary> MakeSummary()
+    {
+        auto summary = std::make_shared<CachedImageSummary>();
+        summary->decoderClsid[0] = 7;
+        summary->containerFormat[15] = 9;
+        summary->frameCount = 3;
+        // A character outside the BMP is stored as a surrogate pair
+        summary->metadataReaders = { L"App1 Metadata Reader", std::wstring(L"x\U0001F600y") };
+        summary->frames.resize(2);
+        summary->frames[1].width = 640;
+        summary->frames[1].height = 480;
+        summary->frames[1].pixelFormat[3] = 0x2B;
+        summary->frames[1].metadataReaders = { L"IFD" };
+
+        return summary;
+    }
+
+    CachedThumbnail MakeThumbnail()
+    {
+        CachedThumbnail thumbnail;
+        thumbnail.width = 3;
+        thumbnail.height = 2;
+        thumbnail.embedded = true;
+        for (uint8_t i = 0; i < 24; i++)
+        {
+            thumbnail.pixels.push_back(i);
+        }
+
+        return thumbnail;
+    }
+
+    bool SameSummary(const CachedImageSummary &a, const CachedImageSummary &b)
+    {
+        if ((a.decoderClsid != b.decoderClsid) || (a.containerFormat != b.containerFormat) || (a.frameCount != b.frameCount)
+            || (a.metadataReaders != b.metadataReaders) || (a.frames.size() != b.frames.size()))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < a.frames.size(); i++)
+        {
+            if ((a.frames[i].width != b.frames[i].width) || (a.frames[i].height != b.frames[i].height)
+                || (a.frames[i].pixelFormat != b.frames[i].pixelFormat) || (a.frames[i].metadataReaders != b.frames[i].metadataReaders))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::vector<uint8_t> MakeContent(size_t size)
+    {
+        std::mt19937 random(1);
+        std::vector<uint8_t> content(size);
+        for (uint8_t &b : content)
+        {
+            b = static_cast<uint8_t>(random());
+        }
+
+        return content;
+    }
+}
+
+TEST_CASE(ImageCache, ContentHash)
+{
+    std::vector<uint8_t> content = MakeContent(500000);
+    const uint64_t hash = HashImageContent(content.data(), content.size());
+
+    CHECK(hash == HashImageContent(content.data(), content.size()));
+    CHECK(hash != HashImageContent(content.data(), content.size() - 1));
+
+    // A change inside the middle sample is seen, and one between the samples is not
+    content[250000 - 32768] ^= 1;
+    const uint64_t changed = HashImageContent(content.data(), content.size());
+    CHECK(hash != changed);
+
+    content[100000] ^= 1;
+    CHECK(changed == HashImageContent(content.data(), content.size()));
+
+    // Small files are hashed whole
+    std::vector<uint8_t> small = MakeContent(1000);
+    const uint64_t smallHash = HashImageContent(small.data(), small.size());
+    small[500] ^= 1;
+    CHECK(smallHash != HashImageContent(small.data(), small.size()));
+}
+
+TEST_CASE(ImageCache, RoundTrip)
+{
+    CTemporaryDirectory directory("RoundTrip");
+    const auto summary = MakeSummary();
+    const CachedThumbnail thumbnail = MakeThumbnail();
+    const uint64_t hash = 0x0123456789ABCDEFULL;
+
+    {
+        CImageCache cache(directory.Path());
+        CHECK(cache.Open());
+        cache.Store({ L"C:\\images\\a.jpg", 500000, 1234 }, hash, summary);
+        // A copy of the same file shares its summary
+        cache.Store({ L"C:\\images\\copy of a.jpg", 500000, 99 }, hash, nullptr);
+        CHECK(cache.StoreThumbnail(hash, thumbnail));
+        CHECK(cache.Save());
+    }
+
+    CImageCache cache(directory.Path());
+    CHECK(cache.Open());
+
+    size_t paths = 0;
+    size_t summaries = 0;
+    cache.GetStats(paths, summaries);
+    CHECK((2 == paths) && (1 == summaries));
+
+    uint64_t found = 0;
+    CHECK(CImageCache::PathState::Unchanged == cache.FindContentHash({ L"C:\\images\\copy of a.jpg", 500000, 99 }, found));
+    CHECK(hash == found);
+
+    const auto loaded = cache.FindSummary(hash);
+    CHECK((nullptr != loaded) && SameSummary(*summary, *loaded));
+    CHECK(nullptr == cache.FindSummary(hash + 1));
+
+    CachedThumbnail loadedThumbnail;
+    CHECK(cache.LoadThumbnail(hash, loadedThumbnail));
+    CHECK((3 == loadedThumbnail.width) && (2 == loadedThumbnail.height) && loadedThumbnail.embedded);
+    CHECK(loadedThumbnail.pixels == thumbnail.pixels);
+
+    cache.RemoveThumbnail(hash);
+    CHECK(!cache.LoadThumbnail(hash, loadedThumbnail));
+}
+
+TEST_CASE(ImageCache, ConcurrentThumbnails)
+{
+    // The grid's workers can store the thumbnail of the same content at once, such as
+    // for two copies of a file; each write goes through a temporary file of its own
+    CTemporaryDirectory directory("ConcurrentThumbnails");
+    CImageCache cache(directory.Path());
+    CHECK(cache.Open());
+
+    const uint64_t hash = 0x0123456789ABCDEFULL;
+    std::atomic<uint32_t> stored{};
+    std::vector<std::thread> workers;
+    for (uint32_t worker = 0; worker < 4; worker++)
+    {
+        workers.emplace_back([&cache, &stored, hash, worker]
+        {
+            // Large enough that the writes overlap
+            CachedThumbnail thumbnail;
+            thumbnail.width = 256 + worker;
+            thumbnail.height = 256;
+            thumbnail.pixels.assign(size_t(thumbnail.width) * thumbnail.height * 4, static_cast<uint8_t>(worker));
+            for (int i = 0; i < 25; i++)
+            {
+                stored += cache.StoreThumbnail(hash, thumbnail) ? 1 : 0;
+            }
+        });
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    // Every write succeeds, except that on Windows renaming over a file that is being
+    // read can fail; the one that wins is whole, and none leaves its temporary behind
+#ifdef _WIN32
+    CHECK(stored > 0);
+#else
+    CHECK(100 == stored);
+#endif
+    CachedThumbnail loaded;
+    CHECK(cache.LoadThumbnail(hash, loaded));
+    CHECK((loaded.width >= 256) && (loaded.width < 260) && (size_t(loaded.width) * loaded.height * 4 == loaded.pixels.size()));
+    CHECK(loaded.pixels.front() == loaded.width - 256);
+
+    size_t temporaries = 0;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(directory.Path()))
+    {
+        temporaries += (entry.path().extension() == ".tmp") ? 1 : 0;
+    }
+    CHECK(0 == temporaries);
+}
+
+TEST_CASE(ImageCache, PathState)
+{
+    CTemporaryDirectory directory("PathState");
+    CImageCache cache(directory.Path());
+    CHECK(cache.Open());
+
+    cache.Store({ L"/images/a.png", 100, 5 }, 42, nullptr);
+
+    // The hash is only given out while the size and time match
+    uint64_t found = 0;
+    CHECK(CImageCache::PathState::Unknown == cache.FindContentHash({ L"/images/b.png", 100, 5 }, found));
+    CHECK(0 == found);
+    CHECK(CImageCache::PathState::Changed == cache.FindContentHash({ L"/images/a.png", 100, 6 }, found));
+    CHECK(CImageCache::PathState::Changed == cache.FindContentHash({ L"/images/a.png", 101, 5 }, found));
+    CHECK(0 == found);
+    CHECK(CImageCache::PathState::Unchanged == cache.FindContentHash({ L"/images/a.png", 100, 5 }, found));
+    CHECK(42 == found);
+
+    // Storing the path again replaces what was known about it
+    cache.Store({ L"/images/a.png", 101, 6 }, 43, nullptr);
+    CHECK(CImageCache::PathState::Changed == cache.FindContentHash({ L"/images/a.png", 100, 5 }, found));
+    CHECK(CImageCache::PathState::Unchanged == cache.FindContentHash({ L"/images/a.png", 101, 6 }, found));
+    CHECK(43 == found);
+}
+
+TEST_CASE(ImageCache, CorruptIndex)
+{
+    CTemporaryDirectory directory("CorruptIndex");
+
+    {
+        CImageCache cache(directory.Path());
+        CHECK(cache.Open());
+        cache.Store({ L"a.jpg", 1, 1 }, 1, MakeSummary());
+        CHECK(cache.Save());
+    }
+
+    const std::filesystem::path index = directory.Path() / "index.bin";
+    std::vector<uint8_t> bytes;
+    {
+        std::ifstream file(index, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    CHECK(bytes.size() > 20);
+    if (bytes.size() <= 20)
+    {
+        return;
+    }
+
+    // A changed byte fails the CRC, and the whole index is dropped
+    bytes[20] ^= 0x55;
+    {
+        std::ofstream file(index, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    CImageCache cache(directory.Path());
+    CHECK(cache.Open());
+
+    size_t paths = 1;
+    size_t summaries = 1;
+    cache.GetStats(paths, summaries);
+    CHECK((0 == paths) && (0 == summaries));
+
+    uint64_t found = 0;
+    CHECK(CImageCache::PathState::Unknown == cache.FindContentHash({ L"a.jpg", 1, 1 }, found));
+
+    // The empty index replaces the corrupt one
+    CHECK(cache.Save());
+    CImageCache reopened(directory.Path());
+    CHECK(reopened.Open());
+    reopened.GetStats(paths, summaries);
+    CHECK((0 == paths) && (0 == summaries));
+}
+
+TEST_CASE(ImageCache, Deserialize)
+{
+    const auto summary = MakeSummary();
+    const std::vector<uint8_t> summaryBytes = CImageCache::SerializeSummary(*summary);
+    const std::vector<uint8_t> thumbnailBytes = CImageCache::SerializeThumbnail(MakeThumbnail());
+
+    CachedImageSummary loaded;
+    CHECK(CImageCache::DeserializeSummary(summaryBytes.data(), summaryBytes.size(), loaded) && SameSummary(*summary, loaded));
+
+    // Every shorter summary and thumbnail is rejected, as are extra bytes
+    bool anyPrefix = false;
+    for (size_t size = 0; size < summaryBytes.size(); size++)
+    {
+        anyPrefix |= CImageCache::DeserializeSummary(summaryBytes.data(), size, loaded);
+    }
+    CHECK(!anyPrefix);
+
+    std::vector<uint8_t> longer = summaryBytes;
+    longer.push_back(0);
+    CHECK(!CImageCache::DeserializeSummary(longer.data(), longer.size(), loaded));
+
+    CachedThumbnail thumbnail;
+    for (size_t size = 0; size < thumbnailBytes.size(); size++)
+    {
+        anyPrefix |= CImageCache::DeserializeThumbnail(thumbnailBytes.data(), size, thumbnail);
+    }
+    CHECK(!anyPrefix);
+
+    // A flipped bit fails the CRC
+    std::vector<uint8_t> flipped = thumbnailBytes;
+    flipped[12] ^= 1;
+    CHECK(!CImageCache::DeserializeThumbnail(flipped.data(), flipped.size(), thumbnail));
+
+    // Junk must never be read past its end, or make a huge allocation
+    std::mt19937 random(2);
+    for (int i = 0; i < 20000; i++)
+    {
+        std::vector<uint8_t> junk(random() % 200);
+        for (uint8_t &b : junk)
+        {
+            b = static_cast<uint8_t>((random() % 4 == 0) ? random() : 0);
+        }
+
+        CImageCache::DeserializeSummary(junk.data(), junk.size(), loaded);
+        CImageCache::DeserializeThumbnail(junk.data(), junk.size(), thumbnail);
+    }
+}
@@ -0,0 +1,153 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "StructureTests.h"
+
+using namespace StructureTests;
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    void AppendSegment(CByteBuilder &jpeg, uint8_t marker, const std::vector<uint8_t> &payload)
+    {
+        jpeg.AppendBE16(static_cast<uint16_t>(0xFF00 | marker)).AppendBE16(static_cast<uint16_t>(payload.size() + 2));
+        jpeg.Append(payload.data(), payload.size());
+    }
+
+    // A progressive file with two scans, the first with restart markers
+    CByteBuilder MakeJpeg()
+    {
+        CByteBuilder jpeg;
+        jpeg.AppendBE16(0xFFD8);
+
+        AppendSegment(jpeg, 0xE0, CByteBuilder().AppendText("JFIF").AppendFill(0, 1)
+            .AppendFill(1, 1).AppendFill(2, 1).AppendFill(1, 1).AppendBE16(72).AppendBE16(72).AppendFill(0, 2).Bytes());
+
+        // Table 0 holds 0 to 63 in zigzag order
+        CByteBuilder quantization;
+        quantization.AppendFill(0x00, 1);
+        for (uint8_t i = 0; i < 64; i++)
+        {
+            quantization.Append(&i, 1);
+        }
+        AppendSegment(jpeg, 0xDB, quantization.Bytes());
+
+        AppendSegment(jpeg, 0xC2, CByteBuilder().AppendFill(8, 1).AppendBE16(16).AppendBE16(32).AppendFill(1, 1)
+            .AppendFill(1, 1).AppendFill(0x11, 1).AppendFill(0, 1).Bytes());
+
+        // A DC table with two one-bit codes, and an AC table with three two-bit codes
+        CByteBuilder huffman;
+        huffman.AppendFill(0x00, 1).AppendFill(2, 1).AppendFill(0, 15).AppendFill(0, 2);
+        huffman.AppendFill(0x10, 1).AppendFill(0, 1).AppendFill(3, 1).AppendFill(0, 14).AppendFill(1, 3);
+        AppendSegment(jpeg, 0xC4, huffman.Bytes());
+
+        AppendSegment(jpeg, 0xDD, CByteBuilder().AppendBE16(4).Bytes());
+
+        const std::vector<uint8_t> scan = {1, 1, 0x00, 0, 0, 0};
+        AppendSegment(jpeg, 0xDA, scan);
+        // Stuffed 0xFF bytes and restart markers are part of the entropy-coded data; RST3
+        // comes out of sequence
+        const uint8_t entropy[] = {0x12, 0xFF, 0x00, 0x34, 0xFF, 0xD0, 0x56, 0xFF, 0xD1, 0x78, 0xFF, 0xD3, 0x9A};
+        jpeg.Append(entropy, sizeof(entropy));
+
+        AppendSegment(jpeg, 0xDA, {1, 1, 0x00, 1, 63, 0x00});
+        jpeg.AppendFill(0x42, 5);
+
+        jpeg.AppendBE16(0xFFD9);
+
+        return jpeg;
+    }
+}
+
+TEST_CASE(JpegStructure, Segments)
+{
+    const CByteBuilder jpeg = MakeJpeg();
+    StructureNode root;
+
+    CHECK(ParseJpegStructure(jpeg.Data(), jpeg.Size(), root));
+    CHECK(root.name == L"JPEG");
+    CHECK(GetValue(root, L"Scans") == L"2");
+    CHECK(GetValue(root, L"QuantizationTables") == L"1");
+    CHECK(GetValue(root, L"HuffmanTables") == L"2");
+    CHECK(GetValue(root, L"RestartInterval") == L"4");
+    CHECK(GetValue(root, L"FrameType") == L"Progressive, Huffman");
+    CHECK(GetValue(root, L"Error").empty());
+
+    const StructureNode *app = FindNode(root, L"APP0");
+    CHECK((nullptr != app) && (GetValue(*app, L"Identifier") == L"JFIF") && (GetValue(*app, L"XDensity") == L"72"));
+
+    const StructureNode *frame = FindNode(root, L"SOF2");
+    CHECK((nullptr != frame) && (GetValue(*frame, L"Width") == L"32") && (GetValue(*frame, L"Height") == L"16"));
+
+    // The zigzag order is undone
+    const StructureNode *table = FindNode(root, L"Table 0");
+    CHECK((nullptr != table) && (GetValue(*table, L"Row 0") == L"0 1 5 6 14 15 27 28"));
+
+    const StructureNode *acTable = FindNode(root, L"AC table 0");
+    CHECK((nullptr != acTable) && (GetValue(*acTable, L"Symbols") == L"3"));
+
+    CHECK(nullptr != FindNode(root, L"SOS (scan 2)"));
+}
+
+TEST_CASE(JpegStructure, RestartMarkers)
+{
+    const CByteBuilder jpeg = MakeJpeg();
+    StructureNode root;
+
+    CHECK(ParseJpegStructure(jpeg.Data(), jpeg.Size(), root));
+
+    const StructureNode *entropy = FindNode(root, L"Entropy-coded data");
+    CHECK(nullptr != entropy);
+    if (nullptr != entropy)
+    {
+        CHECK(13 == entropy->length);
+        CHECK(GetValue(*entropy, L"RestartMarkers") == L"3");
+        CHECK(3 == entropy->children.size());
+        CHECK(1 == CountErrors(*entropy));
+
+        const StructureNode *outOfSequence = FindNode(*entropy, L"RST3");
+        CHECK((nullptr != outOfSequence) && (GetValue(*outOfSequence, L"Error") == L"Restart markers are out of sequence"));
+    }
+}
+
+TEST_CASE(JpegStructure, Truncated)
+{
+    const CByteBuilder jpeg = MakeJpeg();
+
+    // Inside the second scan's entropy-coded data
+    StructureNode root;
+    CHECK(ParseJpegStructure(jpeg.Data(), jpeg.Size() - 4, root));
+    CHECK(GetValue(root, L"Error") == L"There is no EOI marker");
+    CHECK(IsInside(root, jpeg.Size() - 4));
+
+    CheckEveryPrefix(jpeg.Bytes());
+}
+
+TEST_CASE(JpegStructure, BadSegmentLength)
+{
+    CByteBuilder jpeg;
+    jpeg.AppendBE16(0xFFD8).AppendBE16(0xFFFE).AppendBE16(1).AppendBE16(0xFFD9);
+
+    StructureNode root;
+    CHECK(ParseJpegStructure(jpeg.Data(), jpeg.Size(), root));
+
+    const StructureNode *comment = FindNode(root, L"COM");
+    CHECK((nullptr != comment) && (GetValue(*comment, L"Error") == L"The segment length is less than 2"));
+}
+
+TEST_CASE(JpegStructure, TrailingImage)
+{
+    CByteBuilder jpeg = MakeJpeg();
+    jpeg.AppendBE16(0xFFD8).AppendBE16(0xFFD9);
+
+    StructureNode root;
+    CHECK(ParseJpegStructure(jpeg.Data(), jpeg.Size(), root));
+
+    const StructureNode *trailing = FindNode(root, L"Trailing data");
+    CHECK((nullptr != trailing) && (4 == trailing->length) && (GetValue(*trailing, L"Content") == L"Another JPEG image"));
+}
@@ -0,0 +1,218 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+#include "JsonRecord.h"
+
+#include <functional>
+
+namespace
+{
+    const int32_t WINCODEC_ERR_COMPONENTNOTFOUND = static_cast<int32_t>(0x88982F50);
+
+    // Stands in for the imaging factory and the element tree: it "opens" the files it
+    // knows, and writes their elements the way WICInspect's OutputElement does
+    class CStubFactory
+    {
+    public:
+        using WriteTree = std::function<void(CJsonRecordWriter &writer)>;
+
+        void AddFile(const std::wstring &filename, const WriteTree &tree)
+        {
+            m_files.push_back({ filename, tree });
+        }
+
+        // Opens one file the way WICInspect's InspectFile does, counting the calls for
+        // the text and code of a failure
+        std::wstring Inspect(const std::wstring &filename, bool includeCode, CJsonRecordWriter &writer, InspectSummary &summary)
+        {
+            const WriteTree *tree = nullptr;
+            for (const auto &file : m_files)
+            {
+                if (file.first == filename)
+                {
+                    tree = &file.second;
+                }
+            }
+
+            const int32_t result = (nullptr != tree) ? 0 : WINCODEC_ERR_COMPONENTNOTFOUND;
+            const InspectOutcome outcome = MakeInspectOutcome(result, 5, includeCode,
+                [this](int32_t failure)
+                {
+                    m_resultTexts++;
+                    return (WINCODEC_ERR_COMPONENTNOTFOUND == failure) ? L"The component cannot be found." : L"Unknown";
+                },
+                [this]()
+                {
+                    m_codes++;
+                    return L"imagingFactory->CreateDecoderFromFilename(...)";
+                });
+
+            BeginInspectRecord(writer, filename, outcome, summary);
+            if (nullptr != tree)
+            {
+                (*tree)(writer);
+            }
+
+            return writer.EndRecord();
+        }
+
+        uint32_t m_resultTexts{};
+        uint32_t m_codes{};
+
+    private:
+        std::vector<std::pair<std::wstring, WriteTree>> m_files;
+    };
+
+    void WriteDecoder(CJsonRecordWriter &writer)
+    {
+        writer.BeginSection(L"Decoder");
+        writer.AddText(L"\r\n  PNG Decoder  \r\n");
+        writer.AddText(L" \t\r\n");
+        writer.BeginKeyValues(L"Container");
+        writer.AddKeyValue(L"Frames", L"1");
+        writer.EndKeyValues();
+        writer.AddVerbatimText(L"decoder->GetFrame(0, &frame);");
+
+        writer.BeginSection(L"Frame #0");
+        writer.AddKeyValue(L"Size", L"4x2");
+        writer.EndSection();
+
+        writer.EndSection();
+    }
+}
+
+TEST_CASE(JsonRecord, Records)
+{
+    CStubFactory factory;
+    factory.AddFile(L"a.png", WriteDecoder);
+    factory.AddFile(L"empty.png", [](CJsonRecordWriter &) {});
+
+    CJsonRecordWriter writer;
+    InspectSummary summary;
+
+    CHECK(factory.Inspect(L"a.png", false, writer, summary) ==
+        L"{\"file\":\"a.png\",\"result\":\"0x00000000\",\"openMs\":5,\"items\":["
+        L"{\"section\":\"Decoder\",\"items\":["
+        L"{\"text\":\"PNG Decoder\"},"
+        L"{\"group\":\"Container\",\"key\":\"Frames\",\"value\":\"1\"},"
+        L"{\"section\":\"Frame #0\",\"items\":[{\"key\":\"Size\",\"value\":\"4x2\"}]}"
+        L"]}]}");
+
+    // A file with no elements has no items
+    CHECK(factory.Inspect(L"empty.png", false, writer, summary) ==
+        L"{\"file\":\"empty.png\",\"result\":\"0x00000000\",\"openMs\":5}");
+
+    CHECK(factory.Inspect(L"c:\\missing.xyz", true, writer, summary) ==
+        L"{\"file\":\"c:\\\\missing.xyz\",\"result\":\"0x88982F50\",\"error\":\"The component cannot be found.\","
+        L"\"code\":\"imagingFactory->CreateDecoderFromFilename(...)\",\"openMs\":5}");
+
+    // Only the failure is described, and its code is only generated when asked for
+    CHECK(factory.Inspect(L"d:\\missing.xyz", false, writer, summary) ==
+        L"{\"file\":\"d:\\\\missing.xyz\",\"result\":\"0x88982F50\",\"error\":\"The component cannot be found.\",\"openMs\":5}");
+    CHECK((2 == factory.m_resultTexts) && (1 == factory.m_codes));
+
+    CHECK((4 == summary.attempted) && (2 == summary.opened));
+    CHECK(1 == GetInspectExitCode(summary));
+    CHECK(FormatInspectSummary(summary, 1600) == L"Inspected 4 files: 2 opened, 2 failed in 1600 ms (2.5 files/s)");
+    CHECK(FormatInspectSummary(InspectSummary{}, 0) == L"Inspected 0 files: 0 opened, 0 failed in 0 ms (0.0 files/s)");
+    CHECK(0 == GetInspectExitCode(InspectSummary{ 2, 2 }));
+}
+
+TEST_CASE(JsonRecord, VerbatimText)
+{
+    CStubFactory factory;
+    factory.AddFile(L"a.png", WriteDecoder);
+
+    CJsonRecordWriter writer;
+    writer.m_includeVerbatimText = true;
+    InspectSummary summary;
+
+    const std::wstring record = factory.Inspect(L"a.png", true, writer, summary);
+    CHECK(record.find(L"{\"verbatim\":\"decoder->GetFrame(0, &frame);\"}") != std::wstring::npos);
+    CHECK(0 == GetInspectExitCode(summary));
+}
+
+TEST_CASE(JsonRecord, Escaping)
+{
+    CJsonRecordWriter writer;
+    writer.BeginRecord(L"quote\"back\\slash");
+    writer.AddRecordValue(L"control", std::wstring(L"tab\tline\nreturn\rbell\x07") + L'\0' + L"end");
+    writer.AddRecordValue(L"count", 4000000000u);
+
+    CHECK(writer.EndRecord() ==
+        L"{\"file\":\"quote\\\"back\\\\slash\",\"control\":\"tab\\tline\\nreturn\\rbell\\u0007\\u0000end\",\"count\":4000000000}");
+
+    // Characters outside ASCII are kept as they are
+    writer.BeginRecord(L"\u00e9t\u00e9.jpg");
+    CHECK(writer.EndRecord() == L"{\"file\":\"\u00e9t\u00e9.jpg\"}");
+}
+
+TEST_CASE(JsonRecord, Renders)
+{
+    InspectRender frame;
+    frame.element = L"a.png/Frame #0";
+    frame.width = 640;
+    frame.height = 480;
+    frame.renderMs = 12.5;
+    frame.setupMs = 0.25;
+    frame.decodeMs = 8;
+    frame.colorTransformMs = 1.125;
+    frame.conversionMs = 2;
+    frame.alphaMs = 1.0 / 3;
+
+    InspectRender failed;
+    failed.element = L"a.png/Thumbnail";
+    failed.result = static_cast<int32_t>(0x8007000E);
+
+    CJsonRecordWriter writer;
+    writer.BeginRecord(L"a.png");
+    writer.AddRecordValue(L"renders", std::vector<InspectRender>{ frame, failed });
+    writer.AddKeyValue(L"k", L"v");
+
+    CHECK(writer.EndRecord() ==
+        L"{\"file\":\"a.png\",\"renders\":["
+        L"{\"element\":\"a.png/Frame #0\",\"result\":\"0x00000000\",\"width\":640,\"height\":480,\"renderMs\":12.500,"
+        L"\"setupMs\":0.250,\"decodeMs\":8.000,\"colorTransformMs\":1.125,\"conversionMs\":2.000,\"alphaMs\":0.333},"
+        L"{\"element\":\"a.png/Thumbnail\",\"result\":\"0x8007000E\",\"width\":0,\"height\":0,\"renderMs\":0.000,"
+        L"\"setupMs\":0.000,\"decodeMs\":0.000,\"colorTransformMs\":0.000,\"conversionMs\":0.000,\"alphaMs\":0.000}"
+        L"],\"items\":[{\"key\":\"k\",\"value\":\"v\"}]}");
+
+    // A file with no bitmaps has an empty array
+    writer.BeginRecord(L"b.png");
+    writer.AddRecordValue(L"renders", std::vector<InspectRender>());
+    CHECK(writer.EndRecord() == L"{\"file\":\"b.png\",\"renders\":[]}");
+}
+
+TEST_CASE(JsonRecord, OpenSections)
+{
+    // A record that ends inside sections closes them, and a stray EndSection does not
+    // close the record's own items
+    CJsonRecordWriter writer;
+    writer.BeginRecord(L"a");
+    writer.BeginSection(L"outer");
+    writer.BeginSection(L"inner");
+    writer.AddText(L"x");
+    CHECK(writer.EndRecord() ==
+        L"{\"file\":\"a\",\"items\":[{\"section\":\"outer\",\"items\":[{\"section\":\"inner\",\"items\":[{\"text\":\"x\"}]}]}]}");
+
+    writer.BeginRecord(L"b");
+    writer.AddKeyValue(L"k", L"v");
+    writer.EndSection();
+    writer.EndSection();
+    writer.AddKeyValue(L"k2", L"v2");
+    CHECK(writer.EndRecord() == L"{\"file\":\"b\",\"items\":[{\"key\":\"k\",\"value\":\"v\"},{\"key\":\"k2\",\"value\":\"v2\"}]}");
+
+    // Each record starts afresh, and the group of a section ends with it
+    writer.BeginRecord(L"c");
+    writer.BeginSection(L"s");
+    writer.BeginKeyValues(L"g");
+    writer.EndSection();
+    writer.AddKeyValue(L"k", L"v");
+    CHECK(writer.EndRecord() == L"{\"file\":\"c\",\"items\":[{\"section\":\"s\",\"items\":[]},{\"key\":\"k\",\"value\":\"v\"}]}");
+}
@@ -0,0 +1,199 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+#include "MappedView.h"
+
+#include <cstring>
+#include <limits>
+
+#ifndef _WIN32
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::vector<uint8_t> MakeBytes(size_t size)
+    {
+        std::vector<uint8_t> bytes(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            bytes[i] = static_cast<uint8_t>(i * 7 + 1);
+        }
+
+        return bytes;
+    }
+}
+
+TEST_CASE(MappedView, Read)
+{
+    const std::vector<uint8_t> bytes = MakeBytes(10);
+    CMappedView view(bytes.data(), bytes.size());
+    uint8_t buffer[16] = {};
+
+    CHECK(4 == view.Read(buffer, 4));
+    CHECK((0 == memcmp(buffer, bytes.data(), 4)) && (4 == view.Position()));
+
+    // A zero-length read reads nothing, even without a buffer to read into
+    CHECK(0 == view.Read(nullptr, 0));
+    CHECK(4 == view.Position());
+
+    // A read across the end comes back short, and the next one empty
+    memset(buffer, 0xEE, sizeof(buffer));
+    CHECK(6 == view.Read(buffer, sizeof(buffer)));
+    CHECK((0 == memcmp(buffer, bytes.data() + 4, 6)) && (0xEE == buffer[6]));
+    CHECK(10 == view.Position());
+    CHECK(0 == view.Read(buffer, 1));
+    CHECK(10 == view.Position());
+
+    // Nothing at all to read
+    CMappedView empty(nullptr, 0);
+    CHECK(0 == empty.Read(buffer, sizeof(buffer)));
+    CHECK(0 == empty.Position());
+}
+
+TEST_CASE(MappedView, Seek)
+{
+    const std::vector<uint8_t> bytes = MakeBytes(10);
+    CMappedView view(bytes.data(), bytes.size());
+    uint64_t position = 0;
+    uint8_t buffer[4] = {};
+
+    CHECK(view.Seek(3, CMappedView::Origin::Start, position) && (3 == position));
+    CHECK(view.Seek(2, CMappedView::Origin::Current, position) && (5 == position));
+    CHECK(view.Seek(-1, CMappedView::Origin::End, position) && (9 == position));
+    CHECK((1 == view.Read(buffer, sizeof(buffer))) && (bytes[9] == buffer[0]));
+
+    // Past the end is allowed, and reads there return nothing
+    CHECK(view.Seek(100, CMappedView::Origin::End, position) && (110 == position));
+    CHECK(0 == view.Read(buffer, sizeof(buffer)));
+    CHECK(110 == view.Position());
+    CHECK(view.Seek(-105, CMappedView::Origin::Current, position) && (5 == position));
+    CHECK((4 == view.Read(buffer, sizeof(buffer))) && (bytes[5] == buffer[0]));
+
+    // Before the start fails and keeps the position
+    position = 77;
+    CHECK(!view.Seek(-1, CMappedView::Origin::Start, position));
+    CHECK(!view.Seek(-10, CMappedView::Origin::Current, position));
+    CHECK(!view.Seek(-11, CMappedView::Origin::End, position));
+    CHECK(!view.Seek(std::numeric_limits<int64_t>::min(), CMappedView::Origin::End, position));
+    CHECK((77 == position) && (9 == view.Position()));
+
+    CHECK(view.Seek(-10, CMappedView::Origin::End, position) && (0 == position));
+
+    // So does a position that does not fit in 63 bits
+    const int64_t largest = std::numeric_limits<int64_t>::max();
+    CHECK(view.Seek(largest, CMappedView::Origin::Start, position) && (uint64_t(largest) == position));
+    CHECK(!view.Seek(1, CMappedView::Origin::Current, position));
+    CHECK(!view.Seek(largest, CMappedView::Origin::End, position));
+    CHECK(view.Seek(0, CMappedView::Origin::Current, position) && (uint64_t(largest) == position));
+    CHECK(view.Seek(-largest, CMappedView::Origin::Current, position) && (0 == position));
+}
+
+TEST_CASE(MappedView, CopyTo)
+{
+    const std::vector<uint8_t> bytes = MakeBytes(10);
+    CMappedView view(bytes.data(), bytes.size());
+    uint64_t position = 0;
+    uint64_t read = 0;
+    uint64_t written = 0;
+
+    std::vector<uint8_t> copy;
+    size_t pieces = 0;
+    const CMappedView::CopyWriter append = [&](const uint8_t *data, uint32_t size, uint32_t &chunkWritten)
+    {
+        copy.insert(copy.end(), data, data + size);
+        chunkWritten = size;
+        pieces++;
+        return true;
+    };
+
+    CHECK(view.Seek(2, CMappedView::Origin::Start, position));
+    CHECK(view.CopyTo(3, append, read, written));
+    CHECK((3 == read) && (3 == written) && (5 == view.Position()));
+    CHECK(std::vector<uint8_t>(bytes.begin() + 2, bytes.begin() + 5) == copy);
+
+    // Only what is left is copied
+    copy.clear();
+    CHECK(view.CopyTo(UINT64_MAX, append, read, written));
+    CHECK((5 == read) && (5 == written) && (10 == view.Position()));
+    CHECK(std::vector<uint8_t>(bytes.begin() + 5, bytes.end()) == copy);
+
+    // Nothing to copy past the end, or of no length; the writer is not called
+    pieces = 0;
+    CHECK(view.Seek(4, CMappedView::Origin::End, position));
+    CHECK(view.CopyTo(10, append, read, written));
+    CHECK((0 == read) && (0 == written) && (14 == view.Position()));
+    CHECK(view.Seek(0, CMappedView::Origin::Start, position));
+    CHECK(view.CopyTo(0, append, read, written));
+    CHECK((0 == read) && (0 == written) && (0 == view.Position()));
+    CHECK(0 == pieces);
+
+    // A writer that fails after writing part of the piece stops the copy; the piece
+    // still counts as read
+    const CMappedView::CopyWriter failing = [&](const uint8_t *, uint32_t size, uint32_t &chunkWritten)
+    {
+        chunkWritten = size / 2;
+        pieces++;
+        return false;
+    };
+    CHECK(!view.CopyTo(8, failing, read, written));
+    CHECK((8 == read) && (4 == written) && (8 == view.Position()) && (1 == pieces));
+}
+
+#ifndef _WIN32
+TEST_CASE(MappedFile, Open)
+{
+    char path[] = "/tmp/MappedViewTests-XXXXXX";
+    const int descriptor = mkstemp(path);
+    CHECK(descriptor >= 0);
+    if (descriptor < 0)
+    {
+        return;
+    }
+
+    const std::vector<uint8_t> bytes = MakeBytes(70000);
+    CHECK(write(descriptor, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size()));
+    close(descriptor);
+
+    CMappedFile file;
+    CHECK(0 == file.Open(path));
+    CHECK((bytes.size() == file.Size()) && (nullptr != file.Data()));
+    CHECK((nullptr != file.Data()) && (0 == memcmp(file.Data(), bytes.data(), bytes.size())));
+
+    // The mapping outlives the name of the file
+    unlink(path);
+    CMappedView view(file.Data(), file.Size());
+    uint64_t position = 0;
+    uint8_t last = 0;
+    CHECK(view.Seek(-1, CMappedView::Origin::End, position) && (1 == view.Read(&last, 1)) && (bytes.back() == last));
+
+    file.Close();
+    CHECK((0 == file.Size()) && (nullptr == file.Data()));
+
+    // An empty file opens with nothing mapped
+    char emptyPath[] = "/tmp/MappedViewTests-XXXXXX";
+    const int emptyDescriptor = mkstemp(emptyPath);
+    CHECK(emptyDescriptor >= 0);
+    if (emptyDescriptor >= 0)
+    {
+        close(emptyDescriptor);
+        CHECK(0 == file.Open(emptyPath));
+        CHECK((0 == file.Size()) && (nullptr == file.Data()));
+        unlink(emptyPath);
+    }
+
+    CHECK(ENOENT == file.Open("/tmp/MappedViewTests-does-not-exist"));
+    CHECK(EINVAL == file.Open("/tmp"));
+    CHECK((0 == file.Size()) && (nullptr == file.Data()));
+}
+#endif
@@ -0,0 +1,124 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "StructureTests.h"
+
+using namespace StructureTests;
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    const uint8_t PngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    void AppendChunk(CByteBuilder &png, const char *type, const std::vector<uint8_t> &data)
+    {
+        const size_t start = png.Size();
+        png.AppendBE32(static_cast<uint32_t>(data.size())).AppendText(type).Append(data.data(), data.size());
+        png.AppendBE32(FileStructure::Crc32(0, png.Data() + start + 4, data.size() + 4));
+    }
+
+    CByteBuilder MakePng()
+    {
+        CByteBuilder header;
+        header.AppendBE32(16).AppendBE32(8);
+        const uint8_t format[] = {8, 6, 0, 0, 0};
+        header.Append(format, sizeof(format));
+
+        CByteBuilder png;
+        png.Append(PngSignature, sizeof(PngSignature));
+        AppendChunk(png, "IHDR", header.Bytes());
+        AppendChunk(png, "tEXt", CByteBuilder().AppendText("Title").AppendFill(0, 1).AppendText("Test").Bytes());
+        AppendChunk(png, "IDAT", std::vector<uint8_t>(20, 0x55));
+        AppendChunk(png, "IDAT", std::vector<uint8_t>(10, 0xAA));
+        AppendChunk(png, "IEND", {});
+
+        return png;
+    }
+}
+
+TEST_CASE(PngStructure, Chunks)
+{
+    const CByteBuilder png = MakePng();
+    StructureNode root;
+
+    CHECK(ParsePngStructure(png.Data(), png.Size(), root));
+    CHECK(root.name == L"PNG");
+    CHECK(GetValue(root, L"Chunks") == L"5");
+    CHECK(GetValue(root, L"InvalidCRCs") == L"0");
+    CHECK(0 == CountErrors(root));
+
+    const StructureNode *header = FindNode(root, L"IHDR");
+    CHECK((nullptr != header) && (GetValue(*header, L"Width") == L"16") && (GetValue(*header, L"Height") == L"8"));
+
+    const StructureNode *text = FindNode(root, L"tEXt");
+    CHECK((nullptr != text) && (GetValue(*text, L"Keyword") == L"Title"));
+
+    // Consecutive IDAT chunks are grouped
+    const StructureNode *data = FindNode(root, L"IDAT chunks");
+    CHECK((nullptr != data) && (2 == data->children.size()));
+}
+
+TEST_CASE(PngStructure, InvalidCrc)
+{
+    CByteBuilder png = MakePng();
+    // The last byte of the IDAT data
+    std::vector<uint8_t> bytes = png.Bytes();
+    bytes[bytes.size() - 12 - 5] ^= 0xFF;
+
+    StructureNode root;
+    CHECK(ParsePngStructure(bytes.data(), bytes.size(), root));
+    CHECK(GetValue(root, L"InvalidCRCs") == L"1");
+}
+
+TEST_CASE(PngStructure, Truncated)
+{
+    const CByteBuilder png = MakePng();
+
+    // Inside the last IDAT chunk
+    StructureNode root;
+    CHECK(ParsePngStructure(png.Data(), png.Size() - 20, root));
+    CHECK(GetValue(root, L"Error") == L"There is no IEND chunk");
+    CHECK(CountErrors(root) >= 2);
+    CHECK(IsInside(root, png.Size() - 20));
+
+    CheckEveryPrefix(png.Bytes());
+}
+
+TEST_CASE(PngStructure, TrailingData)
+{
+    CByteBuilder png = MakePng();
+    png.AppendText("trailing");
+
+    StructureNode root;
+    CHECK(ParsePngStructure(png.Data(), png.Size(), root));
+
+    const StructureNode *trailing = FindNode(root, L"Trailing data");
+    CHECK((nullptr != trailing) && (8 == trailing->length));
+}
+
+TEST_CASE(PngStructure, OversizedLength)
+{
+    CByteBuilder png;
+    png.Append(PngSignature, sizeof(PngSignature));
+    png.AppendBE32(0xFFFFFFF0).AppendText("IDAT").AppendFill(0, 16);
+
+    StructureNode root;
+    CHECK(ParsePngStructure(png.Data(), png.Size(), root));
+    CHECK(IsInside(root, png.Size()));
+
+    const StructureNode *data = FindNode(root, L"IDAT");
+    CHECK((nullptr != data) && (2 == CountErrors(*data)));
+}
+
+TEST_CASE(PngStructure, NotPng)
+{
+    const uint8_t bytes[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A};
+    StructureNode root;
+
+    CHECK(!ParsePngStructure(bytes, sizeof(bytes), root));
+}
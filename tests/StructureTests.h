@@ -0,0 +1,98 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include "FileStructure.h"
+#include "TestCheck.h"
+
+// Lookups in the trees the native parsers build
+namespace StructureTests
+{
+    // The first node named name, searched depth first below node; null if there is none
+    inline const StructureNode *FindNode(const StructureNode &node, const std::wstring &name)
+    {
+        for (const StructureNode &child : node.children)
+        {
+            if (child.name == name)
+            {
+                return &child;
+            }
+            if (const StructureNode *found = FindNode(child, name))
+            {
+                return found;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // The first value of node with the key, or an empty string
+    inline std::wstring GetValue(const StructureNode &node, const std::wstring &key)
+    {
+        for (const auto &value : node.values)
+        {
+            if (value.first == key)
+            {
+                return value.second;
+            }
+        }
+
+        return std::wstring();
+    }
+
+    // The number of Error values in the tree
+    inline size_t CountErrors(const StructureNode &node)
+    {
+        size_t count = 0;
+        for (const auto &value : node.values)
+        {
+            count += (value.first == L"Error") ? 1 : 0;
+        }
+        for (const StructureNode &child : node.children)
+        {
+            count += CountErrors(child);
+        }
+
+        return count;
+    }
+
+    // Checks that the nodes of the tree lie within size bytes, apart from the ones with
+    // an error, which may point outside of them
+    inline bool IsInside(const StructureNode &node, uint64_t size)
+    {
+        if (!FileStructure::InRange(node.offset, node.length, size) && GetValue(node, L"Error").empty())
+        {
+            return false;
+        }
+        for (const StructureNode &child : node.children)
+        {
+            if (!IsInside(child, size))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Parses every prefix of data, which must not fail or read outside of it
+    inline void CheckEveryPrefix(const std::vector<uint8_t> &data)
+    {
+        for (size_t size = 0; size < data.size(); size++)
+        {
+            // A copy of exactly size bytes, so that reading past it is caught by sanitizers
+            std::vector<uint8_t> prefix(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(size));
+            StructureNode root;
+            if (ParseFileStructure(prefix.data(), prefix.size(), root))
+            {
+                CHECK(IsInside(root, size));
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "BenchSuite.h"
+#include "SyntheticCodec.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Runs WICBench's open, render and save loop over the synthetic codec, which needs
+// neither WIC nor any images, and prints the same report:
+//
+//   SyntheticBench [<iterations>] [<width>x<height>]
+//
+// The bitmap is the one WICBench's /synthetic generates, stored raw and run-length
+// encoded, so that runs on different commits or machines measure the same work.
+
+int main(int argc, char *argv[])
+{
+    const int iterations = (argc > 1) ? std::atoi(argv[1]) : 10;
+    unsigned width = 1024, height = 1024;
+    if ((iterations <= 0) || ((argc > 2) && ((2 != std::sscanf(argv[2], "%ux%u", &width, &height)) ||
+        (0 == width) || (0 == height) || (width > 0x4000) || (height > 0x4000))))
+    {
+        std::fprintf(stderr, "Usage: SyntheticBench [<iterations>] [<width>x<height>]\n");
+        return 2;
+    }
+
+    CSyntheticCodec codec(L"saved.rle");
+    const std::vector<std::wstring> files = { L"synthetic.raw", L"synthetic.rle" };
+    for (const std::wstring &file : files)
+    {
+        codec.AddImage(file, width, height);
+    }
+
+    const uint32_t warmup = 1;
+    std::map<std::wstring, BenchFormatResults> results;
+    const std::vector<BenchFailure> failures = RunBench(codec, files, warmup, static_cast<uint32_t>(iterations), results);
+
+    for (const BenchFailure &failure : failures)
+    {
+        std::fprintf(stderr, "%ls: 0x%.8X\n", failure.filename.c_str(), static_cast<unsigned>(failure.result));
+    }
+
+    std::printf("%u files of %ux%u, %d iterations after %u warmup\n\n", static_cast<unsigned>(files.size()), width, height,
+        iterations, warmup);
+    std::printf("%ls\n", FormatBenchHeader().c_str());
+
+    const auto report = [](const std::wstring &format, const wchar_t *stage, BenchStage &samples)
+    {
+        const std::wstring line = FormatBenchStage(format, stage, samples);
+        if (!line.empty())
+        {
+            std::printf("%ls\n", line.c_str());
+        }
+    };
+
+    for (auto &entry : results)
+    {
+        report(entry.first, L"open", entry.second.open);
+        report(entry.first, L"render", entry.second.render);
+        report(entry.first, L"save", entry.second.save);
+    }
+
+    return failures.empty() ? 0 : 1;
+}
@@ -0,0 +1,286 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "SyntheticCodec.h"
+
+#include "AlphaKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const int32_t E_FAIL = static_cast<int32_t>(0x80004005);
+    const int32_t HRESULT_FILE_NOT_FOUND = static_cast<int32_t>(0x80070002);
+    const int32_t WINCODEC_ERR_BADHEADER = static_cast<int32_t>(0x88982F61);
+    const int32_t WINCODEC_ERR_BADIMAGE = static_cast<int32_t>(0x88982F60);
+
+    const size_t HEADER_BYTES = 13;
+    const uint8_t COMPRESSION_NONE = 0;
+    const uint8_t COMPRESSION_RLE = 1;
+
+    uint32_t ReadLE32(const uint8_t *p)
+    {
+        return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+    }
+
+    void AppendLE32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            out.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    bool HasExtension(const std::wstring &filename, const wchar_t *extension)
+    {
+        const size_t length = std::wcslen(extension);
+
+        return (filename.size() >= length) && (0 == filename.compare(filename.size() - length, length, extension));
+    }
+
+    // Runs of 2 to 129 equal bytes are a byte of 126 + count and the value; anything
+    // else goes in literals of up to 128 bytes, a byte of count - 1 and the bytes
+    void AppendRle(std::vector<uint8_t> &out, const std::vector<uint8_t> &in)
+    {
+        size_t i = 0;
+        while (i < in.size())
+        {
+            size_t run = 1;
+            while ((i + run < in.size()) && (run < 129) && (in[i + run] == in[i]))
+            {
+                run++;
+            }
+
+            if (run >= 2)
+            {
+                out.push_back(static_cast<uint8_t>(126 + run));
+                out.push_back(in[i]);
+                i += run;
+                continue;
+            }
+
+            size_t literal = 1;
+            while ((i + literal < in.size()) && (literal < 128) &&
+                ((i + literal + 1 >= in.size()) || (in[i + literal] != in[i + literal + 1])))
+            {
+                literal++;
+            }
+
+            out.push_back(static_cast<uint8_t>(literal - 1));
+            out.insert(out.end(), in.begin() + static_cast<std::ptrdiff_t>(i), in.begin() + static_cast<std::ptrdiff_t>(i + literal));
+            i += literal;
+        }
+    }
+
+    bool DecodeRle(const uint8_t *data, size_t size, std::vector<uint8_t> &out)
+    {
+        size_t written = 0;
+        size_t i = 0;
+        while ((i < size) && (written < out.size()))
+        {
+            const uint8_t control = data[i++];
+            if (control < 128)
+            {
+                const size_t count = size_t(control) + 1;
+                if ((count > size - i) || (count > out.size() - written))
+                {
+                    return false;
+                }
+                std::memcpy(out.data() + written, data + i, count);
+                i += count;
+                written += count;
+            }
+            else
+            {
+                const size_t count = size_t(control) - 126;
+                if ((i >= size) || (count > out.size() - written))
+                {
+                    return false;
+                }
+                std::memset(out.data() + written, data[i++], count);
+                written += count;
+            }
+        }
+
+        return (written == out.size()) && (i == size);
+    }
+
+    std::vector<uint8_t> Encode(uint32_t width, uint32_t height, const std::vector<uint8_t> &pixels, bool rle)
+    {
+        std::vector<uint8_t> file = { 'S', 'Y', 'N', 'T' };
+        AppendLE32(file, width);
+        AppendLE32(file, height);
+        file.push_back(rle ? COMPRESSION_RLE : COMPRESSION_NONE);
+
+        if (rle)
+        {
+            AppendRle(file, pixels);
+        }
+        else
+        {
+            file.insert(file.end(), pixels.begin(), pixels.end());
+        }
+
+        return file;
+    }
+}
+
+CSyntheticCodec::CSyntheticCodec(const std::wstring &saveFilename)
+    : m_saveFilename(saveFilename)
+{
+}
+
+void CSyntheticCodec::AddImage(const std::wstring &filename, uint32_t width, uint32_t height)
+{
+    std::vector<uint8_t> pixels(size_t(width) * height * 4);
+
+    // The noise is seeded the same on every run
+    uint32_t seed = 1;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        uint8_t *row = pixels.data() + size_t(width) * 4 * y;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            const uint32_t noise = (seed >> 24) & 0x1F;
+
+            row[x*4+0] = static_cast<uint8_t>((x * 255 / std::max(1u, width - 1) + noise) & 0xFF);
+            row[x*4+1] = static_cast<uint8_t>((y * 255 / std::max(1u, height - 1) + noise) & 0xFF);
+            row[x*4+2] = static_cast<uint8_t>(((x + y) & 0xFF) ^ noise);
+            row[x*4+3] = static_cast<uint8_t>(255 - ((x ^ y) & 0x7F));
+        }
+    }
+
+    m_files[filename] = Encode(width, height, pixels, HasExtension(filename, L".rle"));
+}
+
+void CSyntheticCodec::AddFile(const std::wstring &filename, const std::vector<uint8_t> &bytes)
+{
+    m_files[filename] = bytes;
+}
+
+const std::vector<uint8_t> *CSyntheticCodec::GetFile(const std::wstring &filename) const
+{
+    const auto found = m_files.find(filename);
+
+    return (found != m_files.end()) ? &found->second : nullptr;
+}
+
+int32_t CSyntheticCodec::Open(const std::wstring &filename, double &bytes)
+{
+    m_open = GetFile(filename);
+    if (nullptr == m_open)
+    {
+        return HRESULT_FILE_NOT_FOUND;
+    }
+
+    bytes = double(m_open->size());
+
+    m_readOperations++;
+    m_readBytes += std::min(m_open->size(), HEADER_BYTES);
+
+    if ((m_open->size() < HEADER_BYTES) || (0 != std::memcmp(m_open->data(), "SYNT", 4)))
+    {
+        return WINCODEC_ERR_BADHEADER;
+    }
+
+    m_width = ReadLE32(m_open->data() + 4);
+    m_height = ReadLE32(m_open->data() + 8);
+    m_compression = (*m_open)[12];
+
+    // Large enough for any benchmark, and small enough that the pixel count fits in 32 bits
+    if ((0 == m_width) || (0 == m_height) || (m_width > 0x4000) || (m_height > 0x4000) || (m_compression > COMPRESSION_RLE))
+    {
+        return WINCODEC_ERR_BADHEADER;
+    }
+
+    return 0;
+}
+
+int32_t CSyntheticCodec::PrepareRender()
+{
+    return 0;
+}
+
+int32_t CSyntheticCodec::Render(double &bytes, uint64_t &peakWorkingSet)
+{
+    const uint8_t *data = m_open->data() + HEADER_BYTES;
+    const size_t size = m_open->size() - HEADER_BYTES;
+
+    m_readOperations++;
+    m_readBytes += size;
+
+    const uint32_t pixels = m_width * m_height;
+    m_pixels.assign(size_t(pixels) * 4, 0);
+    m_alpha.assign(m_pixels.size(), 0);
+
+    if (COMPRESSION_RLE == m_compression)
+    {
+        if (!DecodeRle(data, size, m_pixels))
+        {
+            return WINCODEC_ERR_BADIMAGE;
+        }
+    }
+    else
+    {
+        if (size != m_pixels.size())
+        {
+            return WINCODEC_ERR_BADIMAGE;
+        }
+        std::memcpy(m_pixels.data(), data, size);
+    }
+
+    PremultiplyAlpha(m_pixels.data(), m_alpha.data(), pixels);
+
+    bytes = double(m_pixels.size());
+    peakWorkingSet = GetWorkingSet();
+
+    return 0;
+}
+
+int32_t CSyntheticCodec::Save(double &bytes)
+{
+    if (m_pixels.empty())
+    {
+        return E_FAIL;
+    }
+
+    std::vector<uint8_t> &saved = m_files[m_saveFilename];
+    saved = Encode(m_width, m_height, m_pixels, HasExtension(m_saveFilename, L".rle"));
+
+    bytes = double(saved.size());
+
+    return 0;
+}
+
+void CSyntheticCodec::Close()
+{
+    m_open = nullptr;
+    m_pixels.clear();
+    m_pixels.shrink_to_fit();
+    m_alpha.clear();
+    m_alpha.shrink_to_fit();
+}
+
+uint64_t CSyntheticCodec::GetWorkingSet()
+{
+    uint64_t bytes = m_pixels.capacity() + m_alpha.capacity();
+    for (const auto &file : m_files)
+    {
+        bytes += file.second.capacity();
+    }
+
+    return bytes;
+}
+
+void CSyntheticCodec::GetReadCounters(uint64_t &operations, uint64_t &bytes)
+{
+    operations = m_readOperations;
+    bytes = m_readBytes;
+}
@@ -0,0 +1,64 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include "BenchSuite.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// A codec for the benchmark suite that needs neither WIC nor files on disk, so that the
+// suite runs on any platform and measures the same work on every commit. Its files are
+// kept in memory: "SYNT", the width and height, a compression byte and the BGRA
+// pixels, either as they are (.raw) or run-length encoded (.rle). Rendering decodes
+// the pixels and premultiplies them with the alpha kernels, as the alpha view does.
+class CSyntheticCodec final : public IBenchCodec
+{
+public:
+    explicit CSyntheticCodec(const std::wstring &saveFilename);
+
+    // Encodes the same gradients with noise that WICBench's /synthetic generates
+    void AddImage(const std::wstring &filename, uint32_t width, uint32_t height);
+    // Adds a file with the given content, such as a damaged one
+    void AddFile(const std::wstring &filename, const std::vector<uint8_t> &bytes);
+    // Null for a file that does not exist
+    [[nodiscard]] const std::vector<uint8_t> *GetFile(const std::wstring &filename) const;
+    // The pixels of the last render, top-down premultiplied BGRA
+    [[nodiscard]] const std::vector<uint8_t> &Pixels() const
+    {
+        return m_pixels;
+    }
+
+    int32_t Open(const std::wstring &filename, double &bytes) override;
+    int32_t PrepareRender() override;
+    int32_t Render(double &bytes, uint64_t &peakWorkingSet) override;
+    int32_t Save(double &bytes) override;
+    void Close() override;
+
+    // The bytes of every file and buffer the codec holds
+    uint64_t GetWorkingSet() override;
+    // A read for the header of each opened file, and one for the pixels of each render
+    void GetReadCounters(uint64_t &operations, uint64_t &bytes) override;
+
+private:
+    std::map<std::wstring, std::vector<uint8_t>> m_files;
+    std::wstring m_saveFilename;
+
+    const std::vector<uint8_t> *m_open{};
+    uint32_t m_width{};
+    uint32_t m_height{};
+    uint8_t m_compression{};
+    std::vector<uint8_t> m_pixels;
+    std::vector<uint8_t> m_alpha;
+
+    uint64_t m_readOperations{};
+    uint64_t m_readBytes{};
+};
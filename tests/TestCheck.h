@@ -0,0 +1,83 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A small test runner for the sources that use nothing but the standard library, so
+// that they are tested on every platform without a test framework. Tests register
+// themselves with TEST_CASE and are run by suite; a failed CHECK is reported and the
+// test goes on, so that one run shows every failure.
+namespace TestCheck
+{
+    using TestFunction = void (*)();
+
+    struct TestCase
+    {
+        const char *suite;
+        const char *name;
+        TestFunction function;
+    };
+
+    std::vector<TestCase> &GetTests();
+    bool Register(const char *suite, const char *name, TestFunction function);
+    void Fail(const char *file, int line, const char *expression);
+
+    // Builds the bytes of a fixture, in either byte order
+    class CByteBuilder
+    {
+    public:
+        CByteBuilder &Append(const void *data, size_t size);
+        CByteBuilder &AppendText(const char *text);
+        CByteBuilder &AppendFill(uint8_t value, size_t count);
+        CByteBuilder &AppendBE16(uint16_t value);
+        CByteBuilder &AppendBE32(uint32_t value);
+        CByteBuilder &AppendBE64(uint64_t value);
+        CByteBuilder &AppendLE16(uint16_t value);
+        CByteBuilder &AppendLE32(uint32_t value);
+        CByteBuilder &AppendLE64(uint64_t value);
+        // Overwrites bytes that were already appended
+        void Patch(size_t offset, const void *data, size_t size);
+
+        [[nodiscard]] size_t Size() const
+        {
+            return m_bytes.size();
+        }
+
+        [[nodiscard]] const uint8_t *Data() const
+        {
+            return m_bytes.data();
+        }
+
+        [[nodiscard]] const std::vector<uint8_t> &Bytes() const
+        {
+            return m_bytes;
+        }
+
+    private:
+        std::vector<uint8_t> m_bytes;
+    };
+}
+
+#define TEST_CASE(suite, name) \
+    static void suite##_##name(); \
+    static const bool suite##_##name##_registered = TestCheck::Register(#suite, #name, suite##_##name); \
+    static void suite##_##name()
+
+#define CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) \
+        { \
+            TestCheck::Fail(__FILE__, __LINE__, #expression); \
+        } \
+    } while (false)
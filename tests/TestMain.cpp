@@ -0,0 +1,141 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    int g_failures = 0;
+}
+
+namespace TestCheck
+{
+    std::vector<TestCase> &GetTests()
+    {
+        // Built on first use, since tests register themselves from other files' statics
+        static std::vector<TestCase> tests;
+
+        return tests;
+    }
+
+    bool Register(const char *suite, const char *name, TestFunction function)
+    {
+        GetTests().push_back({suite, name, function});
+
+        return true;
+    }
+
+    void Fail(const char *file, int line, const char *expression)
+    {
+        std::printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+        g_failures++;
+    }
+
+    CByteBuilder &CByteBuilder::Append(const void *data, size_t size)
+    {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        m_bytes.insert(m_bytes.end(), bytes, bytes + size);
+
+        return *this;
+    }
+
+    CByteBuilder &CByteBuilder::AppendText(const char *text)
+    {
+        return Append(text, std::strlen(text));
+    }
+
+    CByteBuilder &CByteBuilder::AppendFill(uint8_t value, size_t count)
+    {
+        m_bytes.insert(m_bytes.end(), count, value);
+
+        return *this;
+    }
+
+    CByteBuilder &CByteBuilder::AppendBE16(uint16_t value)
+    {
+        m_bytes.push_back(static_cast<uint8_t>(value >> 8));
+        m_bytes.push_back(static_cast<uint8_t>(value));
+
+        return *this;
+    }
+
+    CByteBuilder &CByteBuilder::AppendBE32(uint32_t value)
+    {
+        AppendBE16(static_cast<uint16_t>(value >> 16));
+
+        return AppendBE16(static_cast<uint16_t>(value));
+    }
+
+    CByteBuilder &CByteBuilder::AppendBE64(uint64_t value)
+    {
+        AppendBE32(static_cast<uint32_t>(value >> 32));
+
+        return AppendBE32(static_cast<uint32_t>(value));
+    }
+
+    CByteBuilder &CByteBuilder::AppendLE16(uint16_t value)
+    {
+        m_bytes.push_back(static_cast<uint8_t>(value));
+        m_bytes.push_back(static_cast<uint8_t>(value >> 8));
+
+        return *this;
+    }
+
+    CByteBuilder &CByteBuilder::AppendLE32(uint32_t value)
+    {
+        AppendLE16(static_cast<uint16_t>(value));
+
+        return AppendLE16(static_cast<uint16_t>(value >> 16));
+    }
+
+    CByteBuilder &CByteBuilder::AppendLE64(uint64_t value)
+    {
+        AppendLE32(static_cast<uint32_t>(value));
+
+        return AppendLE32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void CByteBuilder::Patch(size_t offset, const void *data, size_t size)
+    {
+        std::memcpy(m_bytes.data() + offset, data, size);
+    }
+}
+
+// Runs the tests of the suite named on the command line, or all of them
+int main(int argc, char *argv[])
+{
+    const char *suite = (argc > 1) ? argv[1] : nullptr;
+    int run = 0;
+
+    for (const TestCheck::TestCase &test : TestCheck::GetTests())
+    {
+        if ((nullptr != suite) && (0 != std::strcmp(suite, test.suite)))
+        {
+            continue;
+        }
+
+        const int failures = g_failures;
+        test.function();
+        run++;
+
+        std::printf("%s %s.%s\n", (failures == g_failures) ? "passed" : "FAILED", test.suite, test.name);
+    }
+
+    if (0 == run)
+    {
+        std::printf("No tests in suite %s\n", (nullptr != suite) ? suite : "(all)");
+        return 1;
+    }
+
+    std::printf("%d tests, %d failed checks\n", run, g_failures);
+
+    return (0 == g_failures) ? 0 : 1;
+}
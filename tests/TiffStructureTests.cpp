@@ -0,0 +1,357 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "StructureTests.h"
+
+using namespace StructureTests;
+using TestCheck::CByteBuilder;
+
+namespace
+{
+    enum : uint16_t { TypeAscii = 2, TypeShort = 3, TypeLong = 4, TypeUndefined = 7 };
+
+    struct Entry
+    {
+        uint16_t tag;
+        uint16_t type;
+        uint32_t count;
+        // In the file's byte order; stored after the IFD when it does not fit in the entry
+        std::vector<uint8_t> value;
+    };
+
+    // Lays out TIFF and BigTIFF files in either byte order, one IFD after another
+    class CTiffBuilder
+    {
+    public:
+        CTiffBuilder(bool bigEndian, bool bigTiff) :
+            m_bigEndian(bigEndian),
+            m_bigTiff(bigTiff)
+        {
+            m_file.AppendText(bigEndian ? "MM" : "II");
+            Append16(m_file, bigTiff ? 43 : 42);
+            if (bigTiff)
+            {
+                // The offset size and a reserved 0
+                Append16(m_file, 8);
+                Append16(m_file, 0);
+            }
+            AppendOffset(m_file, 0);
+        }
+
+        std::vector<uint8_t> Short(uint16_t value) const
+        {
+            CByteBuilder bytes;
+            Append16(bytes, value);
+
+            return bytes.Bytes();
+        }
+
+        std::vector<uint8_t> Long(std::initializer_list<uint32_t> values) const
+        {
+            CByteBuilder bytes;
+            for (const uint32_t value : values)
+            {
+                Append32(bytes, value);
+            }
+
+            return bytes.Bytes();
+        }
+
+        size_t GetSize() const
+        {
+            return m_file.Size();
+        }
+
+        void AppendData(const std::vector<uint8_t> &data)
+        {
+            m_file.Append(data.data(), data.size());
+        }
+
+        // Returns the offset of the IFD
+        uint32_t AddIfd(const std::vector<Entry> &entries)
+        {
+            const size_t ifdAt = m_file.Size();
+            const size_t entrySize = m_bigTiff ? 20 : 12;
+            const size_t valueSize = m_bigTiff ? 8 : 4;
+
+            if (m_bigTiff)
+            {
+                Append64(m_file, entries.size());
+            }
+            else
+            {
+                Append16(m_file, static_cast<uint16_t>(entries.size()));
+            }
+
+            size_t valuesAt = m_file.Size() + entries.size() * entrySize + valueSize;
+            for (const Entry &entry : entries)
+            {
+                Append16(m_file, entry.tag);
+                Append16(m_file, entry.type);
+                if (m_bigTiff)
+                {
+                    Append64(m_file, entry.count);
+                }
+                else
+                {
+                    Append32(m_file, entry.count);
+                }
+
+                if (entry.value.size() <= valueSize)
+                {
+                    m_file.Append(entry.value.data(), entry.value.size()).AppendFill(0, valueSize - entry.value.size());
+                }
+                else
+                {
+                    AppendOffset(m_file, valuesAt);
+                    valuesAt += entry.value.size();
+                }
+            }
+            AppendOffset(m_file, 0);
+
+            for (const Entry &entry : entries)
+            {
+                if (entry.value.size() > valueSize)
+                {
+                    m_file.Append(entry.value.data(), entry.value.size());
+                }
+            }
+
+            return static_cast<uint32_t>(ifdAt);
+        }
+
+        void SetFirstIfd(uint32_t offset)
+        {
+            PatchOffset(m_bigTiff ? 8 : 4, offset);
+        }
+
+        void SetNextIfd(uint32_t ifd, uint32_t next)
+        {
+            const std::vector<uint8_t> &bytes = m_file.Bytes();
+            const uint64_t count = m_bigTiff ? Read(bytes, ifd, 8) : Read(bytes, ifd, 2);
+            PatchOffset(ifd + (m_bigTiff ? 8 + count * 20 : 2 + count * 12), next);
+        }
+
+        const std::vector<uint8_t> &Bytes() const
+        {
+            return m_file.Bytes();
+        }
+
+    private:
+        void AppendValue(CByteBuilder &bytes, uint64_t value, size_t size) const
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                const size_t shift = 8 * (m_bigEndian ? size - 1 - i : i);
+                const auto byte = static_cast<uint8_t>(value >> shift);
+                bytes.Append(&byte, 1);
+            }
+        }
+
+        void Append16(CByteBuilder &bytes, uint16_t value) const
+        {
+            AppendValue(bytes, value, 2);
+        }
+
+        void Append32(CByteBuilder &bytes, uint32_t value) const
+        {
+            AppendValue(bytes, value, 4);
+        }
+
+        void Append64(CByteBuilder &bytes, uint64_t value) const
+        {
+            AppendValue(bytes, value, 8);
+        }
+
+        void AppendOffset(CByteBuilder &bytes, uint64_t value) const
+        {
+            AppendValue(bytes, value, m_bigTiff ? 8 : 4);
+        }
+
+        uint64_t Read(const std::vector<uint8_t> &bytes, size_t at, size_t size) const
+        {
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; i++)
+            {
+                const size_t shift = 8 * (m_bigEndian ? size - 1 - i : i);
+                value |= uint64_t(bytes[at + i]) << shift;
+            }
+
+            return value;
+        }
+
+        void PatchOffset(uint64_t at, uint64_t value)
+        {
+            CByteBuilder bytes;
+            AppendOffset(bytes, value);
+            m_file.Patch(static_cast<size_t>(at), bytes.Data(), bytes.Size());
+        }
+
+        bool m_bigEndian;
+        bool m_bigTiff;
+        CByteBuilder m_file;
+    };
+
+    std::vector<uint8_t> Text(const char *text)
+    {
+        return CByteBuilder().AppendText(text).AppendFill(0, 1).Bytes();
+    }
+
+    // Two frames; the first has two strips and an Exif IFD
+    CTiffBuilder MakeTiff(bool bigEndian, bool bigTiff)
+    {
+        CTiffBuilder tiff(bigEndian, bigTiff);
+
+        const auto stripsAt = static_cast<uint32_t>(tiff.GetSize());
+        tiff.AppendData(std::vector<uint8_t>(100, 0xAA));
+
+        const uint32_t exif = tiff.AddIfd({
+            { 0x9000, TypeUndefined, 4, {'0', '2', '3', '2'} },
+        });
+
+        const uint32_t ifd0 = tiff.AddIfd({
+            { 0x0100, TypeShort, 1, tiff.Short(10) },
+            { 0x0101, TypeShort, 1, tiff.Short(10) },
+            { 0x010F, TypeAscii, 6, Text("Maker") },
+            { 0x0111, TypeLong, 2, tiff.Long({stripsAt, stripsAt + 50}) },
+            { 0x0117, TypeLong, 2, tiff.Long({50, 50}) },
+            { 0x8769, TypeLong, 1, tiff.Long({exif}) },
+        });
+
+        const uint32_t ifd1 = tiff.AddIfd({
+            { 0x0100, TypeShort, 1, tiff.Short(5) },
+        });
+
+        tiff.SetFirstIfd(ifd0);
+        tiff.SetNextIfd(ifd0, ifd1);
+
+        return tiff;
+    }
+
+    void CheckTiff(const std::vector<uint8_t> &bytes, const wchar_t *name)
+    {
+        StructureNode root;
+
+        CHECK(ParseTiffStructure(bytes.data(), bytes.size(), root));
+        CHECK(root.name == name);
+        CHECK(GetValue(root, L"IFDs") == L"2");
+        CHECK(0 == CountErrors(root));
+
+        const StructureNode *make = FindNode(root, L"0x010F Make");
+        CHECK((nullptr != make) && (GetValue(*make, L"Value") == L"Maker"));
+
+        const StructureNode *strips = FindNode(root, L"Strips");
+        CHECK((nullptr != strips) && (GetValue(*strips, L"Count") == L"2") && (GetValue(*strips, L"TotalBytes") == L"100"));
+
+        const StructureNode *exif = FindNode(root, L"Exif IFD");
+        CHECK((nullptr != exif) && (exif->metadataQuery == L"/ifd/exif"));
+
+        const StructureNode *ifd1 = FindNode(root, L"IFD1");
+        CHECK((nullptr != ifd1) && (1 == ifd1->metadataFrame));
+    }
+}
+
+TEST_CASE(TiffStructure, LittleEndian)
+{
+    CheckTiff(MakeTiff(false, false).Bytes(), L"TIFF");
+}
+
+TEST_CASE(TiffStructure, BigEndian)
+{
+    CheckTiff(MakeTiff(true, false).Bytes(), L"TIFF");
+}
+
+TEST_CASE(TiffStructure, BigTiff)
+{
+    CheckTiff(MakeTiff(false, true).Bytes(), L"BigTIFF");
+    CheckTiff(MakeTiff(true, true).Bytes(), L"BigTIFF");
+}
+
+TEST_CASE(TiffStructure, ChainLoop)
+{
+    CTiffBuilder tiff(false, false);
+    const uint32_t ifd0 = tiff.AddIfd({ { 0x0100, TypeShort, 1, tiff.Short(1) } });
+    const uint32_t ifd1 = tiff.AddIfd({ { 0x0100, TypeShort, 1, tiff.Short(2) } });
+    tiff.SetFirstIfd(ifd0);
+    tiff.SetNextIfd(ifd0, ifd1);
+    tiff.SetNextIfd(ifd1, ifd0);
+
+    StructureNode root;
+    CHECK(ParseTiffStructure(tiff.Bytes().data(), tiff.Bytes().size(), root));
+    CHECK(GetValue(root, L"IFDs") == L"2");
+
+    const StructureNode *loop = FindNode(root, L"IFD2");
+    CHECK((nullptr != loop) && (GetValue(*loop, L"Error") == L"The IFD was already read; the file has a loop"));
+}
+
+TEST_CASE(TiffStructure, SelfLoop)
+{
+    CTiffBuilder tiff(true, true);
+    const uint32_t ifd0 = tiff.AddIfd({ { 0x0100, TypeShort, 1, tiff.Short(1) } });
+    tiff.SetFirstIfd(ifd0);
+    tiff.SetNextIfd(ifd0, ifd0);
+
+    StructureNode root;
+    CHECK(ParseTiffStructure(tiff.Bytes().data(), tiff.Bytes().size(), root));
+    CHECK(GetValue(root, L"IFDs") == L"1");
+    CHECK(1 == CountErrors(root));
+}
+
+TEST_CASE(TiffStructure, PointerLoop)
+{
+    // The Exif IFD points at itself, and IFD0 is also named as a SubIFD of itself
+    CTiffBuilder tiff(false, false);
+    const auto exif = static_cast<uint32_t>(tiff.GetSize());
+    tiff.AddIfd({ { 0x8769, TypeLong, 1, tiff.Long({exif}) } });
+    const auto ifd0 = static_cast<uint32_t>(tiff.GetSize());
+    tiff.AddIfd({
+        { 0x014A, TypeLong, 1, tiff.Long({ifd0}) },
+        { 0x8769, TypeLong, 1, tiff.Long({exif}) },
+    });
+    tiff.SetFirstIfd(ifd0);
+
+    StructureNode root;
+    CHECK(ParseTiffStructure(tiff.Bytes().data(), tiff.Bytes().size(), root));
+    CHECK(GetValue(root, L"IFDs") == L"1");
+    CHECK(2 == CountErrors(root));
+}
+
+TEST_CASE(TiffStructure, Outside)
+{
+    CTiffBuilder tiff(false, false);
+    const uint32_t ifd0 = tiff.AddIfd({
+        { 0x0111, TypeLong, 1, tiff.Long({1000}) },
+        { 0x0117, TypeLong, 1, tiff.Long({50}) },
+        { 0x8769, TypeLong, 1, tiff.Long({5000}) },
+        // Out of order, after ExifIFD
+        { 0x0100, TypeShort, 1, tiff.Short(1) },
+    });
+    tiff.SetFirstIfd(ifd0);
+    tiff.SetNextIfd(ifd0, 0x7FFFFFF0);
+
+    StructureNode root;
+    CHECK(ParseTiffStructure(tiff.Bytes().data(), tiff.Bytes().size(), root));
+
+    const StructureNode *strip = FindNode(root, L"Strip 0");
+    CHECK((nullptr != strip) && (GetValue(*strip, L"Error") == L"The data lies outside of the file"));
+
+    const StructureNode *exif = FindNode(root, L"Exif IFD");
+    CHECK((nullptr != exif) && (GetValue(*exif, L"Error") == L"The IFD lies outside of the data"));
+
+    const StructureNode *width = FindNode(root, L"0x0100 ImageWidth");
+    CHECK((nullptr != width) && (GetValue(*width, L"Error") == L"The entries are not sorted by tag"));
+
+    const StructureNode *next = FindNode(root, L"IFD1");
+    CHECK((nullptr != next) && (GetValue(*next, L"Error") == L"The IFD lies outside of the data"));
+}
+
+TEST_CASE(TiffStructure, Truncated)
+{
+    CheckEveryPrefix(MakeTiff(false, false).Bytes());
+    CheckEveryPrefix(MakeTiff(true, true).Bytes());
+}
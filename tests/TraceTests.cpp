@@ -0,0 +1,173 @@
+﻿//----------------------------------------------------------------------------------------
+// THIS CODE AND INFORMATION IS PROVIDED "AS-IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//----------------------------------------------------------------------------------------
+#include "TestCheck.h"
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // What CTrace::Write writes, read back from a temporary file
+    std::string WriteTrace()
+    {
+        FILE *file = std::tmpfile();
+        CHECK(nullptr != file);
+        if (nullptr == file)
+        {
+            return std::string();
+        }
+
+        CHECK(CTrace::Inst().Write(file));
+
+        std::string text;
+        std::rewind(file);
+        for (int c = std::fgetc(file); EOF != c; c = std::fgetc(file))
+        {
+            text += static_cast<char>(c);
+        }
+        std::fclose(file);
+
+        return text;
+    }
+
+    // The value of a numeric field of the event with the given name
+    double EventValue(const std::string &trace, const char *name, const char *field)
+    {
+        const size_t event = trace.find(std::string("{\"name\":\"") + name + "\"");
+        CHECK(std::string::npos != event);
+        if (std::string::npos == event)
+        {
+            return -1;
+        }
+
+        const size_t value = trace.find(std::string(",\"") + field + "\":", event);
+        CHECK(std::string::npos != value);
+        if (std::string::npos == value)
+        {
+            return -1;
+        }
+
+        return std::strtod(trace.c_str() + value + std::strlen(field) + 4, nullptr);
+    }
+
+    size_t CountEvents(const std::string &trace)
+    {
+        size_t count = 0;
+        for (size_t at = trace.find("{\"name\":"); std::string::npos != at; at = trace.find("{\"name\":", at + 1))
+        {
+            count++;
+        }
+
+        return count;
+    }
+}
+
+TEST_CASE(Trace, Disabled)
+{
+    CTrace::Inst().Clear();
+    CTrace::Inst().Enable(false);
+
+    {
+        CTraceSpan span("Load", L"a.png");
+    }
+
+    CHECK(WriteTrace() == "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n]}\n");
+
+    // A span begun while tracing was off is not recorded when it is turned on
+    {
+        CTraceSpan span("Load");
+        CTrace::Inst().Enable(true);
+    }
+    CTrace::Inst().Enable(false);
+    CHECK(0 == CountEvents(WriteTrace()));
+}
+
+TEST_CASE(Trace, Times)
+{
+    CTrace::Inst().Clear();
+
+    // Timestamps start from the earliest span, and both are in microseconds
+    CTrace::Inst().AddSpan("late", std::string(), 2000000, 2000500);
+    CTrace::Inst().AddSpan("early", std::string(), 1000000, 3500000);
+
+    const std::string trace = WriteTrace();
+    CHECK(2 == CountEvents(trace));
+    CHECK(trace.find("{\"name\":\"late\",\"ph\":\"X\",\"pid\":1,") != std::string::npos);
+    CHECK(1000.0 == EventValue(trace, "late", "ts"));
+    CHECK(0.5 == EventValue(trace, "late", "dur"));
+    CHECK(0.0 == EventValue(trace, "early", "ts"));
+    CHECK(2500.0 == EventValue(trace, "early", "dur"));
+
+    CTrace::Inst().Clear();
+}
+
+TEST_CASE(Trace, Nesting)
+{
+    CTrace::Inst().Clear();
+    CTrace::Inst().Enable(true);
+
+    {
+        CTraceSpan outer("Open", L"dir");
+        {
+            CTraceSpan inner("Load", L"a.png");
+        }
+        {
+            CTraceSpan inner("Render");
+        }
+    }
+
+    CTrace::Inst().Enable(false);
+    const std::string trace = WriteTrace();
+    CTrace::Inst().Clear();
+
+    CHECK(3 == CountEvents(trace));
+
+    // The inner spans lie within the outer one, one after the other, on its thread
+    const double outerStart = EventValue(trace, "Open", "ts");
+    const double outerEnd = outerStart + EventValue(trace, "Open", "dur");
+    const double loadStart = EventValue(trace, "Load", "ts");
+    const double loadEnd = loadStart + EventValue(trace, "Load", "dur");
+    const double renderStart = EventValue(trace, "Render", "ts");
+    const double renderEnd = renderStart + EventValue(trace, "Render", "dur");
+
+    CHECK((outerStart <= loadStart) && (loadEnd <= renderStart) && (renderEnd <= outerEnd));
+    CHECK(EventValue(trace, "Open", "tid") == EventValue(trace, "Load", "tid"));
+    CHECK(EventValue(trace, "Open", "tid") == EventValue(trace, "Render", "tid"));
+
+    // Only spans with a detail have args
+    CHECK(trace.find("\"args\":{\"detail\":\"dir\"}") != std::string::npos);
+    CHECK(trace.find("\"args\":{\"detail\":\"a.png\"}") != std::string::npos);
+    const size_t render = trace.find("{\"name\":\"Render\"");
+    CHECK(std::string::npos == trace.substr(render, trace.find('\n', render) - render).find("\"args\""));
+}
+
+TEST_CASE(Trace, Escaping)
+{
+    CTrace::Inst().Clear();
+    CTrace::Inst().Enable(true);
+
+    {
+        CTraceSpan span("Load", L"C:\\images\\\"quoted\"\tname\n\u00e9\u20ac.png");
+    }
+
+    CTrace::Inst().Enable(false);
+    const std::string trace = WriteTrace();
+    CTrace::Inst().Clear();
+
+    // Quotes, backslashes and control characters are escaped, and the rest is UTF-8
+    CHECK(trace.find("\"detail\":\"C:\\\\images\\\\\\\"quoted\\\"\\u0009name\\u000a\xC3\xA9\xE2\x82\xAC.png\"")
+        != std::string::npos);
+
+    CHECK(CTrace::ToUtf8(L"a\u00e9") == "a\xC3\xA9");
+    CHECK(CTrace::ToUtf8(L"") == "");
+    // A character outside the BMP, which is a surrogate pair where wchar_t is 16 bits
+    CHECK(CTrace::ToUtf8(L"\U0001F600") == "\xF0\x9F\x98\x80");
+}